@@ -5,49 +5,42 @@
 #include "ABC150CANHandler.hpp"
 #include "esp_log.h"
 #include <sstream>
-#include "TimeUtils.hpp"
-
-#define DATA_A                      0x100 // PPS → PC's
-#define DATA_B                      0x120 // PPS → PC's
-
-#define LOWER_LIMITS_A              0x101 // PPS → PC's
-#define UPPER_LIMITS_A              0x102 // PPS → PC's
-#define CONNECTOR_STATUS_NEGATIVE   0x01
-#define CONNECTOR_STATUS_POSITIVE   0x02
-#define CONNECTOR_STATUS_INTERLOCK  0x04
-#define STATUS_A                    0x103  // PPS → PC's
-#define STATION_ID_A                0x104  // PPS → PC's
-
-#define LOWER_LIMITS_B              0x121  // PPS → PC's
-#define UPPER_LIMITS_B              0x122  // PPS → PC's
-#define STATUS_B                    0x123  // PPS → PC's
-#define STATION_ID_B                0x124  // PPS → PC's
-
-
-#define GREETING                    0x140  // PPS → xxx
-#define PC_GREETING                 0x1C0  // PC → PPS
-#define FAULT_DATA                  0x141  // PPS → PC's
-#define PACKET_PROBLEM              0x142  // PPS → PC's
-#define COMMAND_A                   0x180  // PC → PPS
-#define LOWER_LIMITS_A_OUT          0x181  // PC → PPS
-#define UPPER_LIMITS_A_OUT          0x182  // PC → PPS
-#define COMMAND_B                   0x1A0  // PC → PPS
-#define LOWER_LIMITS_B_OUT          0x1A1  // PC → PPS
-#define UPPER_LIMIT_B_OUT           0x1A2  // PC → PPS
-#define CHANGE_CONTROL              0x1C1  // PC → PPS
-#define RVS_MODE_REQUEST            0x1C2  // PC → PPS
-#define REQUEST_PC                  0x160  // xxx → PC's
-#define REQUEST_ABC                 0x1E0  // xxx → PPS
-
-#define CONTROL_MODE                (0b11)
-#define NORMAL_MODE                 (0b100)
-#define ENABLE_MODE                 (0b1000)
-#define LOAD_MODE                   (0b110000)
-#define RVS_MODE                    (0b1000000)
-#define VOLTAGE_SCALE               (0.02)
-#define CURRENT_SCALE               (0.02)
-#define POWER_SCALE                 (5)
-
+#include "OSPort.hpp"
+#include "ABC150Codec.hpp"
+
+#define SEND_MIN_INTERVAL_MS        10
+/* MCP2515 transmit buffers */
+#define TX_MAILBOXES                3
+/* Time for the bus to drain full mailboxes, 3 frames at 250 kbps take 1.5 ms. In ticks, n ticks may be
+ * as little as n - 1 ms. */
+#define TX_DRAIN_TIME_MS            3
+/* Command, lower limits and upper limits */
+#define PACKAGE_FRAMES              3
+#define ABC150_BIT_RATE             250000
+/* Lines of the binary statistics dump */
+#define STATS_DUMP_LINE_BYTES       32
+/* Telemetry age at which running tests fail, DATA is sent every 10 ms and STATUS every 100 ms */
+#define TELEMETRY_STALE_MS          500
+#define EVENT_STACK_SIZE            3072
+#define EVENT_PERIOD_MS             10
+
+const ABC150CANHandler::Route ABC150CANHandler::routes[] = {
+    {DATA_A,          A, &ABC150CANHandler::handleData,          "DATA_A"},
+    {DATA_B,          B, &ABC150CANHandler::handleData,          "DATA_B"},
+    {STATUS_A,        A, &ABC150CANHandler::handleStatus,        "STATUS_A"},
+    {STATUS_B,        B, &ABC150CANHandler::handleStatus,        "STATUS_B"},
+    {LOWER_LIMITS_A,  A, &ABC150CANHandler::handleLowerLimits,   "LOWER_LIMITS_A"},
+    {UPPER_LIMITS_A,  A, &ABC150CANHandler::handleUpperLimits,   "UPPER_LIMITS_A"},
+    {STATION_ID_A,    A, &ABC150CANHandler::handleStationID,     "STATION_ID_A"},
+    {LOWER_LIMITS_B,  B, &ABC150CANHandler::handleLowerLimits,   "LOWER_LIMITS_B"},
+    {UPPER_LIMITS_B,  B, &ABC150CANHandler::handleUpperLimits,   "UPPER_LIMITS_B"},
+    {STATION_ID_B,    B, &ABC150CANHandler::handleStationID,     "STATION_ID_B"},
+    {GREETING,        A, &ABC150CANHandler::handleGreeting,      "GREETING"},
+    {FAULT_DATA,      A, &ABC150CANHandler::handleFaultData,     "FAULT_DATA"},
+    {PACKET_PROBLEM,  A, &ABC150CANHandler::handlePacketProblem, "PACKET_PROBLEM"},
+    {REQUEST_PC,      A, &ABC150CANHandler::handleRequestPC,     "REQUEST_PC"},
+    {0,               A, NULL,                                   NULL}
+};
 
 ABC150CANHandler::ABC150CANHandler(AmpleCAN &_can):
                                   ampleCAN(_can),
@@ -57,21 +50,27 @@ ABC150CANHandler::ABC150CANHandler(AmpleCAN &_can):
                                   problemID(0),
                                   suppID(0),
                                   abcDetected(false),
-								                  xFrequency(500){
-  ampleCAN.registerListener(DATA_A, this);
-  ampleCAN.registerListener(DATA_B, this);
-  ampleCAN.registerListener(LOWER_LIMITS_A, this);
-  ampleCAN.registerListener(UPPER_LIMITS_A, this);
-  ampleCAN.registerListener(STATUS_A, this);
-  ampleCAN.registerListener(STATION_ID_A, this);
-  ampleCAN.registerListener(LOWER_LIMITS_B, this);
-  ampleCAN.registerListener(UPPER_LIMITS_B, this);
-  ampleCAN.registerListener(STATUS_B, this);
-  ampleCAN.registerListener(STATION_ID_B, this);
-  ampleCAN.registerListener(GREETING, this);
-  ampleCAN.registerListener(FAULT_DATA, this);
-  ampleCAN.registerListener(PACKET_PROBLEM, this);
-  ampleCAN.registerListener(REQUEST_PC, this);
+                                  sendTaskHandle(NULL),
+                                  xFrequency(500),
+                                  xMinSendInterval(SEND_MIN_INTERVAL_MS),
+                                  txMutex(OSPort::createMutex()),
+                                  txPending(0),
+                                  txLastWrite(0),
+                                  greetingPending(false),
+                                  stats(ABC150_BIT_RATE),
+                                  watchdog(TELEMETRY_STALE_MS),
+                                  reportedEventDrops(0),
+                                  eventTaskHandle(NULL){
+  for (uint8_t i = 0; routes[i].handler != NULL; i++) {
+    ampleCAN.registerListener(routes[i].id, this);
+    routeIndex[routes[i].id - RECEIVE_ID_BASE] = i + 1;
+    acceptance.add(routes[i].id);
+    /* Statistics slots in route order */
+    stats.addID(routes[i].id, routes[i].name);
+  }
+  if (acceptance.compile()) {
+    acceptance.print();
+  }
 
   channelInfo[A].controlModeOut = Standby;
   channelInfo[A].loadModeOut = Independent;
@@ -80,9 +79,14 @@ ABC150CANHandler::ABC150CANHandler(AmpleCAN &_can):
 
 
   /* Create send task */
-  if (xTaskCreate(&ABC150CANHandler::sendTaskWrapper, "ABC150 send", 4096, this, configMAX_PRIORITIES-2, &sendTaskHandle) != pdPASS){
+  if (!OSPort::createTask(&ABC150CANHandler::sendTaskWrapper, "ABC150 send", 4096, this, OSPORT_MAX_PRIORITIES-2, &sendTaskHandle)){
     ESP_LOGE(TAG, "Failed to create ABC150 Send Task");
   }
+  /* Below the tests, events are only logged */
+  if (!OSPort::createTask(&ABC150CANHandler::eventTaskWrapper, "ABC150 events", EVENT_STACK_SIZE, this, 1,
+                          &eventTaskHandle)){
+    ESP_LOGE(TAG, "Failed to create ABC150 Event Task");
+  }
 
   //sendPCGreeting();
   sendRequestABCPackage();
@@ -90,7 +94,10 @@ ABC150CANHandler::ABC150CANHandler(AmpleCAN &_can):
 
 
 ABC150CANHandler::~ABC150CANHandler() {
-  vTaskDelete(sendTaskHandle);
+  OSPort::deleteTask(sendTaskHandle);
+  if (eventTaskHandle != NULL) {
+    OSPort::deleteTask(eventTaskHandle);
+  }
 }
 
 bool ABC150CANHandler::channelCheck(Channel channel) {
@@ -103,37 +110,43 @@ bool ABC150CANHandler::channelCheck(Channel channel) {
 
 bool ABC150CANHandler::setLowerVoltageLimit(Channel channel, float voltage) {
   if (!channelCheck(channel)) return false;
-  channelInfo[channel].lowerVoltageLimitOut = voltage;
+  channelInfo[channel].lowerVoltageLimitOut = ABC150Units::fromVolts(voltage);
+  notifySend();
   return true;
 }
 
 bool ABC150CANHandler::setLowerCurrentLimit(Channel channel, float current) {
   if (!channelCheck(channel)) return false;
-  channelInfo[channel].lowerCurrentLimitOut = current;
+  channelInfo[channel].lowerCurrentLimitOut = ABC150Units::fromAmps(current);
+  notifySend();
   return true;
 }
 
 bool ABC150CANHandler::setLowerPowerLimit(Channel channel, float power) {
   if (!channelCheck(channel)) return false;
-  channelInfo[channel].lowerPowerLimitOut = power;
+  channelInfo[channel].lowerPowerLimitOut = ABC150Units::fromWatts(power);
+  notifySend();
   return true;
 }
 
 bool ABC150CANHandler::setUpperVoltageLimit(Channel channel, float voltage) {
   if (!channelCheck(channel)) return false;
-  channelInfo[channel].upperVoltageLimitOut = voltage;
+  channelInfo[channel].upperVoltageLimitOut = ABC150Units::fromVolts(voltage);
+  notifySend();
   return true;
 }
 
 bool ABC150CANHandler::setUpperCurrentLimit(Channel channel, float current) {
   if (!channelCheck(channel)) return false;
-  channelInfo[channel].upperCurrentLimitOut = current;
+  channelInfo[channel].upperCurrentLimitOut = ABC150Units::fromAmps(current);
+  notifySend();
   return true;
 }
 
 bool ABC150CANHandler::setUpperPowerLimit(Channel channel, float power) {
   if (!channelCheck(channel)) return false;
-  channelInfo[channel].upperPowerLimitOut = power;
+  channelInfo[channel].upperPowerLimitOut = ABC150Units::fromWatts(power);
+  notifySend();
   return true;
 }
 
@@ -143,144 +156,154 @@ void ABC150CANHandler::setControlMode(Channel channel, ControlMode controlMode)
 
 bool ABC150CANHandler::setVoltage(Channel channel, float voltage) {
   if (!channelCheck(channel)) return false;
-  channelInfo[channel].commandOut = voltage;
+  channelInfo[channel].commandOut = ABC150Units::fromVolts(voltage);
   setControlMode(channel, Voltage);
+  notifySend();
   return true;
 }
 
 bool ABC150CANHandler::setCurrent(Channel channel, float current) {
   if (!channelCheck(channel)) return false;
-  channelInfo[channel].commandOut = current;
+  channelInfo[channel].commandOut = ABC150Units::fromAmps(current);
   setControlMode(channel, Current);
+  notifySend();
   return true;
 }
 
 void ABC150CANHandler::sendPackage(Channel channel) {
-	  sendCommandPackage(channel);
-	  vTaskDelay(pdMS_TO_TICKS(1));
-	  sendLowerLimits(channel);
-	  vTaskDelay(pdMS_TO_TICKS(1));
-	  sendUpperLimits(channel);
-	  vTaskDelay(pdMS_TO_TICKS(1));
+  CAN_frame_t frames[PACKAGE_FRAMES];
+  /* All frames of a package carry the same counter stamp */
+  buildCommandFrame(channel, frames[0]);
+  buildLowerLimitsFrame(channel, frames[1]);
+  buildUpperLimitsFrame(channel, frames[2]);
+  channelInfo[channel].counterStamp++;
+  writeFrames(frames, PACKAGE_FRAMES);
+}
+
+void ABC150CANHandler::writeFrames(const CAN_frame_t *frames, int count) {
+  OSPort::lock(txMutex);
+  while (count > 0) {
+    /* Fill the free transmit buffers in one driver call, wait only when all may still be full */
+    if ((OSPort::getTickMs() - txLastWrite) >= TX_DRAIN_TIME_MS) {
+      txPending = 0;
+    } else if (txPending >= TX_MAILBOXES) {
+      OSPort::delay(TX_DRAIN_TIME_MS);
+      txPending = 0;
+    }
+    int batch = TX_MAILBOXES - txPending;
+    if (batch > count) {
+      batch = count;
+    }
+    ampleCAN.can.writeFrames(frames, batch);
+    for (int i = 0; i < batch; i++) {
+      stats.transmitted(frames[i].FIR.B.DLC);
+    }
+    frames += batch;
+    count -= batch;
+    txPending += batch;
+    stats.queued(txPending);
+    txLastWrite = OSPort::getTickMs();
+  }
+  OSPort::unlock(txMutex);
 }
 
 bool ABC150CANHandler::setPower(Channel channel, float power) {
   if (!channelCheck(channel)) return false;
-  channelInfo[channel].commandOut = power;
+  channelInfo[channel].commandOut = ABC150Units::fromWatts(power);
   setControlMode(channel, Power);
+  notifySend();
   return true;
 }
 
 bool ABC150CANHandler::setLoadMode(Channel channel, LoadMode loadMode) {
   if (!channelCheck(channel)) return false;
   channelInfo[channel].loadModeOut = loadMode;
+  notifySend();
   return true;
 }
 
 std::string ABC150CANHandler::getPacketProblemString(uint8_t problem, uint8_t supp) {
   std::stringstream ss;
-      if (suppID == 0) ss << "Channel A\t";
-      else if (suppID == 1) ss << "Channel B\t";
-      else ss << "Channel Unknown\t";
+  ss << getSuppName(supp) << "\t" << getPacketProblemName(problem) << std::endl;
+  return ss.str();
+}
 
-      switch (problem) {
-      case Command_out_of_limits :
-        ss << "Command_out_of_limits";
-        break;
-      case UVL_too_high :
-        ss << "UVL_too_high";
-        break;
-      case UVL_too_low :
-        ss << "UVL_too_low";
-        break;
-      case LVL_too_high :
-        ss << "LVL_too_high";
-        break;
-      case LVL_too_low :
-        ss << "LVL_too_low";
-        break;
-      case UCL_too_high :
-        ss << "UCL_too_high";
-        break;
-      case UCL_too_low :
-        ss << "UCL_too_low";
-        break;
-      case LCL_too_high :
-        ss << "LCL_too_high";
-        break;
-      case LCL_too_low :
-        ss << "LCL_too_low";
-        break;
-      case UPL_too_high :
-        ss << "UPL_too_high";
-        break;
-      case UPL_too_low :
-        ss << "UPL_too_low";
-        break;
-      case LPL_too_high :
-        ss << "LPL_too_high";
-        break;
-      case LPL_too_low :
-        ss << "LPL_too_low";
-        break;
-      case Invalid_config :
-        ss << "Invalid_config";
-        break;
-      case Invalid_mode :
-        ss << "Invalid_mode";
-        break;
-      case UV_lower_than_LV :
-        ss << "UV_lower_than_LV";
-        break;
-      case UI_lower_than_LI :
-        ss << "UI_lower_than_LI";
-        break;
-      case UP_lower_than_LP :
-        ss << "UP_lower_than_LP";
-        break;
-      case Invalid_control_source :
-        ss << "Invalid_control_source";
-        break;
-      case Invalid_mode1 :
-        ss << "Invalid_mode1";
-        break;
-      case Not_in_remote_control :
-        ss << "Not_in_remote_control";
-        break;
-      case Invalid_station_id_received :
-        ss << "Invalid_station_id_received";
-        break;
-      case load_v_incompatible :
-        ss << "load_v_incompatible";
-        break;
-      case power_allocation_erro :
-        ss << "power_allocation_erro";
-        break;
-      case too_much_command :
-        ss << "too_much_command";
-        break;
-      case out_of_op_space :
-        ss << "out_of_op_space";
-        break;
-      case invalid_channel :
-        ss << "invalid_channel";
-        break;
-      case invalid_sw_version :
-        ss << "invalid_sw_version";
-        break;
-      case wrong_length :
-        ss << "wrong_length";
-        break;
-      case unknown_type :
-        ss << "unknown_type";
-        break;
-      default:
-        ss << "Problem not in list";
-        break;
-      }
-      ss << std::endl;
+const char *ABC150CANHandler::getSuppName(uint8_t supp) {
+  switch (supp) {
+  case channel_A:
+    return "Channel A";
+  case channel_B:
+    return "Channel B";
+  default:
+    return "Channel Unknown";
+  }
+}
 
-      return ss.str();
+const char *ABC150CANHandler::getPacketProblemName(uint8_t problem) {
+  switch (problem) {
+  case Command_out_of_limits:
+    return "Command_out_of_limits";
+  case UVL_too_high:
+    return "UVL_too_high";
+  case UVL_too_low:
+    return "UVL_too_low";
+  case LVL_too_high:
+    return "LVL_too_high";
+  case LVL_too_low:
+    return "LVL_too_low";
+  case UCL_too_high:
+    return "UCL_too_high";
+  case UCL_too_low:
+    return "UCL_too_low";
+  case LCL_too_high:
+    return "LCL_too_high";
+  case LCL_too_low:
+    return "LCL_too_low";
+  case UPL_too_high:
+    return "UPL_too_high";
+  case UPL_too_low:
+    return "UPL_too_low";
+  case LPL_too_high:
+    return "LPL_too_high";
+  case LPL_too_low:
+    return "LPL_too_low";
+  case Invalid_config:
+    return "Invalid_config";
+  case Invalid_mode:
+    return "Invalid_mode";
+  case UV_lower_than_LV:
+    return "UV_lower_than_LV";
+  case UI_lower_than_LI:
+    return "UI_lower_than_LI";
+  case UP_lower_than_LP:
+    return "UP_lower_than_LP";
+  case Invalid_control_source:
+    return "Invalid_control_source";
+  case Invalid_mode1:
+    return "Invalid_mode1";
+  case Not_in_remote_control:
+    return "Not_in_remote_control";
+  case Invalid_station_id_received:
+    return "Invalid_station_id_received";
+  case load_v_incompatible:
+    return "load_v_incompatible";
+  case power_allocation_erro:
+    return "power_allocation_erro";
+  case too_much_command:
+    return "too_much_command";
+  case out_of_op_space:
+    return "out_of_op_space";
+  case invalid_channel:
+    return "invalid_channel";
+  case invalid_sw_version:
+    return "invalid_sw_version";
+  case wrong_length:
+    return "wrong_length";
+  case unknown_type:
+    return "unknown_type";
+  default:
+    return "Problem not in list";
+  }
 }
 
 std::string ABC150CANHandler::getControlModeString(ControlMode controlMode) {
@@ -310,65 +333,66 @@ std::string ABC150CANHandler::getLoadModeString(LoadMode loadMode) {
 void ABC150CANHandler::printInfo() {
   std::stringstream ss;
   for (int i = 0; i < 2; i++) {
+    Telemetry telemetry = getTelemetry((Channel)i);
     ss << "*****************************************" << std::endl;
     ss << "\n\n\r\tChannel " << i << std::endl;
-    ss << "Voltage: " << channelInfo[i].voltage << std::endl;
-    ss << "Current: " << channelInfo[i].current << std::endl;
-    ss << "timestamp: " << channelInfo[i].timestamp << std::endl;
+    ss << "Voltage: " << telemetry.voltage << std::endl;
+    ss << "Current: " << telemetry.current << std::endl;
+    ss << "timestamp: " << telemetry.timestamp << std::endl;
     ss << "lowerVoltageLimit: " << channelInfo[i].lowerVoltageLimit << std::endl;
     ss << "lowerCurrentLimit: " << channelInfo[i].lowerCurrentLimit << std::endl;
     ss << "lowerPowerLimit: " << channelInfo[i].lowerPowerLimit << std::endl;
     ss << "upperVoltageLimit: " << channelInfo[i].upperVoltageLimit << std::endl;
     ss << "upperCurrentLimit: " << channelInfo[i].upperCurrentLimit << std::endl;
     ss << "upperPowerLimit: " << channelInfo[i].upperPowerLimit << std::endl;
-    ss << "command: " << channelInfo[i].command << std::endl;
+    ss << "command: " << telemetry.command << std::endl;
 
     ss << "converterStatus: ";
-    if (channelInfo[i].converterStatus == Local) {
+    if (telemetry.converterStatus == Local) {
       ss << "Local" << std::endl;
-    } else if (channelInfo[i].converterStatus == Remote) {
+    } else if (telemetry.converterStatus == Remote) {
       ss << "Remote" << std::endl;
-    } else if (channelInfo[i].converterStatus == J1850) {
+    } else if (telemetry.converterStatus == J1850) {
       ss << "J1850" << std::endl;
     } else ss << "Unknown" << std::endl;
 
     ss << "controlMode: ";
-    ss << getControlModeString(channelInfo[i].controlMode);
+    ss << getControlModeString(telemetry.controlMode);
 
     ss << "normalMode: ";
-    if (channelInfo[i].normalMode == Normal) {
+    if (telemetry.normalMode == Normal) {
       ss << "Normal" << std::endl;
-    } else if (channelInfo[i].normalMode == Protected_Standby) {
+    } else if (telemetry.normalMode == Protected_Standby) {
       ss << "Protected_Standby" << std::endl;
     } else ss << "Unknown" << std::endl;
 
     ss << "enableMode: ";
-    if (channelInfo[i].enableMode == Enabled) {
+    if (telemetry.enableMode == Enabled) {
       ss << "Enabled" << std::endl;
-    } else if (channelInfo[i].enableMode == Disabled) {
+    } else if (telemetry.enableMode == Disabled) {
       ss << "Disabled" << std::endl;
     } else ss << "Unknown" << std::endl;
 
     ss << "loadMode: ";
-    ss << getLoadModeString(channelInfo[i].loadMode);
+    ss << getLoadModeString(telemetry.loadMode);
 
     ss << "rvsMode: ";
-    if (channelInfo[i].rvsMode == RVS_off) {
+    if (telemetry.rvsMode == RVS_off) {
       ss << "RVS_off" << std::endl;
-    } else if (channelInfo[i].rvsMode == RVS_on) {
+    } else if (telemetry.rvsMode == RVS_on) {
       ss << "RVS_on" << std::endl;
     } else ss << "Unknown" << std::endl;
 
     ss << "stationID: " << channelInfo[i].stationID << std::endl;
     ss << "stationIDSet: " << channelInfo[i].stationIDSet << std::endl;
     ss << "counterStamp: " << (int)channelInfo[i].counterStamp << std::endl;
-    ss << "lowerVoltageLimitOut: " << channelInfo[i].lowerVoltageLimitOut << std::endl;
-    ss << "lowerCurrentLimitOut: " << channelInfo[i].lowerCurrentLimitOut << std::endl;
-    ss << "lowerPowerLimitOut: " << channelInfo[i].lowerPowerLimitOut << std::endl;
-    ss << "upperVoltageLimitOut: " << channelInfo[i].upperVoltageLimitOut << std::endl;
-    ss << "upperCurrentLimitOut: " << channelInfo[i].upperCurrentLimitOut << std::endl;
-    ss << "upperPowerLimitOut: " << channelInfo[i].upperPowerLimitOut << std::endl;
-    ss << "commandOut: " << channelInfo[i].commandOut << std::endl;
+    ss << "lowerVoltageLimitOut: " << ABC150Units::toVolts(channelInfo[i].lowerVoltageLimitOut) << std::endl;
+    ss << "lowerCurrentLimitOut: " << ABC150Units::toAmps(channelInfo[i].lowerCurrentLimitOut) << std::endl;
+    ss << "lowerPowerLimitOut: " << ABC150Units::toWatts(channelInfo[i].lowerPowerLimitOut) << std::endl;
+    ss << "upperVoltageLimitOut: " << ABC150Units::toVolts(channelInfo[i].upperVoltageLimitOut) << std::endl;
+    ss << "upperCurrentLimitOut: " << ABC150Units::toAmps(channelInfo[i].upperCurrentLimitOut) << std::endl;
+    ss << "upperPowerLimitOut: " << ABC150Units::toWatts(channelInfo[i].upperPowerLimitOut) << std::endl;
+    ss << "commandOut (mV, cA or W): " << channelInfo[i].commandOut << std::endl;
 
     ss << "controlModeOut: ";
     ss << getControlModeString(channelInfo[i].controlModeOut);
@@ -394,275 +418,240 @@ void ABC150CANHandler::printInfo() {
 }
 
 void ABC150CANHandler::handleData(Channel channel, CAN_frame_t &msg) {
-  channelInfo[channel].voltage = ((int16_t)((uint16_t)msg.data.u8[0] << 8) | (uint16_t)msg.data.u8[1]) * VOLTAGE_SCALE;
-  channelInfo[channel].current = ((int16_t)((uint16_t)msg.data.u8[2] << 8) | (uint16_t)msg.data.u8[3]) * CURRENT_SCALE;
-  channelInfo[channel].timestamp = (((uint32_t)msg.data.u8[4] << 24) |
-                                    ((uint32_t)msg.data.u8[5] << 16) |
-                                    ((uint32_t)msg.data.u8[6] << 8) |
-                                     (uint32_t)msg.data.u8[7]);
+  int64_t raws[ABC150Codec::DATA_FIELDS];
+  Telemetry &received = channelInfo[channel].received;
+  ABC150Codec::decodeRaw(ABC150Codec::DATA_LAYOUT, msg.data.u8, raws);
+  received.voltage = ABC150Units::toVolts(ABC150Units::voltageFromWire(raws[ABC150Codec::DATA_VOLTAGE]));
+  received.current = ABC150Units::toAmps(ABC150Units::currentFromWire(raws[ABC150Codec::DATA_CURRENT]));
+  received.timestamp = raws[ABC150Codec::DATA_TIMESTAMP];
+  channelInfo[channel].telemetry.write(received);
+  watchdog.data(channel, received.timestamp);
 }
 
 void ABC150CANHandler::handleLowerLimits(Channel channel, CAN_frame_t &msg) {
-  channelInfo[channel].lowerVoltageLimit = ((int16_t)((uint16_t)msg.data.u8[0] << 8) | (uint16_t)msg.data.u8[1]) * VOLTAGE_SCALE;
-  channelInfo[channel].lowerCurrentLimit = ((int16_t)((uint16_t)msg.data.u8[2] << 8) | (uint16_t)msg.data.u8[3]) * CURRENT_SCALE;
-  channelInfo[channel].lowerPowerLimit = ((int16_t)((uint16_t)msg.data.u8[4] << 8) | (uint16_t)msg.data.u8[5]) * POWER_SCALE;
+  int64_t raws[ABC150Codec::LIMITS_FIELDS];
+  ABC150Codec::decodeRaw(ABC150Codec::LIMITS_LAYOUT, msg.data.u8, raws);
+  channelInfo[channel].lowerVoltageLimit = ABC150Units::toVolts(ABC150Units::voltageFromWire(raws[ABC150Codec::LIMITS_VOLTAGE]));
+  channelInfo[channel].lowerCurrentLimit = ABC150Units::toAmps(ABC150Units::currentFromWire(raws[ABC150Codec::LIMITS_CURRENT]));
+  channelInfo[channel].lowerPowerLimit = ABC150Units::toWatts(ABC150Units::powerFromWire(raws[ABC150Codec::LIMITS_POWER]));
 }
 
 void ABC150CANHandler::handleUpperLimits(Channel channel, CAN_frame_t &msg) {
-  channelInfo[channel].upperVoltageLimit = ((int16_t)((uint16_t)msg.data.u8[0] << 8) | (uint16_t)msg.data.u8[1]) * VOLTAGE_SCALE;
-  channelInfo[channel].upperCurrentLimit = ((int16_t)((uint16_t)msg.data.u8[2] << 8) | (uint16_t)msg.data.u8[3]) * CURRENT_SCALE;
-  channelInfo[channel].upperPowerLimit = ((int16_t)((uint16_t)msg.data.u8[4] << 8) | (uint16_t)msg.data.u8[5]) * POWER_SCALE;
+  int64_t raws[ABC150Codec::LIMITS_FIELDS];
+  ABC150Codec::decodeRaw(ABC150Codec::LIMITS_LAYOUT, msg.data.u8, raws);
+  channelInfo[channel].upperVoltageLimit = ABC150Units::toVolts(ABC150Units::voltageFromWire(raws[ABC150Codec::LIMITS_VOLTAGE]));
+  channelInfo[channel].upperCurrentLimit = ABC150Units::toAmps(ABC150Units::currentFromWire(raws[ABC150Codec::LIMITS_CURRENT]));
+  channelInfo[channel].upperPowerLimit = ABC150Units::toWatts(ABC150Units::powerFromWire(raws[ABC150Codec::LIMITS_POWER]));
 }
 
 void ABC150CANHandler::handleStatus(Channel channel, CAN_frame_t &msg) {
-  if ((channelInfo[channel].converterStatus) != (ConverterStatus)msg.data.u8[2]) {
-    ESP_LOGI(TAG, "Converter status changed to %d", msg.data.u8[2]);
+  int64_t raws[ABC150Codec::STATUS_FIELDS];
+  Telemetry &received = channelInfo[channel].received;
+  ABC150Codec::decodeRaw(ABC150Codec::STATUS_LAYOUT, msg.data.u8, raws);
+  ConverterStatus converterStatus = (ConverterStatus)raws[ABC150Codec::STATUS_CONVERTER];
+  if (received.converterStatus != converterStatus) {
+    pushEvent(STATUS_A, channel, converterStatus);
   }
-  channelInfo[channel].converterStatus = (ConverterStatus)msg.data.u8[2];
-  channelInfo[channel].connectorStatusPositive = ((msg.data.u8[4] & CONNECTOR_STATUS_POSITIVE) == CONNECTOR_STATUS_POSITIVE);
-  channelInfo[channel].connectorStatusNegative = ((msg.data.u8[4] & CONNECTOR_STATUS_NEGATIVE) == CONNECTOR_STATUS_NEGATIVE);
-  channelInfo[channel].connectorStatusInterlock = ((msg.data.u8[4] & CONNECTOR_STATUS_INTERLOCK) == CONNECTOR_STATUS_INTERLOCK);
-  channelInfo[channel].controlMode = (ControlMode)(msg.data.u8[3] & CONTROL_MODE);
-  channelInfo[channel].normalMode = (NormalMode)((msg.data.u8[3] & NORMAL_MODE) >> 2);
-  channelInfo[channel].enableMode = (EnableMode)((msg.data.u8[3] & ENABLE_MODE) >> 3);
-  channelInfo[channel].loadMode = (LoadMode)((msg.data.u8[3] & LOAD_MODE) >> 4);
-  channelInfo[channel].rvsMode = (RVSMode)((msg.data.u8[3] & RVS_MODE) >> 6);
-  switch(channelInfo[channel].controlMode) {
+  received.converterStatus = converterStatus;
+  received.connectorStatusPositive = raws[ABC150Codec::STATUS_CONNECTOR_POSITIVE];
+  received.connectorStatusNegative = raws[ABC150Codec::STATUS_CONNECTOR_NEGATIVE];
+  received.connectorStatusInterlock = raws[ABC150Codec::STATUS_CONNECTOR_INTERLOCK];
+  received.controlMode = (ControlMode)raws[ABC150Codec::STATUS_CONTROL_MODE];
+  received.normalMode = (NormalMode)raws[ABC150Codec::STATUS_NORMAL_MODE];
+  received.enableMode = (EnableMode)raws[ABC150Codec::STATUS_ENABLE_MODE];
+  received.loadMode = (LoadMode)raws[ABC150Codec::STATUS_LOAD_MODE];
+  received.rvsMode = (RVSMode)raws[ABC150Codec::STATUS_RVS_MODE];
+  switch(received.controlMode) {
   case Voltage:
+    received.command = ABC150Units::toVolts(ABC150Units::voltageFromWire(raws[ABC150Codec::STATUS_COMMAND]));
+    break;
   case Current:
-    channelInfo[channel].command = ((int16_t)((uint16_t)msg.data.u8[0] << 8) | (uint16_t)msg.data.u8[1]) * VOLTAGE_SCALE;
+    received.command = ABC150Units::toAmps(ABC150Units::currentFromWire(raws[ABC150Codec::STATUS_COMMAND]));
     break;
   case Power:
-    channelInfo[channel].command = ((int16_t)((uint16_t)msg.data.u8[0] << 8) | (uint16_t)msg.data.u8[1]) * POWER_SCALE;
+    received.command = ABC150Units::toWatts(ABC150Units::powerFromWire(raws[ABC150Codec::STATUS_COMMAND]));
     break;
   default:
-    channelInfo[channel].command = ((int16_t)((uint16_t)msg.data.u8[0] << 8) | (uint16_t)msg.data.u8[1]);
+    received.command = raws[ABC150Codec::STATUS_COMMAND];
     break;
   }
+  channelInfo[channel].telemetry.write(received);
+  watchdog.status(channel);
 }
 
 void ABC150CANHandler::handleStationID(Channel channel, CAN_frame_t &msg) {
   if (!channelInfo[channel].stationIDSet) {
-    channelInfo[channel].stationID = (((uint64_t)msg.data.u8[0] << 32) |
-        ((uint64_t)msg.data.u8[1] << 24) |
-        ((uint64_t)msg.data.u8[2] << 16) |
-         ((uint64_t)msg.data.u8[3] << 8) |
-         (msg.data.u8[4]));
+    channelInfo[channel].stationID = ABC150Codec::decodeRaw(ABC150Codec::STATION_ID_LAYOUT.signals[ABC150Codec::STATION_ID], msg.data.u8);
     channelInfo[channel].stationIDSet = true;
   }
 }
 
-void ABC150CANHandler::handleGreeting(CAN_frame_t &msg) {
-  swVersion = (((uint32_t)msg.data.u8[0] << 24) |
-      ((uint32_t)msg.data.u8[1] << 16) |
-       ((uint32_t)msg.data.u8[2] << 8) |
-       (msg.data.u8[3]));
-  hardwareVersion = msg.data.u8[4];
-  if (hardwareVersion == 0x0D) {
-    ESP_LOGI(TAG, "ABC150 Detected");
-    abcDetected = true;
-    return;
-  }  else {
-    ESP_LOGE(TAG, "Hardware Version: %d", hardwareVersion);
-  }
-  abcDetected = false;
+void ABC150CANHandler::handleGreeting(Channel channel, CAN_frame_t &msg) {
+  int64_t raws[ABC150Codec::GREETING_FIELDS];
+  ABC150Codec::decodeRaw(ABC150Codec::GREETING_LAYOUT, msg.data.u8, raws);
+  swVersion = raws[ABC150Codec::GREETING_SW_VERSION];
+  hardwareVersion = raws[ABC150Codec::GREETING_HW_VERSION];
+  abcDetected = hardwareVersion == 0x0D;
+  pushEvent(GREETING, channel, hardwareVersion);
 }
 
-void ABC150CANHandler::handleFaultData(CAN_frame_t &msg) {
-  faultID = msg.data.u8[0];
-  moduleID = msg.data.u8[1];
-  ESP_LOGE(TAG, "Received faultID: %d; moduleID: %d", faultID, moduleID);
+void ABC150CANHandler::handleFaultData(Channel channel, CAN_frame_t &msg) {
+  int64_t raws[ABC150Codec::FAULT_FIELDS];
+  ABC150Codec::decodeRaw(ABC150Codec::FAULT_DATA_LAYOUT, msg.data.u8, raws);
+  faultID = raws[ABC150Codec::FAULT_ID];
+  moduleID = raws[ABC150Codec::FAULT_MODULE_ID];
+  pushEvent(FAULT_DATA, channel, faultID, moduleID);
 }
 
-void ABC150CANHandler::handlePacketProblem(CAN_frame_t &msg) {
-  uint8_t problem = msg.data.u8[0];
-  uint8_t supp = msg.data.u8[1];
+void ABC150CANHandler::handlePacketProblem(Channel channel, CAN_frame_t &msg) {
+  int64_t raws[ABC150Codec::PROBLEM_FIELDS];
+  ABC150Codec::decodeRaw(ABC150Codec::PACKET_PROBLEM_LAYOUT, msg.data.u8, raws);
+  uint8_t problem = raws[ABC150Codec::PROBLEM_ID];
+  uint8_t supp = raws[ABC150Codec::PROBLEM_SUPP_ID];
 
   if ((problemID != problem) || suppID != supp) {
-
-    ESP_LOGE(TAG, "%s", getPacketProblemString(problem, supp).c_str());
+    pushEvent(PACKET_PROBLEM, channel, problem, supp);
   }
   problemID = problem;
   suppID = supp;
 }
 
-void ABC150CANHandler::handleRequestPC(CAN_frame_t &msg) {
-  uint16_t canID = (((uint16_t)msg.data.u8[0] << 8) | (uint16_t)msg.data.u8[1]);
+void ABC150CANHandler::handleRequestPC(Channel channel, CAN_frame_t &msg) {
+  uint16_t canID = ABC150Codec::decodeRaw(ABC150Codec::REQUEST_LAYOUT.signals[ABC150Codec::REQUEST_CAN_ID], msg.data.u8);
 
   if (canID == PC_GREETING) {
     sendPCGreeting();
   } else {
-    ESP_LOGI(TAG, "Request for CAN ID 0x%02x", canID);
+    pushEvent(REQUEST_PC, channel, canID);
   }
 }
 
 
 void ABC150CANHandler::msgReceived(CAN_frame_t &msg) {
-  switch(msg.MsgID) {
-  case DATA_A:
-    handleData(A, msg);
-    break;
-  case DATA_B:
-    handleData(B, msg);
-    break;
-  case LOWER_LIMITS_A:
-    handleLowerLimits(A, msg);
-    break;
-  case UPPER_LIMITS_A:
-    handleUpperLimits(A, msg);
-    break;
-  case STATUS_A:
-    handleStatus(A, msg);
-    break;
-  case STATION_ID_A:
-    handleStationID(A, msg);
-    break;
-  case LOWER_LIMITS_B:
-    handleLowerLimits(B, msg);
-    break;
-  case UPPER_LIMITS_B:
-    handleUpperLimits(B, msg);
-    break;
-  case STATUS_B:
-    handleStatus(B, msg);
-    break;
-  case STATION_ID_B:
-    handleStationID(B, msg);
-    break;
-  case GREETING:
-    handleGreeting(msg);
-    break;
-  case FAULT_DATA:
-    handleFaultData(msg);
-    break;
-  case PACKET_PROBLEM:
-    handlePacketProblem(msg);
-    break;
-  case REQUEST_PC:
-    handleRequestPC(msg);
-    break;
+  /* Frames the MCP2515 filters let through without being ours */
+  bool counted = stats.isEnabled();
+  if (msg.FIR.B.FF != CAN_frame_std || msg.MsgID - RECEIVE_ID_BASE >= RECEIVE_ID_SPAN ||
+      !acceptance.accepts(msg.MsgID)) {
+    if (counted) {
+      stats.received(-1, msg.FIR.B.DLC, 0);
+    }
+    return;
+  }
+  int index = routeIndex[msg.MsgID - RECEIVE_ID_BASE] - 1;
+  if (counted) {
+    /* The scheduler tick is a counter read, esp_timer is not */
+    stats.received(index, msg.FIR.B.DLC, OSPort::getTickMs());
   }
+  const Route &route = routes[index];
+  (this->*route.handler)(route.channel, msg);
 }
 
-void ABC150CANHandler::sendPCGreeting() {
-  CAN_frame_t msg;
+void ABC150CANHandler::buildPCGreetingFrame(CAN_frame_t &msg) {
   msg.MsgID = PC_GREETING;
   msg.FIR.B.FF = CAN_frame_std;
   msg.FIR.B.DLC = 6;
-//  msg.data.u8[0] = ((swVersion >> 24) & 0xFF);
-//  msg.data.u8[1] = ((swVersion >> 16) & 0xFF);
-//  msg.data.u8[2] = ((swVersion >> 8) & 0xFF);
-//  msg.data.u8[3] = (swVersion & 0xFF);
-//  msg.data.u8[5] = 0x0;
-//  msg.data.u8[4] = hardwareVersion;
-  ampleCAN.can.CAN_write_frame(&msg);
+  memset(msg.data.u8, 0, sizeof(msg.data.u8));
 }
 
-void ABC150CANHandler::sendCommandPackage(Channel channel) {
-  CAN_frame_t msg;
-  int16_t scaledValue = 0;
-  msg.MsgID = COMMAND_A + (channel * 0x20);
-  msg.FIR.B.FF = CAN_frame_std;
-  msg.FIR.B.DLC = 4;
-  msg.data.u8[0] = channelInfo[channel].counterStamp;
+void ABC150CANHandler::sendPCGreeting() {
+  /* Called from the receive callback, which must not wait for the transmit buffers */
+  greetingPending = true;
+  notifySend();
+}
+
+int16_t ABC150CANHandler::getCommandWire(Channel channel) {
   switch(channelInfo[channel].controlModeOut) {
     case Voltage:
-      scaledValue = channelInfo[channel].commandOut / VOLTAGE_SCALE;
-      break;
+      return ABC150Units::voltageToWire(channelInfo[channel].commandOut);
     case Current:
-      scaledValue = channelInfo[channel].commandOut / CURRENT_SCALE;
-      break;
+      return ABC150Units::currentToWire(channelInfo[channel].commandOut);
     case Power:
-      scaledValue = channelInfo[channel].commandOut / POWER_SCALE;
-      break;
+      return ABC150Units::powerToWire(channelInfo[channel].commandOut);
     default:
-      scaledValue = 0;
-      break;
+      return 0;
     }
+}
 
-  msg.data.u8[1] = (scaledValue >> 8) & 0xFF;
-  msg.data.u8[2] = (scaledValue) & 0xFF;
+void ABC150CANHandler::buildCommandFrame(Channel channel, CAN_frame_t &msg) {
+  msg.MsgID = COMMAND_A + (channel * CHANNEL_ID_STRIDE);
+  msg.FIR.B.FF = CAN_frame_std;
+  msg.FIR.B.DLC = ABC150Codec::COMMAND_LAYOUT.dlc;
+
+  int64_t raws[ABC150Codec::COMMAND_FIELDS];
+  raws[ABC150Codec::COMMAND_COUNTER] = channelInfo[channel].counterStamp;
+  raws[ABC150Codec::COMMAND_VALUE] = getCommandWire(channel);
+  raws[ABC150Codec::COMMAND_LOAD_MODE] = channelInfo[channel].loadModeOut;
   if (channelInfo[channel].enable) {
-    msg.data.u8[3] = channelInfo[channel].controlModeOut | (channelInfo[channel].loadModeOut << 4) ;
+    raws[ABC150Codec::COMMAND_CONTROL_MODE] = channelInfo[channel].controlModeOut;
   } else {
-    // Bit5-4 : 11: Do not Change
     // Bit1-0 : 11: Standby
-    msg.data.u8[3] = Standby | (channelInfo[channel].loadModeOut << 4);
+    raws[ABC150Codec::COMMAND_CONTROL_MODE] = Standby;
   }
-  ampleCAN.can.CAN_write_frame(&msg);
+  ABC150Codec::encodeRaw(ABC150Codec::COMMAND_LAYOUT, msg.data.u8, raws);
 }
 
-void ABC150CANHandler::sendLowerLimits(Channel channel) {
-  CAN_frame_t msg;
-  msg.MsgID = LOWER_LIMITS_A_OUT + (channel * 0x20);;
+void ABC150CANHandler::buildLowerLimitsFrame(Channel channel, CAN_frame_t &msg) {
+  msg.MsgID = LOWER_LIMITS_A_OUT + (channel * CHANNEL_ID_STRIDE);
   msg.FIR.B.FF = CAN_frame_std;
-  msg.FIR.B.DLC = 7;
-  int16_t lvoltage = channelInfo[channel].lowerVoltageLimitOut / VOLTAGE_SCALE;
-  int16_t lcurrent = channelInfo[channel].lowerCurrentLimitOut / CURRENT_SCALE;
-  int16_t lpower = channelInfo[channel].lowerPowerLimitOut / POWER_SCALE;
-  msg.data.u8[0] = channelInfo[channel].counterStamp;
-  msg.data.u8[1] = ((lvoltage >> 8) & 0xFF);
-  msg.data.u8[2] = lvoltage & 0xFF;
-  msg.data.u8[3] = ((lcurrent >> 8) & 0xFF);
-  msg.data.u8[4] = lcurrent & 0xFF;
-  msg.data.u8[5] = ((lpower >> 8) & 0xFF);
-  msg.data.u8[6] = lpower & 0xFF;
-  ampleCAN.can.CAN_write_frame(&msg);
-}
-
-void ABC150CANHandler::sendUpperLimits(Channel channel) {
-  CAN_frame_t msg;
-  msg.MsgID = UPPER_LIMITS_A_OUT + (channel * 0x20);;
+  msg.FIR.B.DLC = ABC150Codec::LIMITS_OUT_LAYOUT.dlc;
+  int64_t raws[ABC150Codec::LIMITS_OUT_FIELDS];
+  raws[ABC150Codec::LIMITS_OUT_COUNTER] = channelInfo[channel].counterStamp;
+  raws[ABC150Codec::LIMITS_OUT_VOLTAGE] = ABC150Units::voltageToWire(channelInfo[channel].lowerVoltageLimitOut);
+  raws[ABC150Codec::LIMITS_OUT_CURRENT] = ABC150Units::currentToWire(channelInfo[channel].lowerCurrentLimitOut);
+  raws[ABC150Codec::LIMITS_OUT_POWER] = ABC150Units::powerToWire(channelInfo[channel].lowerPowerLimitOut);
+  ABC150Codec::encodeRaw(ABC150Codec::LIMITS_OUT_LAYOUT, msg.data.u8, raws);
+}
+
+void ABC150CANHandler::buildUpperLimitsFrame(Channel channel, CAN_frame_t &msg) {
+  msg.MsgID = UPPER_LIMITS_A_OUT + (channel * CHANNEL_ID_STRIDE);
   msg.FIR.B.FF = CAN_frame_std;
-  msg.FIR.B.DLC = 7;
-  int16_t uvoltage = channelInfo[channel].upperVoltageLimitOut / VOLTAGE_SCALE;
-  int16_t ucurrent = channelInfo[channel].upperCurrentLimitOut / CURRENT_SCALE;
-  int16_t upower = channelInfo[channel].upperPowerLimitOut / POWER_SCALE;
-  msg.data.u8[0] = channelInfo[channel].counterStamp;
-  msg.data.u8[1] = ((uvoltage >> 8) & 0xFF);
-  msg.data.u8[2] = uvoltage & 0xFF;
-  msg.data.u8[3] = ((ucurrent >> 8) & 0xFF);
-  msg.data.u8[4] = ucurrent & 0xFF;
-  msg.data.u8[5] = ((upower >> 8) & 0xFF);
-  msg.data.u8[6] = upower & 0xFF;
-  ampleCAN.can.CAN_write_frame(&msg);
-
-  /* Counter stamp gets incremented here */
-  channelInfo[channel].counterStamp++;
+  msg.FIR.B.DLC = ABC150Codec::LIMITS_OUT_LAYOUT.dlc;
+  int64_t raws[ABC150Codec::LIMITS_OUT_FIELDS];
+  raws[ABC150Codec::LIMITS_OUT_COUNTER] = channelInfo[channel].counterStamp;
+  raws[ABC150Codec::LIMITS_OUT_VOLTAGE] = ABC150Units::voltageToWire(channelInfo[channel].upperVoltageLimitOut);
+  raws[ABC150Codec::LIMITS_OUT_CURRENT] = ABC150Units::currentToWire(channelInfo[channel].upperCurrentLimitOut);
+  raws[ABC150Codec::LIMITS_OUT_POWER] = ABC150Units::powerToWire(channelInfo[channel].upperPowerLimitOut);
+  ABC150Codec::encodeRaw(ABC150Codec::LIMITS_OUT_LAYOUT, msg.data.u8, raws);
+}
 
+void ABC150CANHandler::buildChangeControlFrame(Channel channel, CAN_frame_t &msg) {
+  msg.MsgID = CHANGE_CONTROL;
+  msg.FIR.B.FF = CAN_frame_std;
+  msg.FIR.B.DLC = ABC150Codec::CHANGE_CONTROL_LAYOUT.dlc;
+  int64_t raws[ABC150Codec::CHANGE_CONTROL_FIELDS];
+  raws[ABC150Codec::CHANGE_CONTROL_CHANNEL] = channel;
+  raws[ABC150Codec::CHANGE_CONTROL_FROM] = getConverterStatus(channel);
+  raws[ABC150Codec::CHANGE_CONTROL_TO] = Remote;
+  raws[ABC150Codec::CHANGE_CONTROL_HW_ID] = hardwareVersion; // Hardware ID for ABC150
+  raws[ABC150Codec::CHANGE_CONTROL_STATION_ID] = channelInfo[channel].stationID;
+  ABC150Codec::encodeRaw(ABC150Codec::CHANGE_CONTROL_LAYOUT, msg.data.u8, raws);
 }
 
 void ABC150CANHandler::sendChangeControl(Channel channel) {
   CAN_frame_t msg;
-  msg.MsgID = CHANGE_CONTROL;
-  msg.FIR.B.FF = CAN_frame_std;
-  msg.FIR.B.DLC = 8;
-  msg.data.u8[0] = channel;
-  msg.data.u8[0] = msg.data.u8[0] | (channelInfo[channel].converterStatus << 1); //From
-  msg.data.u8[0] = msg.data.u8[0] | (Remote << 4); //To
-  msg.data.u8[1] = hardwareVersion; // Hardware ID for ABC150
-  msg.data.u8[3] = ((channelInfo[channel].stationID >> 32) & 0xFF);
-  msg.data.u8[4] = ((channelInfo[channel].stationID >> 24) & 0xFF);
-  msg.data.u8[5] = ((channelInfo[channel].stationID >> 16) & 0xFF);
-  msg.data.u8[6] = ((channelInfo[channel].stationID >> 8) & 0xFF);
-  msg.data.u8[7] = ((channelInfo[channel].stationID) & 0xFF);
-  ampleCAN.can.CAN_write_frame(&msg);
+  buildChangeControlFrame(channel, msg);
+  writeFrames(&msg, 1);
 }
 
 void ABC150CANHandler::sendRequestABCPackage() {
   CAN_frame_t msg;
   msg.MsgID = REQUEST_ABC;
   msg.FIR.B.FF = CAN_frame_std;
-  msg.FIR.B.DLC = 2;
-  msg.data.u8[0] = (GREETING >> 8) & 0xFF;
-  msg.data.u8[1] = (GREETING) & 0xFF;
-  ampleCAN.can.CAN_write_frame(&msg);
+  msg.FIR.B.DLC = ABC150Codec::REQUEST_LAYOUT.dlc;
+  int64_t raws[ABC150Codec::REQUEST_FIELDS];
+  raws[ABC150Codec::REQUEST_CAN_ID] = GREETING;
+  ABC150Codec::encodeRaw(ABC150Codec::REQUEST_LAYOUT, msg.data.u8, raws);
+  writeFrames(&msg, 1);
 }
 
 void  ABC150CANHandler::takeControl(Channel channel) {
-  sendPCGreeting();
-  sendChangeControl(channel);
+  /* Through writeFrames() like the package the send task follows them with */
+  CAN_frame_t frames[2];
+  buildPCGreetingFrame(frames[0]);
+  buildChangeControlFrame(channel, frames[1]);
+  writeFrames(frames, 2);
   channelInfo[channel].sending = true;
+  notifySend();
 }
 
 void  ABC150CANHandler::releaseControl(Channel channel) {
@@ -683,6 +672,7 @@ bool ABC150CANHandler::enable(Channel channel) {
   }
 
   channelInfo[channel].enable = true;
+  notifySend();
   return true;
 }
 
@@ -690,6 +680,7 @@ bool ABC150CANHandler::disable(Channel channel) {
   channelInfo[channel].enable = false;
   channelInfo[channel].commandOut = 0;
   channelInfo[channel].controlModeOut = Standby;
+  notifySend();
   return true;
 }
 
@@ -697,16 +688,48 @@ bool ABC150CANHandler::isDetected() {
   return abcDetected;
 }
 
+const CANAcceptanceFilter::Registers &ABC150CANHandler::getAcceptanceFilter() {
+  return acceptance.getRegisters();
+}
+
+CANStats &ABC150CANHandler::getStats() {
+  return stats;
+}
+
+TelemetryWatchdog &ABC150CANHandler::getWatchdog() {
+  return watchdog;
+}
+
+bool ABC150CANHandler::isFresh(Channel channel) {
+  return watchdog.isFresh(channel);
+}
+
+void ABC150CANHandler::dumpStats() {
+  uint8_t record[CAN_STATS_RECORD_SIZE];
+  size_t size = stats.serialize(record, sizeof(record));
+  printf("CAN statistics record, %d bytes:\r\n", (int)size);
+  for (size_t i = 0; i < size; i++) {
+    printf("%02x", record[i]);
+    if ((i + 1) % STATS_DUMP_LINE_BYTES == 0 || i + 1 == size) {
+      printf("\r\n");
+    }
+  }
+}
+
+ABC150CANHandler::Telemetry ABC150CANHandler::getTelemetry(Channel channel) {
+  return channelInfo[channel].telemetry.read();
+}
+
 float ABC150CANHandler::getVoltage(Channel channel) {
-  return channelInfo[channel].voltage;
+  return getTelemetry(channel).voltage;
 }
 
 float ABC150CANHandler::getCurrent(Channel channel) {
-  return channelInfo[channel].current;
+  return getTelemetry(channel).current;
 }
 
 uint32_t ABC150CANHandler::getTimeStamp(Channel channel) {
-  return channelInfo[channel].timestamp;
+  return getTelemetry(channel).timestamp;
 }
 
 ABC150CANHandler::ControlMode ABC150CANHandler::getControlModeOut(Channel ch){
@@ -717,10 +740,25 @@ ABC150CANHandler::LoadMode ABC150CANHandler::getLoadModeOut(Channel ch){
 	return channelInfo[ch].loadModeOut;
 }
 ABC150CANHandler::ConverterStatus ABC150CANHandler::getConverterStatus(Channel ch){
-	return channelInfo[ch].converterStatus;
+	return getTelemetry(ch).converterStatus;
 }
 float ABC150CANHandler::getCommand(Channel ch){
-	return channelInfo[ch].command;
+	return getTelemetry(ch).command;
+}
+
+ABC150CANHandler::Setpoints ABC150CANHandler::getSetpoints(Channel channel) {
+  Setpoints setpoints;
+  ChannelInfo &info = channelInfo[channel];
+  setpoints.controlMode = info.controlModeOut;
+  setpoints.enable = info.enable;
+  setpoints.command = getCommandWire(channel);
+  setpoints.lowerVoltageLimit = ABC150Units::voltageToWire(info.lowerVoltageLimitOut);
+  setpoints.lowerCurrentLimit = ABC150Units::currentToWire(info.lowerCurrentLimitOut);
+  setpoints.lowerPowerLimit = ABC150Units::powerToWire(info.lowerPowerLimitOut);
+  setpoints.upperVoltageLimit = ABC150Units::voltageToWire(info.upperVoltageLimitOut);
+  setpoints.upperCurrentLimit = ABC150Units::currentToWire(info.upperCurrentLimitOut);
+  setpoints.upperPowerLimit = ABC150Units::powerToWire(info.upperPowerLimitOut);
+  return setpoints;
 }
 
 
@@ -731,24 +769,107 @@ void ABC150CANHandler::sendTaskWrapper(void *arg) {
 
 void ABC150CANHandler::setFrequency(int timeDelta) {
 	int taskFrequency = timeDelta;
-	xFrequency = pdMS_TO_TICKS(taskFrequency); //Run 500ms
+	xFrequency = taskFrequency; //Run 500ms
 }
 
 void ABC150CANHandler::setDefaultFrequency() {
-	xFrequency = pdMS_TO_TICKS(500);
+	xFrequency = 500;
+}
+
+void ABC150CANHandler::notifySend() {
+  if (sendTaskHandle != NULL) {
+    OSPort::notifyGive(sendTaskHandle);
+  }
+}
+
+void ABC150CANHandler::pushEvent(uint16_t id, Channel channel, uint16_t code, uint8_t detail) {
+  uint32_t position;
+  Event *event = events.claim(&position);
+  if (event == NULL) {
+    return;
+  }
+  event->timeMs = OSPort::getTickMs();
+  event->id = id;
+  event->code = code;
+  event->channel = channel;
+  event->detail = detail;
+  events.publish(position);
+}
+
+void ABC150CANHandler::logEvent(const Event &event) {
+  switch (event.id) {
+  case STATUS_A:
+    ESP_LOGI(TAG, "%u ms: Converter status %c changed to %d", event.timeMs, 'A' + event.channel, event.code);
+    break;
+  case GREETING:
+    if (event.code == 0x0D) {
+      ESP_LOGI(TAG, "%u ms: ABC150 Detected", event.timeMs);
+    } else {
+      ESP_LOGE(TAG, "%u ms: Hardware Version: %d", event.timeMs, event.code);
+    }
+    break;
+  case FAULT_DATA:
+    ESP_LOGE(TAG, "%u ms: Received faultID: %d; moduleID: %d", event.timeMs, event.code, event.detail);
+    break;
+  case PACKET_PROBLEM:
+    ESP_LOGE(TAG, "%u ms: %s\t%s", event.timeMs, getSuppName(event.detail), getPacketProblemName(event.code));
+    break;
+  case REQUEST_PC:
+    ESP_LOGI(TAG, "%u ms: Request for CAN ID 0x%02x", event.timeMs, event.code);
+    break;
+  default:
+    break;
+  }
+}
+
+void ABC150CANHandler::eventTaskWrapper(void *arg) {
+  ABC150CANHandler * obj =  (ABC150CANHandler *)arg;
+  obj->eventTask();
+}
+
+void ABC150CANHandler::eventTask() {
+  Event event;
+  while (1) {
+    while (events.pop(&event)) {
+      logEvent(event);
+    }
+    uint32_t drops = events.getDropped();
+    if (drops != reportedEventDrops) {
+      ESP_LOGE(TAG, "%u events dropped", drops - reportedEventDrops);
+      reportedEventDrops = drops;
+    }
+    OSPort::delay(EVENT_PERIOD_MS);
+  }
 }
 
 void ABC150CANHandler::sendTask() {
-  CAN_frame_t canMsg;
-  xLastWakeTime = xTaskGetTickCount();
+  uint32_t elapsed;
+  xLastWakeTime = OSPort::getTickMs();
   while (1) {
-      // Wait for the next cycle.
-      vTaskDelayUntil(&xLastWakeTime, xFrequency);
-      if (channelInfo[A].sending && channelInfo[A].converterStatus == Remote) {
+      // Wait for a setpoint change or the keep-alive period.
+      elapsed = OSPort::getTickMs() - xLastWakeTime;
+      OSPort::notifyTake((elapsed < xFrequency) ? (xFrequency - elapsed) : 0);
+
+      // Answer a greeting request at once, through the same transmit pacing.
+      if (greetingPending.exchange(false)) {
+        CAN_frame_t msg;
+        buildPCGreetingFrame(msg);
+        writeFrames(&msg, 1);
+      }
+
+      // Rate limit bursts of setpoint changes, they are sent together.
+      elapsed = OSPort::getTickMs() - xLastWakeTime;
+      if (elapsed < xMinSendInterval) {
+        OSPort::delay(xMinSendInterval - elapsed);
+        OSPort::notifyTake(0);
+      }
+      xLastWakeTime = OSPort::getTickMs();
+
+      if (channelInfo[A].sending && getConverterStatus(A) == Remote) {
         sendPackage(A);
       }
 
-      if (channelInfo[B].sending && channelInfo[B].converterStatus == Remote) {
+      if (channelInfo[B].sending && getConverterStatus(B) == Remote) {
         sendPackage(B);
       }
   }
@@ -776,6 +897,11 @@ void ABC150CANUserInterface::help() {
   printf("  t: take control\r\n");
   printf("  r: release control\r\n");
   printf("  s: sendRequestABCPackage\r\n");
+  printf("  c: Print bus statistics\r\n");
+  printf("  b: Dump bus statistics record\r\n");
+  printf("  z: Reset bus statistics\r\n");
+  printf("  f: Print telemetry age\r\n");
+  printf("  l: Set telemetry stale limit\r\n");
 
   printf("  h: Print this help again\r\n");
   printf("  q: Quit\r\n\n\n");
@@ -803,6 +929,7 @@ bool ABC150CANUserInterface::getInput(const char *printString, AmpleSerial &pc,
 void ABC150CANUserInterface::ABC150CANInterface(AmpleSerial &pc, ABC150CANHandler *canHandler) {
   ABC150CANHandler::Channel ch;
   float val;
+  int limit;
 
   pc.clear();
   ABC150CANUserInterface::help();
@@ -906,6 +1033,28 @@ void ABC150CANUserInterface::ABC150CANInterface(AmpleSerial &pc, ABC150CANHandle
           canHandler->sendRequestABCPackage();
         break;
 
+      case 'c':
+        canHandler->getStats().print();
+        break;
+
+      case 'b':
+        canHandler->dumpStats();
+        break;
+
+      case 'z':
+        canHandler->getStats().reset();
+        break;
+
+      case 'f':
+        canHandler->getWatchdog().print();
+        break;
+
+      case 'l':
+        if (pc.readNumber(limit, "Enter telemetry stale limit in ms: ") && limit > 0) {
+          canHandler->getWatchdog().setStaleLimit(limit);
+        }
+        break;
+
       case 'h':
         ABC150CANUserInterface::help();
         break;
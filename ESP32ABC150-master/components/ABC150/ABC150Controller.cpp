@@ -6,6 +6,7 @@
 #include "ABC150Controller.hpp"
 #include "NVSConfig.hpp"
 #include "AmpleLogger.hpp"
+#include "esp_log.h"
 
 
 #define BATT_CAN_FREQUENCY CAN_SPEED_500KBPS
@@ -28,6 +29,11 @@ ABC150Controller::ABC150Controller(unsigned int _ampleID,
   gpio_set_direction(batteryControlPin, GPIO_MODE_OUTPUT);
   gpio_set_level(batteryControlPin, 0);
 
+  /* Only the ABC150 receive IDs interrupt the ESP32, the handler checks the rest in software */
+  const CANAcceptanceFilter::Registers &filter = abc150CANHandler.getAcceptanceFilter();
+  if (!mcp2515CAN.setAcceptanceFilter(filter.mask, filter.filter)) {
+    ESP_LOGE(TAG, "Failed to program the MCP2515 acceptance filters");
+  }
 }
 
 
@@ -39,6 +45,10 @@ PlateCANHandler* ABC150Controller::getPlateCANHandler() {
   return &plateCANHandler;
 }
 
+MCP2515_CAN* ABC150Controller::getMCP2515CAN() {
+  return &mcp2515CAN;
+}
+
 
 void ABC150Controller::turn12vOn() {
   printf("Turning 12v ON\r\n");
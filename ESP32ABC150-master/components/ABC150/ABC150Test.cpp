@@ -32,6 +32,35 @@ bool ABC150Test::getCDFlag() {
   return cDFlag;
 }
 
+bool ABC150Test::getProfileFlag() {
+  return profileFlag;
+}
+
+void ABC150Test::listProfiles() {
+}
+
+bool ABC150Test::setProfile(int) {
+  return false;
+}
+
+bool ABC150Test::setPowerTracking(bool) {
+  return false;
+}
+
+void ABC150Test::printStats() {
+}
+
+uint32_t ABC150Test::getPeriodMs() {
+  return periodMs;
+}
+
+uint32_t ABC150Test::getDeadlineMs() {
+  return deadlineMs;
+}
+
+void ABC150Test::schedule(TestScheduler &) {
+}
+
 void ABC150Test::printAndSaveResult(std::stringstream &result) {
   std::string res = result.str();
   result.str("");
@@ -4,8 +4,9 @@
 #include "ABC150TestManager.hpp"
 #include "esp_log.h"
 #include "esp_task_wdt.h"
+#include "ABC150Units.hpp"
 
-TimerHandle_t debugLogTimer = NULL;
+OSPort::Timer debugLogTimer = NULL;
 
 
 ABC150TestManager::ABC150TestManager(ABC150Controller &_abc150Controller) :
@@ -14,26 +15,36 @@ ABC150TestManager::ABC150TestManager(ABC150Controller &_abc150Controller) :
                   abc150Handler(abc150Controller.getABC150CANHandler()),
                   collection(BatteryModuleCollection::collection()),
                   bmAmpleID{},
-                  xLastWakeTime(0){
+                  telemetry(&ABC150TestManager::telemetrySample, &ABC150TestManager::telemetryStatus, this),
+                  commands(&ABC150TestManager::handleCommand, this){
 
   /* Create a timer for logging */
-  debugLogTimer = xTimerCreate("debugLogTimer",
-                            pdMS_TO_TICKS(1000),
-                            pdTRUE,
-                            (void*)0,
-                            debugLog);
+  debugLogTimer = OSPort::createTimer("debugLogTimer",
+                                      1000,
+                                      true,
+                                      debugLog,
+                                      NULL);
   assert(debugLogTimer != NULL);
   debugLogEnable = false;
-  /* Create loop task */
-  if (xTaskCreate(&ABC150TestManager::loopTaskWrapper, "ABC150 loop", 4096, this, configMAX_PRIORITIES-3, &loopTaskHandle) != pdPASS){
-    ESP_LOGE(TAG, "Failed to create ABC150 loop Task");
+  /* Test output goes through the console task */
+  if (!AsyncConsole::console().start()) {
+    ESP_LOGE(TAG, "Failed to start the console");
+  }
+  /* Create the test loop tasks */
+  if (!scheduler.start()){
+    ESP_LOGE(TAG, "Failed to start ABC150 test scheduler");
+  }
+  /* Off until a rate is set, main attaches the sinks */
+  telemetry.schedule(scheduler);
+  if (!telemetry.start()) {
+    ESP_LOGE(TAG, "Failed to start telemetry");
   }
 }
 
-void ABC150TestManager::debugLog(TimerHandle_t xTimer) {
+void ABC150TestManager::debugLog(void *) {
   BatteryInfo *batteryInfo = BatteryModuleCollection::collection().getBatteryInfo();
 
-  printf("%.02fV | %.02fA | %.02f%% | %d online | %d HV_ON | %.02fC_Max | %.02fC_Avg | %.02fkw_AP | %.02fkwh_AE | %.02fkw_CP\r\n",
+  AsyncConsole::console().print("%.02fV | %.02fA | %.02f%% | %d online | %d HV_ON | %.02fC_Max | %.02fC_Avg | %.02fkw_AP | %.02fkwh_AE | %.02fkw_CP\r\n",
     batteryInfo->voltage,
     batteryInfo->current,
     batteryInfo->soc,
@@ -49,10 +60,290 @@ void ABC150TestManager::debugLog(TimerHandle_t xTimer) {
 
 void ABC150TestManager::addSingleChannelTest(SingleChannelTest *singleTest) {
   singleTestVec.push_back(singleTest);
+  singleJobs.push_back(scheduler.addJob(singleTest->getTestName(), &ABC150TestManager::testJob, singleTest,
+                                        TestScheduler::Monitor, singleTest->getPeriodMs(), singleTest->getDeadlineMs()));
+  singleTest->schedule(scheduler);
 }
 
 void ABC150TestManager::addDualChannelTest(DualChannelTest *dualTest) {
   dualTestVec.push_back(dualTest);
+  dualJobs.push_back(scheduler.addJob(dualTest->getTestName(), &ABC150TestManager::testJob, dualTest,
+                                      TestScheduler::Monitor, dualTest->getPeriodMs(), dualTest->getDeadlineMs()));
+  dualTest->schedule(scheduler);
+}
+
+TestScheduler &ABC150TestManager::getScheduler() {
+  return scheduler;
+}
+
+TelemetryStream &ABC150TestManager::getTelemetry() {
+  return telemetry;
+}
+
+static int16_t toTelemetry(float value, float unitsPerOne) {
+  return ABC150Units::saturate16(ABC150Units::fromFloat(value, unitsPerOne));
+}
+
+void ABC150TestManager::telemetrySample(void *arg, TelemetrySample &sample) {
+  ABC150TestManager *manager = (ABC150TestManager *)arg;
+  for (int ch = 0; ch < TELEMETRY_CHANNELS; ch++) {
+    ABC150CANHandler::Telemetry received = manager->abc150Handler->getTelemetry((ABC150CANHandler::Channel)ch);
+    sample.channels[ch].voltage = ABC150Units::voltageToWire(ABC150Units::roundVolts(received.voltage));
+    sample.channels[ch].current = ABC150Units::currentToWire(ABC150Units::roundAmps(received.current));
+    sample.channels[ch].timestamp = received.timestamp;
+  }
+}
+
+void ABC150TestManager::telemetryStatus(void *arg, TelemetryStatus &status) {
+  ABC150TestManager *manager = (ABC150TestManager *)arg;
+  for (int ch = 0; ch < TELEMETRY_CHANNELS; ch++) {
+    ABC150CANHandler::Setpoints setpoints = manager->abc150Handler->getSetpoints((ABC150CANHandler::Channel)ch);
+    TelemetryChannelStatus &channel = status.channels[ch];
+    channel.converterStatus = manager->abc150Handler->getConverterStatus((ABC150CANHandler::Channel)ch);
+    channel.controlMode = setpoints.controlMode;
+    channel.enable = setpoints.enable;
+    channel.command = setpoints.command;
+    channel.lowerVoltageLimit = setpoints.lowerVoltageLimit;
+    channel.lowerCurrentLimit = setpoints.lowerCurrentLimit;
+    channel.lowerPowerLimit = setpoints.lowerPowerLimit;
+    channel.upperVoltageLimit = setpoints.upperVoltageLimit;
+    channel.upperCurrentLimit = setpoints.upperCurrentLimit;
+    channel.upperPowerLimit = setpoints.upperPowerLimit;
+  }
+  /* Single channel tests first, in the order of the test lists */
+  status.testCount = 0;
+  for (size_t i = 0; i < manager->singleTestVec.size() && status.testCount < TELEMETRY_MAX_TESTS; i++) {
+    status.testStates[status.testCount++] = (uint8_t)manager->singleTestVec[i]->getTestState();
+  }
+  for (size_t j = 0; j < manager->dualTestVec.size() && status.testCount < TELEMETRY_MAX_TESTS; j++) {
+    status.testStates[status.testCount++] = (uint8_t)manager->dualTestVec[j]->getTestState();
+  }
+
+  BatteryInfo *batteryInfo = manager->collection.getBatteryInfo();
+  TelemetryBattery &battery = status.battery;
+  battery.voltage = ABC150Units::voltageToWire(ABC150Units::roundVolts(batteryInfo->voltage));
+  battery.current = ABC150Units::currentToWire(ABC150Units::roundAmps(batteryInfo->current));
+  battery.soc = toTelemetry(batteryInfo->soc, 100.0f);
+  battery.onlineCount = batteryInfo->onlineCount;
+  battery.hvOnCount = batteryInfo->HVOnCount;
+  battery.maxTemp = toTelemetry(batteryInfo->maxTemp, 10.0f);
+  battery.avgTemp = toTelemetry(batteryInfo->avgTemp, 10.0f);
+  battery.minCellVoltage = toTelemetry(batteryInfo->minCellVoltage, 1000.0f);
+  battery.maxCellVoltage = toTelemetry(batteryInfo->maxCellVoltage, 1000.0f);
+  battery.availablePower = toTelemetry(batteryInfo->availablePower, 100.0f);
+  battery.availableEnergy = toTelemetry(batteryInfo->availableEnergy, 100.0f);
+  battery.chargingPower = toTelemetry(batteryInfo->chargingPower, 100.0f);
+}
+
+CommandServer &ABC150TestManager::getCommandServer() {
+  return commands;
+}
+
+static bool toTestType(uint8_t type, ABC150TestManager::TestType *testType) {
+  if (type == CommandProtocol::Single) {
+    *testType = ABC150TestManager::TestType::Single;
+  } else if (type == CommandProtocol::Dual) {
+    *testType = ABC150TestManager::TestType::Dual;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+CommandProtocol::Result ABC150TestManager::handleCommand(void *arg, CommandProtocol::Message &request,
+                                                         CommandProtocol::Message &response) {
+  ABC150TestManager *manager = (ABC150TestManager *)arg;
+  return manager->runCommand(request, response);
+}
+
+CommandProtocol::Result ABC150TestManager::runCommand(CommandProtocol::Message &request,
+                                                      CommandProtocol::Message &response) {
+  uint8_t type, test, channel, value8;
+  uint32_t value32;
+  TestType testType;
+  TelemetryStatus status = {};
+  bool done;
+
+  switch (request.command) {
+  case CommandProtocol::Ping:
+    if (!request.atEnd()) return CommandProtocol::BadLength;
+    response.put32(OSPort::getTickMs());
+    return CommandProtocol::Ok;
+
+  case CommandProtocol::GetStatus:
+    if (!request.atEnd()) return CommandProtocol::BadLength;
+    telemetryStatus(this, status);
+    response.put32(OSPort::getTickMs());
+    response.length += TelemetryFrame::putStatus(status, response.payload + response.length);
+    return CommandProtocol::Ok;
+
+  case CommandProtocol::ListTests:
+    if (!request.atEnd()) return CommandProtocol::BadLength;
+    return listTestsCommand(response);
+
+  case CommandProtocol::StartTest:
+    return startTestCommand(request);
+
+  case CommandProtocol::StopTest:
+    if (!request.get8(&type) || !request.get8(&test) || !request.atEnd()) return CommandProtocol::BadLength;
+    if (!toTestType(type, &testType) || !testCheck(testType, test)) return CommandProtocol::InvalidArgument;
+    done = (testType == TestType::Single) ? stopSingleTest(test) : stopDualTest(test);
+    return done ? CommandProtocol::Ok : CommandProtocol::Rejected;
+
+  case CommandProtocol::StopAll:
+    if (!request.get8(&value8) || !request.atEnd()) return CommandProtocol::BadLength;
+    if (value8) {
+      stopAllOverride();
+    } else {
+      stopAll();
+    }
+    return CommandProtocol::Ok;
+
+  case CommandProtocol::SetSetpoint:
+    if (!request.get8(&channel) || !request.get8(&value8) || !request.get32(&value32) || !request.atEnd()) {
+      return CommandProtocol::BadLength;
+    }
+    if (channel > ABC150CANHandler::B) return CommandProtocol::InvalidArgument;
+    return setSetpointCommand((ABC150CANHandler::Channel)channel, value8, (int32_t)value32);
+
+  case CommandProtocol::SetControl:
+    if (!request.get8(&channel) || !request.get8(&value8) || !request.atEnd()) return CommandProtocol::BadLength;
+    if (channel > ABC150CANHandler::B) return CommandProtocol::InvalidArgument;
+    return setControlCommand((ABC150CANHandler::Channel)channel, value8);
+
+  case CommandProtocol::SetBMID:
+    if (!request.get8(&channel) || !request.get32(&value32) || !request.atEnd()) return CommandProtocol::BadLength;
+    if (channel > ABC150CANHandler::B) return CommandProtocol::InvalidArgument;
+    setBMAmpleID(channel, value32);
+    return CommandProtocol::Ok;
+
+  case CommandProtocol::SetTelemetryRate:
+    if (!request.get8(&value8) || !request.atEnd()) return CommandProtocol::BadLength;
+    return telemetry.setRate(value8) ? CommandProtocol::Ok : CommandProtocol::InvalidArgument;
+
+  case CommandProtocol::SetPowerTracking:
+    if (!request.get8(&type) || !request.get8(&test) || !request.get8(&value8) || !request.atEnd()) {
+      return CommandProtocol::BadLength;
+    }
+    if (!toTestType(type, &testType) || !testCheck(testType, test)) return CommandProtocol::InvalidArgument;
+    return setPowerTracking(testType, test, value8 != 0) ? CommandProtocol::Ok : CommandProtocol::Rejected;
+
+  default:
+    return CommandProtocol::UnknownCommand;
+  }
+}
+
+CommandProtocol::Result ABC150TestManager::listTestsCommand(CommandProtocol::Message &response) {
+  response.put8(singleTestVec.size() + dualTestVec.size());
+  for (size_t i = 0; i < singleTestVec.size() + dualTestVec.size(); i++) {
+    bool single = i < singleTestVec.size();
+    TestType type = single ? TestType::Single : TestType::Dual;
+    int test = single ? i : i - singleTestVec.size();
+    ABC150Test *abc150Test = single ? (ABC150Test *)singleTestVec[test] : (ABC150Test *)dualTestVec[test];
+    uint8_t flags = (checkCycleFlag(type, test) ? CommandProtocol::HasCycles : 0) |
+                    (checkCDFlag(type, test) ? CommandProtocol::HasVoltage : 0) |
+                    (checkProfileFlag(type, test) ? CommandProtocol::HasProfile : 0);
+    response.put8(single ? CommandProtocol::Single : CommandProtocol::Dual);
+    response.put8(test);
+    response.put8(single ? singleTestVec[test]->getChannel() : COMMAND_NO_CHANNEL);
+    response.put8((uint8_t)abc150Test->getTestState());
+    response.put8(flags);
+    if (!response.putString(abc150Test->getTestName())) {
+      return CommandProtocol::Rejected;
+    }
+  }
+  return CommandProtocol::Ok;
+}
+
+CommandProtocol::Result ABC150TestManager::startTestCommand(CommandProtocol::Message &request) {
+  uint8_t type, test, profile;
+  uint16_t cycles;
+  uint32_t voltage;
+  TestType testType;
+  if (!request.get8(&type) || !request.get8(&test) || !request.get16(&cycles) || !request.get32(&voltage) ||
+      !request.get8(&profile) || !request.atEnd()) {
+    return CommandProtocol::BadLength;
+  }
+  if (!toTestType(type, &testType) || !testCheck(testType, test)) {
+    return CommandProtocol::InvalidArgument;
+  }
+  /* The same steps as the menu, voltage and profile are ignored by tests that do not take them */
+  if (checkCDFlag(testType, test)) {
+    setDestinationVoltage(testType, test, ABC150Units::toVolts((int32_t)voltage));
+  }
+  if (checkProfileFlag(testType, test) && !setProfile(testType, test, profile)) {
+    return CommandProtocol::InvalidArgument;
+  }
+  int cycleNum = (cycles > 0) ? cycles : 1;
+  bool started = (testType == TestType::Single) ? runSingleTest(test, cycleNum) : runDualTest(test, cycleNum);
+  return started ? CommandProtocol::Ok : CommandProtocol::Rejected;
+}
+
+CommandProtocol::Result ABC150TestManager::setSetpointCommand(ABC150CANHandler::Channel channel, uint8_t setpoint,
+                                                              int32_t value) {
+  bool done;
+  switch (setpoint) {
+  case CommandProtocol::LowerVoltageLimit:
+    done = abc150Handler->setLowerVoltageLimit(channel, ABC150Units::toVolts(value));
+    break;
+  case CommandProtocol::LowerCurrentLimit:
+    done = abc150Handler->setLowerCurrentLimit(channel, ABC150Units::toAmps(value));
+    break;
+  case CommandProtocol::LowerPowerLimit:
+    done = abc150Handler->setLowerPowerLimit(channel, ABC150Units::toWatts(value));
+    break;
+  case CommandProtocol::UpperVoltageLimit:
+    done = abc150Handler->setUpperVoltageLimit(channel, ABC150Units::toVolts(value));
+    break;
+  case CommandProtocol::UpperCurrentLimit:
+    done = abc150Handler->setUpperCurrentLimit(channel, ABC150Units::toAmps(value));
+    break;
+  case CommandProtocol::UpperPowerLimit:
+    done = abc150Handler->setUpperPowerLimit(channel, ABC150Units::toWatts(value));
+    break;
+  case CommandProtocol::Voltage:
+    done = abc150Handler->setVoltage(channel, ABC150Units::toVolts(value));
+    break;
+  case CommandProtocol::Current:
+    done = abc150Handler->setCurrent(channel, ABC150Units::toAmps(value));
+    break;
+  case CommandProtocol::Power:
+    done = abc150Handler->setPower(channel, ABC150Units::toWatts(value));
+    break;
+  case CommandProtocol::LoadMode:
+    if (value < ABC150CANHandler::Independent || value > ABC150CANHandler::Do_not_Change) {
+      return CommandProtocol::InvalidArgument;
+    }
+    done = abc150Handler->setLoadMode(channel, (ABC150CANHandler::LoadMode)value);
+    break;
+  default:
+    return CommandProtocol::InvalidArgument;
+  }
+  return done ? CommandProtocol::Ok : CommandProtocol::Rejected;
+}
+
+CommandProtocol::Result ABC150TestManager::setControlCommand(ABC150CANHandler::Channel channel, uint8_t control) {
+  switch (control) {
+  case CommandProtocol::Enable:
+    return abc150Handler->enable(channel) ? CommandProtocol::Ok : CommandProtocol::Rejected;
+  case CommandProtocol::Disable:
+    return abc150Handler->disable(channel) ? CommandProtocol::Ok : CommandProtocol::Rejected;
+  case CommandProtocol::TakeControl:
+    abc150Handler->takeControl(channel);
+    return CommandProtocol::Ok;
+  case CommandProtocol::ReleaseControl:
+    abc150Handler->releaseControl(channel);
+    return CommandProtocol::Ok;
+  default:
+    return CommandProtocol::InvalidArgument;
+  }
+}
+
+bool ABC150TestManager::testJob(void *arg) {
+  ABC150Test *test = (ABC150Test *)arg;
+  test->loop();
+  ABC150Test::TestState state = test->getTestState();
+  return state == ABC150Test::TestState::Running || state == ABC150Test::TestState::Restart;
 }
 
 const char* ABC150TestManager::getTestStateName(ABC150Test::TestState testState) {
@@ -82,13 +373,13 @@ bool ABC150TestManager::runSingleTest(int singleTest, int cycleNum) {
     return false;
   }
   unsigned int bmID = bmAmpleID[singleTestVec[singleTest]->getChannel()];
-  for (int j = 0; j < dualTestVec.size(); j++) {
+  for (size_t j = 0; j < dualTestVec.size(); j++) {
     if (dualTestVec[j]->getTestState() == ABC150Test::TestState::Running) {
       ESP_LOGE(TAG, "%s already running.", dualTestVec[j]->getTestName());
       return false;
     }
   }
-  for (int i = 0; i < singleTestVec.size(); i++) {
+  for (size_t i = 0; i < singleTestVec.size(); i++) {
     if (singleTestVec[i]->getTestState() == ABC150Test::TestState::Running) {
       if (singleTestVec[i]->getChannel() == singleTestVec[singleTest]->getChannel()) {
         ESP_LOGE(TAG, "%s already running on channel %s.", singleTestVec[i]->getTestName(), SingleChannelTest::getChannelName(singleTestVec[i]->getChannel()));
@@ -99,7 +390,9 @@ bool ABC150TestManager::runSingleTest(int singleTest, int cycleNum) {
   BatteryModuleInfo *bmInfo = collection.getBatteryModuleByID(bmID);
   if (bmInfo != NULL) {
     singleTestVec[singleTest]->setCycles(cycleNum);
-    singleTestVec[singleTest]->startTest(bmInfo);
+    if (singleTestVec[singleTest]->startTest(bmInfo)) {
+      scheduler.activate(singleJobs[singleTest]);
+    }
   } else {
     if (bmAmpleID[singleTestVec[singleTest]->getChannel()] == 0) {
       ESP_LOGE(TAG, "BM ID not set");
@@ -115,20 +408,22 @@ bool ABC150TestManager::runDualTest(int dualTest, int cycleNum) {
   if (!testCheck(TestType::Dual, dualTest)) {
     return false;
   }
-  for (int j = 0; j < dualTestVec.size(); j++) {
+  for (size_t j = 0; j < dualTestVec.size(); j++) {
     if (dualTestVec[j]->getTestState() == ABC150Test::TestState::Running) {
       ESP_LOGE(TAG, "%s already running.", dualTestVec[j]->getTestName());
       return false;
     }
   }
-  for (int i = 0; i < singleTestVec.size(); i++) {
+  for (size_t i = 0; i < singleTestVec.size(); i++) {
     if (singleTestVec[i]->getTestState() == ABC150Test::TestState::Running) {
       ESP_LOGE(TAG, "%s already running on %s", singleTestVec[i]->getTestName(), SingleChannelTest::getChannelName(singleTestVec[i]->getChannel()));
       return false;
     }
   }
   dualTestVec[dualTest]->setCycles(cycleNum);
-  dualTestVec[dualTest]->startTest();
+  if (dualTestVec[dualTest]->startTest()) {
+    scheduler.activate(dualJobs[dualTest]);
+  }
   return true;
 }
 
@@ -147,7 +442,7 @@ bool ABC150TestManager::stopSingleTest(int singleTest) {
 }
 
 bool ABC150TestManager::stopDualTest(int dualTest) {
-  if (testCheck(TestType::Dual, dualTest)) {
+  if (!testCheck(TestType::Dual, dualTest)) {
     return false;
   }
   if (dualTestVec[dualTest]->getTestState() == ABC150Test::TestState::Running ||
@@ -161,35 +456,35 @@ bool ABC150TestManager::stopDualTest(int dualTest) {
 }
 
 void ABC150TestManager::stopAll() {
-  for(int i = 0; i < singleTestVec.size(); i++) {
+  for (size_t i = 0; i < singleTestVec.size(); i++) {
     if (singleTestVec[i]->getTestState() == ABC150Test::TestState::Running ||
         singleTestVec[i]->getTestState() == ABC150Test::TestState::Restart) {
       singleTestVec[i]->stopTest(ABC150Test::TestState::Idle);
     }
   }
-  for(int j = 0; j < dualTestVec.size(); j++) {
-    if (singleTestVec[j]->getTestState() == ABC150Test::TestState::Running ||
-        singleTestVec[j]->getTestState() == ABC150Test::TestState::Restart) {
-      singleTestVec[j]->stopTest(ABC150Test::TestState::Idle);
+  for (size_t j = 0; j < dualTestVec.size(); j++) {
+    if (dualTestVec[j]->getTestState() == ABC150Test::TestState::Running ||
+        dualTestVec[j]->getTestState() == ABC150Test::TestState::Restart) {
+      dualTestVec[j]->stopTest(ABC150Test::TestState::Idle);
     }
   }
 }
 
 void ABC150TestManager::stopAllOverride() {
   plateHandler->HVOff();
-  vTaskDelay(pdMS_TO_TICKS(500));
+  OSPort::delay(500);
   abc150Handler->releaseControl(ABC150CANHandler::A);
   abc150Handler->releaseControl(ABC150CANHandler::B);
 }
 
 bool ABC150TestManager::testCheck(TestType type, int test) {
   if (type == TestType::Single) {
-    if (test < 0 || test >= singleTestVec.size()) {
+    if (test < 0 || test >= (int)singleTestVec.size()) {
       ESP_LOGE(TAG, "Invalid test");
       return false;
     }
   } else if (type == TestType::Dual) {
-    if (test < 0 || test >= dualTestVec.size()) {
+    if (test < 0 || test >= (int)dualTestVec.size()) {
       ESP_LOGE(TAG, "Invalid test");
       return false;
     }
@@ -215,32 +510,61 @@ bool ABC150TestManager::checkCDFlag(TestType type, int test) {
   return false;
 }
 
+bool ABC150TestManager::checkProfileFlag(TestType type, int test) {
+  if (type == TestType::Single) {
+    return singleTestVec[test]->getProfileFlag();
+  } else if (type == TestType::Dual) {
+    return dualTestVec[test]->getProfileFlag();
+  }
+  return false;
+}
+
 void ABC150TestManager::listAllTests() {
   printf("\r\n");
   printf(GREEN "%-25s|%-10s|%-10s\r\n", "TestName", "Channel", "State" RESET);
-  for (int i = 0; i < singleTestVec.size(); i++) {
+  for (size_t i = 0; i < singleTestVec.size(); i++) {
     printf("%-25s|%-10s|%-10s\r\n", singleTestVec[i]->getTestName(),
       SingleChannelTest::getChannelName(singleTestVec[i]->getChannel()), getTestStateName(singleTestVec[i]->getTestState()));
   }
-  for (int j = 0; j < dualTestVec.size(); j++) {
+  for (size_t j = 0; j < dualTestVec.size(); j++) {
     printf("%-25s|%-10s|%-10s\r\n", dualTestVec[j]->getTestName(), "dual",
       getTestStateName(dualTestVec[j]->getTestState()));
   }
 }
 
+void ABC150TestManager::printStats() {
+  for (size_t i = 0; i < singleTestVec.size(); i++) {
+    printf(GREEN "%s (%s)\r\n" RESET, singleTestVec[i]->getTestName(),
+      SingleChannelTest::getChannelName(singleTestVec[i]->getChannel()));
+    singleTestVec[i]->printStats();
+  }
+  for (size_t j = 0; j < dualTestVec.size(); j++) {
+    printf(GREEN "%s (dual)\r\n" RESET, dualTestVec[j]->getTestName());
+    dualTestVec[j]->printStats();
+  }
+  printf(GREEN "Scheduler\r\n" RESET);
+  scheduler.print();
+  printf(GREEN "Console\r\n" RESET);
+  AsyncConsole::console().printStats();
+  printf(GREEN "Telemetry\r\n" RESET);
+  telemetry.printStats();
+  printf(GREEN "Commands\r\n" RESET);
+  commands.printStats();
+}
+
 void ABC150TestManager::listTestsByType(TestType type) {
   printf("\r\n");
   if (type == TestType::Single) {
       printf(GREEN "%-3s|%-25s|%-10s|%-10s\r\n", "Num","TestName", "Channel", "State" RESET);
-      for (int i = 0; i < singleTestVec.size(); i++) {
-        printf("%-3d|%-25s|%-10s|%-10s\r\n", i, singleTestVec[i]->getTestName(),
+      for (size_t i = 0; i < singleTestVec.size(); i++) {
+        printf("%-3d|%-25s|%-10s|%-10s\r\n", (int)i, singleTestVec[i]->getTestName(),
         SingleChannelTest::getChannelName(singleTestVec[i]->getChannel()), getTestStateName(singleTestVec[i]->getTestState()));
       }
       return;
   } else if (type == TestType::Dual) {
       printf(GREEN "%-3s|%-25s|%-10s\r\n", "Num","TestName", "State" RESET);
-      for (int j = 0; j < dualTestVec.size(); j++) {
-        printf("%-3d|%-25s|%-10s\r\n", j, dualTestVec[j]->getTestName(),
+      for (size_t j = 0; j < dualTestVec.size(); j++) {
+        printf("%-3d|%-25s|%-10s\r\n", (int)j, dualTestVec[j]->getTestName(),
         getTestStateName(dualTestVec[j]->getTestState()));
       }
       return;
@@ -259,6 +583,45 @@ bool ABC150TestManager::setDestinationVoltage(TestType type, int test, float vol
   return true;
 }
 
+void ABC150TestManager::listProfiles(TestType type, int test) {
+  if(!testCheck(type, test)) {
+    return;
+  }
+  if (type == TestType::Single) {
+    singleTestVec[test]->listProfiles();
+  } else if (type == TestType::Dual) {
+    dualTestVec[test]->listProfiles();
+  }
+}
+
+bool ABC150TestManager::setProfile(TestType type, int test, int profile) {
+  if(!testCheck(type, test)) {
+    return false;
+  }
+  if (type == TestType::Single) {
+    return singleTestVec[test]->setProfile(profile);
+  } else if (type == TestType::Dual) {
+    return dualTestVec[test]->setProfile(profile);
+  }
+  return false;
+}
+
+bool ABC150TestManager::setPowerTracking(TestType type, int test, bool enable) {
+  if(!testCheck(type, test)) {
+    return false;
+  }
+  bool done = false;
+  if (type == TestType::Single) {
+    done = singleTestVec[test]->setPowerTracking(enable);
+  } else if (type == TestType::Dual) {
+    done = dualTestVec[test]->setPowerTracking(enable);
+  }
+  if (!done) {
+    ESP_LOGE(TAG, "Test has no power tracking");
+  }
+  return done;
+}
+
 void ABC150TestManager::setBMAmpleID(int ch, unsigned int ID) {
   if (ch == 0 || ch == 1) {
     bmAmpleID[ch] = ID;
@@ -270,19 +633,14 @@ void ABC150TestManager::setBMAmpleID(int ch, unsigned int ID) {
 void ABC150TestManager::debugToggle() {
   if (debugLogEnable == true) {
     debugLogEnable = false;
-    assert(xTimerStop(debugLogTimer, pdMS_TO_TICKS(1000)) == pdPASS);
+    assert(OSPort::stopTimer(debugLogTimer));
   } else {
     debugLogEnable = true;
-    assert(xTimerStart(debugLogTimer, pdMS_TO_TICKS(1000)) == pdPASS);
+    assert(OSPort::startTimer(debugLogTimer));
   }
   printf("debug output %s\r\n", debugLogEnable ? "enabled" : "disabled");
 }
 
-void ABC150TestManager::loopTaskWrapper(void *arg) {
-  ABC150TestManager * obj =  (ABC150TestManager *)arg;
-  obj->loopTask();
-}
-
 uint64_t ABC150TestManager::getRunningTime(TestType type, int test) {
   if (type == TestType::Single) {
     if (testCheck(TestType::Single, test)) {
@@ -296,24 +654,6 @@ uint64_t ABC150TestManager::getRunningTime(TestType type, int test) {
   return 0;
 }
 
-void ABC150TestManager::loopTask() {
-  CAN_frame_t canMsg;
-  const TickType_t xFrequency = pdMS_TO_TICKS(100);//Run 100ms
-  xLastWakeTime = xTaskGetTickCount();
-
-  while (1) {
-    // Wait for the next cycle.
-
-    vTaskDelayUntil(&xLastWakeTime, xFrequency);
-    for(int i = 0; i < singleTestVec.size(); i++) {
-      singleTestVec[i]->loop();
-    }
-    for (int j = 0; j < dualTestVec.size(); j++) {
-      dualTestVec[j]->loop();
-    }
-  }
-}
-
 void ABC150TestUserInterface::help() {
   printf("\r\n");
   printf(GREEN "ABC150 Test Interface.\r\n" RESET);
@@ -329,6 +669,9 @@ void ABC150TestUserInterface::help() {
   printf("  d: Enable/Disable debug output\r\n");
   printf("  r: Get running time of a test\r\n");
   printf("  l: List all tests\r\n");
+  printf("  s: Print test timing statistics\r\n");
+  printf("  y: Set binary telemetry rate\r\n");
+  printf("  t: Enable/Disable power tracking of a test\r\n");
 
   printf("  h: Print this help again\r\n");
   printf("  q: Quit\r\n\n\n");
@@ -346,6 +689,9 @@ void ABC150TestUserInterface::ABC150TestInterface(AmpleSerial &pc, ABC150TestMan
       int cycles;
       char confirm;
       int type;
+      int profile;
+      int rate;
+      ABC150TestManager::TestType testType;
       printf("ABC150> ");
       fflush(stdout);
       input = pc.rx_char();
@@ -365,6 +711,13 @@ void ABC150TestUserInterface::ABC150TestInterface(AmpleSerial &pc, ABC150TestMan
               if (!testManager->setDestinationVoltage(ABC150TestManager::TestType::Single, test, voltage)) break;
             }
           }
+          if (testManager->checkProfileFlag(ABC150TestManager::TestType::Single, test)) {
+            testManager->listProfiles(ABC150TestManager::TestType::Single, test);
+            printf("\r\n");
+            if (!pc.readNumber(profile, "Which profile? ")) break;
+            printf("\r\n");
+            if (!testManager->setProfile(ABC150TestManager::TestType::Single, test, profile)) break;
+          }
           testManager->runSingleTest(test, cycles);
         }
         break;
@@ -383,6 +736,13 @@ void ABC150TestUserInterface::ABC150TestInterface(AmpleSerial &pc, ABC150TestMan
               if (!testManager->setDestinationVoltage(ABC150TestManager::TestType::Dual, test, voltage)) break;
             }
           }
+          if (testManager->checkProfileFlag(ABC150TestManager::TestType::Dual, test)) {
+            testManager->listProfiles(ABC150TestManager::TestType::Dual, test);
+            printf("\r\n");
+            if (!pc.readNumber(profile, "Which profile? ")) break;
+            printf("\r\n");
+            if (!testManager->setProfile(ABC150TestManager::TestType::Dual, test, profile)) break;
+          }
           testManager->runDualTest(test, cycles);
         }
         break;
@@ -473,6 +833,45 @@ void ABC150TestUserInterface::ABC150TestInterface(AmpleSerial &pc, ABC150TestMan
         testManager->listAllTests();
         break;
 
+      case 's':
+        testManager->printStats();
+        break;
+
+      case 'y':
+        if (pc.readNumber(rate, "Rate in Hz (0 off, 10-100): ")) {
+          printf("\r\n");
+          if (testManager->getTelemetry().setRate(rate)) {
+            printf("telemetry %s\r\n", (rate == 0) ? "disabled" : "enabled");
+          }
+        }
+        break;
+
+      case 't':
+        printf("\n1| Single\r\n2| Dual\r\n");
+        printf("\r\n");
+        if (pc.readNumber(type, "Single or Dual? ")) {
+          printf("\r\n");
+          if (type != 1 && type != 2) {
+            ESP_LOGE("ABC150TestManager", "Invalid type");
+            break;
+          }
+          testType = (type == 1) ? ABC150TestManager::TestType::Single : ABC150TestManager::TestType::Dual;
+          testManager->listTestsByType(testType);
+          printf("\r\n");
+          if (!pc.readNumber(test, "Which test? ")) break;
+          printf("\r\n");
+          if (!testManager->testCheck(testType, test)) break;
+          printf("Enable power tracking? Press 'n' to disable or 'y' to enable.\r\n");
+          confirm = pc.rx_char();
+          printf("\r\n");
+          if (confirm == 'y' || confirm == 'n') {
+            testManager->setPowerTracking(testType, test, confirm == 'y');
+          } else {
+            ESP_LOGE("ABC150TestManager", "Invalid input");
+          }
+        }
+        break;
+
       case 'h':
         ABC150TestUserInterface::help();
         break;
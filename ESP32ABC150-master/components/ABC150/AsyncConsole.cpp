@@ -0,0 +1,201 @@
+/*
+ * AsyncConsole.cpp
+ */
+
+#include "AsyncConsole.hpp"
+#include "esp_log.h"
+#include <stdio.h>
+#include <string.h>
+
+#define CONSOLE_STACK_SIZE          3072
+/* Lowest application priority, output only goes out when nothing else runs */
+#define CONSOLE_PRIORITY            1
+#define CONSOLE_DRAIN_PERIOD_MS     10
+/* Longest conversion specification copied from a format, e.g. %-10.3f */
+#define CONSOLE_SPEC_SIZE           16
+
+AsyncConsole &AsyncConsole::console() {
+  static AsyncConsole console;
+  return console;
+}
+
+AsyncConsole::AsyncConsole() :
+                           reportedDrops(0),
+                           writer(&AsyncConsole::writeStdout),
+                           taskHandle(NULL){
+}
+
+AsyncConsole::~AsyncConsole() {
+  if (taskHandle != NULL) {
+    OSPort::deleteTask(taskHandle);
+  }
+}
+
+bool AsyncConsole::start() {
+  if (taskHandle != NULL) {
+    return true;
+  }
+  if (!OSPort::createTask(&AsyncConsole::consoleTaskWrapper, "Console", CONSOLE_STACK_SIZE, this, CONSOLE_PRIORITY,
+                          &taskHandle)) {
+    ESP_LOGE(TAG, "Failed to create console task");
+    return false;
+  }
+  return true;
+}
+
+void AsyncConsole::setWriter(Writer _writer) {
+  writer = _writer;
+}
+
+uint32_t AsyncConsole::drain() {
+  uint32_t count = 0;
+  Record *record;
+  while ((record = records.front()) != NULL) {
+    size_t length = format(*record, line, sizeof(line));
+    /* Free the record before the slow write */
+    records.release();
+    writer(line, length);
+    count++;
+  }
+  uint32_t drops = records.getDropped();
+  if (drops != reportedDrops) {
+    int length = snprintf(line, sizeof(line), "[%u console records dropped]\r\n", drops - reportedDrops);
+    reportedDrops = drops;
+    writer(line, length);
+  }
+  return count;
+}
+
+size_t AsyncConsole::format(const Record &record, char *out, size_t size) {
+  size_t length = 0;
+  int arg = 0;
+  const char *p = record.format;
+  char spec[CONSOLE_SPEC_SIZE];
+  while (*p != 0 && length < size - 1) {
+    if (*p != '%') {
+      out[length++] = *p++;
+      continue;
+    }
+    if (p[1] == '%') {
+      out[length++] = '%';
+      p += 2;
+      continue;
+    }
+    /* Keep flags, width and precision, the length comes from the stored argument */
+    size_t n = 0;
+    spec[n++] = *p++;
+    while (*p != 0 && strchr("-+ #0123456789.", *p) != NULL && n < CONSOLE_SPEC_SIZE - 4) {
+      spec[n++] = *p++;
+    }
+    while (*p != 0 && strchr("hlLjzt", *p) != NULL) {
+      p++;
+    }
+    char conversion = *p;
+    if (conversion == 0) {
+      break;
+    }
+    p++;
+    if (arg >= record.count) {
+      out[length++] = '?';
+      continue;
+    }
+    ArgType type = record.types[arg];
+    ArgValue value = record.values[arg];
+    arg++;
+    int written = 0;
+    switch (conversion) {
+    case 'd':
+    case 'i':
+    case 'c':
+    case 'u':
+    case 'x':
+    case 'X':
+    case 'o':
+      if (type == Double) {
+        value.i = (long long)value.d;
+      } else if (type == String) {
+        value.i = 0;
+      }
+      if (conversion == 'c') {
+        spec[n++] = 'c';
+        spec[n] = 0;
+        written = snprintf(out + length, size - length, spec, (int)value.i);
+      } else {
+        spec[n++] = 'l';
+        spec[n++] = 'l';
+        spec[n++] = conversion;
+        spec[n] = 0;
+        if (conversion == 'd' || conversion == 'i') {
+          written = snprintf(out + length, size - length, spec, value.i);
+        } else {
+          written = snprintf(out + length, size - length, spec, value.u);
+        }
+      }
+      break;
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+      if (type == Signed) {
+        value.d = (double)value.i;
+      } else if (type == Unsigned) {
+        value.d = (double)value.u;
+      } else if (type == String) {
+        value.d = 0;
+      }
+      spec[n++] = conversion;
+      spec[n] = 0;
+      written = snprintf(out + length, size - length, spec, value.d);
+      break;
+    case 's':
+      spec[n++] = 's';
+      spec[n] = 0;
+      written = snprintf(out + length, size - length, spec, (type == String && value.s != NULL) ? value.s : "?");
+      break;
+    default:
+      out[length++] = '?';
+      break;
+    }
+    if (written > 0) {
+      length += ((size_t)written < size - length) ? written : size - length - 1;
+    }
+  }
+  out[length] = 0;
+  return length;
+}
+
+uint32_t AsyncConsole::getQueued() {
+  return records.getPushed();
+}
+
+uint32_t AsyncConsole::getWritten() {
+  return records.getPopped();
+}
+
+uint32_t AsyncConsole::getDropped() {
+  return records.getDropped();
+}
+
+void AsyncConsole::printStats() {
+  printf("  %-8s|%-8s|%s\r\n", "Queued", "Written", "Dropped");
+  printf("  %-8u|%-8u|%u\r\n", getQueued(), getWritten(), getDropped());
+}
+
+void AsyncConsole::writeStdout(const char *text, size_t length) {
+  fwrite(text, 1, length, stdout);
+  fflush(stdout);
+}
+
+void AsyncConsole::consoleTaskWrapper(void *arg) {
+  AsyncConsole *console = (AsyncConsole *)arg;
+  console->consoleTask();
+}
+
+void AsyncConsole::consoleTask() {
+  while (1) {
+    drain();
+    OSPort::delay(CONSOLE_DRAIN_PERIOD_MS);
+  }
+}
@@ -0,0 +1,220 @@
+/*
+ * CANAcceptanceFilter.cpp
+ *
+ * compile() tries every mask made of the bits on which the IDs agree plus a
+ * subset of the bits on which they differ, for RXB0 with one or two of the
+ * groups of IDs that mask forms, and the best mask for the rest on RXB1. The
+ * search grows with 4^(differing bits), 5 for the ABC150 IDs.
+ */
+
+#include "CANAcceptanceFilter.hpp"
+#include "esp_log.h"
+#include <string.h>
+
+#define CAN_STD_ID_MASK             0x7FF
+/* Filters of RXB0 and RXB1 */
+#define RXB0_FILTERS                2
+#define RXB1_FILTERS                4
+
+static int bitCount(uint32_t value) {
+  int count = 0;
+  while (value) {
+    value &= value - 1;
+    count++;
+  }
+  return count;
+}
+
+CANAcceptanceFilter::CANAcceptanceFilter() :
+                     idCount(0),
+                     registers{}{
+  memset(bitmap, 0, sizeof(bitmap));
+}
+
+bool CANAcceptanceFilter::add(uint16_t id) {
+  if (id >= CAN_STD_ID_COUNT || idCount >= CAN_ACCEPTANCE_MAX_IDS) {
+    ESP_LOGE(TAG, "Can not add ID 0x%03x", id);
+    return false;
+  }
+  if (accepts(id)) {
+    return true;
+  }
+  bitmap[id >> 5] |= 1u << (id & 31);
+  ids[idCount++] = id;
+  return true;
+}
+
+bool CANAcceptanceFilter::cover(uint32_t members, uint16_t mask, int filters, Buffer *buffer) {
+  buffer->mask = mask;
+  buffer->count = 0;
+  for (int i = 0; i < idCount; i++) {
+    if (!(members & (1u << i))) {
+      continue;
+    }
+    uint16_t value = ids[i] & mask;
+    int j = 0;
+    while (j < buffer->count && buffer->values[j] != value) {
+      j++;
+    }
+    if (j == buffer->count) {
+      if (buffer->count == filters) {
+        return false;
+      }
+      buffer->values[buffer->count++] = value;
+    }
+  }
+  buffer->accepted = (uint32_t)buffer->count << bitCount(~mask & CAN_STD_ID_MASK);
+  return true;
+}
+
+bool CANAcceptanceFilter::bestCover(uint32_t members, uint16_t fixed, uint16_t varying, int filters, Buffer *buffer) {
+  bool found = false;
+  Buffer candidate;
+  /* Every subset of the varying bits, down to none */
+  uint16_t subset = varying;
+  while (1) {
+    if (cover(members, fixed | subset, filters, &candidate) && (!found || candidate.accepted < buffer->accepted)) {
+      *buffer = candidate;
+      found = true;
+    }
+    if (subset == 0) {
+      break;
+    }
+    subset = (subset - 1) & varying;
+  }
+  return found;
+}
+
+bool CANAcceptanceFilter::compile() {
+  if (idCount == 0) {
+    return false;
+  }
+  uint32_t all = (idCount == 32) ? 0xFFFFFFFF : ((1u << idCount) - 1);
+  uint16_t varying = 0;
+  for (int i = 1; i < idCount; i++) {
+    varying |= ids[i] ^ ids[0];
+  }
+  uint16_t fixed = ~varying & CAN_STD_ID_MASK;
+
+  Buffer rxb0;
+  Buffer rxb1;
+  bool found = false;
+  uint32_t best = 0;
+  /* Everything on RXB1, RXB0 repeats one of its filters */
+  if (bestCover(all, fixed, varying, RXB1_FILTERS, &rxb1)) {
+    rxb0.mask = rxb1.mask;
+    rxb0.values[0] = rxb1.values[0];
+    rxb0.count = 1;
+    best = rxb1.accepted;
+    found = true;
+  }
+  /* One or two groups of an RXB0 mask, the rest on RXB1 */
+  uint16_t subset = varying;
+  while (1) {
+    uint16_t mask = fixed | subset;
+    uint16_t groups[CAN_ACCEPTANCE_MAX_IDS];
+    uint32_t groupMembers[CAN_ACCEPTANCE_MAX_IDS];
+    int groupCount = 0;
+    for (int i = 0; i < idCount; i++) {
+      int j = 0;
+      while (j < groupCount && groups[j] != (ids[i] & mask)) {
+        j++;
+      }
+      if (j == groupCount) {
+        groups[groupCount] = ids[i] & mask;
+        groupMembers[groupCount++] = 0;
+      }
+      groupMembers[j] |= 1u << i;
+    }
+    uint32_t groupSize = 1u << bitCount(~mask & CAN_STD_ID_MASK);
+    for (int a = 0; a < groupCount; a++) {
+      for (int b = a; b < groupCount; b++) {
+        uint32_t members = groupMembers[a] | groupMembers[b];
+        uint32_t accepted = groupSize * ((a == b) ? 1 : 2);
+        Buffer rest;
+        if (members == all) {
+          rest.accepted = 0;
+        } else {
+          uint16_t restVarying = 0;
+          int first = -1;
+          for (int i = 0; i < idCount; i++) {
+            if (!(members & (1u << i))) {
+              if (first < 0) {
+                first = i;
+              }
+              restVarying |= ids[i] ^ ids[first];
+            }
+          }
+          if (!bestCover(all & ~members, ~restVarying & CAN_STD_ID_MASK, restVarying, RXB1_FILTERS, &rest)) {
+            continue;
+          }
+        }
+        if (found && accepted + rest.accepted >= best) {
+          continue;
+        }
+        rxb0.mask = mask;
+        rxb0.values[0] = groups[a];
+        rxb0.values[1] = groups[b];
+        rxb0.count = 2;
+        if (members == all) {
+          rxb1.mask = mask;
+          rxb1.values[0] = groups[a];
+          rxb1.count = 1;
+        } else {
+          rxb1 = rest;
+        }
+        best = accepted + rest.accepted;
+        found = true;
+      }
+    }
+    if (subset == 0) {
+      break;
+    }
+    subset = (subset - 1) & varying;
+  }
+  if (!found) {
+    ESP_LOGE(TAG, "No filter covers %d IDs", idCount);
+    return false;
+  }
+  /* Unused filters repeat a used one */
+  registers.mask[0] = rxb0.mask;
+  registers.mask[1] = rxb1.mask;
+  for (int i = 0; i < RXB0_FILTERS; i++) {
+    registers.filter[i] = rxb0.values[(i < rxb0.count) ? i : 0];
+  }
+  for (int i = 0; i < RXB1_FILTERS; i++) {
+    registers.filter[RXB0_FILTERS + i] = rxb1.values[(i < rxb1.count) ? i : 0];
+  }
+  return true;
+}
+
+const CANAcceptanceFilter::Registers &CANAcceptanceFilter::getRegisters() {
+  return registers;
+}
+
+bool CANAcceptanceFilter::hardwareAccepts(uint16_t id) {
+  for (int i = 0; i < CAN_FILTERS; i++) {
+    uint16_t mask = registers.mask[(i < RXB0_FILTERS) ? 0 : 1];
+    if ((id & mask) == (registers.filter[i] & mask)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+uint32_t CANAcceptanceFilter::getHardwareAcceptedCount() {
+  uint32_t count = 0;
+  for (uint16_t id = 0; id < CAN_STD_ID_COUNT; id++) {
+    if (hardwareAccepts(id)) {
+      count++;
+    }
+  }
+  return count;
+}
+
+void CANAcceptanceFilter::print() {
+  ESP_LOGI(TAG, "RXM0 0x%03x RXF0 0x%03x RXF1 0x%03x", registers.mask[0], registers.filter[0], registers.filter[1]);
+  ESP_LOGI(TAG, "RXM1 0x%03x RXF2 0x%03x RXF3 0x%03x RXF4 0x%03x RXF5 0x%03x", registers.mask[1],
+           registers.filter[2], registers.filter[3], registers.filter[4], registers.filter[5]);
+  ESP_LOGI(TAG, "%d IDs, %d pass the filters", idCount, getHardwareAcceptedCount());
+}
@@ -0,0 +1,189 @@
+/*
+ * CANStats.cpp
+ */
+
+#include "CANStats.hpp"
+#include "OSPort.hpp"
+#include <stdio.h>
+
+const uint32_t CANStats::bucketLimitsMs[CAN_STATS_BUCKETS] = {
+    1, 2, 5, 10, 20, 50, 100, 200, 1000, UINT32_MAX
+};
+
+static uint8_t *put16(uint8_t *out, uint16_t value) {
+  out[0] = value;
+  out[1] = value >> 8;
+  return out + 2;
+}
+
+static uint8_t *put32(uint8_t *out, uint32_t value) {
+  out[0] = value;
+  out[1] = value >> 8;
+  out[2] = value >> 16;
+  out[3] = value >> 24;
+  return out + 4;
+}
+
+CANStats::CANStats(uint32_t _bitRate) :
+                   bitRate(_bitRate),
+                   slotCount(0),
+                   enabled(true){
+  for (int i = 0; i < CAN_STATS_MAX_IDS; i++) {
+    slots[i].id = 0;
+    slots[i].name = "";
+  }
+  reset();
+}
+
+int CANStats::addID(uint16_t id, const char *name) {
+  if (slotCount >= CAN_STATS_MAX_IDS) {
+    return -1;
+  }
+  slots[slotCount].id = id;
+  slots[slotCount].name = name;
+  return slotCount++;
+}
+
+void CANStats::reset() {
+  for (int i = 0; i < CAN_STATS_MAX_IDS; i++) {
+    slots[i].frames.store(0, std::memory_order_relaxed);
+    slots[i].lastMs.store(0, std::memory_order_relaxed);
+    for (int j = 0; j < CAN_STATS_BUCKETS; j++) {
+      slots[i].buckets[j].store(0, std::memory_order_relaxed);
+    }
+  }
+  otherFrames.store(0, std::memory_order_relaxed);
+  rxBits.store(0, std::memory_order_relaxed);
+  txFrames.store(0, std::memory_order_relaxed);
+  txBits.store(0, std::memory_order_relaxed);
+  for (int i = 0; i < CAN_STATS_MAX_DEPTH; i++) {
+    depths[i].store(0, std::memory_order_relaxed);
+  }
+  startMs = OSPort::getTimeMs();
+}
+
+void CANStats::setEnabled(bool enable) {
+  enabled.store(enable, std::memory_order_relaxed);
+}
+
+bool CANStats::isEnabled() {
+  return enabled.load(std::memory_order_relaxed);
+}
+
+void CANStats::received(int slot, uint8_t dlc, uint32_t nowMs) {
+  increment(rxBits, frameBits(dlc));
+  if (slot < 0 || slot >= slotCount) {
+    increment(otherFrames);
+    return;
+  }
+  Slot &s = slots[slot];
+  if (s.frames.load(std::memory_order_relaxed) > 0) {
+    uint32_t interval = nowMs - s.lastMs.load(std::memory_order_relaxed);
+    int i = 0;
+    while (interval >= bucketLimitsMs[i] && i < CAN_STATS_BUCKETS - 1) {
+      i++;
+    }
+    increment(s.buckets[i]);
+  }
+  s.lastMs.store(nowMs, std::memory_order_relaxed);
+  increment(s.frames);
+}
+
+void CANStats::transmitted(uint8_t dlc) {
+  txFrames.fetch_add(1, std::memory_order_relaxed);
+  txBits.fetch_add(frameBits(dlc), std::memory_order_relaxed);
+}
+
+void CANStats::queued(int depth) {
+  if (depth < 1) {
+    depth = 1;
+  } else if (depth > CAN_STATS_MAX_DEPTH) {
+    depth = CAN_STATS_MAX_DEPTH;
+  }
+  depths[depth - 1].fetch_add(1, std::memory_order_relaxed);
+}
+
+uint32_t CANStats::getFrames(int slot) {
+  return (slot >= 0 && slot < slotCount) ? slots[slot].frames.load(std::memory_order_relaxed) : 0;
+}
+
+uint32_t CANStats::getOtherFrames() {
+  return otherFrames.load(std::memory_order_relaxed);
+}
+
+uint32_t CANStats::getAgeMs(int slot) {
+  if (getFrames(slot) == 0) {
+    return UINT32_MAX;
+  }
+  return OSPort::getTickMs() - slots[slot].lastMs.load(std::memory_order_relaxed);
+}
+
+uint32_t CANStats::getElapsedMs() {
+  int64_t elapsedMs = OSPort::getTimeMs() - startMs;
+  return (elapsedMs > UINT32_MAX) ? UINT32_MAX : (uint32_t)elapsedMs;
+}
+
+float CANStats::getBusLoad() {
+  uint32_t elapsedMs = getElapsedMs();
+  if (elapsedMs == 0) {
+    return 0;
+  }
+  uint32_t bits = rxBits.load(std::memory_order_relaxed) + txBits.load(std::memory_order_relaxed);
+  return (float)bits * 1000 / bitRate / elapsedMs;
+}
+
+void CANStats::print() {
+  uint32_t elapsedMs = getElapsedMs();
+  printf("  %d.%03d s, bus load %.1f %% (frames passing the filters), %d other frames\r\n", elapsedMs / 1000,
+         elapsedMs % 1000, getBusLoad() * 100, otherFrames.load(std::memory_order_relaxed));
+  printf("  %-5s|%-15s|%-8s|%-9s|inter-arrival <1 <2 <5 <10 <20 <50 <100 <200 <1000 >=1000 ms\r\n", "ID", "Name",
+         "Frames", "Age ms");
+  for (int i = 0; i < slotCount; i++) {
+    uint32_t age = getAgeMs(i);
+    printf("  0x%03x|%-15s|%-8d|", slots[i].id, slots[i].name, getFrames(i));
+    if (age == UINT32_MAX) {
+      printf("%-9s|", "-");
+    } else {
+      printf("%-9d|", age);
+    }
+    for (int j = 0; j < CAN_STATS_BUCKETS; j++) {
+      printf(" %d", slots[i].buckets[j].load(std::memory_order_relaxed));
+    }
+    printf("\r\n");
+  }
+  printf("  Sent %d frames, transmit buffers in use after a write:", txFrames.load(std::memory_order_relaxed));
+  for (int i = 0; i < CAN_STATS_MAX_DEPTH; i++) {
+    printf(" %d: %d", i + 1, depths[i].load(std::memory_order_relaxed));
+  }
+  printf("\r\n");
+}
+
+size_t CANStats::serialize(uint8_t *out, size_t size) {
+  size_t length = CAN_STATS_HEADER_SIZE + slotCount * CAN_STATS_SLOT_SIZE;
+  if (size < length) {
+    return 0;
+  }
+  uint8_t *p = out;
+  p = put32(p, CAN_STATS_MAGIC);
+  p = put16(p, CAN_STATS_VERSION);
+  *p++ = slotCount;
+  *p++ = CAN_STATS_BUCKETS;
+  p = put32(p, getElapsedMs());
+  p = put32(p, bitRate);
+  p = put32(p, rxBits.load(std::memory_order_relaxed));
+  p = put32(p, otherFrames.load(std::memory_order_relaxed));
+  p = put32(p, txFrames.load(std::memory_order_relaxed));
+  p = put32(p, txBits.load(std::memory_order_relaxed));
+  for (int i = 0; i < CAN_STATS_MAX_DEPTH; i++) {
+    p = put32(p, depths[i].load(std::memory_order_relaxed));
+  }
+  for (int i = 0; i < slotCount; i++) {
+    p = put16(p, slots[i].id);
+    p = put32(p, getFrames(i));
+    p = put32(p, getAgeMs(i));
+    for (int j = 0; j < CAN_STATS_BUCKETS; j++) {
+      p = put32(p, slots[i].buckets[j].load(std::memory_order_relaxed));
+    }
+  }
+  return p - out;
+}
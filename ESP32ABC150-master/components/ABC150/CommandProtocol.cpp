@@ -0,0 +1,178 @@
+/*
+ * CommandProtocol.cpp
+ */
+
+#include "CommandProtocol.hpp"
+#include "TelemetryFrame.hpp"
+#include <string.h>
+
+void CommandProtocol::Message::clear() {
+  length = 0;
+  position = 0;
+}
+
+bool CommandProtocol::Message::put8(uint8_t value) {
+  if (length + 1 > COMMAND_MAX_PAYLOAD) {
+    return false;
+  }
+  payload[length++] = value;
+  return true;
+}
+
+bool CommandProtocol::Message::put16(uint16_t value) {
+  if (length + 2 > COMMAND_MAX_PAYLOAD) {
+    return false;
+  }
+  payload[length++] = value;
+  payload[length++] = value >> 8;
+  return true;
+}
+
+bool CommandProtocol::Message::put32(uint32_t value) {
+  if (length + 4 > COMMAND_MAX_PAYLOAD) {
+    return false;
+  }
+  payload[length++] = value;
+  payload[length++] = value >> 8;
+  payload[length++] = value >> 16;
+  payload[length++] = value >> 24;
+  return true;
+}
+
+bool CommandProtocol::Message::putString(const char *string) {
+  size_t stringLength = strlen(string);
+  if (stringLength > UINT8_MAX || length + 1 + stringLength > COMMAND_MAX_PAYLOAD) {
+    return false;
+  }
+  payload[length++] = stringLength;
+  memcpy(payload + length, string, stringLength);
+  length += stringLength;
+  return true;
+}
+
+bool CommandProtocol::Message::get8(uint8_t *value) {
+  if (position + 1 > length) {
+    return false;
+  }
+  *value = payload[position++];
+  return true;
+}
+
+bool CommandProtocol::Message::get16(uint16_t *value) {
+  if (position + 2 > length) {
+    return false;
+  }
+  *value = payload[position] | (payload[position + 1] << 8);
+  position += 2;
+  return true;
+}
+
+bool CommandProtocol::Message::get32(uint32_t *value) {
+  if (position + 4 > length) {
+    return false;
+  }
+  *value = payload[position] | (payload[position + 1] << 8) | (payload[position + 2] << 16) |
+           ((uint32_t)payload[position + 3] << 24);
+  position += 4;
+  return true;
+}
+
+bool CommandProtocol::Message::getString(char *string, size_t size) {
+  uint8_t stringLength;
+  if (!get8(&stringLength) || position + stringLength > length) {
+    return false;
+  }
+  size_t copied = (stringLength < size) ? stringLength : size - 1;
+  memcpy(string, payload + position, copied);
+  string[copied] = '\0';
+  position += stringLength;
+  return true;
+}
+
+bool CommandProtocol::Message::atEnd() {
+  return position == length;
+}
+
+size_t CommandProtocol::encode(const Message &message, uint8_t *out, size_t size) {
+  if (message.length > COMMAND_MAX_PAYLOAD) {
+    return 0;
+  }
+  uint8_t frame[COMMAND_MAX_LENGTH];
+  uint8_t *p = frame;
+  *p++ = message.type;
+  *p++ = message.sequence;
+  *p++ = message.sequence >> 8;
+  *p++ = message.command;
+  if (message.type == Response) {
+    *p++ = message.result;
+  }
+  memcpy(p, message.payload, message.length);
+  p += message.length;
+  return TelemetryFrame::pack(frame, p - frame, out, size);
+}
+
+bool CommandProtocol::decode(const uint8_t *in, size_t length, Message *message) {
+  uint8_t frame[COMMAND_MAX_FRAME];
+  size_t size = TelemetryFrame::unpack(in, length, frame, sizeof(frame));
+  if (size < 4 || (frame[0] != Request && frame[0] != Response)) {
+    return false;
+  }
+  size_t header = (frame[0] == Response) ? COMMAND_HEADER : COMMAND_HEADER - 1;
+  if (size < header || size - header > COMMAND_MAX_PAYLOAD) {
+    return false;
+  }
+  message->type = (Type)frame[0];
+  message->sequence = frame[1] | (frame[2] << 8);
+  message->command = frame[3];
+  message->result = (frame[0] == Response) ? (Result)frame[4] : (Result)Ok;
+  message->length = size - header;
+  message->position = 0;
+  memcpy(message->payload, frame + header, message->length);
+  return true;
+}
+
+const char *CommandProtocol::getCommandName(uint8_t command) {
+  switch (command) {
+  case Ping:
+    return "Ping";
+  case GetStatus:
+    return "GetStatus";
+  case ListTests:
+    return "ListTests";
+  case StartTest:
+    return "StartTest";
+  case StopTest:
+    return "StopTest";
+  case StopAll:
+    return "StopAll";
+  case SetSetpoint:
+    return "SetSetpoint";
+  case SetControl:
+    return "SetControl";
+  case SetBMID:
+    return "SetBMID";
+  case SetTelemetryRate:
+    return "SetTelemetryRate";
+  case SetPowerTracking:
+    return "SetPowerTracking";
+  default:
+    return "Unknown";
+  }
+}
+
+const char *CommandProtocol::getResultName(uint8_t result) {
+  switch (result) {
+  case Ok:
+    return "Ok";
+  case UnknownCommand:
+    return "UnknownCommand";
+  case BadLength:
+    return "BadLength";
+  case InvalidArgument:
+    return "InvalidArgument";
+  case Rejected:
+    return "Rejected";
+  default:
+    return "Unknown";
+  }
+}
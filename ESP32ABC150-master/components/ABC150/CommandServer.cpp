@@ -0,0 +1,142 @@
+/*
+ * CommandServer.cpp
+ */
+
+#include "CommandServer.hpp"
+#include "esp_log.h"
+#include <stdio.h>
+
+#define COMMAND_STACK_SIZE          4096
+/* Above the console and telemetry writers, a busy console UART does not hold up commands */
+#define COMMAND_PRIORITY            2
+#define COMMAND_READ_SIZE           64
+/* Wait before reading again after the link failed */
+#define COMMAND_RETRY_MS            1000
+
+CommandServer::CommandServer(Handler _handler, void *_handlerArg) :
+                             handler(_handler),
+                             handlerArg(_handlerArg),
+                             reader(NULL),
+                             writer(NULL),
+                             linkArg(NULL),
+                             frameLength(0),
+                             overflow(false),
+                             answered(false),
+                             lastSequence(0),
+                             lastCommand(0),
+                             responseLength(0),
+                             requests(0),
+                             repeats(0),
+                             corrupt(0),
+                             taskHandle(NULL){
+}
+
+CommandServer::~CommandServer() {
+  if (taskHandle != NULL) {
+    OSPort::deleteTask(taskHandle);
+  }
+}
+
+bool CommandServer::start(Reader _reader, Writer _writer, void *_linkArg) {
+  if (taskHandle != NULL) {
+    ESP_LOGE(TAG, "Already started");
+    return false;
+  }
+  reader = _reader;
+  writer = _writer;
+  linkArg = _linkArg;
+  if (!OSPort::createTask(&CommandServer::taskWrapper, "Commands", COMMAND_STACK_SIZE, this, COMMAND_PRIORITY,
+                          &taskHandle)) {
+    ESP_LOGE(TAG, "Failed to create command task");
+    return false;
+  }
+  return true;
+}
+
+void CommandServer::receive(const uint8_t *data, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    if (data[i] != 0) {
+      if (frameLength < sizeof(frame)) {
+        frame[frameLength++] = data[i];
+      } else {
+        overflow = true;
+      }
+      continue;
+    }
+    if (frameLength == 0) {
+      continue;
+    }
+    if (overflow) {
+      corrupt++;
+    } else {
+      handleFrame();
+    }
+    frameLength = 0;
+    overflow = false;
+  }
+}
+
+void CommandServer::handleFrame() {
+  if (!CommandProtocol::decode(frame, frameLength, &request) || request.type != CommandProtocol::Request) {
+    /* Noise, or a response echoed back, the client sends the request again */
+    corrupt++;
+    return;
+  }
+  if (answered && request.sequence == lastSequence && request.command == lastCommand) {
+    repeats++;
+    writer(response, responseLength, linkArg);
+    return;
+  }
+  requests++;
+  reply.clear();
+  reply.result = handler(handlerArg, request, reply);
+  reply.type = CommandProtocol::Response;
+  reply.sequence = request.sequence;
+  reply.command = request.command;
+  responseLength = CommandProtocol::encode(reply, response, sizeof(response));
+  if (responseLength == 0) {
+    ESP_LOGE(TAG, "%s response does not fit", CommandProtocol::getCommandName(request.command));
+    reply.clear();
+    reply.result = CommandProtocol::Rejected;
+    responseLength = CommandProtocol::encode(reply, response, sizeof(response));
+  }
+  answered = true;
+  lastSequence = request.sequence;
+  lastCommand = request.command;
+  writer(response, responseLength, linkArg);
+}
+
+uint32_t CommandServer::getRequests() {
+  return requests;
+}
+
+uint32_t CommandServer::getRepeats() {
+  return repeats;
+}
+
+uint32_t CommandServer::getCorrupt() {
+  return corrupt;
+}
+
+void CommandServer::printStats() {
+  printf("  %-8s|%-8s|%s\r\n", "Requests", "Repeats", "Corrupt");
+  printf("  %-8u|%-8u|%u\r\n", getRequests(), getRepeats(), getCorrupt());
+}
+
+void CommandServer::taskWrapper(void *arg) {
+  CommandServer *server = (CommandServer *)arg;
+  server->task();
+}
+
+void CommandServer::task() {
+  uint8_t data[COMMAND_READ_SIZE];
+  while (1) {
+    int length = reader(data, sizeof(data), linkArg);
+    if (length < 0) {
+      ESP_LOGE(TAG, "Command link failed");
+      OSPort::delay(COMMAND_RETRY_MS);
+      continue;
+    }
+    receive(data, length);
+  }
+}
@@ -0,0 +1,134 @@
+/*
+ * DriveCycleCatalog.cpp
+ *
+ * Backend independent part, map() and unmap() are in DriveCycleCatalogFlash.cpp
+ * (target) and tools/host/DriveCycleCatalogPOSIX.cpp (host).
+ */
+
+#include "DriveCycleCatalog.hpp"
+#include "esp_log.h"
+#include <stdio.h>
+#include <string.h>
+
+DriveCycleCatalog::DriveCycleCatalog() :
+                   data(NULL),
+                   mapHandle(0),
+                   mapSize(0),
+                   entries(NULL),
+                   count(0),
+                   single{}{
+}
+
+DriveCycleCatalog::~DriveCycleCatalog() {
+  unmap();
+}
+
+bool DriveCycleCatalog::isMapped() {
+  return data != NULL;
+}
+
+bool DriveCycleCatalog::checkIndex() {
+  if (mapSize >= sizeof(uint32_t) && *(const uint32_t *)data == DRIVECYCLE_MAGIC) {
+    strncpy(single.name, "default", DRIVECYCLE_NAME_LENGTH - 1);
+    single.offset = 0;
+    single.size = mapSize;
+    single.crc = 0;
+    entries = &single;
+    count = 1;
+    return true;
+  }
+  const Header *header = (const Header *)data;
+  if (mapSize < sizeof(Header) || header->magic != DRIVECYCLE_CATALOG_MAGIC ||
+      header->version != DRIVECYCLE_CATALOG_VERSION) {
+    ESP_LOGE(TAG, "No drive cycle catalog");
+    return false;
+  }
+  if (header->count > DRIVECYCLE_CATALOG_MAX_ENTRIES ||
+      sizeof(Header) + header->count * sizeof(Entry) > mapSize) {
+    ESP_LOGE(TAG, "Invalid catalog: %d entries", header->count);
+    return false;
+  }
+  entries = (const Entry *)(header + 1);
+  for (uint32_t i = 0; i < header->count; i++) {
+    const Entry &entry = entries[i];
+    if (entry.offset % sizeof(uint32_t) != 0 || entry.offset > mapSize || entry.size > mapSize - entry.offset ||
+        memchr(entry.name, 0, DRIVECYCLE_NAME_LENGTH) == NULL) {
+      ESP_LOGE(TAG, "Invalid catalog entry %d", i);
+      return false;
+    }
+  }
+  count = header->count;
+  return true;
+}
+
+uint32_t DriveCycleCatalog::getCount() {
+  return count;
+}
+
+const char *DriveCycleCatalog::getName(uint32_t index) {
+  return (index < count) ? entries[index].name : "";
+}
+
+int DriveCycleCatalog::find(const char *name) {
+  for (uint32_t i = 0; i < count; i++) {
+    if (strcmp(entries[i].name, name) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+bool DriveCycleCatalog::verify(uint32_t index) {
+  if (index >= count) {
+    ESP_LOGE(TAG, "No drive cycle %d", index);
+    return false;
+  }
+  const Entry &entry = entries[index];
+  if (entries == &single) {
+    ESP_LOGW(TAG, "%s has no CRC", entry.name);
+    return true;
+  }
+  uint32_t crc = crc32(data + entry.offset, entry.size);
+  if (crc != entry.crc) {
+    ESP_LOGE(TAG, "%s: CRC 0x%08x, expected 0x%08x", entry.name, crc, entry.crc);
+    return false;
+  }
+  return true;
+}
+
+bool DriveCycleCatalog::open(uint32_t index, DriveCycleImage &image) {
+  if (index >= count) {
+    ESP_LOGE(TAG, "No drive cycle %d", index);
+    return false;
+  }
+  return image.open(data + entries[index].offset, entries[index].size);
+}
+
+void DriveCycleCatalog::list() {
+  printf("%-3s|%-24s|%-10s|%-10s|%-10s\r\n", "Num", "Name", "Samples", "Period", "Duration");
+  for (uint32_t i = 0; i < count; i++) {
+    const DriveCycleImage::Header *header = (const DriveCycleImage::Header *)(data + entries[i].offset);
+    if (entries[i].size < sizeof(DriveCycleImage::Header) || header->magic != DRIVECYCLE_MAGIC) {
+      printf("%-3d|%-24s|invalid\r\n", i, entries[i].name);
+      continue;
+    }
+    printf("%-3d|%-24s|%-10d|%-7d ms|%-8.1f s%s\r\n", i, entries[i].name, header->sampleCount, header->periodMs,
+           (double)header->sampleCount * header->periodMs / 1000,
+           (header->encoding == DRIVECYCLE_ENCODING_RICE) ? " compressed" : "");
+  }
+}
+
+uint32_t DriveCycleCatalog::crc32(const uint8_t *data, uint32_t size, uint32_t crc) {
+  /* Reflected polynomial 0xEDB88320, a nibble at a time */
+  static const uint32_t table[16] = {
+      0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+      0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+  };
+  crc = ~crc;
+  for (uint32_t i = 0; i < size; i++) {
+    crc ^= data[i];
+    crc = (crc >> 4) ^ table[crc & 0x0F];
+    crc = (crc >> 4) ^ table[crc & 0x0F];
+  }
+  return ~crc;
+}
@@ -0,0 +1,43 @@
+/*
+ * DriveCycleCatalogFlash.cpp
+ */
+
+#include "DriveCycleCatalog.hpp"
+#include "esp_partition.h"
+#include "esp_log.h"
+
+bool DriveCycleCatalog::map(const char *name) {
+  unmap();
+  const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                              (esp_partition_subtype_t)DRIVECYCLE_PARTITION_SUBTYPE,
+                                                              name);
+  if (partition == NULL) {
+    ESP_LOGE(TAG, "Partition %s not found", name);
+    return false;
+  }
+  const void *mapped;
+  spi_flash_mmap_handle_t handle;
+  esp_err_t ret = esp_partition_mmap(partition, 0, partition->size, SPI_FLASH_MMAP_DATA, &mapped, &handle);
+  if (ret != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to map partition %s (%s)", name, esp_err_to_name(ret));
+    return false;
+  }
+  data = (const uint8_t *)mapped;
+  mapHandle = handle;
+  mapSize = partition->size;
+  if (!checkIndex()) {
+    unmap();
+    return false;
+  }
+  return true;
+}
+
+void DriveCycleCatalog::unmap() {
+  if (data != NULL) {
+    spi_flash_munmap(mapHandle);
+  }
+  data = NULL;
+  mapSize = 0;
+  entries = NULL;
+  count = 0;
+}
@@ -0,0 +1,129 @@
+/*
+ * DriveCycleCodec.cpp
+ */
+
+#include "DriveCycleCodec.hpp"
+#include <stddef.h>
+
+/* Initial mean of 16 */
+RiceState::RiceState() :
+           sum(16),
+           count(1){
+}
+
+int RiceState::parameter() {
+  int k = 0;
+  while ((count << k) < sum && k < RICE_MAX_PARAMETER) {
+    k++;
+  }
+  return k;
+}
+
+void RiceState::update(uint32_t value) {
+  sum += value;
+  count++;
+  if (count >= RICE_ADAPT_WINDOW) {
+    sum >>= 1;
+    count >>= 1;
+  }
+}
+
+uint32_t RiceState::zigzag(int32_t value) {
+  return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+int32_t RiceState::unzigzag(uint32_t value) {
+  return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+DriveCycleDecoder::DriveCycleDecoder() {
+  begin(NULL, 0);
+}
+
+void DriveCycleDecoder::begin(const uint8_t *_data, uint32_t _size) {
+  data = _data;
+  size = _size;
+  byteIndex = 0;
+  rice = RiceState();
+  previous = 0;
+  bits = 0;
+  bitCount = 0;
+  position = 0;
+}
+
+uint32_t DriveCycleDecoder::getPosition() {
+  return position;
+}
+
+void DriveCycleDecoder::refill() {
+  while (bitCount <= 24 && byteIndex < size) {
+    bits |= (uint32_t)data[byteIndex++] << (24 - bitCount);
+    bitCount += 8;
+  }
+}
+
+void DriveCycleDecoder::consume(int count) {
+  bits = (count < 32) ? bits << count : 0;
+  bitCount -= count;
+}
+
+bool DriveCycleDecoder::readBits(int count, uint32_t *value) {
+  refill();
+  if (bitCount < count) {
+    return false;
+  }
+  *value = (count > 0) ? bits >> (32 - count) : 0;
+  consume(count);
+  return true;
+}
+
+bool DriveCycleDecoder::decode(int16_t *out, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    /* Unary quotient, a run of ones is counted a whole word at a time */
+    int quotient = 0;
+    while (1) {
+      refill();
+      if (bitCount == 0) {
+        return false;
+      }
+      int run = (~bits != 0) ? __builtin_clz(~bits) : 32;
+      if (run > bitCount) {
+        run = bitCount;
+      }
+      if (quotient + run > RICE_ESCAPE_QUOTIENT) {
+        run = RICE_ESCAPE_QUOTIENT - quotient;
+      }
+      quotient += run;
+      consume(run);
+      if (quotient == RICE_ESCAPE_QUOTIENT) {
+        break;
+      }
+      if (bitCount > 0) {
+        /* Terminating zero */
+        consume(1);
+        break;
+      }
+    }
+    int k = rice.parameter();
+    uint32_t value;
+    if (quotient == RICE_ESCAPE_QUOTIENT) {
+      if (!readBits(RICE_RAW_BITS, &value)) {
+        return false;
+      }
+    } else {
+      if (!readBits(k, &value)) {
+        return false;
+      }
+      value |= (uint32_t)quotient << k;
+    }
+    rice.update(value);
+    int32_t sample = previous + RiceState::unzigzag(value);
+    if (sample > INT16_MAX || sample < INT16_MIN) {
+      return false;
+    }
+    previous = sample;
+    out[i] = (int16_t)sample;
+    position++;
+  }
+  return true;
+}
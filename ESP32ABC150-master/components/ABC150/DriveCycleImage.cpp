@@ -0,0 +1,129 @@
+/*
+ * DriveCycleImage.cpp
+ */
+
+#include "DriveCycleImage.hpp"
+#include "esp_log.h"
+
+/* Samples decoded at a time when reading compressed images */
+#define DECODE_CHUNK_SAMPLES        32
+
+DriveCycleImage::DriveCycleImage() :
+                 header(NULL),
+                 samples(NULL),
+                 size(0){
+}
+
+DriveCycleImage::~DriveCycleImage() {
+  close();
+}
+
+bool DriveCycleImage::open(const void *data, uint32_t _size) {
+  close();
+  header = (const Header *)data;
+  size = _size;
+  if (!checkHeader()) {
+    close();
+    return false;
+  }
+  return true;
+}
+
+void DriveCycleImage::close() {
+  header = NULL;
+  samples = NULL;
+  size = 0;
+}
+
+bool DriveCycleImage::isOpen() {
+  return header != NULL;
+}
+
+bool DriveCycleImage::checkHeader() {
+  if (size < sizeof(Header)) {
+    ESP_LOGE(TAG, "Image too small");
+    return false;
+  }
+  if (header->magic != DRIVECYCLE_MAGIC || header->version != DRIVECYCLE_VERSION) {
+    ESP_LOGE(TAG, "No drive cycle image (magic 0x%08x version %d)", header->magic, header->version);
+    return false;
+  }
+  if (header->periodMs == 0) {
+    ESP_LOGE(TAG, "Invalid header: period %d ms", header->periodMs);
+    return false;
+  }
+  if (header->encoding == DRIVECYCLE_ENCODING_RAW) {
+    if (header->sampleCount > (size - sizeof(Header)) / sizeof(int16_t)) {
+      ESP_LOGE(TAG, "Invalid header: %d samples", header->sampleCount);
+      return false;
+    }
+    samples = (const int16_t *)(header + 1);
+    return true;
+  }
+  if (header->encoding != DRIVECYCLE_ENCODING_RICE) {
+    ESP_LOGE(TAG, "Unknown encoding %d", header->encoding);
+    return false;
+  }
+  /*
+   * Every sample takes at least one bit. The samples themselves are covered by
+   * the catalog CRC (DriveCycleCatalog::verify()), decoding them all here would
+   * hold up the test start; a sample that fails to decode fails read().
+   */
+  if (header->sampleCount > (uint64_t)(size - sizeof(Header)) * 8) {
+    ESP_LOGE(TAG, "Invalid header: %d samples in %d bytes", header->sampleCount, (int)(size - sizeof(Header)));
+    return false;
+  }
+  samples = NULL;
+  decoder.begin((const uint8_t *)(header + 1), size - sizeof(Header));
+  return true;
+}
+
+uint32_t DriveCycleImage::getPeriodMs() {
+  return header->periodMs;
+}
+
+uint32_t DriveCycleImage::getSampleCount() {
+  return header->sampleCount;
+}
+
+bool DriveCycleImage::read(uint32_t index, float *powerKW, uint32_t count) {
+  if (index + count > header->sampleCount) {
+    return false;
+  }
+  float scale = header->powerScaleW / 1000.0f;
+  if (samples != NULL) {
+    for (uint32_t i = 0; i < count; i++) {
+      powerKW[i] = samples[index + i] * scale;
+    }
+    return true;
+  }
+  if (index < decoder.getPosition()) {
+    decoder.begin((const uint8_t *)(header + 1), size - sizeof(Header));
+  }
+  int16_t chunk[DECODE_CHUNK_SAMPLES];
+  /* Skip to index */
+  while (decoder.getPosition() < index) {
+    uint32_t skip = index - decoder.getPosition();
+    if (!decoder.decode(chunk, (skip < DECODE_CHUNK_SAMPLES) ? skip : DECODE_CHUNK_SAMPLES)) {
+      return false;
+    }
+  }
+  while (count > 0) {
+    uint32_t n = (count < DECODE_CHUNK_SAMPLES) ? count : DECODE_CHUNK_SAMPLES;
+    if (!decoder.decode(chunk, n)) {
+      return false;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+      powerKW[i] = chunk[i] * scale;
+    }
+    powerKW += n;
+    count -= n;
+  }
+  return true;
+}
+
+float DriveCycleImage::getPowerKW(uint32_t index) {
+  float powerKW = 0;
+  read(index, &powerKW, 1);
+  return powerKW;
+}
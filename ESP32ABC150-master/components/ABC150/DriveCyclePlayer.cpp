@@ -0,0 +1,138 @@
+/*
+ * DriveCyclePlayer.cpp
+ */
+
+#include "DriveCyclePlayer.hpp"
+
+DriveCyclePlayer::DriveCyclePlayer(Interpolation _interpolation, float _slewRate) :
+                                   interpolation(_interpolation),
+                                   slewRate(_slewRate),
+                                   controlPeriodMs(1000){
+  reset(controlPeriodMs);
+}
+
+void DriveCyclePlayer::reset(uint32_t _controlPeriodMs, float initialOutput) {
+  controlPeriodMs = _controlPeriodMs;
+  count = 0;
+  ended = false;
+  startTime = 0;
+  endTime = 0;
+  time = 0;
+  output = initialOutput;
+  slewLimited = 0;
+}
+
+bool DriveCyclePlayer::needsSample() {
+  return !ended && (count < 4 || time >= times[2]);
+}
+
+void DriveCyclePlayer::append(uint32_t timeMs, float value) {
+  if (count == 4) {
+    for (int i = 0; i < 3; i++) {
+      times[i] = times[i + 1];
+      values[i] = values[i + 1];
+    }
+    count = 3;
+  }
+  times[count] = timeMs;
+  values[count] = value;
+  count++;
+}
+
+void DriveCyclePlayer::pushSample(uint32_t timeMs, float value) {
+  if (count == 0) {
+    /* The first sample also stands in for the one before it */
+    append(timeMs, value);
+    startTime = timeMs;
+    time = timeMs;
+  }
+  append(timeMs, value);
+}
+
+void DriveCyclePlayer::pad() {
+  uint32_t gap = times[count - 1] - times[count - 2];
+  append(times[count - 1] + (gap ? gap : 1), values[count - 1]);
+}
+
+void DriveCyclePlayer::endOfSamples() {
+  if (ended) {
+    return;
+  }
+  ended = true;
+  if (count == 0) {
+    return;
+  }
+  endTime = times[count - 1];
+  while (count < 4) {
+    pad();
+  }
+}
+
+float DriveCyclePlayer::interpolate() {
+  float t1 = times[1];
+  float t2 = times[2];
+  float u = (t2 > t1) ? (time - t1) / (t2 - t1) : 1;
+  /* Samples are late, hold the newest one */
+  if (u > 1) {
+    u = 1;
+  }
+  switch (interpolation) {
+  case Hold:
+    return (u < 1) ? values[1] : values[2];
+  case Linear:
+    return values[1] + u * (values[2] - values[1]);
+  case Cubic:
+  default: {
+    /* Cubic Hermite with finite difference tangents, scaled to the segment length */
+    float m1 = (values[2] - values[0]) / (t2 - times[0]) * (t2 - t1);
+    float m2 = (values[3] - values[1]) / (times[3] - t1) * (t2 - t1);
+    float u2 = u * u;
+    float u3 = u2 * u;
+    return (2 * u3 - 3 * u2 + 1) * values[1] + (u3 - 2 * u2 + u) * m1 +
+           (-2 * u3 + 3 * u2) * values[2] + (u3 - u2) * m2;
+  }
+  }
+}
+
+float DriveCyclePlayer::step() {
+  if (count < 4) {
+    return output;
+  }
+  /* After the end the window moves on through padding */
+  while (ended && time >= times[2] && times[2] < endTime) {
+    pad();
+  }
+  float target = interpolate();
+  float maxStep = slewRate * controlPeriodMs / 1000;
+  if (slewRate > 0 && target > output + maxStep) {
+    output += maxStep;
+    slewLimited++;
+  } else if (slewRate > 0 && target < output - maxStep) {
+    output -= maxStep;
+    slewLimited++;
+  } else {
+    output = target;
+  }
+  time += controlPeriodMs;
+  return output;
+}
+
+bool DriveCyclePlayer::isFinished() {
+  return ended && time > endTime;
+}
+
+uint32_t DriveCyclePlayer::getTimeMs() {
+  return time - startTime;
+}
+
+uint32_t DriveCyclePlayer::getSlewLimited() {
+  return slewLimited;
+}
+
+void DriveCyclePlayer::setInterpolation(Interpolation _interpolation) {
+  interpolation = _interpolation;
+}
+
+void DriveCyclePlayer::setSlewRate(float _slewRate) {
+  slewRate = _slewRate;
+}
@@ -0,0 +1,132 @@
+/*
+ * DriveCyclePrefetcher.cpp
+ */
+
+#include "DriveCyclePrefetcher.hpp"
+#include "esp_log.h"
+#include <assert.h>
+
+/* Below the plate loop, above idle */
+#define READER_TASK_PRIORITY        1
+
+DriveCyclePrefetcher::DriveCyclePrefetcher(DriveCycleImage &_image) :
+                                           image(_image),
+                                           buffer{},
+                                           head(0),
+                                           tail(0),
+                                           sampleCount(0),
+                                           underruns(0),
+                                           running(false),
+                                           fillMutex(OSPort::createMutex()),
+                                           readerTaskHandle(NULL){
+  assert(fillMutex != NULL);
+  if (!OSPort::createTask(&DriveCyclePrefetcher::readerTaskWrapper, "Drive cycle reader", 4096, this, READER_TASK_PRIORITY, &readerTaskHandle)){
+    ESP_LOGE(TAG, "Failed to create drive cycle reader task");
+  }
+}
+
+DriveCyclePrefetcher::~DriveCyclePrefetcher() {
+  OSPort::deleteTask(readerTaskHandle);
+}
+
+void DriveCyclePrefetcher::fetch(uint32_t index, float *out, uint32_t count) {
+  /* Compressed images are decoded here, on the reader task */
+  if (!image.read(index, out, count)) {
+    ESP_LOGE(TAG, "Failed to read samples %d to %d", index, index + count - 1);
+    for (uint32_t i = 0; i < count; i++) {
+      out[i] = 0;
+    }
+  }
+}
+
+bool DriveCyclePrefetcher::fillHalf() {
+  OSPort::lock(fillMutex);
+  uint32_t index = head.load(std::memory_order_relaxed);
+  /* head is always half aligned, so a half never wraps */
+  if (!running || index >= sampleCount ||
+      index - tail.load(std::memory_order_acquire) > PREFETCH_BUFFER_SAMPLES - PREFETCH_HALF_SAMPLES) {
+    OSPort::unlock(fillMutex);
+    return false;
+  }
+  uint32_t count = sampleCount - index;
+  if (count > PREFETCH_HALF_SAMPLES) {
+    count = PREFETCH_HALF_SAMPLES;
+  }
+  fetch(index, &buffer[index % PREFETCH_BUFFER_SAMPLES], count);
+  head.store(index + PREFETCH_HALF_SAMPLES, std::memory_order_release);
+  OSPort::unlock(fillMutex);
+  return true;
+}
+
+void DriveCyclePrefetcher::start() {
+  OSPort::lock(fillMutex);
+  head.store(0);
+  tail.store(0);
+  underruns.store(0);
+  sampleCount = image.getSampleCount();
+  running = true;
+  OSPort::unlock(fillMutex);
+  /* Both halves before playback starts */
+  while (fillHalf());
+}
+
+void DriveCyclePrefetcher::stop() {
+  OSPort::lock(fillMutex);
+  running = false;
+  OSPort::unlock(fillMutex);
+}
+
+bool DriveCyclePrefetcher::next(float *powerKW) {
+  uint32_t index = tail.load(std::memory_order_relaxed);
+  if (index >= sampleCount) {
+    return false;
+  }
+  if (index == head.load(std::memory_order_acquire)) {
+    underruns.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  *powerKW = buffer[index % PREFETCH_BUFFER_SAMPLES];
+  tail.store(index + 1, std::memory_order_release);
+  if ((index + 1) % PREFETCH_HALF_SAMPLES == 0) {
+    OSPort::notifyGive(readerTaskHandle);
+  }
+  return true;
+}
+
+uint32_t DriveCyclePrefetcher::peek(float *powerKW, uint32_t count) {
+  uint32_t index = tail.load(std::memory_order_relaxed);
+  uint32_t available = head.load(std::memory_order_acquire);
+  if (available > sampleCount) {
+    available = sampleCount;
+  }
+  uint32_t n = 0;
+  while (n < count && index + n < available) {
+    powerKW[n] = buffer[(index + n) % PREFETCH_BUFFER_SAMPLES];
+    n++;
+  }
+  return n;
+}
+
+bool DriveCyclePrefetcher::isFinished() {
+  return tail.load(std::memory_order_relaxed) >= sampleCount;
+}
+
+uint32_t DriveCyclePrefetcher::getUnderruns() {
+  return underruns.load(std::memory_order_relaxed);
+}
+
+uint32_t DriveCyclePrefetcher::getPlayed() {
+  return tail.load(std::memory_order_relaxed);
+}
+
+void DriveCyclePrefetcher::readerTaskWrapper(void *arg) {
+  DriveCyclePrefetcher *obj = (DriveCyclePrefetcher *)arg;
+  obj->readerTask();
+}
+
+void DriveCyclePrefetcher::readerTask() {
+  while (1) {
+    OSPort::notifyTake(OSPORT_WAIT_FOREVER);
+    while (fillHalf());
+  }
+}
@@ -53,6 +53,14 @@ bool DualChannelTest::loopCheck(){
         }
       }
     }
+    if (!abc150Handler->isFresh(ABC150CANHandler::A)) {
+      TelemetryWatchdog &watchdog = abc150Handler->getWatchdog();
+      ESP_LOGE(TAG, "Channel A %s stale for %d ms.",
+               TelemetryWatchdog::getSourceName(watchdog.getOldest(ABC150CANHandler::A)),
+               watchdog.getAgeMs(ABC150CANHandler::A));
+      stopTest(TestState::Failed);
+      return false;
+    }
     if (abc150Handler->getConverterStatus(ABC150CANHandler::A) != ABC150CANHandler::ConverterStatus::Remote) {
       ESP_LOGE(TAG, "Not in remote mode.");
       stopTest(TestState::Failed);
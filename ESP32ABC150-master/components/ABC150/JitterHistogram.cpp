@@ -0,0 +1,56 @@
+/*
+ * JitterHistogram.cpp
+ */
+
+#include "JitterHistogram.hpp"
+#include <stdio.h>
+#include <string.h>
+
+const uint32_t JitterHistogram::bucketLimitsUs[JITTER_BUCKETS] = {
+    100, 200, 500, 1000, 2000, 5000, 10000, UINT32_MAX
+};
+
+JitterHistogram::JitterHistogram() {
+  reset();
+}
+
+void JitterHistogram::reset() {
+  memset(buckets, 0, sizeof(buckets));
+  count = 0;
+  maxUs = 0;
+}
+
+void JitterHistogram::record(int64_t intervalUs, uint32_t periodUs) {
+  int64_t deviation = intervalUs - periodUs;
+  uint32_t jitterUs = (deviation < 0) ? -deviation : deviation;
+  int i = 0;
+  while (jitterUs >= bucketLimitsUs[i] && i < JITTER_BUCKETS - 1) {
+    i++;
+  }
+  buckets[i]++;
+  count++;
+  if (jitterUs > maxUs) {
+    maxUs = jitterUs;
+  }
+}
+
+uint32_t JitterHistogram::getCount() {
+  return count;
+}
+
+uint32_t JitterHistogram::getMaxUs() {
+  return maxUs;
+}
+
+void JitterHistogram::print() {
+  printf("  Jitter (%d intervals, max %d us):\r\n", count, maxUs);
+  uint32_t lower = 0;
+  for (int i = 0; i < JITTER_BUCKETS; i++) {
+    if (i < JITTER_BUCKETS - 1) {
+      printf("    %6d - %6d us: %d\r\n", lower, bucketLimitsUs[i], buckets[i]);
+    } else {
+      printf("    %6d+         us: %d\r\n", lower, buckets[i]);
+    }
+    lower = bucketLimitsUs[i];
+  }
+}
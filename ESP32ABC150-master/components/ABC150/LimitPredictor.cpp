@@ -0,0 +1,173 @@
+/*
+ * LimitPredictor.cpp
+ */
+
+#include "LimitPredictor.hpp"
+#include <math.h>
+#include <string.h>
+
+/* Per window */
+#define LIMIT_FORGETTING            0.9f
+#define LIMIT_INITIAL_COVARIANCE    100.0f
+/* Covariance is not grown beyond this while the fit is not excited */
+#define LIMIT_MAX_COVARIANCE        1000.0f
+/* Heat input unit, (10 kW)^2 */
+#define LIMIT_HEAT_UNIT_KW2         100.0f
+/* Weakest limit drop per heat input assumed, tuned with tools/LimitPredictorBench [kW/(10 kW)^2 s] */
+#define LIMIT_MIN_HEAT_SENSITIVITY  0.6f
+/* The prediction keeps this many recent misses below it, which decay per window */
+#define LIMIT_MISS_MARGIN           2.0f
+#define LIMIT_MISS_DECAY            0.9f
+
+void LimitPredictor::Model::reset() {
+  memset(theta, 0, sizeof(theta));
+  memset(p, 0, sizeof(p));
+  for (int i = 0; i < LIMIT_INPUTS; i++) {
+    p[i][i] = LIMIT_INITIAL_COVARIANCE;
+  }
+  miss = 0;
+}
+
+void LimitPredictor::Model::update(const float *inputs, float change) {
+  float pPhi[LIMIT_INPUTS];
+  float denominator = LIMIT_FORGETTING;
+  float trace = 0;
+  for (int i = 0; i < LIMIT_INPUTS; i++) {
+    pPhi[i] = 0;
+    for (int j = 0; j < LIMIT_INPUTS; j++) {
+      pPhi[i] += p[i][j] * inputs[j];
+    }
+    denominator += inputs[i] * pPhi[i];
+    trace += p[i][i];
+  }
+  float error = change - predict(inputs);
+  miss = fmaxf(miss * LIMIT_MISS_DECAY, -error);
+  for (int i = 0; i < LIMIT_INPUTS; i++) {
+    theta[i] += pPhi[i] / denominator * error;
+  }
+  float forgetting = (trace < LIMIT_MAX_COVARIANCE) ? LIMIT_FORGETTING : 1.0f;
+  for (int i = 0; i < LIMIT_INPUTS; i++) {
+    for (int j = 0; j < LIMIT_INPUTS; j++) {
+      p[i][j] = (p[i][j] - pPhi[i] * pPhi[j] / denominator) / forgetting;
+    }
+  }
+}
+
+float LimitPredictor::Model::predict(const float *inputs) {
+  float change = 0;
+  for (int i = 0; i < LIMIT_INPUTS; i++) {
+    change += theta[i] * inputs[i];
+  }
+  return change;
+}
+
+LimitPredictor::LimitPredictor(float _lagSeconds, float _slewRate) :
+                               lagSeconds(_lagSeconds),
+                               slewRate(_slewRate){
+  lagWindows = (int)(lagSeconds / LIMIT_WINDOW_S + 0.5f);
+  if (lagWindows > LIMIT_MAX_LAG_WINDOWS) {
+    lagWindows = LIMIT_MAX_LAG_WINDOWS;
+  }
+  reset();
+}
+
+void LimitPredictor::reset() {
+  started = false;
+  availablePower = 0;
+  chargingPower = 0;
+  power = 0;
+  memset(window, 0, sizeof(window));
+  windowStartDischarge = 0;
+  windowStartCharge = 0;
+  pastCount = 0;
+  discharge.reset();
+  charge.reset();
+}
+
+void LimitPredictor::accumulate(float *inputs, float power, float seconds) {
+  inputs[LIMIT_INPUT_ENERGY] += power * seconds;
+  inputs[LIMIT_INPUT_HEAT] += power * power / LIMIT_HEAT_UNIT_KW2 * seconds;
+  inputs[LIMIT_INPUT_TIME] += seconds;
+}
+
+void LimitPredictor::update(float _availablePower, float _chargingPower, float _power, float dtSeconds) {
+  availablePower = _availablePower;
+  chargingPower = _chargingPower;
+  power = _power;
+  if (!started) {
+    started = true;
+    windowStartDischarge = availablePower;
+    windowStartCharge = chargingPower;
+    return;
+  }
+  accumulate(window, power, dtSeconds);
+  if (window[LIMIT_INPUT_TIME] < LIMIT_WINDOW_S) {
+    return;
+  }
+  for (int i = LIMIT_MAX_LAG_WINDOWS; i > 0; i--) {
+    memcpy(past[i], past[i - 1], sizeof(past[i]));
+  }
+  memcpy(past[0], window, sizeof(past[0]));
+  if (pastCount <= LIMIT_MAX_LAG_WINDOWS) {
+    pastCount++;
+  }
+  /* The reports of this window show the pack as it was lagWindows earlier */
+  if (pastCount > lagWindows) {
+    discharge.update(past[lagWindows], availablePower - windowStartDischarge);
+    charge.update(past[lagWindows], chargingPower - windowStartCharge);
+  }
+  memset(window, 0, sizeof(window));
+  windowStartDischarge = availablePower;
+  windowStartCharge = chargingPower;
+}
+
+float LimitPredictor::limitAt(Model &model, float reported, const float *ahead) {
+  /* Inputs since the state the report shows */
+  int windows = (lagWindows < pastCount) ? lagWindows : pastCount;
+  float inputs[LIMIT_INPUTS];
+  for (int k = 0; k < LIMIT_INPUTS; k++) {
+    inputs[k] = ahead[k] + window[k];
+    for (int i = 0; i < windows; i++) {
+      inputs[k] += past[i][k];
+    }
+  }
+  float change = model.predict(inputs);
+  float heatSensitivity = model.theta[LIMIT_INPUT_HEAT];
+  if (heatSensitivity > -LIMIT_MIN_HEAT_SENSITIVITY) {
+    change += (-LIMIT_MIN_HEAT_SENSITIVITY - heatSensitivity) * inputs[LIMIT_INPUT_HEAT];
+  }
+  float limit = reported + ((change < 0) ? change : 0);
+  limit -= LIMIT_MISS_MARGIN * model.miss;
+  return (limit > 0) ? limit : 0;
+}
+
+void LimitPredictor::shapeLimit(Model &model, float reported, const float *upcoming, uint32_t count,
+                                float firstOffset, float period, float sign, float *limit) {
+  float ahead[LIMIT_INPUTS] = {0};
+  *limit = limitAt(model, reported, ahead);
+  accumulate(ahead, power, firstOffset);
+  for (uint32_t i = 0; i < count; i++) {
+    float seconds = firstOffset + i * period;
+    float predicted = limitAt(model, reported, ahead);
+    /* Ramp down early enough to be under the limit when the sample plays */
+    if (sign * upcoming[i] > predicted && predicted + slewRate * seconds < *limit) {
+      *limit = predicted + slewRate * seconds;
+    }
+    accumulate(ahead, upcoming[i], period);
+  }
+}
+
+void LimitPredictor::shape(const float *upcoming, uint32_t count, float firstOffset, float period,
+                           float *maxDischarge, float *maxCharge) {
+  shapeLimit(discharge, availablePower, upcoming, count, firstOffset, period, 1, maxDischarge);
+  shapeLimit(charge, chargingPower, upcoming, count, firstOffset, period, -1, maxCharge);
+}
+
+float LimitPredictor::getEnergySensitivity(bool charge) {
+  /* kW/kJ to kW/kWh */
+  return (charge ? this->charge.theta[LIMIT_INPUT_ENERGY] : discharge.theta[LIMIT_INPUT_ENERGY]) * 3600;
+}
+
+float LimitPredictor::getHeatSensitivity(bool charge) {
+  return charge ? this->charge.theta[LIMIT_INPUT_HEAT] : discharge.theta[LIMIT_INPUT_HEAT];
+}
@@ -0,0 +1,110 @@
+/*
+ * OSPortFreeRTOS.cpp
+ */
+
+#include "OSPort.hpp"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/timers.h"
+#include "TimeUtils.hpp"
+#include "esp_timer.h"
+
+/* Block time for timer commands when the timer queue is full */
+#define TIMER_COMMAND_TIMEOUT_MS    1000
+
+static TickType_t toTicks(uint32_t ms) {
+  return (ms == OSPORT_WAIT_FOREVER) ? portMAX_DELAY : pdMS_TO_TICKS(ms);
+}
+
+namespace OSPort {
+
+bool createTask(TaskFunction function, const char *name, uint32_t stackSize, void *arg,
+                int priority, TaskHandle *handle) {
+  return xTaskCreate(function, name, stackSize, arg, priority, (TaskHandle_t *)handle) == pdPASS;
+}
+
+void deleteTask(TaskHandle task) {
+  vTaskDelete((TaskHandle_t)task);
+}
+
+void suspendTask(TaskHandle task) {
+  vTaskSuspend((TaskHandle_t)task);
+}
+
+void resumeTask(TaskHandle task) {
+  vTaskResume((TaskHandle_t)task);
+}
+
+void delay(uint32_t ms) {
+  vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+void delayUntil(uint32_t *lastWakeTime, uint32_t period) {
+  TickType_t lastWakeTicks = *lastWakeTime / portTICK_PERIOD_MS;
+  vTaskDelayUntil(&lastWakeTicks, pdMS_TO_TICKS(period));
+  *lastWakeTime = lastWakeTicks * portTICK_PERIOD_MS;
+}
+
+uint32_t getTickMs() {
+  return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+int64_t getTimeMs() {
+  return TimeUtils::esp_timer_get_time_ms();
+}
+
+int64_t getTimeUs() {
+  return esp_timer_get_time();
+}
+
+void notifyGive(TaskHandle task) {
+  xTaskNotifyGive((TaskHandle_t)task);
+}
+
+uint32_t notifyTake(uint32_t timeout) {
+  return ulTaskNotifyTake(pdTRUE, toTicks(timeout));
+}
+
+Mutex createMutex() {
+  return xSemaphoreCreateMutex();
+}
+
+bool lock(Mutex mutex, uint32_t timeout) {
+  return xSemaphoreTake((SemaphoreHandle_t)mutex, toTicks(timeout)) == pdTRUE;
+}
+
+void unlock(Mutex mutex) {
+  xSemaphoreGive((SemaphoreHandle_t)mutex);
+}
+
+/* FreeRTOS timer callbacks get the timer handle, the ID carries function and argument */
+struct TimerContext {
+  TimerFunction function;
+  void *arg;
+};
+
+static void timerCallback(TimerHandle_t xTimer) {
+  TimerContext *context = (TimerContext *)pvTimerGetTimerID(xTimer);
+  context->function(context->arg);
+}
+
+Timer createTimer(const char *name, uint32_t period, bool autoReload, TimerFunction function, void *arg) {
+  TimerContext *context = new TimerContext{function, arg};
+  TimerHandle_t timer = xTimerCreate(name, pdMS_TO_TICKS(period), autoReload ? pdTRUE : pdFALSE,
+                                     context, timerCallback);
+  if (timer == NULL) {
+    delete context;
+  }
+  return timer;
+}
+
+bool startTimer(Timer timer) {
+  return xTimerStart((TimerHandle_t)timer, pdMS_TO_TICKS(TIMER_COMMAND_TIMEOUT_MS)) == pdPASS;
+}
+
+bool stopTimer(Timer timer) {
+  return xTimerStop((TimerHandle_t)timer, pdMS_TO_TICKS(TIMER_COMMAND_TIMEOUT_MS)) == pdPASS;
+}
+
+}
@@ -0,0 +1,49 @@
+/*
+ * PowerTracker.cpp
+ */
+
+#include "PowerTracker.hpp"
+
+PowerTracker::PowerTracker(float _kp, float _ki, float _integralLimit) :
+                           kp(_kp),
+                           ki(_ki),
+                           integralLimit(_integralLimit),
+                           integral(0),
+                           correction(0){
+}
+
+void PowerTracker::reset() {
+  integral = 0;
+  correction = 0;
+}
+
+float PowerTracker::update(float target, float measured, float minPower, float maxPower, float dtSeconds) {
+  /* Only track what the limits allow */
+  if (target > maxPower) {
+    target = maxPower;
+  } else if (target < minPower) {
+    target = minPower;
+  }
+  float error = target - measured;
+  float command = target + kp * error + integral;
+  /* Integrate unless the command is limited in the direction of the error */
+  if (!(command >= maxPower && error > 0) && !(command <= minPower && error < 0)) {
+    integral += ki * error * dtSeconds;
+    if (integral > integralLimit) {
+      integral = integralLimit;
+    } else if (integral < -integralLimit) {
+      integral = -integralLimit;
+    }
+  }
+  if (command > maxPower) {
+    command = maxPower;
+  } else if (command < minPower) {
+    command = minPower;
+  }
+  correction = command - target;
+  return command;
+}
+
+float PowerTracker::getCorrection() {
+  return correction;
+}
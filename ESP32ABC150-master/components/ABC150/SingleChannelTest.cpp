@@ -33,6 +33,12 @@ bool SingleChannelTest::loopCheck(BatteryModuleInfo* bmInfo) {
     ESP_LOGE(TAG, "BM state error");
     return false;
   }
+  if (!abc150Handler->isFresh(channel)) {
+    TelemetryWatchdog &watchdog = abc150Handler->getWatchdog();
+    ESP_LOGE(TAG, "Channel %s %s stale for %d ms.", getChannelName(channel),
+             TelemetryWatchdog::getSourceName(watchdog.getOldest(channel)), watchdog.getAgeMs(channel));
+    return false;
+  }
   if (abc150Handler->getConverterStatus(channel) != ABC150CANHandler::ConverterStatus::Remote) {
     ESP_LOGE(TAG, "Not in remote mode.");
     return false;
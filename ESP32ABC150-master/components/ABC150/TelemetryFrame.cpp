@@ -0,0 +1,276 @@
+/*
+ * TelemetryFrame.cpp
+ */
+
+#include "TelemetryFrame.hpp"
+#include "DriveCycleCatalog.hpp"
+#include <string.h>
+
+static uint8_t *put16(uint8_t *out, uint16_t value) {
+  out[0] = value;
+  out[1] = value >> 8;
+  return out + 2;
+}
+
+static uint8_t *put32(uint8_t *out, uint32_t value) {
+  out[0] = value;
+  out[1] = value >> 8;
+  out[2] = value >> 16;
+  out[3] = value >> 24;
+  return out + 4;
+}
+
+static uint16_t get16(const uint8_t *in) {
+  return in[0] | (in[1] << 8);
+}
+
+static uint32_t get32(const uint8_t *in) {
+  return in[0] | (in[1] << 8) | (in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+bool TelemetryFrame::fits(const TelemetrySample &previous, const TelemetrySample &next) {
+  if ((uint32_t)(next.timeMs - previous.timeMs) > UINT8_MAX) {
+    return false;
+  }
+  for (int ch = 0; ch < TELEMETRY_CHANNELS; ch++) {
+    if ((uint32_t)(next.channels[ch].timestamp - previous.channels[ch].timestamp) > UINT8_MAX) {
+      return false;
+    }
+  }
+  return true;
+}
+
+size_t TelemetryFrame::encodeSamples(const TelemetrySample *samples, uint8_t count, uint8_t sequence, uint8_t *out,
+                                     size_t size) {
+  if (count == 0 || count > TELEMETRY_MAX_SAMPLES) {
+    return 0;
+  }
+  uint8_t frame[TELEMETRY_OVERHEAD + TELEMETRY_MAX_PAYLOAD];
+  uint8_t *p = frame;
+  *p++ = Samples;
+  *p++ = sequence;
+  p = put32(p, samples[0].timeMs);
+  *p++ = count;
+  for (int ch = 0; ch < TELEMETRY_CHANNELS; ch++) {
+    p = put32(p, samples[0].channels[ch].timestamp);
+  }
+  for (int i = 0; i < count; i++) {
+    const TelemetrySample &previous = samples[(i > 0) ? i - 1 : 0];
+    *p++ = samples[i].timeMs - previous.timeMs;
+    for (int ch = 0; ch < TELEMETRY_CHANNELS; ch++) {
+      p = put16(p, samples[i].channels[ch].voltage);
+      p = put16(p, samples[i].channels[ch].current);
+      *p++ = samples[i].channels[ch].timestamp - previous.channels[ch].timestamp;
+    }
+  }
+  return pack(frame, p - frame, out, size);
+}
+
+size_t TelemetryFrame::encodeStatus(const TelemetryStatus &status, uint8_t sequence, uint8_t *out, size_t size) {
+  if (status.testCount > TELEMETRY_MAX_TESTS) {
+    return 0;
+  }
+  uint8_t frame[TELEMETRY_OVERHEAD + TELEMETRY_STATUS_SIZE];
+  uint8_t *p = frame;
+  *p++ = Status;
+  *p++ = sequence;
+  p = put32(p, status.timeMs);
+  p += putStatus(status, p);
+  return pack(frame, p - frame, out, size);
+}
+
+size_t TelemetryFrame::putStatus(const TelemetryStatus &status, uint8_t *out) {
+  uint8_t *p = out;
+  for (int ch = 0; ch < TELEMETRY_CHANNELS; ch++) {
+    const TelemetryChannelStatus &channel = status.channels[ch];
+    *p++ = channel.converterStatus;
+    *p++ = channel.controlMode;
+    *p++ = channel.enable;
+    p = put16(p, channel.command);
+    p = put16(p, channel.lowerVoltageLimit);
+    p = put16(p, channel.lowerCurrentLimit);
+    p = put16(p, channel.lowerPowerLimit);
+    p = put16(p, channel.upperVoltageLimit);
+    p = put16(p, channel.upperCurrentLimit);
+    p = put16(p, channel.upperPowerLimit);
+  }
+  uint8_t testCount = (status.testCount < TELEMETRY_MAX_TESTS) ? status.testCount : TELEMETRY_MAX_TESTS;
+  *p++ = testCount;
+  memcpy(p, status.testStates, testCount);
+  p += testCount;
+  const TelemetryBattery &battery = status.battery;
+  p = put16(p, battery.voltage);
+  p = put16(p, battery.current);
+  p = put16(p, battery.soc);
+  *p++ = battery.onlineCount;
+  *p++ = battery.hvOnCount;
+  p = put16(p, battery.maxTemp);
+  p = put16(p, battery.avgTemp);
+  p = put16(p, battery.minCellVoltage);
+  p = put16(p, battery.maxCellVoltage);
+  p = put16(p, battery.availablePower);
+  p = put16(p, battery.availableEnergy);
+  p = put16(p, battery.chargingPower);
+  return p - out;
+}
+
+size_t TelemetryFrame::pack(uint8_t *frame, size_t length, uint8_t *out, size_t size) {
+  put32(frame + length, DriveCycleCatalog::crc32(frame, length));
+  length += 4;
+  if (size < length + length / 254 + 3) {
+    return 0;
+  }
+  out[0] = 0;
+  size_t encoded = cobsEncode(frame, length, out + 1);
+  out[encoded + 1] = 0;
+  return encoded + 2;
+}
+
+size_t TelemetryFrame::unpack(const uint8_t *in, size_t length, uint8_t *frame, size_t size) {
+  if (length <= 4 || length > size) {
+    return 0;
+  }
+  size_t decoded = cobsDecode(in, length, frame);
+  if (decoded <= 4) {
+    return 0;
+  }
+  decoded -= 4;
+  if (DriveCycleCatalog::crc32(frame, decoded) != get32(frame + decoded)) {
+    return 0;
+  }
+  return decoded;
+}
+
+bool TelemetryFrame::decode(const uint8_t *in, size_t length, Decoded *decoded) {
+  uint8_t frame[TELEMETRY_MAX_FRAME];
+  size_t size = unpack(in, length, frame, sizeof(frame));
+  if (size < TELEMETRY_OVERHEAD - 4) {
+    return false;
+  }
+  const uint8_t *p = frame + 2;
+  const uint8_t *end = frame + size;
+  decoded->type = (Type)frame[0];
+  decoded->sequence = frame[1];
+  if (decoded->type == Samples) {
+    if (end - p < TELEMETRY_SAMPLES_HEADER) {
+      return false;
+    }
+    uint32_t timeMs = get32(p);
+    decoded->count = p[4];
+    p += 5;
+    uint32_t timestamps[TELEMETRY_CHANNELS];
+    for (int ch = 0; ch < TELEMETRY_CHANNELS; ch++) {
+      timestamps[ch] = get32(p);
+      p += 4;
+    }
+    if (decoded->count == 0 || decoded->count > TELEMETRY_MAX_SAMPLES ||
+        end - p != decoded->count * TELEMETRY_SAMPLE_SIZE) {
+      return false;
+    }
+    for (int i = 0; i < decoded->count; i++) {
+      TelemetrySample &sample = decoded->samples[i];
+      timeMs += *p++;
+      sample.timeMs = timeMs;
+      for (int ch = 0; ch < TELEMETRY_CHANNELS; ch++) {
+        sample.channels[ch].voltage = get16(p);
+        sample.channels[ch].current = get16(p + 2);
+        timestamps[ch] += p[4];
+        sample.channels[ch].timestamp = timestamps[ch];
+        p += 5;
+      }
+    }
+    return true;
+  }
+  if (decoded->type != Status || end - p < 4) {
+    return false;
+  }
+  decoded->status.timeMs = get32(p);
+  decoded->count = 0;
+  return getStatus(p + 4, end - p - 4, &decoded->status);
+}
+
+bool TelemetryFrame::getStatus(const uint8_t *in, size_t length, TelemetryStatus *status) {
+  const uint8_t *p = in;
+  const uint8_t *end = in + length;
+  if (length < TELEMETRY_STATUS_SIZE - 4 - TELEMETRY_MAX_TESTS) {
+    return false;
+  }
+  for (int ch = 0; ch < TELEMETRY_CHANNELS; ch++) {
+    TelemetryChannelStatus &channel = status->channels[ch];
+    channel.converterStatus = p[0];
+    channel.controlMode = p[1];
+    channel.enable = p[2];
+    channel.command = get16(p + 3);
+    channel.lowerVoltageLimit = get16(p + 5);
+    channel.lowerCurrentLimit = get16(p + 7);
+    channel.lowerPowerLimit = get16(p + 9);
+    channel.upperVoltageLimit = get16(p + 11);
+    channel.upperCurrentLimit = get16(p + 13);
+    channel.upperPowerLimit = get16(p + 15);
+    p += 17;
+  }
+  status->testCount = *p++;
+  if (status->testCount > TELEMETRY_MAX_TESTS || end - p != status->testCount + 22) {
+    return false;
+  }
+  memcpy(status->testStates, p, status->testCount);
+  p += status->testCount;
+  TelemetryBattery &battery = status->battery;
+  battery.voltage = get16(p);
+  battery.current = get16(p + 2);
+  battery.soc = get16(p + 4);
+  battery.onlineCount = p[6];
+  battery.hvOnCount = p[7];
+  battery.maxTemp = get16(p + 8);
+  battery.avgTemp = get16(p + 10);
+  battery.minCellVoltage = get16(p + 12);
+  battery.maxCellVoltage = get16(p + 14);
+  battery.availablePower = get16(p + 16);
+  battery.availableEnergy = get16(p + 18);
+  battery.chargingPower = get16(p + 20);
+  return true;
+}
+
+size_t TelemetryFrame::cobsEncode(const uint8_t *in, size_t length, uint8_t *out) {
+  /* Each block starts with its length + 1 and stands for its bytes and a zero, 0xFF blocks have no zero */
+  size_t codeIndex = 0;
+  uint8_t code = 1;
+  size_t o = 1;
+  for (size_t i = 0; i < length; i++) {
+    if (in[i] == 0) {
+      out[codeIndex] = code;
+      codeIndex = o++;
+      code = 1;
+      continue;
+    }
+    out[o++] = in[i];
+    if (++code == 0xFF) {
+      out[codeIndex] = code;
+      codeIndex = o++;
+      code = 1;
+    }
+  }
+  out[codeIndex] = code;
+  return o;
+}
+
+size_t TelemetryFrame::cobsDecode(const uint8_t *in, size_t length, uint8_t *out) {
+  size_t o = 0;
+  size_t i = 0;
+  while (i < length) {
+    uint8_t code = in[i++];
+    if (code == 0 || i + code - 1 > length) {
+      return 0;
+    }
+    for (int j = 1; j < code; j++) {
+      if (in[i] == 0) {
+        return 0;
+      }
+      out[o++] = in[i++];
+    }
+    if (code != 0xFF && i < length) {
+      out[o++] = 0;
+    }
+  }
+  return o;
+}
@@ -0,0 +1,188 @@
+/*
+ * TelemetryStream.cpp
+ */
+
+#include "TelemetryStream.hpp"
+#include "esp_log.h"
+#include <stdio.h>
+
+#define TELEMETRY_STACK_SIZE        3072
+/* Lowest application priority, like the console */
+#define TELEMETRY_PRIORITY          1
+#define TELEMETRY_WRITE_PERIOD_MS   10
+
+TelemetryStream::TelemetryStream(SampleFunction _sampleFunction, StatusFunction _statusFunction, void *_arg) :
+                                 sampleFunction(_sampleFunction),
+                                 statusFunction(_statusFunction),
+                                 arg(_arg),
+                                 sampleCount(0),
+                                 sequence(0),
+                                 lastStatusMs(0),
+                                 rateHz(0),
+                                 rateChanges(0),
+                                 seenRateChanges(0),
+                                 bytes(0),
+                                 sinkCount(0),
+                                 scheduler(NULL),
+                                 job(-1),
+                                 taskHandle(NULL){
+}
+
+TelemetryStream::~TelemetryStream() {
+  if (taskHandle != NULL) {
+    OSPort::deleteTask(taskHandle);
+  }
+}
+
+bool TelemetryStream::start() {
+  if (taskHandle != NULL) {
+    return true;
+  }
+  if (!OSPort::createTask(&TelemetryStream::writerTaskWrapper, "Telemetry", TELEMETRY_STACK_SIZE, this,
+                          TELEMETRY_PRIORITY, &taskHandle)) {
+    ESP_LOGE(TAG, "Failed to create telemetry task");
+    return false;
+  }
+  return true;
+}
+
+void TelemetryStream::schedule(TestScheduler &_scheduler) {
+  scheduler = &_scheduler;
+  uint32_t periodMs = 1000 / TELEMETRY_MIN_RATE_HZ;
+  job = scheduler->addJob("Telemetry", &TelemetryStream::sampleJob, this, TestScheduler::Monitor, periodMs, periodMs);
+}
+
+bool TelemetryStream::addSink(Writer writer, void *arg) {
+  if (sinkCount >= TELEMETRY_MAX_SINKS) {
+    ESP_LOGE(TAG, "No room for another sink");
+    return false;
+  }
+  sinks[sinkCount].writer = writer;
+  sinks[sinkCount].arg = arg;
+  sinkCount++;
+  return true;
+}
+
+bool TelemetryStream::setRate(uint32_t hz) {
+  if (job < 0) {
+    ESP_LOGE(TAG, "Not scheduled");
+    return false;
+  }
+  if (hz != 0 && (hz < TELEMETRY_MIN_RATE_HZ || hz > TELEMETRY_MAX_RATE_HZ)) {
+    ESP_LOGE(TAG, "Rate must be 0 or %d-%d Hz", TELEMETRY_MIN_RATE_HZ, TELEMETRY_MAX_RATE_HZ);
+    return false;
+  }
+  rateHz = hz;
+  rateChanges++;
+  if (hz == 0) {
+    return scheduler->deactivate(job);
+  }
+  return scheduler->setPeriod(job, 1000 / hz, 1000 / hz) && scheduler->activate(job);
+}
+
+uint32_t TelemetryStream::getRate() {
+  return rateHz;
+}
+
+bool TelemetryStream::sampleJob(void *arg) {
+  TelemetryStream *stream = (TelemetryStream *)arg;
+  stream->sample();
+  return stream->getRate() != 0;
+}
+
+void TelemetryStream::sample() {
+  uint32_t rate = rateHz;
+  if (rate == 0) {
+    return;
+  }
+  uint32_t now = OSPort::getTickMs();
+  uint32_t changes = rateChanges;
+  if (changes != seenRateChanges) {
+    /* Started or changed, begin with a status frame and an empty batch */
+    seenRateChanges = changes;
+    sampleCount = 0;
+    lastStatusMs = now - TELEMETRY_STATUS_PERIOD_MS;
+  }
+
+  TelemetrySample next = {};
+  sampleFunction(arg, next);
+  next.timeMs = now;
+  if (sampleCount > 0 && !TelemetryFrame::fits(samples[sampleCount - 1], next)) {
+    queueSamples();
+  }
+  samples[sampleCount++] = next;
+  if (sampleCount >= rate * TELEMETRY_FRAME_PERIOD_MS / 1000) {
+    queueSamples();
+  }
+
+  if (now - lastStatusMs >= TELEMETRY_STATUS_PERIOD_MS) {
+    lastStatusMs = now;
+    queueStatus(now);
+  }
+}
+
+void TelemetryStream::queueSamples() {
+  uint32_t position;
+  Frame *frame = frames.claim(&position);
+  if (frame != NULL) {
+    frame->length = TelemetryFrame::encodeSamples(samples, sampleCount, sequence, frame->data, sizeof(frame->data));
+    frames.publish(position);
+  }
+  sequence++;
+  sampleCount = 0;
+}
+
+void TelemetryStream::queueStatus(uint32_t timeMs) {
+  uint32_t position;
+  Frame *frame = frames.claim(&position);
+  if (frame != NULL) {
+    TelemetryStatus status = {};
+    statusFunction(arg, status);
+    status.timeMs = timeMs;
+    frame->length = TelemetryFrame::encodeStatus(status, sequence, frame->data, sizeof(frame->data));
+    frames.publish(position);
+  }
+  sequence++;
+}
+
+uint32_t TelemetryStream::write() {
+  uint32_t count = 0;
+  Frame frame;
+  while (frames.pop(&frame)) {
+    for (int i = 0; i < sinkCount; i++) {
+      sinks[i].writer(frame.data, frame.length, sinks[i].arg);
+    }
+    bytes += frame.length;
+    count++;
+  }
+  return count;
+}
+
+uint32_t TelemetryStream::getFrames() {
+  return frames.getPopped();
+}
+
+uint32_t TelemetryStream::getBytes() {
+  return bytes;
+}
+
+uint32_t TelemetryStream::getDropped() {
+  return frames.getDropped();
+}
+
+void TelemetryStream::printStats() {
+  printf("  %-8s|%-8s|%-10s|%s\r\n", "Rate Hz", "Frames", "Bytes", "Dropped");
+  printf("  %-8u|%-8u|%-10u|%u\r\n", getRate(), getFrames(), getBytes(), getDropped());
+}
+
+void TelemetryStream::writerTaskWrapper(void *arg) {
+  TelemetryStream *stream = (TelemetryStream *)arg;
+  stream->writerTask();
+}
+
+void TelemetryStream::writerTask() {
+  while (1) {
+    write();
+    OSPort::delay(TELEMETRY_WRITE_PERIOD_MS);
+  }
+}
@@ -0,0 +1,115 @@
+/*
+ * TelemetryWatchdog.cpp
+ */
+
+#include "TelemetryWatchdog.hpp"
+#include "OSPort.hpp"
+#include <stdio.h>
+
+TelemetryWatchdog::TelemetryWatchdog(uint32_t _staleLimitMs) :
+                                     staleLimitMs(_staleLimitMs){
+  reset();
+}
+
+void TelemetryWatchdog::setStaleLimit(uint32_t ms) {
+  staleLimitMs.store(ms, std::memory_order_relaxed);
+}
+
+uint32_t TelemetryWatchdog::getStaleLimit() {
+  return staleLimitMs.load(std::memory_order_relaxed);
+}
+
+void TelemetryWatchdog::reset() {
+  for (int i = 0; i < TELEMETRY_CHANNELS; i++) {
+    for (int j = 0; j < Sources; j++) {
+      channels[i].seen[j].store(false, std::memory_order_relaxed);
+      channels[i].lastMs[j].store(0, std::memory_order_relaxed);
+    }
+    channels[i].lastTimestamp = 0;
+  }
+}
+
+void TelemetryWatchdog::mark(ChannelTimes &times, Source source, uint32_t now) {
+  times.lastMs[source].store(now, std::memory_order_relaxed);
+  times.seen[source].store(true, std::memory_order_release);
+}
+
+void TelemetryWatchdog::data(int channel, uint32_t timestamp) {
+  if (channel < 0 || channel >= TELEMETRY_CHANNELS) {
+    return;
+  }
+  ChannelTimes &times = channels[channel];
+  uint32_t now = (uint32_t)OSPort::getTimeMs();
+  /* A repeated timestamp is a frozen ABC150, not a fresh sample */
+  if (!times.seen[Timestamp].load(std::memory_order_relaxed) || timestamp != times.lastTimestamp) {
+    times.lastTimestamp = timestamp;
+    mark(times, Timestamp, now);
+  }
+  mark(times, Data, now);
+}
+
+void TelemetryWatchdog::status(int channel) {
+  if (channel < 0 || channel >= TELEMETRY_CHANNELS) {
+    return;
+  }
+  mark(channels[channel], Status, (uint32_t)OSPort::getTimeMs());
+}
+
+uint32_t TelemetryWatchdog::getAgeMs(int channel, Source source) {
+  if (channel < 0 || channel >= TELEMETRY_CHANNELS || source < 0 || source >= Sources ||
+      !channels[channel].seen[source].load(std::memory_order_acquire)) {
+    return UINT32_MAX;
+  }
+  return (uint32_t)OSPort::getTimeMs() - channels[channel].lastMs[source].load(std::memory_order_relaxed);
+}
+
+uint32_t TelemetryWatchdog::getAgeMs(int channel) {
+  return getAgeMs(channel, getOldest(channel));
+}
+
+TelemetryWatchdog::Source TelemetryWatchdog::getOldest(int channel) {
+  Source oldest = Data;
+  uint32_t oldestAge = getAgeMs(channel, Data);
+  for (int i = Data + 1; i < Sources; i++) {
+    uint32_t age = getAgeMs(channel, (Source)i);
+    if (age > oldestAge) {
+      oldest = (Source)i;
+      oldestAge = age;
+    }
+  }
+  return oldest;
+}
+
+bool TelemetryWatchdog::isFresh(int channel) {
+  return getAgeMs(channel) <= getStaleLimit();
+}
+
+const char *TelemetryWatchdog::getSourceName(Source source) {
+  switch (source) {
+  case Data:
+    return "DATA";
+  case Status:
+    return "STATUS";
+  case Timestamp:
+    return "timestamp";
+  default:
+    return "unknown";
+  }
+}
+
+void TelemetryWatchdog::print() {
+  printf("  Stale after %d ms\r\n", getStaleLimit());
+  printf("  %-8s|%-9s|%-9s|%-9s|%s\r\n", "Channel", "DATA ms", "STATUS ms", "Stamp ms", "State");
+  for (int i = 0; i < TELEMETRY_CHANNELS; i++) {
+    printf("  %-8c|", 'A' + i);
+    for (int j = 0; j < Sources; j++) {
+      uint32_t age = getAgeMs(i, (Source)j);
+      if (age == UINT32_MAX) {
+        printf("%-9s|", "-");
+      } else {
+        printf("%-9d|", age);
+      }
+    }
+    printf("%s\r\n", isFresh(i) ? "fresh" : "stale");
+  }
+}
@@ -0,0 +1,271 @@
+/*
+ * TestScheduler.cpp
+ */
+
+#include "TestScheduler.hpp"
+#include "esp_log.h"
+#include <stdio.h>
+
+#define LANE_STACK_SIZE             4096
+
+/* Both below the ABC150 send task */
+const int TestScheduler::lanePriorities[Lanes] = {
+    OSPORT_MAX_PRIORITIES-3, OSPORT_MAX_PRIORITIES-4
+};
+
+static const char *laneNames[] = {"Control", "Monitor"};
+
+TestScheduler::TestScheduler() :
+                             jobCount(0),
+                             mutex(OSPort::createMutex()){
+  for (int i = 0; i < Lanes; i++) {
+    lanes[i].scheduler = this;
+    lanes[i].lane = (Lane)i;
+    lanes[i].handle = NULL;
+  }
+}
+
+TestScheduler::~TestScheduler() {
+  for (int i = 0; i < Lanes; i++) {
+    if (lanes[i].handle != NULL) {
+      OSPort::deleteTask(lanes[i].handle);
+    }
+  }
+}
+
+bool TestScheduler::start() {
+  char name[24];
+  for (int i = 0; i < Lanes; i++) {
+    if (lanes[i].handle != NULL) {
+      continue;
+    }
+    snprintf(name, sizeof(name), "ABC150 %s", laneNames[i]);
+    if (!OSPort::createTask(&TestScheduler::laneTaskWrapper, name, LANE_STACK_SIZE, &lanes[i], lanePriorities[i],
+                            &lanes[i].handle)) {
+      ESP_LOGE(TAG, "Failed to create %s lane task", laneNames[i]);
+      return false;
+    }
+  }
+  return true;
+}
+
+int TestScheduler::addJob(const char *name, JobFunction function, void *arg, Lane lane, uint32_t periodMs,
+                          uint32_t deadlineMs) {
+  if (function == NULL || lane < 0 || lane >= Lanes || periodMs == 0) {
+    ESP_LOGE(TAG, "Invalid job %s", name);
+    return -1;
+  }
+  OSPort::lock(mutex);
+  if (jobCount >= TEST_SCHEDULER_MAX_JOBS) {
+    OSPort::unlock(mutex);
+    ESP_LOGE(TAG, "No room for job %s", name);
+    return -1;
+  }
+  Job &job = jobs[jobCount];
+  job.name = name;
+  job.function = function;
+  job.arg = arg;
+  job.lane = lane;
+  job.periodMs = periodMs;
+  job.deadlineMs = (deadlineMs == 0) ? periodMs : deadlineMs;
+  job.active = false;
+  job.activation = 0;
+  job.releaseMs = 0;
+  job.runs = 0;
+  job.overruns = 0;
+  job.skipped = 0;
+  job.maxLatencyUs = 0;
+  job.maxResponseUs = 0;
+  int index = jobCount++;
+  OSPort::unlock(mutex);
+  return index;
+}
+
+bool TestScheduler::jobCheck(int job) {
+  if (job < 0 || job >= jobCount) {
+    ESP_LOGE(TAG, "Invalid job %d", job);
+    return false;
+  }
+  return true;
+}
+
+bool TestScheduler::setPeriod(int job, uint32_t periodMs, uint32_t deadlineMs) {
+  if (!jobCheck(job) || periodMs == 0) return false;
+  OSPort::lock(mutex);
+  jobs[job].periodMs = periodMs;
+  jobs[job].deadlineMs = (deadlineMs == 0) ? periodMs : deadlineMs;
+  OSPort::unlock(mutex);
+  return true;
+}
+
+bool TestScheduler::activate(int job) {
+  if (!jobCheck(job)) return false;
+  OSPort::lock(mutex);
+  jobs[job].active = true;
+  jobs[job].activation++;
+  jobs[job].releaseMs = OSPort::getTimeMs();
+  OSPort::TaskHandle handle = lanes[jobs[job].lane].handle;
+  OSPort::unlock(mutex);
+  if (handle != NULL) {
+    OSPort::notifyGive(handle);
+  }
+  return true;
+}
+
+bool TestScheduler::deactivate(int job) {
+  if (!jobCheck(job)) return false;
+  OSPort::lock(mutex);
+  jobs[job].active = false;
+  OSPort::unlock(mutex);
+  return true;
+}
+
+bool TestScheduler::isActive(int job) {
+  if (!jobCheck(job)) return false;
+  OSPort::lock(mutex);
+  bool active = jobs[job].active;
+  OSPort::unlock(mutex);
+  return active;
+}
+
+uint32_t TestScheduler::getRuns(int job) {
+  if (!jobCheck(job)) return 0;
+  OSPort::lock(mutex);
+  uint32_t runs = jobs[job].runs;
+  OSPort::unlock(mutex);
+  return runs;
+}
+
+uint32_t TestScheduler::getOverruns(int job) {
+  if (!jobCheck(job)) return 0;
+  OSPort::lock(mutex);
+  uint32_t overruns = jobs[job].overruns;
+  OSPort::unlock(mutex);
+  return overruns;
+}
+
+uint32_t TestScheduler::getSkipped(int job) {
+  if (!jobCheck(job)) return 0;
+  OSPort::lock(mutex);
+  uint32_t skipped = jobs[job].skipped;
+  OSPort::unlock(mutex);
+  return skipped;
+}
+
+uint32_t TestScheduler::getMaxResponseUs(int job) {
+  if (!jobCheck(job)) return 0;
+  OSPort::lock(mutex);
+  uint32_t maxResponseUs = jobs[job].maxResponseUs;
+  OSPort::unlock(mutex);
+  return maxResponseUs;
+}
+
+void TestScheduler::resetStats() {
+  OSPort::lock(mutex);
+  for (int i = 0; i < jobCount; i++) {
+    jobs[i].runs = 0;
+    jobs[i].overruns = 0;
+    jobs[i].skipped = 0;
+    jobs[i].maxLatencyUs = 0;
+    jobs[i].maxResponseUs = 0;
+  }
+  OSPort::unlock(mutex);
+}
+
+void TestScheduler::print() {
+  printf("  %-3s|%-28s|%-8s|%-7s|%-9s|%-8s|%-9s|%-8s|%-11s|%s\r\n", "Num", "Job", "Lane", "Active", "Period ms",
+         "Runs", "Overruns", "Skipped", "Latency us", "Response us");
+  /* Copied so the lanes never wait for the console */
+  Job copy[TEST_SCHEDULER_MAX_JOBS];
+  OSPort::lock(mutex);
+  int count = jobCount;
+  for (int i = 0; i < count; i++) {
+    copy[i] = jobs[i];
+  }
+  OSPort::unlock(mutex);
+  for (int i = 0; i < count; i++) {
+    Job &job = copy[i];
+    printf("  %-3d|%-28s|%-8s|%-7s|%-9d|%-8d|%-9d|%-8d|%-11d|%d (deadline %d)\r\n", i, job.name,
+           laneNames[job.lane], job.active ? "yes" : "no", job.periodMs, job.runs, job.overruns, job.skipped, job.maxLatencyUs,
+           job.maxResponseUs, job.deadlineMs * 1000);
+  }
+}
+
+void TestScheduler::laneTaskWrapper(void *arg) {
+  LaneTask *laneTask = (LaneTask *)arg;
+  laneTask->scheduler->laneTask(laneTask->lane);
+}
+
+void TestScheduler::laneTask(Lane lane) {
+  while (1) {
+    int64_t now = OSPort::getTimeMs();
+    int next = -1;
+    int64_t wakeMs = INT64_MAX;
+    OSPort::lock(mutex);
+    for (int i = 0; i < jobCount; i++) {
+      Job &job = jobs[i];
+      if (job.lane != lane || !job.active) {
+        continue;
+      }
+      if (job.releaseMs > now) {
+        if (job.releaseMs < wakeMs) {
+          wakeMs = job.releaseMs;
+        }
+      } else if (next < 0 || job.releaseMs + job.deadlineMs < jobs[next].releaseMs + jobs[next].deadlineMs) {
+        next = i;
+      }
+    }
+    if (next < 0) {
+      OSPort::unlock(mutex);
+      /* activate() wakes the lane early */
+      OSPort::notifyTake((wakeMs == INT64_MAX) ? OSPORT_WAIT_FOREVER : (uint32_t)(wakeMs - now));
+      continue;
+    }
+    JobFunction function = jobs[next].function;
+    void *arg = jobs[next].arg;
+    uint32_t activation = jobs[next].activation;
+    int64_t releaseMs = jobs[next].releaseMs;
+    OSPort::unlock(mutex);
+
+    /* The lock is never held while a job runs, jobs may call into the scheduler */
+    int64_t startUs = OSPort::getTimeUs();
+    bool keep = function(arg);
+    complete(next, activation, releaseMs, startUs, OSPort::getTimeUs(), keep);
+  }
+}
+
+void TestScheduler::complete(int index, uint32_t activation, int64_t releaseMs, int64_t startUs, int64_t endUs,
+                             bool keep) {
+  OSPort::lock(mutex);
+  Job &job = jobs[index];
+  int64_t latencyUs = startUs - releaseMs * 1000;
+  int64_t responseUs = endUs - releaseMs * 1000;
+  job.runs++;
+  if (latencyUs > job.maxLatencyUs) {
+    job.maxLatencyUs = latencyUs;
+  }
+  if (responseUs > job.maxResponseUs) {
+    job.maxResponseUs = responseUs;
+  }
+  if (responseUs > (int64_t)job.deadlineMs * 1000) {
+    job.overruns++;
+  }
+  /* Reactivated while it ran: the new activation stands */
+  if (job.activation != activation) {
+    OSPort::unlock(mutex);
+    return;
+  }
+  if (!keep) {
+    job.active = false;
+  }
+  if (job.active) {
+    int64_t now = endUs / 1000;
+    job.releaseMs = releaseMs + job.periodMs;
+    if (job.releaseMs < now) {
+      int64_t missed = (now - job.releaseMs - 1) / job.periodMs + 1;
+      job.skipped += missed;
+      job.releaseMs += missed * job.periodMs;
+    }
+  }
+  OSPort::unlock(mutex);
+}
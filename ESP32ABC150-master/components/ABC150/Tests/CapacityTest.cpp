@@ -3,7 +3,7 @@
  */
 
 #include "CapacityTest.hpp"
-#include "TimeUtils.hpp"
+#include "OSPort.hpp"
 #include "esp_log.h"
 #include <sstream>
 
@@ -31,15 +31,15 @@ CapacityTest::CapacityTest(int _capacityWaitTime, ABC150CANHandler::Channel _cha
   }
 
 bool CapacityTest::startTest(BatteryModuleInfo *_bmInfo) {
-  xSemaphoreTake(startMutex, portMAX_DELAY);
+  OSPort::lock(startMutex);
   if (!preTestChecks(_bmInfo)) {
-    xSemaphoreGive(startMutex);
+    OSPort::unlock(startMutex);
     return false;
   }
 
   if (state == TestState::Running) {
     ESP_LOGE(TAG, "Already running");
-    xSemaphoreGive(startMutex);
+    OSPort::unlock(startMutex);
     return false;
   }
 
@@ -54,7 +54,7 @@ bool CapacityTest::startTest(BatteryModuleInfo *_bmInfo) {
       _bmInfo->FETFailure ||
       _bmInfo->otherHardwareFailure) {
     ESP_LOGE(TAG, "BM error");
-    xSemaphoreGive(startMutex);
+    OSPort::unlock(startMutex);
     return false;
   }
 
@@ -72,37 +72,37 @@ bool CapacityTest::startTest(BatteryModuleInfo *_bmInfo) {
   plateHandler->setBMState(bmInfo->batteryID, true);
   plateHandler->HVOn(bmInfo->batteryID);
   abc150Handler->takeControl(channel);
-  vTaskDelay(pdMS_TO_TICKS(2000));
+  OSPort::delay(2000);
   if (abc150Handler->getConverterStatus(channel) != ABC150CANHandler::ConverterStatus::Remote) {
     ESP_LOGE(TAG, "Not in remote mode, taking control again.");
     abc150Handler->takeControl(channel);
-    vTaskDelay(pdMS_TO_TICKS(2000));
+    OSPort::delay(2000);
   }
   state = TestState::Running;
-  startTime = TimeUtils::esp_timer_get_time_ms();
+  startTime = OSPort::getTimeMs();
   AmpleLogger::getTestLogger()->logStartTime("CapacityTest");
   localState = LocalState::CC;
   abc150Handler->enable(channel);
-  xSemaphoreGive(startMutex);
+  OSPort::unlock(startMutex);
   return true;
 
 }
 
 bool CapacityTest::stopTest(TestState testState) {
-  xSemaphoreTake(stopMutex, portMAX_DELAY);
+  OSPort::lock(stopMutex);
   /* If the user stops the test in between cycles */
   if (testState == TestState::Idle && state == TestState::Restart) {
     state = TestState::Idle;
     ESP_LOGI(TAG, "Idle");
-    xSemaphoreGive(stopMutex);
+    OSPort::unlock(stopMutex);
     return true;
   }
   abc150Handler->disable(channel);
-  vTaskDelay(pdMS_TO_TICKS(500));
+  OSPort::delay(500);
   abc150Handler->releaseControl(channel);
   plateHandler->HVOff(bmInfo->batteryID);
   cycles--;
-  stopTime = TimeUtils::esp_timer_get_time_ms();
+  stopTime = OSPort::getTimeMs();
   AmpleLogger::getTestLogger()->logEndTime("CapacityTest");
   /* A cycle finishes */
   if (testState == TestState::Success) {
@@ -110,7 +110,7 @@ bool CapacityTest::stopTest(TestState testState) {
     if (cycles > 0) {
       ESP_LOGI(TAG, "Cycle %d done", cycles);
       state = ABC150Test::TestState::Restart;
-      startWait = TimeUtils::esp_timer_get_time_ms();
+      startWait = OSPort::getTimeMs();
       ESP_LOGI(TAG, "Restart");
     } else {
       if (state == TestState::Running) state = TestState::Success;
@@ -128,7 +128,7 @@ bool CapacityTest::stopTest(TestState testState) {
     ESP_LOGI(TAG, "Idle");
     printAllResults();
   }
-  xSemaphoreGive(stopMutex);
+  OSPort::unlock(stopMutex);
   return true;
 }
 
@@ -180,20 +180,21 @@ void CapacityTest::loop() {
        localState = LocalState::CV;
      } else if ((localState == LocalState::CV) && (abc150Handler->getCurrent(channel) <= 0.2)) {
        ESP_LOGI(TAG, "CV done");
-       espDischargeStartTime = TimeUtils::esp_timer_get_time_ms();
+       espDischargeStartTime = OSPort::getTimeMs();
        abcDischargeStartTime = abc150Handler->getTimeStamp(channel);
        lastLoopTime = espDischargeStartTime;
        energy = 0;
        abc150Handler->setCurrent(channel, -1 * DISCHARGE_CURRENT);
        localState = LocalState::Discharge;
      } else if (localState == LocalState::Discharge) {
-       currentTime = TimeUtils::esp_timer_get_time_ms();
-       energy += (abc150Handler->getVoltage(channel) * abc150Handler->getCurrent(channel) * (currentTime - lastLoopTime));
+       currentTime = OSPort::getTimeMs();
+       ABC150CANHandler::Telemetry telemetry = abc150Handler->getTelemetry(channel);
+       energy += (telemetry.voltage * telemetry.current * (currentTime - lastLoopTime));
        if (bmInfo->minCellVoltage <= 2.5) {
            ESP_LOGI(TAG, "Discharge done");
            localState = LocalState::Recharge;
            espDischargeEndTime = currentTime;
-           abcDischargeEndTime = abc150Handler->getTimeStamp(channel);
+           abcDischargeEndTime = telemetry.timestamp;
            printResult();
         }
      } else if (localState == LocalState::Recharge) {
@@ -204,8 +205,8 @@ void CapacityTest::loop() {
           }
      }
    } else if (state == TestState::Restart) {
-    stopWait = TimeUtils::esp_timer_get_time_ms();
-    if (stopWait - startWait >= capacityWaitTime) {
+    stopWait = OSPort::getTimeMs();
+    if (stopWait - startWait >= (uint64_t)capacityWaitTime) {
       startTest(bmInfo);
     }
   }
@@ -4,7 +4,7 @@
 
 #include "ChargeDischargeTest.hpp"
 #include "esp_log.h"
-#include "TimeUtils.hpp"
+#include "OSPort.hpp"
 
 
 ChargeDischargeTest::ChargeDischargeTest(ABC150CANHandler::Channel _channel, ABC150CANHandler *_abc150Handler, PlateCANHandler *_plateHandler):
@@ -22,21 +22,21 @@ ChargeDischargeTest::ChargeDischargeTest(ABC150CANHandler::Channel _channel, ABC
   }
 
 bool ChargeDischargeTest::startTest(BatteryModuleInfo *_bmInfo) {
-  xSemaphoreTake(startMutex, portMAX_DELAY);
+  OSPort::lock(startMutex);
   if (!preTestChecks(_bmInfo)) {
-    xSemaphoreGive(startMutex);
+    OSPort::unlock(startMutex);
     return false;
   }
 
   if (destinationVoltage == 0) {
     ESP_LOGE(TAG, "Destination voltage not set");
-    xSemaphoreGive(startMutex);
+    OSPort::unlock(startMutex);
     return false;
   }
 
   if (state == TestState::Running) {
     ESP_LOGE(TAG, "Already running");
-    xSemaphoreGive(startMutex);
+    OSPort::unlock(startMutex);
     return false;
   }
 
@@ -51,7 +51,7 @@ bool ChargeDischargeTest::startTest(BatteryModuleInfo *_bmInfo) {
       _bmInfo->FETFailure ||
       _bmInfo->otherHardwareFailure) {
     ESP_LOGE(TAG, "BM error");
-    xSemaphoreGive(startMutex);
+    OSPort::unlock(startMutex);
     return false;
   }
 
@@ -75,29 +75,29 @@ bool ChargeDischargeTest::startTest(BatteryModuleInfo *_bmInfo) {
   plateHandler->setBMState(bmInfo->batteryID, true);
   plateHandler->HVOn(bmInfo->batteryID);
   abc150Handler->takeControl(channel);
-  vTaskDelay(pdMS_TO_TICKS(2000));
+  OSPort::delay(2000);
   if (abc150Handler->getConverterStatus(channel) != ABC150CANHandler::ConverterStatus::Remote) {
     ESP_LOGE(TAG, "Not in remote mode, taking control again.");
     abc150Handler->takeControl(channel);
-    vTaskDelay(pdMS_TO_TICKS(2000));
+    OSPort::delay(2000);
   }
   state = TestState::Running;
-  startTime = TimeUtils::esp_timer_get_time_ms();
+  startTime = OSPort::getTimeMs();
   AmpleLogger::getTestLogger()->logStartTime("Charge/DischargeTest");
   abc150Handler->enable(channel);
-  xSemaphoreGive(startMutex);
+  OSPort::unlock(startMutex);
   return true;
 }
 
 bool ChargeDischargeTest::stopTest(TestState testState) {
-  xSemaphoreTake(stopMutex, portMAX_DELAY);
+  OSPort::lock(stopMutex);
   AmpleLogger::getTestLogger()->logEndTime("Charge/DischargeTest");
   abc150Handler->disable(channel);
-  vTaskDelay(pdMS_TO_TICKS(500));
+  OSPort::delay(500);
   abc150Handler->releaseControl(channel);
   plateHandler->HVOff(bmInfo->batteryID);
   destinationVoltage = 0;
-  stopTime = TimeUtils::esp_timer_get_time_ms();
+  stopTime = OSPort::getTimeMs();
   if (testState == TestState::Success) {
     state = TestState::Success;
     ESP_LOGI(TAG, "Success");
@@ -108,7 +108,7 @@ bool ChargeDischargeTest::stopTest(TestState testState) {
     state = TestState::Idle;
     ESP_LOGI(TAG, "Idle");
   }
-  xSemaphoreGive(stopMutex);
+  OSPort::unlock(stopMutex);
   return true;
 }
 
@@ -138,7 +138,7 @@ void ChargeDischargeTest::loop() {
        return;
      }
 
-     currentTime = TimeUtils::esp_timer_get_time_ms();
+     currentTime = OSPort::getTimeMs();
      if (((charging && abc150Handler->getCurrent(channel) <= 0.2) ||
          (!charging && abc150Handler->getCurrent(channel) >= -0.2))
          && (currentTime - startTime > 5000)) {
@@ -3,7 +3,7 @@
  */
 
 #include "esp_log.h"
-#include "TimeUtils.hpp"
+#include "OSPort.hpp"
 #include "PlateChargeDischargeTest.hpp"
 #include "PCAL6416a.hpp"
 #include "AmpleConfig.hpp"
@@ -29,10 +29,10 @@ void PlateChargeDischargeTest::printResult() {
 }
 
 bool PlateChargeDischargeTest::startTest() {
-  xSemaphoreTake(startMutex, portMAX_DELAY);
+  OSPort::lock(startMutex);
   if (state == TestState::Running) {
     ESP_LOGE(TAG, "Already running");
-    xSemaphoreGive(startMutex);
+    OSPort::unlock(startMutex);
     return false;
   }
   if (onlineCount < 1){
@@ -42,18 +42,18 @@ bool PlateChargeDischargeTest::startTest() {
 
   if (destinationVoltage == 0) {
     ESP_LOGE(TAG, "Plate Destination voltage not set");
-    xSemaphoreGive(startMutex);
+    OSPort::unlock(startMutex);
     return false;
   }
   ESP_LOGI(TAG, "Destination Voltage: %f\n", destinationVoltage);
   
   /*Initial settings*/
   plateHandler->HVOn();
-  vTaskDelay(pdMS_TO_TICKS(500));
+  OSPort::delay(500);
 
   if (collection.getHVCount() != onlineCount) {
     ESP_LOGE(TAG, "HVCount() != onlineCount\n");
-    xSemaphoreGive(startMutex);
+    OSPort::unlock(startMutex);
     return false;
   } else {
     ESP_LOGI(TAG, "There are %d BMs online.\n", onlineCount);
@@ -84,43 +84,42 @@ bool PlateChargeDischargeTest::startTest() {
   /*Close plate contactors*/
   pcal6416a->gpioSetValue(CONFIG::CONTACTORS::preChargeCtrlPin,1);
   pcal6416a->gpioSetValue(CONFIG::CONTACTORS::relayNCtrlPin,1);
-  vTaskDelay(pdMS_TO_TICKS(100));
+  OSPort::delay(100);
   pcal6416a->gpioSetValue(CONFIG::CONTACTORS::relayPCtrlPin,1);
-  vTaskDelay(pdMS_TO_TICKS(100));
+  OSPort::delay(100);
   pcal6416a->gpioSetValue(CONFIG::CONTACTORS::preChargeCtrlPin,0);
 
   /* ABC150 Commands */
   abc150Handler->takeControl(ABC150CANHandler::A);
-  vTaskDelay(pdMS_TO_TICKS(500));
+  OSPort::delay(500);
   abc150Handler->takeControl(ABC150CANHandler::B);
   abc150Handler->setLoadMode(ABC150CANHandler::A,ABC150CANHandler::Parallel);
-  vTaskDelay(pdMS_TO_TICKS(500));
+  OSPort::delay(500);
   abc150Handler->releaseControl(ABC150CANHandler::B);
-  startTime = TimeUtils::esp_timer_get_time_ms();
+  startTime = OSPort::getTimeMs();
   AmpleLogger::getTestLogger()->logStartTime("PlateChargeDischarge");
   abc150Handler->setVoltage(ABC150CANHandler::A, destinationVoltage);
   abc150Handler->enable(ABC150CANHandler::A);
   state = TestState::Running;
-  xLastWakeTimePlate = xTaskGetTickCount();
-  xSemaphoreGive(startMutex);
+  OSPort::unlock(startMutex);
   return true;
 }
 
 bool PlateChargeDischargeTest::stopTest(TestState testState) {
-  xSemaphoreTake(stopMutex, portMAX_DELAY);
+  OSPort::lock(stopMutex);
   abc150Handler->disable(ABC150CANHandler::A);
-  vTaskDelay(pdMS_TO_TICKS(500));
+  OSPort::delay(500);
   /*Open plate contactors*/
   pcal6416a->gpioSetValue(CONFIG::CONTACTORS::relayNCtrlPin,1);
-  vTaskDelay(pdMS_TO_TICKS(100));
+  OSPort::delay(100);
   pcal6416a->gpioSetValue(CONFIG::CONTACTORS::relayPCtrlPin,1);
-  vTaskDelay(pdMS_TO_TICKS(100));
+  OSPort::delay(100);
   plateHandler->HVOff();
   abc150Handler->setLoadMode(ABC150CANHandler::A,ABC150CANHandler::Independent);
-  vTaskDelay(pdMS_TO_TICKS(500));
+  OSPort::delay(500);
   abc150Handler->releaseControl(ABC150CANHandler::A);
   abc150Handler->releaseControl(ABC150CANHandler::B);
-  stopTime = TimeUtils::esp_timer_get_time_ms();
+  stopTime = OSPort::getTimeMs();
   AmpleLogger::getTestLogger()->logEndTime("PlateChargeDischarge");
   if (testState == TestState::Success) {
     if (state == TestState::Running) state = TestState::Success;
@@ -132,14 +131,14 @@ bool PlateChargeDischargeTest::stopTest(TestState testState) {
     state = TestState::Idle;
     ESP_LOGI(TAG, "Idle");
   }
-  xSemaphoreGive(stopMutex);
+  OSPort::unlock(stopMutex);
   return true;
 }
 
 void PlateChargeDischargeTest::loop() {
   int64_t currentTime;
   if (state == TestState::Running && loopCheck()) {
-    currentTime = TimeUtils::esp_timer_get_time_ms();
+    currentTime = OSPort::getTimeMs();
     /* Stop test after current becomes negligible */
     if (((charging && abc150Handler->getCurrent(ABC150CANHandler::A) <= (0.2 * bmCount)) ||
         (!charging && abc150Handler->getCurrent(ABC150CANHandler::A) >= (-0.2 * bmCount)))
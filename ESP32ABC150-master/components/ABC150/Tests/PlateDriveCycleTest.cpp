@@ -3,17 +3,29 @@
  */
 
 #include "esp_log.h"
-#include "TimeUtils.hpp"
+#include "OSPort.hpp"
 #include "PlateDriveCycleTest.hpp"
+#include "AsyncConsole.hpp"
 #include "PCAL6416a.hpp"
-#include <fstream>
-#include <iostream>
-#include "esp_vfs.h"
-#include "esp_spiffs.h"
+#include <math.h>
 #include "esp_task_wdt.h"
 #include "AmpleConfig.hpp"
 
-ifstream file;
+/* Setpoint update period, drive cycle samples are interpolated in between */
+#define CONTROL_PERIOD_MS           100
+/* Plate power slew rate limit, kW/s */
+#define SLEW_RATE_KW_PER_S          20
+/* Power tracking, tuned with tools/PowerTrackingBench */
+#define POWER_TRACKING_ENABLE       false
+#define TRACKING_KP                 0.2
+#define TRACKING_KI                 1.0
+#define TRACKING_INTEGRAL_LIMIT_W   5000
+/* Limit prediction, tuned with tools/LimitPredictorBench */
+#define LIMIT_PREDICTION_ENABLE     true
+/* Age of the BMS power limits */
+#define LIMIT_LAG_S                 1.0
+/* Drive cycle samples looked ahead for limit drops */
+#define LIMIT_LOOKAHEAD_SAMPLES     32
 
 PlateDriveCycleTest::PlateDriveCycleTest(int _driveCycleWaitTime, ABC150CANHandler *_abc150Handler, PlateCANHandler *_plateHandler):
                      DualChannelTest(_abc150Handler, _plateHandler),
@@ -21,73 +33,109 @@ PlateDriveCycleTest::PlateDriveCycleTest(int _driveCycleWaitTime, ABC150CANHandl
                      plateHandler(_plateHandler),
                      collection(BatteryModuleCollection::collection()),
                      driveCycleWaitTime(_driveCycleWaitTime),
-                     xLastWakeTimePlate(0),
-                     pcal6416a(PCAL6416a::getInstance()){
+                     scheduler(NULL),
+                     plateJob(-1),
+                     pcal6416a(PCAL6416a::getInstance()),
+                     profile(0),
+                     prefetcher(driveCycle),
+                     player(DriveCyclePlayer::Cubic, SLEW_RATE_KW_PER_S),
+                     tracker(TRACKING_KP, TRACKING_KI, TRACKING_INTEGRAL_LIMIT_W),
+                     powerTracking(POWER_TRACKING_ENABLE),
+                     predictor(LIMIT_LAG_S, SLEW_RATE_KW_PER_S),
+                     limitPrediction(LIMIT_PREDICTION_ENABLE),
+                     timeDelta(0),
+                     controlPeriod(CONTROL_PERIOD_MS),
+                     lastPlateWakeUs(0),
+                     finished(false){
   TAG = "PlateDriveCycleTest";
   assert(startMutex != NULL);
   assert(stopMutex != NULL);
 
   logger = AmpleLogger::getTestLogger();
-
-  if (xTaskCreate(&PlateDriveCycleTest::loopPlateTaskWrapper, "ABC150 Plate loop", 4096, this, configMAX_PRIORITIES-4, &loopPlateTaskHandle) != pdPASS){
-    ESP_LOGI(TAG, "Failed to create ABC150 loop Task");
+  profileFlag = true;
+  if (catalog.map(DRIVECYCLE_PARTITION)) {
+    ESP_LOGI(TAG, "%d drive cycles", catalog.getCount());
   }
 }
 
+void PlateDriveCycleTest::schedule(TestScheduler &_scheduler) {
+  scheduler = &_scheduler;
+  plateJob = scheduler->addJob("PlateDriveCycleTest plate", &PlateDriveCycleTest::loopPlateJob, this,
+                               TestScheduler::Control, CONTROL_PERIOD_MS, CONTROL_PERIOD_MS);
+}
+
 void PlateDriveCycleTest::printResult() {
 }
 
-int PlateDriveCycleTest::getTimeDelta(){
-  int timeDelta;
-  file >> timeDelta;
-  return timeDelta*1000;
+void PlateDriveCycleTest::listProfiles() {
+  catalog.list();
+}
+
+bool PlateDriveCycleTest::setProfile(int profileNum) {
+  if (profileNum < 0 || profileNum >= (int)catalog.getCount()) {
+    ESP_LOGE(TAG, "Invalid drive cycle %d", profileNum);
+    return false;
+  }
+  profile = profileNum;
+  return true;
+}
+
+bool PlateDriveCycleTest::setPowerTracking(bool enable) {
+  powerTracking = enable;
+  ESP_LOGI(TAG, "Power tracking %s", enable ? "enabled" : "disabled");
+  return true;
+}
+
+void PlateDriveCycleTest::printStats() {
+  printf("  %d samples played, %d underruns\r\n", prefetcher.getPlayed(), prefetcher.getUnderruns());
+  printf("  %d of %d ms slew rate limited\r\n", player.getSlewLimited() * controlPeriod, player.getTimeMs());
+  plateJitter.print();
 }
 
 bool PlateDriveCycleTest::startTest() {
-  xSemaphoreTake(startMutex, portMAX_DELAY);
+  OSPort::lock(startMutex);
   if(!preTestChecks()) {
-    xSemaphoreGive(startMutex);
+    OSPort::unlock(startMutex);
     return false;
   }
-  if (state == TestState::Running) {
-    ESP_LOGE(TAG, "Already running");
-    xSemaphoreGive(startMutex);
+  if (plateJob < 0) {
+    ESP_LOGE(TAG, "Plate loop not scheduled");
+    OSPort::unlock(startMutex);
     return false;
   }
-  /* Mount and check SPIFFS status */
-  esp_vfs_spiffs_conf_t conf = {
-      .base_path = "/spiffs",
-      .partition_label = "storage",
-      .max_files = 5,
-      .format_if_mount_failed = false
-  };
-  static const char *TAG = "SPIFFS";
-  esp_err_t ret = esp_vfs_spiffs_register(&conf);
-  if (ret != ESP_OK) {
-    if (ret == ESP_FAIL) {
-      ESP_LOGE(TAG, "Failed to mount or format filesystem");
-    } else if (ret == ESP_ERR_NOT_FOUND) {
-      ESP_LOGE(TAG, "Failed to find SPIFFS partition");
-    } else {
-      ESP_LOGE(TAG, "Failed to initialize SPIFFS (%s)", esp_err_to_name(ret));
-    }
-    xSemaphoreGive(startMutex);
+  if (state == TestState::Running) {
+    ESP_LOGE(TAG, "Already running");
+    OSPort::unlock(startMutex);
     return false;
   }
-  /*Open file*/
-  file.open("/spiffs/DriveCycleSample.csv");
-  if(!file.good()) {
-    ESP_LOGE(TAG, "File is unreadable");
-    xSemaphoreGive(startMutex);
+  /*Check drive cycle before HV on*/
+  if (!catalog.verify(profile) || !catalog.open(profile, driveCycle)) {
+    ESP_LOGE(TAG, "Drive cycle %d is unreadable", profile);
+    OSPort::unlock(startMutex);
     return false;
   }
+  timeDelta = driveCycle.getPeriodMs();
+  controlPeriod = (timeDelta < CONTROL_PERIOD_MS) ? timeDelta : CONTROL_PERIOD_MS;
+  ESP_LOGI(TAG, "Drive cycle %s: %d samples every %d ms, setpoint every %d ms", catalog.getName(profile),
+           driveCycle.getSampleCount(), timeDelta, controlPeriod);
+  prefetcher.start();
+  player.reset(controlPeriod);
+  tracker.reset();
+  predictor.reset();
+  plateJitter.reset();
+  lastPlateWakeUs = 0;
+  finished = false;
 
   plateHandler->HVOn();
-  vTaskDelay(pdMS_TO_TICKS(500));
+  OSPort::delay(500);
 
   if (collection.getHVCount() != onlineCount) {
     ESP_LOGE(TAG, "HVCount() != onlineCount\n");
-    xSemaphoreGive(startMutex);
+    /* Undo what was started for this run */
+    plateHandler->HVOff();
+    prefetcher.stop();
+    driveCycle.close();
+    OSPort::unlock(startMutex);
     return false;
   } else {
     ESP_LOGI(TAG, "There are %d BMs online.\n", onlineCount);
@@ -111,68 +159,66 @@ bool PlateDriveCycleTest::startTest() {
   /*Close plate contactors*/
   pcal6416a->gpioSetValue(CONFIG::CONTACTORS::preChargeCtrlPin,1);
   pcal6416a->gpioSetValue(CONFIG::CONTACTORS::relayNCtrlPin,1);
-  vTaskDelay(pdMS_TO_TICKS(100));
+  OSPort::delay(100);
   pcal6416a->gpioSetValue(CONFIG::CONTACTORS::relayPCtrlPin,1);
-  vTaskDelay(pdMS_TO_TICKS(100));
+  OSPort::delay(100);
   pcal6416a->gpioSetValue(CONFIG::CONTACTORS::preChargeCtrlPin,0);
 
   /* ABC150 Commands */
   abc150Handler->takeControl(ABC150CANHandler::A);
-  vTaskDelay(pdMS_TO_TICKS(500));
+  OSPort::delay(500);
   abc150Handler->takeControl(ABC150CANHandler::B);
   abc150Handler -> setLoadMode(ABC150CANHandler::A,ABC150CANHandler::Parallel);
-  vTaskDelay(pdMS_TO_TICKS(500));
+  OSPort::delay(500);
   abc150Handler->releaseControl(ABC150CANHandler::B);
-  startTime = TimeUtils::esp_timer_get_time_ms();
+  startTime = OSPort::getTimeMs();
   logger->logStartTime("PlateDriveCycleTest");
   abc150Handler->setPower(ABC150CANHandler::A, 0);
   abc150Handler->enable(ABC150CANHandler::A);
   state = TestState::Running;
-  printf("Test Power\t|\tAvailable Power\t|\tCharging Power\t|\tC/D\t|\tValue\t|\tCurrent\t|\tCommand\n");
-  xLastWakeTimePlate = xTaskGetTickCount();
-  vTaskResume(loopPlateTaskHandle);
-  xSemaphoreGive(startMutex);
+  AsyncConsole::console().print("Test Power\t|\tAvailable Power\t|\tCharging Power\t|\tC/D\t|\tValue\t|\tCurrent\t|\tCommand\n");
+  scheduler->setPeriod(plateJob, controlPeriod, controlPeriod);
+  scheduler->activate(plateJob);
+  OSPort::unlock(startMutex);
   return true;
 }
 
 bool PlateDriveCycleTest::stopTest(TestState testState) {
-  xSemaphoreTake(stopMutex, portMAX_DELAY);
+  OSPort::lock(stopMutex);
   /* If the user stops the test in between cycles */
   if (testState == TestState::Idle && state == TestState::Restart) {
     state = TestState::Idle;
     ESP_LOGI(TAG, "Idle");
-    xSemaphoreGive(stopMutex);
+    OSPort::unlock(stopMutex);
     return true;
   }
   logger->logEndTime("PlateDriveCycleTest");
   abc150Handler->disable(ABC150CANHandler::A);
-  vTaskDelay(pdMS_TO_TICKS(500));
+  OSPort::delay(500);
 
   /*Open plate contactors*/
   pcal6416a->gpioSetValue(CONFIG::CONTACTORS::relayNCtrlPin,1);
-  vTaskDelay(pdMS_TO_TICKS(100));
+  OSPort::delay(100);
   pcal6416a->gpioSetValue(CONFIG::CONTACTORS::relayPCtrlPin,1);
-  vTaskDelay(pdMS_TO_TICKS(100));
+  OSPort::delay(100);
 
   plateHandler->HVOff();
   abc150Handler -> setLoadMode(ABC150CANHandler::A,ABC150CANHandler::Independent);
-  vTaskDelay(pdMS_TO_TICKS(1000));
+  OSPort::delay(1000);
   abc150Handler->releaseControl(ABC150CANHandler::A);
   abc150Handler->releaseControl(ABC150CANHandler::B);
-  if(file.is_open()) {
-    file.close();
-  }
-  esp_vfs_spiffs_unregister("storage");
+  prefetcher.stop();
+  driveCycle.close();
   ESP_LOGI(TAG, "Test stopped");
-  vTaskSuspend(loopPlateTaskHandle);
+  scheduler->deactivate(plateJob);
   abc150Handler->setDefaultFrequency();
   cycles--;
-  stopTime = TimeUtils::esp_timer_get_time_ms();
+  stopTime = OSPort::getTimeMs();
   if (testState == TestState::Success) {
     if (cycles > 0) {
       ESP_LOGI(TAG, "Cycle %d done", cycles);
       state = TestState::Restart;
-      startWait = TimeUtils::esp_timer_get_time_ms(); 
+      startWait = OSPort::getTimeMs(); 
       ESP_LOGI(TAG, "Restart");
     } else {
       state = TestState::Success;
@@ -185,89 +231,117 @@ bool PlateDriveCycleTest::stopTest(TestState testState) {
     state = TestState::Idle;
     ESP_LOGI(TAG, "Idle");
   }
-  xSemaphoreGive(stopMutex);
+  OSPort::unlock(stopMutex);
   return true;
 }
 
-void PlateDriveCycleTest::loopPlateTaskWrapper(void *arg) {
+bool PlateDriveCycleTest::loopPlateJob(void *arg) {
   PlateDriveCycleTest* obj =  (PlateDriveCycleTest *)arg;
-  obj->loopPlateTask();
-}
-
-void PlateDriveCycleTest::loopPlateTask() {
-  CAN_frame_t canMsg;
-  vTaskSuspend(NULL);
-  const TickType_t xFrequency = pdMS_TO_TICKS(timeDelta);
-  while (1) {
-    vTaskDelayUntil(&xLastWakeTimePlate, xFrequency);
-    loopPlate();
+  int64_t now = OSPort::getTimeUs();
+  if (obj->lastPlateWakeUs != 0) {
+    obj->plateJitter.record(now - obj->lastPlateWakeUs, obj->controlPeriod * 1000);
   }
+  obj->lastPlateWakeUs = now;
+  obj->loopPlate();
+  return obj->state == TestState::Running && !obj->finished;
 }
+
 void PlateDriveCycleTest::loop(){
   if (state == TestState::Running) {
+    if (finished) {
+      /* The stop sequence takes seconds, it must not hold up the Control lane */
+      stopTest(TestState::Success);
+      return;
+    }
     loopCheck();
+  } else if (state == TestState::Restart) {
+    stopWait = OSPort::getTimeMs();
+    if (stopWait - startWait >= (uint64_t)driveCycleWaitTime) {
+      startTest();
+    }
   }
 }
 
 void PlateDriveCycleTest::loopPlate() {
-  if (state == TestState::Running) {
-    if (file.good()) {
-      /*Get next value in drive cycle file*/
-      float r[3];
-      for(int i = 0; i < 3; ++i) {
-        file >> r[i];
-        file.get();
+  if (state == TestState::Running && !finished) {
+    /* Keep the player supplied up to two samples ahead */
+    while (player.needsSample()) {
+      float powerKW;
+      if (prefetcher.next(&powerKW)) {
+        player.pushSample((prefetcher.getPlayed() - 1) * timeDelta, powerKW/16);
+      } else if (prefetcher.isFinished()) {
+        player.endOfSamples();
+      } else {
+        /* Underrun, counted in the prefetcher. The player holds the newest sample. */
+        break;
       }
-      float power;
-      float testPower = r[2]/16;
-      /*Limit discharging power to 70 kW*/
-      if (testPower >= 70){
-        testPower = 70;
+    }
+    if (player.isFinished()) {
+      ESP_LOGI(TAG, "Finished Drive Cycle");
+      finished = true;
+      return;
+    }
+    /* Print once per drive cycle sample, not every control step */
+    bool printStep = player.getTimeMs() % timeDelta < controlPeriod;
+    /*Get interpolated drive cycle value*/
+    float power;
+    float testPower = player.step();
+    /*Limit discharging power to 70 kW*/
+    if (testPower >= 70){
+      testPower = 70;
+    }
+    /*Power battery can provide*/
+    float availablePower = BatteryModuleCollection::collection().getBatteryInfo()->availablePower;
+    /*Power battery can intake*/
+    float chargingPower = BatteryModuleCollection::collection().getBatteryInfo()->chargingPower;
+    ABC150CANHandler::Telemetry telemetry = abc150Handler->getTelemetry(ABC150CANHandler::A);
+    /*Limits for this step, lowered ahead of where the reported limits are heading*/
+    float maxDischarge = availablePower;
+    float maxCharge = chargingPower;
+    if (limitPrediction) {
+      float upcoming[LIMIT_LOOKAHEAD_SAMPLES];
+      uint32_t count = prefetcher.peek(upcoming, LIMIT_LOOKAHEAD_SAMPLES);
+      for (uint32_t i = 0; i < count; i++) {
+        upcoming[i] /= 16;
       }
-      /*Power battery can provide*/
-      float availablePower = BatteryModuleCollection::collection().getBatteryInfo()->availablePower;
-      /*Power battery can intake*/
-      float chargingPower = BatteryModuleCollection::collection().getBatteryInfo()->chargingPower;
-      /*Charging or Discharging*/
-      char CD;
-      //Discharging plate
-      if (testPower >= 0) {
-          CD = 'D';
-        if (testPower<=availablePower){
-          power = testPower *-1;
-        } else {
-          power = availablePower*-1;
-        }
-      //Charging plate
+      /* The next sample in the prefetcher plays after the ones the player holds */
+      float firstOffset = ((float)prefetcher.getPlayed() * timeDelta - player.getTimeMs()) / 1000;
+      predictor.update(availablePower, chargingPower, telemetry.voltage*telemetry.current/-1000,
+                       controlPeriod/1000.0f);
+      predictor.shape(upcoming, count, firstOffset, timeDelta/1000.0f, &maxDischarge, &maxCharge);
+    }
+    /*Charging or Discharging*/
+    char CD;
+    //Discharging plate
+    if (testPower >= 0) {
+        CD = 'D';
+      if (testPower<=maxDischarge){
+        power = testPower *-1;
       } else {
-        CD = 'C';
-        testPower = abs(testPower);
-        if (testPower <= chargingPower) {
-          power = testPower;
-        } else {
-          power = chargingPower;
-        }
+        power = maxDischarge*-1;
       }
-      logger->logDriveCyclePower(testPower,power);
-      abc150Handler->setPower(ABC150CANHandler::A, power*1000);
-      printf("%f\t|\t%f\t|\t%f\t|\t%c\t|\t%f\t|\t%f\t|\t%f\t|\t\n", testPower, availablePower, chargingPower, CD, power, abc150Handler->getCurrent(ABC150CANHandler::A), abc150Handler->getCommand(ABC150CANHandler::A)/1000);
+    //Charging plate
     } else {
-      /*EOF*/
-      if (file.eof()) {
-        ESP_LOGI(TAG, "Finished Drive Cycle");
-        stopTest(TestState::Success);
-        return;
+      CD = 'C';
+      testPower = fabsf(testPower);
+      if (testPower <= maxCharge) {
+        power = testPower;
       } else {
-        /* unreadable file*/
-        ESP_LOGE(TAG, "File not readable.");
-        stopTest(TestState::Failed);
-        return;
+        power = maxCharge;
       }
     }
-  } else if (state == TestState::Restart) {
-      stopWait = TimeUtils::esp_timer_get_time_ms();
-      if (stopWait - startWait >= driveCycleWaitTime) {
-        startTest();
-      }
+    float command = power*1000;
+    if (powerTracking) {
+      /*Correct for the delivered power, within what the battery can provide and intake*/
+      command = tracker.update(power*1000, telemetry.voltage*telemetry.current,
+                               maxDischarge*-1000, maxCharge*1000, controlPeriod/1000.0f);
+    }
+    abc150Handler->setPower(ABC150CANHandler::A, command);
+    if (printStep) {
+      logger->logDriveCyclePower(testPower,power);
+      /* Formatted and written by the console task, the plate loop never waits for the UART */
+      AsyncConsole::console().print("%f\t|\t%f\t|\t%f\t|\t%c\t|\t%f\t|\t%f\t|\t%f\t|\t\n", testPower, availablePower,
+                                    chargingPower, CD, power, telemetry.current, telemetry.command/1000);
+    }
   }
 }
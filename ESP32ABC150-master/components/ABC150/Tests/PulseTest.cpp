@@ -3,7 +3,7 @@
  */
 
 #include "PulseTest.hpp"
-#include "TimeUtils.hpp"
+#include "OSPort.hpp"
 #include "esp_log.h"
 
 #define PULSE_TIME_MS   10000
@@ -27,19 +27,19 @@ PulseTest::PulseTest(int _pulseWaitTime, ABC150CANHandler::Channel _channel, ABC
   }
 
 bool PulseTest::startTest(BatteryModuleInfo *_bmInfo) {
-  xSemaphoreTake(startMutex, portMAX_DELAY);
+  OSPort::lock(startMutex);
   if (!preTestChecks(_bmInfo)) {
-    xSemaphoreGive(startMutex);
+    OSPort::unlock(startMutex);
     return false;
   }
   if (state == ABC150Test::TestState::Running) {
     ESP_LOGE(TAG, "Already running");
-    xSemaphoreGive(startMutex);
+    OSPort::unlock(startMutex);
     return false;
   }
   if (collection.isBMErrors(_bmInfo)) {
     ESP_LOGE(TAG, "BM error present");
-    xSemaphoreGive(startMutex);
+    OSPort::unlock(startMutex);
     return false;
   }
 
@@ -61,41 +61,41 @@ bool PulseTest::startTest(BatteryModuleInfo *_bmInfo) {
   plateHandler->setBMState(bmInfo->batteryID, true);
   plateHandler->HVOn(bmInfo->batteryID);
   abc150Handler->takeControl(channel);
-  vTaskDelay(pdMS_TO_TICKS(2000));
+  OSPort::delay(2000);
   if (abc150Handler->getConverterStatus(channel) != ABC150CANHandler::ConverterStatus::Remote) {
     ESP_LOGE(TAG, "Not in remote mode, taking control again.");
     abc150Handler->takeControl(channel);
-    vTaskDelay(pdMS_TO_TICKS(2000));
+    OSPort::delay(2000);
   }
-  startTime = TimeUtils::esp_timer_get_time_ms();
+  startTime = OSPort::getTimeMs();
   AmpleLogger::getTestLogger()->logStartTime("PulseTest");
   state = ABC150Test::TestState::Running;
   abc150Handler->enable(channel);
-  xSemaphoreGive(startMutex);
+  OSPort::unlock(startMutex);
   return true;
 }
 
 bool PulseTest::stopTest(TestState testState) {
-  xSemaphoreTake(stopMutex, portMAX_DELAY);
+  OSPort::lock(stopMutex);
   /* If the user stops the test in between cycles */
   if (testState == TestState::Idle && state == TestState::Restart) {
     state = TestState::Idle;
     ESP_LOGI(TAG, "Idle");
-    xSemaphoreGive(stopMutex);
+    OSPort::unlock(stopMutex);
     return true;
   }
   abc150Handler->disable(channel);
-  vTaskDelay(pdMS_TO_TICKS(500));
+  OSPort::delay(500);
   abc150Handler->releaseControl(channel);
   plateHandler->HVOff(bmInfo->batteryID);
   cycles--;
-  stopTime = TimeUtils::esp_timer_get_time_ms();
+  stopTime = OSPort::getTimeMs();
   AmpleLogger::getTestLogger()->logEndTime("PulseTest");
   if (testState == TestState::Success) {
     if (cycles > 0) {
       ESP_LOGI(TAG, "Cycle %d done", cycles);
       state = TestState::Restart;
-      startWait = TimeUtils::esp_timer_get_time_ms();
+      startWait = OSPort::getTimeMs();
       ESP_LOGI(TAG, "Restart");
     } else {
       if (state == TestState::Running) state = TestState::Success;
@@ -108,7 +108,7 @@ bool PulseTest::stopTest(TestState testState) {
     state = TestState::Idle;
     ESP_LOGI(TAG, "Idle");
   }
-  xSemaphoreGive(stopMutex);
+  OSPort::unlock(stopMutex);
   return true;
 }
 
@@ -214,7 +214,7 @@ void PulseTest::loop() {
       stopTest(TestState::Failed);
       return;
     }
-    currentTime = TimeUtils::esp_timer_get_time_ms();
+    currentTime = OSPort::getTimeMs();
     if (currentTime - startTime >= 10000) {
       /* Copy final values */
       memcpy(cellVoltagesFinal, bmInfo->cellVoltages, sizeof(cellVoltagesInitial));
@@ -223,8 +223,8 @@ void PulseTest::loop() {
       printResult();
     }
   } else if (state == TestState::Restart) {
-    stopWait = TimeUtils::esp_timer_get_time_ms();
-    if (stopWait - startWait >= pulseWaitTime) {
+    stopWait = OSPort::getTimeMs();
+    if (stopWait - startWait >= (uint64_t)pulseWaitTime) {
       startTest(bmInfo);
     }
   }
@@ -24,15 +24,11 @@ PlateChargeDischargeTest();
   bool stopTest(TestState testState);
   void loop();
   void printResult();
-  void loopPlateTask();
-  static void loopPlateTaskWrapper(void *arg);
 
 private:
   ABC150CANHandler *abc150Handler;
   PlateCANHandler *plateHandler;
   BatteryModuleCollection &collection;
-  TaskHandle_t loopPlateTaskHandle;
-  TickType_t xLastWakeTimePlate;
   PCAL6416a *pcal6416a;
   bool charging;
   int bmCount;
@@ -13,6 +13,14 @@
 #include "DualChannelTest.hpp"
 #include "AmpleLogger.hpp"
 #include "ABC150TestManager.hpp"
+#include "DriveCycleImage.hpp"
+#include "DriveCycleCatalog.hpp"
+#include "DriveCyclePrefetcher.hpp"
+#include "DriveCyclePlayer.hpp"
+#include "PowerTracker.hpp"
+#include "LimitPredictor.hpp"
+#include "JitterHistogram.hpp"
+#include <atomic>
 
 class PlateDriveCycleTest : public DualChannelTest {
 
@@ -24,8 +32,14 @@ public:
   void loop();
   void loopPlate();
   void printResult();
-  void loopPlateTask();
-  static void loopPlateTaskWrapper(void *arg);
+  void printStats();
+  void listProfiles();
+  bool setProfile(int profileNum);
+  /* Closed loop correction of the plate power from DATA_A feedback */
+  bool setPowerTracking(bool enable);
+  /* Adds loopPlate() to the Control lane */
+  void schedule(TestScheduler &_scheduler);
+  static bool loopPlateJob(void *arg);
 
 private:
   ABC150CANHandler *abc150Handler;
@@ -33,11 +47,29 @@ private:
   TestLogger *logger;
   BatteryModuleCollection &collection;
   int driveCycleWaitTime;
-  TaskHandle_t loopPlateTaskHandle;
-  TickType_t xLastWakeTimePlate;
+  TestScheduler *scheduler;
+  int plateJob;
   PCAL6416a *pcal6416a;
-  int getTimeDelta();
-  float timeDelta;
+  /* Mapped once in the constructor */
+  DriveCycleCatalog catalog;
+  /* Catalog index of the drive cycle */
+  int profile;
+  DriveCycleImage driveCycle;
+  DriveCyclePrefetcher prefetcher;
+  DriveCyclePlayer player;
+  PowerTracker tracker;
+  bool powerTracking;
+  LimitPredictor predictor;
+  bool limitPrediction;
+  /* Drive cycle sample period, ms */
+  uint32_t timeDelta;
+  /* Plate loop period, ms */
+  uint32_t controlPeriod;
+  /* Plate loop wake-up timing */
+  JitterHistogram plateJitter;
+  int64_t lastPlateWakeUs;
+  /* Set by the plate loop at the end of the drive cycle, the Monitor lane runs stopTest() */
+  std::atomic<bool> finished;
 
 };
 
@@ -19,7 +19,7 @@ public:
   /* ABC150Test virtual functions */
   bool startTest(BatteryModuleInfo *_bmInfo);
   bool stopTest(TestState testState);
-  static void restartTest(TimerHandle_t xTimer);
+  static void restartTest(void *arg);
   void loop();
   void printResult();
 
@@ -36,7 +36,7 @@ private:
   float cellVoltagesFinal[NUM_CELLS];
   float bmVoltageInitial;
   float bmVoltageFinal;
-  TimerHandle_t prechargeOffTimer;
+  OSPort::Timer prechargeOffTimer;
 
 };
 
@@ -6,10 +6,19 @@
 #define _ABC150CANHANDLER_HPP_
 
 #include "AmpleCAN.hpp"
-#include "freertos/FreeRTOS.h"
-#include "freertos/timers.h"
 #include "AmpleSerial.hpp"
+#include "OSPort.hpp"
+#include "ABC150Codec.hpp"
+#include "ABC150Units.hpp"
+#include "SeqLock.hpp"
+#include "CANAcceptanceFilter.hpp"
+#include "CANStats.hpp"
+#include "TelemetryWatchdog.hpp"
+#include "MPSCRing.hpp"
+#include <atomic>
 
+/* Receive path events waiting for the event task, power of two */
+#define ABC150_EVENTS               16
 
 class ABC150CANHandler: public AmpleCANListener {
 public:
@@ -53,20 +62,12 @@ public:
   enum EnableMode               {Enabled, Disabled};
   enum LoadMode                 {Independent, Parallel, Differential, Do_not_Change};
   enum RVSMode                  {RVS_off, RVS_on};
-private:
-  AmpleCAN &ampleCAN;
 
-  class ChannelInfo {
-  public:
+  /* Consistent view of the DATA_x and STATUS_x frames of one channel */
+  struct Telemetry {
     float voltage;
     float current;
     uint32_t timestamp;
-    float lowerVoltageLimit;
-    float lowerCurrentLimit;
-    float lowerPowerLimit;
-    float upperVoltageLimit;
-    float upperCurrentLimit;
-    float upperPowerLimit;
     float command;
     ConverterStatus converterStatus;
     ControlMode controlMode; //voltage, current, power, standby
@@ -77,16 +78,46 @@ private:
     bool connectorStatusNegative;
     bool connectorStatusPositive;
     bool connectorStatusInterlock;
+  };
+
+  /* Setpoints as sent to the ABC150, in wire units */
+  struct Setpoints {
+    ControlMode controlMode;
+    bool enable;
+    /* Scaled by the control mode */
+    int16_t command;
+    int16_t lowerVoltageLimit;
+    int16_t lowerCurrentLimit;
+    int16_t lowerPowerLimit;
+    int16_t upperVoltageLimit;
+    int16_t upperCurrentLimit;
+    int16_t upperPowerLimit;
+  };
+private:
+  AmpleCAN &ampleCAN;
+
+  class ChannelInfo {
+  public:
+    /* Only touched by the receive path, published through telemetry */
+    Telemetry received;
+    SeqLock<Telemetry> telemetry;
+    float lowerVoltageLimit;
+    float lowerCurrentLimit;
+    float lowerPowerLimit;
+    float upperVoltageLimit;
+    float upperCurrentLimit;
+    float upperPowerLimit;
     uint64_t stationID;
     bool stationIDSet;
     uint8_t counterStamp;
-    float lowerVoltageLimitOut;
-    float lowerCurrentLimitOut;
-    float lowerPowerLimitOut;
-    float upperVoltageLimitOut;
-    float upperCurrentLimitOut;
-    float upperPowerLimitOut;
-    float commandOut;
+    ABC150Units::Millivolts lowerVoltageLimitOut;
+    ABC150Units::Centiamps lowerCurrentLimitOut;
+    ABC150Units::Watts lowerPowerLimitOut;
+    ABC150Units::Millivolts upperVoltageLimitOut;
+    ABC150Units::Centiamps upperCurrentLimitOut;
+    ABC150Units::Watts upperPowerLimitOut;
+    /* mV, cA or W depending on controlModeOut */
+    int32_t commandOut;
     ControlMode controlModeOut; //voltage, current, power, standby
     LoadMode loadModeOut; // independent, parallel, differential, unselected
     bool enable;
@@ -95,6 +126,20 @@ private:
   };
   ChannelInfo channelInfo[2] = {};
 
+  typedef void (ABC150CANHandler::*MessageHandler)(Channel channel, CAN_frame_t &msg);
+  struct Route {
+    uint16_t id;
+    Channel channel;
+    MessageHandler handler;
+    const char *name;
+  };
+  /* Received message IDs, used for listener registration and dispatch */
+  static const Route routes[];
+  /* routes[] index + 1 per (MsgID - RECEIVE_ID_BASE), 0 if not handled */
+  uint8_t routeIndex[RECEIVE_ID_SPAN] = {};
+  /* Received message IDs as MCP2515 filters and as the software check */
+  CANAcceptanceFilter acceptance;
+
   //unsigned int versionNumber;
   uint32_t swVersion;
   uint16_t hardwareVersion;
@@ -105,18 +150,59 @@ private:
 
   bool abcDetected;
 
-  TaskHandle_t sendTaskHandle;
-  TickType_t xLastWakeTime;
-  TickType_t xFrequency;
+  OSPort::TaskHandle sendTaskHandle;
+  uint32_t xLastWakeTime;
+  /* Keep-alive period when no setpoint changes, ms */
+  uint32_t xFrequency;
+  /* Minimum time between two sends, ms */
+  uint32_t xMinSendInterval;
+  /* Frames written to the transmit buffers and time of the last write, by the send task and takeControl() */
+  OSPort::Mutex txMutex;
+  int txPending;
+  uint32_t txLastWrite;
+  /* PC greeting requested by the ABC150, sent by the send task */
+  std::atomic<bool> greetingPending;
+  /* Bus statistics, slots in routes[] order */
+  CANStats stats;
+  /* Age of the DATA and STATUS frames per channel */
+  TelemetryWatchdog watchdog;
+  /* Something the receive path reports, logged later by the event task */
+  struct Event {
+    uint32_t timeMs;
+    /* Message ID of the frame */
+    uint16_t id;
+    /* Converter status, hardware version, fault, problem or requested ID */
+    uint16_t code;
+    uint8_t channel;
+    /* Module ID of a fault, supplementary ID of a packet problem */
+    uint8_t detail;
+  };
+  MPSCRing<Event, ABC150_EVENTS> events;
+  uint32_t reportedEventDrops;
+  OSPort::TaskHandle eventTaskHandle;
+  /* Receive path only: no formatting, no allocation, never blocks */
+  void pushEvent(uint16_t id, Channel channel, uint16_t code, uint8_t detail = 0);
+  void logEvent(const Event &event);
   const char* TAG = "ABC150CANHandler";
 
 
   void setControlMode(Channel channel, ControlMode controlMode);
+  /* Wakes the send task so a changed setpoint goes out immediately */
+  void notifySend();
+  int16_t getCommandWire(Channel channel);
 
 public:
   ABC150CANHandler(AmpleCAN &_can);
   virtual ~ABC150CANHandler();
   void msgReceived(CAN_frame_t &msg);
+  /* Masks and filters for the MCP2515 that pass only the received message IDs */
+  const CANAcceptanceFilter::Registers &getAcceptanceFilter();
+  CANStats &getStats();
+  /* Prints the binary statistics record in hex */
+  void dumpStats();
+  TelemetryWatchdog &getWatchdog();
+  /* DATA and STATUS of a channel received and its timestamp advancing within the stale limit */
+  bool isFresh(Channel channel);
 
   /* Set send task frequency */
   void setFrequency(int timeDelta);
@@ -126,6 +212,10 @@ public:
   static void sendTaskWrapper(void *arg);
   void sendTask();
 
+  /* Event task, logs what the receive path reported */
+  static void eventTaskWrapper(void *arg);
+  void eventTask();
+
   bool channelCheck(Channel channel);
   /* Used to change control of channel to remote */
   bool setLowerVoltageLimit(Channel channel, float voltage);
@@ -139,6 +229,8 @@ public:
   bool setPower(Channel channel, float power);
   bool setLoadMode(Channel channel, LoadMode loadMode);
   std::string getPacketProblemString(uint8_t problem, uint8_t supp);
+  static const char *getPacketProblemName(uint8_t problem);
+  static const char *getSuppName(uint8_t supp);
   std::string getControlModeString(ControlMode controlMode);
   std::string getLoadModeString(LoadMode loadMode);
   void printInfo();
@@ -148,15 +240,20 @@ public:
   void handleUpperLimits(Channel channel, CAN_frame_t &msg);
   void handleStatus(Channel channel, CAN_frame_t &msg);
   void handleStationID(Channel channel, CAN_frame_t &msg);
-  void handleGreeting(CAN_frame_t &msg);
-  void handleFaultData(CAN_frame_t &msg);
-  void handlePacketProblem(CAN_frame_t &msg);
-  void handleRequestPC(CAN_frame_t &msg);
+  /* Bus-wide messages, channel is unused */
+  void handleGreeting(Channel channel, CAN_frame_t &msg);
+  void handleFaultData(Channel channel, CAN_frame_t &msg);
+  void handlePacketProblem(Channel channel, CAN_frame_t &msg);
+  void handleRequestPC(Channel channel, CAN_frame_t &msg);
 
+  void buildPCGreetingFrame(CAN_frame_t &msg);
   void sendPCGreeting();
-  void sendCommandPackage(Channel channel);
-  void sendLowerLimits(Channel channel);
-  void sendUpperLimits(Channel channel);
+  void buildCommandFrame(Channel channel, CAN_frame_t &msg);
+  void buildLowerLimitsFrame(Channel channel, CAN_frame_t &msg);
+  void buildUpperLimitsFrame(Channel channel, CAN_frame_t &msg);
+  /* Hands frames to the free transmit buffers in batches, in order */
+  void writeFrames(const CAN_frame_t *frames, int count);
+  void buildChangeControlFrame(Channel channel, CAN_frame_t &msg);
   void sendChangeControl(Channel channel);
   void sendRequestABCPackage();
   void sendPackage(Channel channel);
@@ -167,6 +264,7 @@ public:
   bool disable(Channel channel);
   bool isDetected();
 
+  Telemetry getTelemetry(Channel channel);
   float getVoltage(Channel channel);
   float getCurrent(Channel channel);
   uint32_t getTimeStamp(Channel channel);
@@ -174,6 +272,7 @@ public:
   LoadMode getLoadModeOut(Channel ch);
   ConverterStatus getConverterStatus(Channel ch);
   float getCommand(Channel ch);
+  Setpoints getSetpoints(Channel channel);
 
 };
 
@@ -0,0 +1,280 @@
+/*
+ * ABC150Codec.hpp
+ *
+ * CAN message IDs and signal layouts of the ABC150 protocol. Each message
+ * is described by a table of signals (byte offset, bit position, width,
+ * signedness and scale) and decoded/encoded by walking that table at compile
+ * time, so no handler has to hand-roll big-endian shifts. The handler uses
+ * the raw variants with the fixed-point units of ABC150Units.hpp, decode()
+ * and encode() scale through double for the host tools.
+ */
+
+#ifndef _ABC150CODEC_HPP_
+#define _ABC150CODEC_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define DATA_A                      0x100 // PPS → PC's
+#define DATA_B                      0x120 // PPS → PC's
+
+#define LOWER_LIMITS_A              0x101 // PPS → PC's
+#define UPPER_LIMITS_A              0x102 // PPS → PC's
+#define STATUS_A                    0x103  // PPS → PC's
+#define STATION_ID_A                0x104  // PPS → PC's
+
+#define LOWER_LIMITS_B              0x121  // PPS → PC's
+#define UPPER_LIMITS_B              0x122  // PPS → PC's
+#define STATUS_B                    0x123  // PPS → PC's
+#define STATION_ID_B                0x124  // PPS → PC's
+
+
+#define GREETING                    0x140  // PPS → xxx
+#define PC_GREETING                 0x1C0  // PC → PPS
+#define FAULT_DATA                  0x141  // PPS → PC's
+#define PACKET_PROBLEM              0x142  // PPS → PC's
+#define COMMAND_A                   0x180  // PC → PPS
+#define LOWER_LIMITS_A_OUT          0x181  // PC → PPS
+#define UPPER_LIMITS_A_OUT          0x182  // PC → PPS
+#define COMMAND_B                   0x1A0  // PC → PPS
+#define LOWER_LIMITS_B_OUT          0x1A1  // PC → PPS
+#define UPPER_LIMIT_B_OUT           0x1A2  // PC → PPS
+#define CHANGE_CONTROL              0x1C1  // PC → PPS
+#define RVS_MODE_REQUEST            0x1C2  // PC → PPS
+#define REQUEST_PC                  0x160  // xxx → PC's
+#define REQUEST_ABC                 0x1E0  // xxx → PPS
+
+/* Offset between the channel A and channel B message IDs */
+#define CHANNEL_ID_STRIDE           0x20
+
+/* Range of the IDs received from the ABC150, DATA_A .. REQUEST_PC */
+#define RECEIVE_ID_BASE             DATA_A
+#define RECEIVE_ID_SPAN             (REQUEST_PC - DATA_A + 1)
+
+#define VOLTAGE_SCALE               (0.02)
+#define CURRENT_SCALE               (0.02)
+#define POWER_SCALE                 (5)
+
+
+namespace ABC150Codec {
+
+struct Signal {
+  uint8_t offset;   // first payload byte of the field, MSB first
+  uint8_t shift;    // bit position of the field's LSB
+  uint8_t width;    // field width in bits
+  bool isSigned;
+  double scale;
+};
+
+template <size_t N>
+struct Message {
+  uint8_t dlc;
+  Signal signals[N];
+};
+
+inline uint8_t byteCount(const Signal &signal) {
+  return (signal.shift + signal.width + 7) / 8;
+}
+
+inline uint64_t fieldMask(const Signal &signal) {
+  return (signal.width < 64) ? ((1ULL << signal.width) - 1) : ~0ULL;
+}
+
+/* The 8 payload bytes as one word, byte 0 on top. The frame buffers are always 8 bytes long, so a
+ * shorter payload is read and written in full as well. */
+inline uint64_t loadPayload(const uint8_t *data) {
+  return ((uint64_t)data[0] << 56) | ((uint64_t)data[1] << 48) | ((uint64_t)data[2] << 40) |
+         ((uint64_t)data[3] << 32) | ((uint64_t)data[4] << 24) | ((uint64_t)data[5] << 16) |
+         ((uint64_t)data[6] << 8) | (uint64_t)data[7];
+}
+
+inline void storePayload(uint8_t *data, uint64_t word) {
+  data[0] = (uint8_t)(word >> 56);
+  data[1] = (uint8_t)(word >> 48);
+  data[2] = (uint8_t)(word >> 40);
+  data[3] = (uint8_t)(word >> 32);
+  data[4] = (uint8_t)(word >> 24);
+  data[5] = (uint8_t)(word >> 16);
+  data[6] = (uint8_t)(word >> 8);
+  data[7] = (uint8_t)word;
+}
+
+/* Bit position of the signal's LSB in the payload word */
+inline uint8_t wordShift(const Signal &signal) {
+  return 64 - 8 * (signal.offset + byteCount(signal)) + signal.shift;
+}
+
+/* Returns the unscaled, sign extended value of a signal */
+inline int64_t decodeRaw(const Signal &signal, uint64_t word) {
+  uint64_t value = (word >> wordShift(signal)) & fieldMask(signal);
+  if (signal.isSigned) {
+    uint64_t sign = 1ULL << (signal.width - 1);
+    value = (value ^ sign) - sign;
+  }
+  return (int64_t)value;
+}
+
+inline int64_t decodeRaw(const Signal &signal, const uint8_t *data) {
+  return decodeRaw(signal, loadPayload(data));
+}
+
+/* Writes the low bits of raw into the signal, leaving neighbouring bits untouched */
+inline void encodeRaw(const Signal &signal, uint8_t *data, int64_t raw) {
+  uint64_t mask = fieldMask(signal) << signal.shift;
+  uint64_t value = ((uint64_t)raw << signal.shift) & mask;
+  for (int i = byteCount(signal) - 1; i >= 0; i--) {
+    uint8_t &byte = data[signal.offset + i];
+    byte = (byte & ~(uint8_t)mask) | (uint8_t)value;
+    mask >>= 8;
+    value >>= 8;
+  }
+}
+
+/* Walks the signals of a message with the index as a template argument, so that the compiler
+ * folds the constexpr layouts below into plain shifts and masks instead of looping over the table. */
+template <size_t I, size_t N>
+struct Fields {
+  static inline void decode(const Message<N> &message, uint64_t word, double (&values)[N]) {
+    values[I] = ABC150Codec::decodeRaw(message.signals[I], word) * message.signals[I].scale;
+    Fields<I + 1, N>::decode(message, word, values);
+  }
+
+  static inline void decodeRaw(const Message<N> &message, uint64_t word, int64_t (&raws)[N]) {
+    raws[I] = ABC150Codec::decodeRaw(message.signals[I], word);
+    Fields<I + 1, N>::decodeRaw(message, word, raws);
+  }
+
+  static inline uint64_t encode(const Message<N> &message, const double (&values)[N]) {
+    return field(message.signals[I], (int64_t)(values[I] / message.signals[I].scale)) |
+           Fields<I + 1, N>::encode(message, values);
+  }
+
+  static inline uint64_t encodeRaw(const Message<N> &message, const int64_t (&raws)[N]) {
+    return field(message.signals[I], raws[I]) | Fields<I + 1, N>::encodeRaw(message, raws);
+  }
+
+  static inline uint64_t field(const Signal &signal, int64_t raw) {
+    return ((uint64_t)raw & fieldMask(signal)) << wordShift(signal);
+  }
+};
+
+template <size_t N>
+struct Fields<N, N> {
+  static inline void decode(const Message<N> &, uint64_t, double (&)[N]) {}
+  static inline void decodeRaw(const Message<N> &, uint64_t, int64_t (&)[N]) {}
+  static inline uint64_t encode(const Message<N> &, const double (&)[N]) { return 0; }
+  static inline uint64_t encodeRaw(const Message<N> &, const int64_t (&)[N]) { return 0; }
+};
+
+/* The payload is loaded once */
+template <size_t N>
+inline void decode(const Message<N> &message, const uint8_t *data, double (&values)[N]) {
+  Fields<0, N>::decode(message, loadPayload(data), values);
+}
+
+/* Clears the payload and encodes all signals. Values are truncated towards zero. */
+template <size_t N>
+inline void encode(const Message<N> &message, uint8_t *data, const double (&values)[N]) {
+  storePayload(data, Fields<0, N>::encode(message, values));
+}
+
+/* Unscaled values of all signals, no floating point */
+template <size_t N>
+inline void decodeRaw(const Message<N> &message, const uint8_t *data, int64_t (&raws)[N]) {
+  Fields<0, N>::decodeRaw(message, loadPayload(data), raws);
+}
+
+/* Clears the payload and encodes unscaled values, scales are ignored */
+template <size_t N>
+inline void encodeRaw(const Message<N> &message, uint8_t *data, const int64_t (&raws)[N]) {
+  storePayload(data, Fields<0, N>::encodeRaw(message, raws));
+}
+
+/* DATA_A / DATA_B */
+enum {DATA_VOLTAGE, DATA_CURRENT, DATA_TIMESTAMP, DATA_FIELDS};
+constexpr Message<DATA_FIELDS> DATA_LAYOUT = {8, {
+  {0, 0, 16, true,  VOLTAGE_SCALE},
+  {2, 0, 16, true,  CURRENT_SCALE},
+  {4, 0, 32, false, 1}}};
+
+/* LOWER_LIMITS_x / UPPER_LIMITS_x */
+enum {LIMITS_VOLTAGE, LIMITS_CURRENT, LIMITS_POWER, LIMITS_FIELDS};
+constexpr Message<LIMITS_FIELDS> LIMITS_LAYOUT = {6, {
+  {0, 0, 16, true, VOLTAGE_SCALE},
+  {2, 0, 16, true, CURRENT_SCALE},
+  {4, 0, 16, true, POWER_SCALE}}};
+
+/* STATUS_x, the command scale depends on the control mode */
+enum {STATUS_COMMAND, STATUS_CONVERTER, STATUS_CONTROL_MODE, STATUS_NORMAL_MODE,
+      STATUS_ENABLE_MODE, STATUS_LOAD_MODE, STATUS_RVS_MODE, STATUS_CONNECTOR_NEGATIVE,
+      STATUS_CONNECTOR_POSITIVE, STATUS_CONNECTOR_INTERLOCK, STATUS_FIELDS};
+constexpr Message<STATUS_FIELDS> STATUS_LAYOUT = {5, {
+  {0, 0, 16, true,  1},
+  {2, 0, 8,  false, 1},
+  {3, 0, 2,  false, 1},
+  {3, 2, 1,  false, 1},
+  {3, 3, 1,  false, 1},
+  {3, 4, 2,  false, 1},
+  {3, 6, 1,  false, 1},
+  {4, 0, 1,  false, 1},
+  {4, 1, 1,  false, 1},
+  {4, 2, 1,  false, 1}}};
+
+/* STATION_ID_x */
+enum {STATION_ID, STATION_ID_FIELDS};
+constexpr Message<STATION_ID_FIELDS> STATION_ID_LAYOUT = {5, {
+  {0, 0, 40, false, 1}}};
+
+/* GREETING */
+enum {GREETING_SW_VERSION, GREETING_HW_VERSION, GREETING_FIELDS};
+constexpr Message<GREETING_FIELDS> GREETING_LAYOUT = {5, {
+  {0, 0, 32, false, 1},
+  {4, 0, 8,  false, 1}}};
+
+/* FAULT_DATA */
+enum {FAULT_ID, FAULT_MODULE_ID, FAULT_FIELDS};
+constexpr Message<FAULT_FIELDS> FAULT_DATA_LAYOUT = {2, {
+  {0, 0, 8, false, 1},
+  {1, 0, 8, false, 1}}};
+
+/* PACKET_PROBLEM */
+enum {PROBLEM_ID, PROBLEM_SUPP_ID, PROBLEM_FIELDS};
+constexpr Message<PROBLEM_FIELDS> PACKET_PROBLEM_LAYOUT = {2, {
+  {0, 0, 8, false, 1},
+  {1, 0, 8, false, 1}}};
+
+/* REQUEST_PC / REQUEST_ABC */
+enum {REQUEST_CAN_ID, REQUEST_FIELDS};
+constexpr Message<REQUEST_FIELDS> REQUEST_LAYOUT = {2, {
+  {0, 0, 16, false, 1}}};
+
+/* COMMAND_x, the command is scaled by the caller according to the control mode */
+enum {COMMAND_COUNTER, COMMAND_VALUE, COMMAND_CONTROL_MODE, COMMAND_LOAD_MODE, COMMAND_FIELDS};
+constexpr Message<COMMAND_FIELDS> COMMAND_LAYOUT = {4, {
+  {0, 0, 8,  false, 1},
+  {1, 0, 16, true,  1},
+  {3, 0, 2,  false, 1},
+  {3, 4, 2,  false, 1}}};
+
+/* LOWER_LIMITS_x_OUT / UPPER_LIMITS_x_OUT */
+enum {LIMITS_OUT_COUNTER, LIMITS_OUT_VOLTAGE, LIMITS_OUT_CURRENT, LIMITS_OUT_POWER, LIMITS_OUT_FIELDS};
+constexpr Message<LIMITS_OUT_FIELDS> LIMITS_OUT_LAYOUT = {7, {
+  {0, 0, 8,  false, 1},
+  {1, 0, 16, true,  VOLTAGE_SCALE},
+  {3, 0, 16, true,  CURRENT_SCALE},
+  {5, 0, 16, true,  POWER_SCALE}}};
+
+/* CHANGE_CONTROL */
+enum {CHANGE_CONTROL_CHANNEL, CHANGE_CONTROL_FROM, CHANGE_CONTROL_TO, CHANGE_CONTROL_HW_ID,
+      CHANGE_CONTROL_STATION_ID, CHANGE_CONTROL_FIELDS};
+constexpr Message<CHANGE_CONTROL_FIELDS> CHANGE_CONTROL_LAYOUT = {8, {
+  {0, 0, 1,  false, 1},
+  {0, 1, 3,  false, 1},
+  {0, 4, 4,  false, 1},
+  {1, 0, 8,  false, 1},
+  {3, 0, 40, false, 1}}};
+
+}
+
+#endif /* _ABC150CODEC_HPP_ */
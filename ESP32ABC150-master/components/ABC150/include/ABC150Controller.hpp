@@ -18,6 +18,7 @@ public:
                    gpio_num_t _batteryControlPin = GPIO_NUM_26);
   ABC150CANHandler* getABC150CANHandler();
   PlateCANHandler* getPlateCANHandler();
+  MCP2515_CAN* getMCP2515CAN();
 
   void turn12vOn();
   void turn12vOff();
@@ -36,6 +37,8 @@ private:
   gpio_num_t batteryControlPin;
   bool bat12vEnabled;
 
+  const char* TAG = "ABC150Controller";
+
 };
 
 
@@ -7,6 +7,8 @@
 
 #include "BatteryModuleCollection.hpp"
 #include "esp_log.h"
+#include "OSPort.hpp"
+#include "TestScheduler.hpp"
 #include <queue>
 
 class ABC150Test {
@@ -20,11 +22,25 @@ public:
   const char* getTestName();
   virtual void loop() = 0;
   virtual void printResult() = 0;
+  /* loop() runs every period while the test is running or waiting to restart,
+   * and should finish within the deadline */
+  uint32_t getPeriodMs();
+  uint32_t getDeadlineMs();
+  /* Adds jobs of the test besides loop(), none by default */
+  virtual void schedule(TestScheduler &scheduler);
+  /* Timing statistics of the running or last run, nothing by default */
+  virtual void printStats();
   uint64_t getRunningTime();
   void setDestinationVoltage(float voltage);
   void setCycles(int cyclesNum);
   bool getCycleFlag();
   bool getCDFlag();
+  bool getProfileFlag();
+  /* Profiles the test can run, none by default */
+  virtual void listProfiles();
+  virtual bool setProfile(int profileNum);
+  /* Closed loop power correction, not supported by default */
+  virtual bool setPowerTracking(bool enable);
   void printAndSaveResult(std::stringstream &result);
   void printAllResults();
 
@@ -39,9 +55,12 @@ protected:
   int cycles = 1;
   bool cycleFlag = true;
   bool cDFlag = false;
+  bool profileFlag = false;
+  uint32_t periodMs = 100;
+  uint32_t deadlineMs = 100;
   std::queue<std::string> resultQueue;
-  SemaphoreHandle_t startMutex = xSemaphoreCreateMutex();
-  SemaphoreHandle_t stopMutex = xSemaphoreCreateMutex();
+  OSPort::Mutex startMutex = OSPort::createMutex();
+  OSPort::Mutex stopMutex = OSPort::createMutex();
 
 };
 
@@ -10,7 +10,11 @@
 #include "BatteryModuleCollection.hpp"
 #include "SingleChannelTest.hpp"
 #include "DualChannelTest.hpp"
-#include "freertos/timers.h"
+#include "OSPort.hpp"
+#include "TestScheduler.hpp"
+#include "AsyncConsole.hpp"
+#include "TelemetryStream.hpp"
+#include "CommandServer.hpp"
 #include "assert.h"
 
 class ABC150TestManager {
@@ -20,7 +24,7 @@ public:
   enum class TestType {Single, Dual};
 
   ABC150TestManager(ABC150Controller &_abc150Controller);
-  static void debugLog(TimerHandle_t xTimer);
+  static void debugLog(void *arg);
   void debugToggle();
   virtual void addSingleChannelTest(SingleChannelTest *singleTest);
   virtual void addDualChannelTest(DualChannelTest *dualTest);
@@ -28,9 +32,11 @@ public:
   bool testCheck(TestType type, int test);
   bool checkCycleFlag(TestType type, int test);
   bool checkCDFlag(TestType type, int test);
+  bool checkProfileFlag(TestType type, int test);
   void listAllTests();
   uint64_t getRunningTime(TestType type, int test);
   void listTestsByType(TestType type);
+  void printStats();
   bool runSingleTest(int test, int cycles = 1);
   bool runDualTest(int test, int cycles = 1);
   bool stopSingleTest(int test);
@@ -38,11 +44,25 @@ public:
   void stopAll();
   void stopAllOverride();
   bool setDestinationVoltage(TestType type, int test, float voltage);
+  void listProfiles(TestType type, int test);
+  bool setProfile(TestType type, int test, int profile);
+  /* False if the test has no power tracking */
+  bool setPowerTracking(TestType type, int test, bool enable);
   void printInfo();
   void setBMAmpleID(int ch, unsigned int ID);
-  /* Loop task */
-  static void loopTaskWrapper(void *arg);
-  void loopTask();
+  TestScheduler &getScheduler();
+  /* Add sinks before setting a rate */
+  TelemetryStream &getTelemetry();
+  /* Telemetry sources, arg is the test manager */
+  static void telemetrySample(void *arg, TelemetrySample &sample);
+  static void telemetryStatus(void *arg, TelemetryStatus &status);
+  /* Start it with the link to serve, see CommandProtocol.hpp */
+  CommandServer &getCommandServer();
+  /* CommandServer handler, arg is the test manager */
+  static CommandProtocol::Result handleCommand(void *arg, CommandProtocol::Message &request,
+                                               CommandProtocol::Message &response);
+  /* loop() of a test, scheduled while it runs or waits to restart */
+  static bool testJob(void *arg);
   vector<SingleChannelTest*> singleTestVec;
   vector<DualChannelTest*> dualTestVec;
 
@@ -53,9 +73,19 @@ private:
   BatteryModuleCollection &collection;
   unsigned int bmAmpleID[2];
   bool debugLogEnable;
-  TaskHandle_t loopTaskHandle;
-  TickType_t xLastWakeTime;
+  TestScheduler scheduler;
+  /* Scheduler job of each test's loop(), same order as the test vectors */
+  vector<int> singleJobs;
+  vector<int> dualJobs;
+  TelemetryStream telemetry;
+  CommandServer commands;
   const char* TAG = "ABC150TestManager";
+
+  CommandProtocol::Result runCommand(CommandProtocol::Message &request, CommandProtocol::Message &response);
+  CommandProtocol::Result listTestsCommand(CommandProtocol::Message &response);
+  CommandProtocol::Result startTestCommand(CommandProtocol::Message &request);
+  CommandProtocol::Result setSetpointCommand(ABC150CANHandler::Channel channel, uint8_t setpoint, int32_t value);
+  CommandProtocol::Result setControlCommand(ABC150CANHandler::Channel channel, uint8_t control);
 };
 
 class ABC150TestUserInterface {
@@ -0,0 +1,93 @@
+/*
+ * ABC150Units.hpp
+ *
+ * Fixed-point units of the ABC150 protocol: voltages in millivolts, currents
+ * in centiamps and powers in watts. Scaling between these and the 16 bit wire
+ * fields (0.02 V, 0.02 A and 5 W per LSB) is integer only, the ESP32 has no
+ * double precision FPU. Setpoints are converted from float once when they are
+ * set, truncated towards zero from the exact float value; towards the wire
+ * they are truncated again. This gives the wire value (int16_t)(x / 0.02) of
+ * the double path for every float, e.g. 0.06f, just below 0.06, goes out as
+ * 2. Out of the int16 range they saturate instead of wrapping around at
+ * +-655 V / A. Telemetry read back from the wire converts with rounding.
+ */
+
+#ifndef _ABC150UNITS_HPP_
+#define _ABC150UNITS_HPP_
+
+#include <stdint.h>
+#include <math.h>
+
+/* Units per wire LSB */
+#define VOLTAGE_LSB_MV              20
+#define CURRENT_LSB_CA              2
+#define POWER_LSB_W                 5
+
+/* Largest magnitude a float setpoint converts to, far beyond the wire range */
+#define UNITS_FLOAT_LIMIT           1.0e9f
+
+namespace ABC150Units {
+
+typedef int32_t Millivolts;
+typedef int32_t Centiamps;
+typedef int32_t Watts;
+
+inline int16_t saturate16(int32_t value) {
+  if (value > INT16_MAX) return INT16_MAX;
+  if (value < INT16_MIN) return INT16_MIN;
+  return (int16_t)value;
+}
+
+/* Rounds to the nearest unit, NaN converts to 0 */
+inline int32_t fromFloat(float value, float unitsPerOne) {
+  float units = value * unitsPerOne;
+  if (units > UNITS_FLOAT_LIMIT) return (int32_t)UNITS_FLOAT_LIMIT;
+  if (units < -UNITS_FLOAT_LIMIT) return -(int32_t)UNITS_FLOAT_LIMIT;
+  if (units != units) return 0;
+  return (int32_t)lroundf(units);
+}
+
+/* Truncates the exact product towards zero, NaN converts to 0. A float is a 24 bit integer times a power of
+ * two, so this needs no double. */
+inline int32_t truncateFloat(float value, int32_t unitsPerOne) {
+  float units = value * unitsPerOne;
+  if (units > UNITS_FLOAT_LIMIT) return (int32_t)UNITS_FLOAT_LIMIT;
+  if (units < -UNITS_FLOAT_LIMIT) return -(int32_t)UNITS_FLOAT_LIMIT;
+  if (units != units) return 0;
+  int exponent;
+  int64_t product = (int64_t)ldexpf(frexpf(fabsf(value), &exponent), 24) * unitsPerOne;
+  int shift = 24 - exponent;
+  if (shift <= 0) {
+    product <<= -shift;
+  } else {
+    product = (shift < 63) ? (product >> shift) : 0;
+  }
+  return (value < 0) ? -(int32_t)product : (int32_t)product;
+}
+
+/* Setpoints */
+inline Millivolts fromVolts(float volts)        { return truncateFloat(volts, 1000); }
+inline Centiamps fromAmps(float amps)           { return truncateFloat(amps, 100); }
+inline Watts fromWatts(float watts)             { return truncateFloat(watts, 1); }
+
+/* Telemetry, to the nearest unit */
+inline Millivolts roundVolts(float volts)       { return fromFloat(volts, 1000.0f); }
+inline Centiamps roundAmps(float amps)          { return fromFloat(amps, 100.0f); }
+
+/* Divisions keep the result the float nearest to the exact value */
+inline float toVolts(Millivolts mv)             { return mv / 1000.0f; }
+inline float toAmps(Centiamps ca)               { return ca / 100.0f; }
+inline float toWatts(Watts w)                   { return (float)w; }
+
+/* Truncated towards zero and saturated to the wire range */
+inline int16_t voltageToWire(Millivolts mv)     { return saturate16(mv / VOLTAGE_LSB_MV); }
+inline int16_t currentToWire(Centiamps ca)      { return saturate16(ca / CURRENT_LSB_CA); }
+inline int16_t powerToWire(Watts w)             { return saturate16(w / POWER_LSB_W); }
+
+inline Millivolts voltageFromWire(int16_t raw)  { return (Millivolts)raw * VOLTAGE_LSB_MV; }
+inline Centiamps currentFromWire(int16_t raw)   { return (Centiamps)raw * CURRENT_LSB_CA; }
+inline Watts powerFromWire(int16_t raw)         { return (Watts)raw * POWER_LSB_W; }
+
+}
+
+#endif /* _ABC150UNITS_HPP_ */
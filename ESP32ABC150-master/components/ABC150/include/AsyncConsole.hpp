@@ -0,0 +1,113 @@
+/*
+ * AsyncConsole.hpp
+ *
+ * Console output that never blocks the caller. print() stores the format
+ * pointer and the arguments as a binary record in a lock-free ring that any
+ * number of tasks may write to; a low priority task formats the records and
+ * writes them to the UART. When the ring is full the record is dropped and
+ * counted, the console task reports the drops in the output.
+ */
+
+#ifndef _ASYNCCONSOLE_HPP_
+#define _ASYNCCONSOLE_HPP_
+
+#include "OSPort.hpp"
+#include "MPSCRing.hpp"
+#include <stddef.h>
+#include <stdint.h>
+
+/* Power of two */
+#define CONSOLE_RECORDS             32
+#define CONSOLE_MAX_ARGS            10
+#define CONSOLE_LINE_SIZE           256
+
+class AsyncConsole {
+public:
+  /* Writes formatted output, may block */
+  typedef void (*Writer)(const char *text, size_t length);
+
+  /* The console all tests print through */
+  static AsyncConsole &console();
+
+  AsyncConsole();
+  virtual ~AsyncConsole();
+  /* Creates the console task */
+  bool start();
+  void setWriter(Writer writer);
+
+  /*
+   * Queues a printf style record. The format and %s arguments are formatted
+   * later and must stay valid, use string literals. Supports flags, width and
+   * precision but not '*'. Returns false and counts a drop when the ring is
+   * full.
+   */
+  template <typename... Args>
+  bool print(const char *format, Args... args) {
+    static_assert(sizeof...(Args) <= CONSOLE_MAX_ARGS, "Too many console arguments");
+    uint32_t position;
+    Record *record = records.claim(&position);
+    if (record == NULL) {
+      return false;
+    }
+    record->format = format;
+    record->count = 0;
+    put(*record, args...);
+    records.publish(position);
+    return true;
+  }
+
+  /* Formats and writes the queued records. One consumer only: the console task once started. */
+  uint32_t drain();
+
+  uint32_t getQueued();
+  uint32_t getWritten();
+  uint32_t getDropped();
+  void printStats();
+
+private:
+  enum ArgType : uint8_t        {Signed, Unsigned, Double, String};
+  union ArgValue {
+    long long i;
+    unsigned long long u;
+    double d;
+    const char *s;
+  };
+  struct Record {
+    const char *format;
+    uint8_t count;
+    ArgType types[CONSOLE_MAX_ARGS];
+    ArgValue values[CONSOLE_MAX_ARGS];
+  };
+
+  MPSCRing<Record, CONSOLE_RECORDS> records;
+  uint32_t reportedDrops;
+  Writer writer;
+  char line[CONSOLE_LINE_SIZE];
+  OSPort::TaskHandle taskHandle;
+  const char* TAG = "AsyncConsole";
+
+  size_t format(const Record &record, char *out, size_t size);
+  static void writeStdout(const char *text, size_t length);
+  static void consoleTaskWrapper(void *arg);
+  void consoleTask();
+
+  void put(Record &) {}
+  template <typename T, typename... Rest>
+  void put(Record &record, T value, Rest... rest) {
+    set(record.types[record.count], record.values[record.count], value);
+    record.count++;
+    put(record, rest...);
+  }
+
+  /* float, char, short and enums promote to these */
+  static void set(ArgType &type, ArgValue &arg, int value)                { type = Signed; arg.i = value; }
+  static void set(ArgType &type, ArgValue &arg, long value)               { type = Signed; arg.i = value; }
+  static void set(ArgType &type, ArgValue &arg, long long value)          { type = Signed; arg.i = value; }
+  static void set(ArgType &type, ArgValue &arg, unsigned value)           { type = Unsigned; arg.u = value; }
+  static void set(ArgType &type, ArgValue &arg, unsigned long value)      { type = Unsigned; arg.u = value; }
+  static void set(ArgType &type, ArgValue &arg, unsigned long long value) { type = Unsigned; arg.u = value; }
+  static void set(ArgType &type, ArgValue &arg, double value)             { type = Double; arg.d = value; }
+  static void set(ArgType &type, ArgValue &arg, const char *value)        { type = String; arg.s = value; }
+};
+
+#endif /* _ASYNCCONSOLE_HPP_ */
@@ -0,0 +1,69 @@
+/*
+ * CANAcceptanceFilter.hpp
+ *
+ * Acceptance filtering of standard CAN IDs. compile() turns the added IDs
+ * into the MCP2515 masks and filters (RXM0 with RXF0-1 for RXB0, RXM1 with
+ * RXF2-5 for RXB1) that let through all of them and as few others as
+ * possible. accepts() is the software fallback, a single bitmap test for
+ * frames that get past the hardware or when it is not programmed.
+ */
+
+#ifndef _CANACCEPTANCEFILTER_HPP_
+#define _CANACCEPTANCEFILTER_HPP_
+
+#include <stdint.h>
+
+#define CAN_STD_ID_COUNT            2048
+#define CAN_FILTER_MASKS            2
+#define CAN_FILTERS                 6
+#define CAN_ACCEPTANCE_MAX_IDS      32
+
+class CANAcceptanceFilter {
+public:
+  struct Registers {
+    uint16_t mask[CAN_FILTER_MASKS];
+    uint16_t filter[CAN_FILTERS];
+  };
+
+  CANAcceptanceFilter();
+  bool add(uint16_t id);
+  /* Chooses the registers, false if the IDs can not be covered */
+  bool compile();
+  const Registers &getRegisters();
+  /* Standard IDs the registers let through */
+  uint32_t getHardwareAcceptedCount();
+  bool hardwareAccepts(uint16_t id);
+  void print();
+
+  bool accepts(uint32_t id) {
+    return id < CAN_STD_ID_COUNT && (bitmap[id >> 5] & (1u << (id & 31))) != 0;
+  }
+
+  /* Register bytes of an ID, mask or filter: SIDH and SIDL (EXIDE clear) */
+  static uint8_t sidh(uint16_t id) {
+    return id >> 3;
+  }
+  static uint8_t sidl(uint16_t id) {
+    return (id & 0x07) << 5;
+  }
+
+private:
+  /* Buffer with a mask and the filter values it compares with */
+  struct Buffer {
+    uint16_t mask;
+    uint16_t values[CAN_FILTERS];
+    int count;
+    uint32_t accepted;
+  };
+
+  uint32_t bitmap[CAN_STD_ID_COUNT / 32];
+  uint16_t ids[CAN_ACCEPTANCE_MAX_IDS];
+  int idCount;
+  Registers registers;
+  const char* TAG = "CANAcceptanceFilter";
+
+  bool cover(uint32_t members, uint16_t mask, int filters, Buffer *buffer);
+  bool bestCover(uint32_t members, uint16_t fixed, uint16_t varying, int filters, Buffer *buffer);
+};
+
+#endif /* _CANACCEPTANCEFILTER_HPP_ */
@@ -0,0 +1,105 @@
+/*
+ * CANStats.hpp
+ *
+ * Receive and transmit statistics of a CAN bus: frames, inter-arrival
+ * histogram and age of the last frame per ID, bus load and transmit queue
+ * depth. Every counter is a relaxed 32 bit atomic that readers can look at
+ * any time without a lock. The receive path is the only writer of the receive
+ * counters, which are updated with a plain load and store; frames can be sent
+ * from several tasks, so the transmit counters are added atomically.
+ *
+ * The receive path passes the arrival time in, the 1 ms scheduler tick it
+ * already has or reads once per frame, so the statistics never read a clock
+ * themselves. Arrival times are 32 bit ticks: intervals and ages are their
+ * unsigned differences and stay exact for 49 days, the inter-arrival buckets
+ * have 1 ms resolution. The time since reset() is 64 bit ms.
+ *
+ * Binary record (little endian), see serialize():
+ *   magic u32, version u16, IDs u8, buckets u8, time since reset ms u32,
+ *   bit rate u32, received bits u32, other frames u32, sent frames u32,
+ *   sent bits u32, writes by transmit buffers in use u32[CAN_STATS_MAX_DEPTH]
+ *   per ID: id u16, frames u32, age ms u32, inter-arrival buckets u32[CAN_STATS_BUCKETS]
+ */
+
+#ifndef _CANSTATS_HPP_
+#define _CANSTATS_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+#define CAN_STATS_MAGIC             0x31545343  // "CST1"
+#define CAN_STATS_VERSION           1
+#define CAN_STATS_MAX_IDS           16
+#define CAN_STATS_BUCKETS           10
+/* Transmit buffers in use after a write, 1 to CAN_STATS_MAX_DEPTH */
+#define CAN_STATS_MAX_DEPTH         3
+#define CAN_STATS_HEADER_SIZE       (32 + 4 * CAN_STATS_MAX_DEPTH)
+#define CAN_STATS_SLOT_SIZE         (10 + 4 * CAN_STATS_BUCKETS)
+#define CAN_STATS_RECORD_SIZE       (CAN_STATS_HEADER_SIZE + CAN_STATS_MAX_IDS * CAN_STATS_SLOT_SIZE)
+
+class CANStats {
+public:
+  CANStats(uint32_t _bitRate);
+  /* Slot for received frames of id, -1 if all are taken */
+  int addID(uint16_t id, const char *name);
+  void reset();
+
+  /* Receive statistics are on by default, switching them off is only meant for measuring their cost */
+  void setEnabled(bool enable);
+  bool isEnabled();
+
+  /* Frame of a slot at OSPort::getTickMs() nowMs, or with slot -1 a frame that is not ours */
+  void received(int slot, uint8_t dlc, uint32_t nowMs);
+  void transmitted(uint8_t dlc);
+  /* Transmit buffers in use after a write */
+  void queued(int depth);
+
+  uint32_t getFrames(int slot);
+  /* Frames received with slot -1 */
+  uint32_t getOtherFrames();
+  /* Time since the last frame of a slot, UINT32_MAX before the first */
+  uint32_t getAgeMs(int slot);
+  /* Share of the bit rate used by the frames this node saw since reset() */
+  float getBusLoad();
+
+  void print();
+  /* Writes the binary record, returns its size or 0 if it does not fit */
+  size_t serialize(uint8_t *out, size_t size);
+
+private:
+  struct Slot {
+    uint16_t id;
+    const char *name;
+    std::atomic<uint32_t> frames;
+    /* Tick of the last frame */
+    std::atomic<uint32_t> lastMs;
+    std::atomic<uint32_t> buckets[CAN_STATS_BUCKETS];
+  };
+
+  /* Upper bound of each inter-arrival bucket in ms, the last one is open ended */
+  static const uint32_t bucketLimitsMs[CAN_STATS_BUCKETS];
+  uint32_t bitRate;
+  Slot slots[CAN_STATS_MAX_IDS];
+  int slotCount;
+  std::atomic<uint32_t> otherFrames;
+  std::atomic<uint32_t> rxBits;
+  std::atomic<uint32_t> txFrames;
+  std::atomic<uint32_t> txBits;
+  std::atomic<uint32_t> depths[CAN_STATS_MAX_DEPTH];
+  std::atomic<bool> enabled;
+  /* OSPort::getTimeMs() of reset(), only written by it */
+  int64_t startMs;
+
+  uint32_t getElapsedMs();
+
+  static void increment(std::atomic<uint32_t> &counter, uint32_t value = 1) {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+  }
+  /* Frame length without stuff bits */
+  static uint32_t frameBits(uint8_t dlc) {
+    return 47 + 8 * ((dlc > 8) ? 8 : dlc);
+  }
+};
+
+#endif /* _CANSTATS_HPP_ */
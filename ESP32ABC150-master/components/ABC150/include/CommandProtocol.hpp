@@ -0,0 +1,97 @@
+/*
+ * CommandProtocol.hpp
+ *
+ * Binary request/response protocol for scripting the test manager, shared by
+ * CommandServer and the host client. Frames use the CRC, COBS and zero
+ * delimiters of TelemetryFrame (pack()/unpack()). Before COBS (little endian):
+ *   request:  type u8 (Request), sequence u16, command u8, arguments, crc32 u32
+ *   response: type u8 (Response), sequence u16, command u8, result u8, payload, crc32 u32
+ * Every request is answered with the sequence and command it carried, which is
+ * the acknowledgement. A client that gets no answer sends the same request
+ * with the same sequence again; the server answers a repeat of the request it
+ * answered last from its copy of the response instead of running it twice.
+ * A client numbers its requests from a random start so it does not repeat the
+ * last sequence of a previous client.
+ *
+ * Arguments and payloads, values are in the units of ABC150Units.hpp
+ * (mV, cA, W):
+ *   Ping              -                               -> uptime ms u32
+ *   GetStatus         -                               -> time ms u32, TelemetryFrame status payload
+ *   ListTests         -                               -> tests u8, per test: test type u8, index u8,
+ *                                                        channel u8 (0xFF dual), state u8, flags u8,
+ *                                                        name length u8, name
+ *   StartTest         test type u8, index u8, cycles u16, voltage mV i32, profile u8  -> -
+ *                     (voltage and profile are used by tests flagged HasVoltage and HasProfile)
+ *   StopTest          test type u8, index u8          -> -
+ *   StopAll           override u8 (HV off and release both channels)  -> -
+ *   SetSetpoint       channel u8, setpoint u8, value i32 (LoadMode: the mode)  -> -
+ *   SetControl        channel u8, control u8          -> -
+ *   SetBMID           channel u8, Ample ID u32        -> -
+ *   SetTelemetryRate  rate Hz u8                      -> -
+ *   SetPowerTracking  test type u8, index u8, enable u8  -> - (Rejected if the test has none)
+ */
+
+#ifndef _COMMANDPROTOCOL_HPP_
+#define _COMMANDPROTOCOL_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define COMMAND_MAX_PAYLOAD         480
+/* Type, sequence, command, result */
+#define COMMAND_HEADER              5
+#define COMMAND_MAX_LENGTH          (COMMAND_HEADER + COMMAND_MAX_PAYLOAD + 4)
+/* COBS adds a byte per 254 and the frame is sent between two delimiters */
+#define COMMAND_MAX_FRAME           (COMMAND_MAX_LENGTH + COMMAND_MAX_LENGTH / 254 + 3)
+#define COMMAND_NO_CHANNEL          0xFF
+
+class CommandProtocol {
+public:
+  /* Frame types, after those of TelemetryFrame */
+  enum Type : uint8_t           {Request = 0x10, Response = 0x11};
+  enum Command : uint8_t        {Ping = 1, GetStatus, ListTests, StartTest, StopTest, StopAll, SetSetpoint,
+                                 SetControl, SetBMID, SetTelemetryRate, SetPowerTracking};
+  enum Result : uint8_t         {Ok, UnknownCommand, BadLength, InvalidArgument, Rejected};
+  enum TestType : uint8_t       {Single, Dual};
+  /* ListTests flags, what StartTest takes besides cycles */
+  enum TestFlags : uint8_t      {HasCycles = 1, HasVoltage = 2, HasProfile = 4};
+  enum Setpoint : uint8_t       {LowerVoltageLimit, LowerCurrentLimit, LowerPowerLimit, UpperVoltageLimit,
+                                 UpperCurrentLimit, UpperPowerLimit, Voltage, Current, Power, LoadMode};
+  enum Control : uint8_t        {Enable, Disable, TakeControl, ReleaseControl};
+
+  /* A request or response. put*() append to the payload, get*() read it from the front. */
+  struct Message {
+    Type type;
+    uint16_t sequence;
+    uint8_t command;
+    uint8_t result;
+    uint16_t length;
+    uint16_t position;
+    uint8_t payload[COMMAND_MAX_PAYLOAD];
+
+    void clear();
+    /* False once the payload is full, the message is then incomplete */
+    bool put8(uint8_t value);
+    bool put16(uint16_t value);
+    bool put32(uint32_t value);
+    bool putString(const char *string);
+    /* False past the end of the payload */
+    bool get8(uint8_t *value);
+    bool get16(uint16_t *value);
+    bool get32(uint32_t *value);
+    /* Copies up to size - 1 characters and terminates */
+    bool getString(char *string, size_t size);
+    /* Whether all of the payload was read */
+    bool atEnd();
+  };
+
+  /* Delimited frame of message, returns the length written, 0 if it does not fit */
+  static size_t encode(const Message &message, uint8_t *out, size_t size);
+  /* Decodes the bytes between two delimiters, false if corrupt or not a command frame */
+  static bool decode(const uint8_t *in, size_t length, Message *message);
+
+  static const char *getCommandName(uint8_t command);
+  static const char *getResultName(uint8_t result);
+};
+
+#endif /* _COMMANDPROTOCOL_HPP_ */
@@ -0,0 +1,72 @@
+/*
+ * CommandServer.hpp
+ *
+ * Answers CommandProtocol requests on a byte link of its own, next to the
+ * interactive menus on the console. A task reads the link, collects frames
+ * between delimiters and runs each request through the handler, which fills
+ * in the response payload and returns the result. A repeat of the request
+ * answered last (same sequence and command) is answered again from the kept
+ * response, so a retry after a lost response does not run the command twice.
+ */
+
+#ifndef _COMMANDSERVER_HPP_
+#define _COMMANDSERVER_HPP_
+
+#include "CommandProtocol.hpp"
+#include "OSPort.hpp"
+#include <stddef.h>
+#include <stdint.h>
+
+class CommandServer {
+public:
+  /* Runs request, whose payload is unread, and returns the result. response is cleared. */
+  typedef CommandProtocol::Result (*Handler)(void *arg, CommandProtocol::Message &request,
+                                             CommandProtocol::Message &response);
+  /* Reads up to size bytes, waits a short time at most. Returns the bytes read, < 0 if the link failed. */
+  typedef int (*Reader)(uint8_t *data, size_t size, void *arg);
+  /* Writes one frame, may block */
+  typedef void (*Writer)(const uint8_t *data, size_t length, void *arg);
+
+  CommandServer(Handler _handler, void *_handlerArg);
+  virtual ~CommandServer();
+  /* Creates the task serving the link */
+  bool start(Reader _reader, Writer _writer, void *_linkArg);
+  /* Takes received bytes and answers the complete requests among them */
+  void receive(const uint8_t *data, size_t length);
+
+  uint32_t getRequests();
+  uint32_t getRepeats();
+  uint32_t getCorrupt();
+  void printStats();
+
+  static void taskWrapper(void *arg);
+  void task();
+
+private:
+  Handler handler;
+  void *handlerArg;
+  Reader reader;
+  Writer writer;
+  void *linkArg;
+  /* Frame being received, without delimiters */
+  uint8_t frame[COMMAND_MAX_FRAME];
+  size_t frameLength;
+  bool overflow;
+  /* Last response, sent again for a repeated request */
+  bool answered;
+  uint16_t lastSequence;
+  uint8_t lastCommand;
+  uint8_t response[COMMAND_MAX_FRAME];
+  size_t responseLength;
+  CommandProtocol::Message request;
+  CommandProtocol::Message reply;
+  uint32_t requests;
+  uint32_t repeats;
+  uint32_t corrupt;
+  OSPort::TaskHandle taskHandle;
+  const char* TAG = "CommandServer";
+
+  void handleFrame();
+};
+
+#endif /* _COMMANDSERVER_HPP_ */
@@ -0,0 +1,79 @@
+/*
+ * DriveCycleCatalog.hpp
+ *
+ * Index of the drive cycle images in the "drivecycle" partition, written by
+ * tools/DriveCycleCatalogBuilder. The partition is mapped once at boot and
+ * images are opened in place, so switching profiles or restarting a cycle
+ * does not touch the flash mapping.
+ *
+ * Layout (little endian):
+ *   Header
+ *   Entry[count]
+ *   images at the offsets of their entries, 4 byte aligned
+ *
+ * A partition holding a single image, as flashed before the catalog, reads
+ * as a catalog with one entry named "default" and no CRC.
+ */
+
+#ifndef _DRIVECYCLECATALOG_HPP_
+#define _DRIVECYCLECATALOG_HPP_
+
+#include <stdint.h>
+#include "DriveCycleImage.hpp"
+
+#define DRIVECYCLE_CATALOG_MAGIC    0x4C594344  // "DCYL"
+#define DRIVECYCLE_CATALOG_VERSION  1
+#define DRIVECYCLE_NAME_LENGTH      24
+#define DRIVECYCLE_CATALOG_MAX_ENTRIES 64
+
+class DriveCycleCatalog {
+public:
+  struct Header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;
+  };
+
+  struct Entry {
+    char name[DRIVECYCLE_NAME_LENGTH];  // NUL terminated
+    uint32_t offset;        // from the start of the catalog
+    uint32_t size;
+    uint32_t crc;           // crc32() of the image
+  };
+
+  DriveCycleCatalog();
+  ~DriveCycleCatalog();
+
+  /* Maps the partition (target) or file (host) with the given name and checks the index */
+  bool map(const char *name);
+  void unmap();
+  bool isMapped();
+
+  uint32_t getCount();
+  const char *getName(uint32_t index);
+  /* Index of the named image, -1 if there is none */
+  int find(const char *name);
+  /* Compares the CRC of an image with its entry */
+  bool verify(uint32_t index);
+  /* Opens an image in place, valid until unmap() */
+  bool open(uint32_t index, DriveCycleImage &image);
+  void list();
+
+  /* CRC-32 (IEEE), continues from crc */
+  static uint32_t crc32(const uint8_t *data, uint32_t size, uint32_t crc = 0);
+
+private:
+  const uint8_t *data;
+  /* Backend specific mapping handle and size */
+  uint32_t mapHandle;
+  uint32_t mapSize;
+  const Entry *entries;
+  uint32_t count;
+  /* Entry of a partition holding a single image */
+  Entry single;
+  const char* TAG = "DriveCycleCatalog";
+
+  bool checkIndex();
+};
+
+#endif /* _DRIVECYCLECATALOG_HPP_ */
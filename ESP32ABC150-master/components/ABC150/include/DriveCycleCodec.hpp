@@ -0,0 +1,68 @@
+/*
+ * DriveCycleCodec.hpp
+ *
+ * Compressed sample encoding of drive cycle images. Each sample is coded as
+ * the difference to the previous one, zigzag mapped to an unsigned value and
+ * Rice coded: the value >> k in unary (ones ended by a zero), then the low k
+ * bits. k follows the running mean of the coded values. A quotient of
+ * RICE_ESCAPE_QUOTIENT ones is followed by the value in RICE_RAW_BITS bits
+ * instead. Bits are packed MSB first.
+ *
+ * Decoding is sequential and needs only the few words of DriveCycleDecoder,
+ * whatever the length of the cycle. The encoder is host only, see
+ * tools/host/include/DriveCycleEncoder.hpp.
+ */
+
+#ifndef _DRIVECYCLECODEC_HPP_
+#define _DRIVECYCLECODEC_HPP_
+
+#include <stdint.h>
+
+#define RICE_ESCAPE_QUOTIENT        16
+/* Zigzag of a difference of two int16 samples */
+#define RICE_RAW_BITS               17
+#define RICE_MAX_PARAMETER          15
+/* Samples the running mean covers, before it is halved */
+#define RICE_ADAPT_WINDOW           32
+
+/* Adaptive Rice parameter, shared by encoder and decoder */
+class RiceState {
+public:
+  RiceState();
+  int parameter();
+  void update(uint32_t value);
+  /* Differences as coded values and back */
+  static uint32_t zigzag(int32_t value);
+  static int32_t unzigzag(uint32_t value);
+
+private:
+  uint32_t sum;
+  uint32_t count;
+};
+
+class DriveCycleDecoder {
+public:
+  DriveCycleDecoder();
+  void begin(const uint8_t *_data, uint32_t _size);
+  /* Returns false if the data ends or is corrupt before count samples */
+  bool decode(int16_t *out, uint32_t count);
+  /* Samples decoded since begin() */
+  uint32_t getPosition();
+
+private:
+  const uint8_t *data;
+  uint32_t size;
+  uint32_t byteIndex;
+  RiceState rice;
+  int32_t previous;
+  /* bitCount valid bits, left aligned */
+  uint32_t bits;
+  int bitCount;
+  uint32_t position;
+
+  void refill();
+  void consume(int count);
+  bool readBits(int count, uint32_t *value);
+};
+
+#endif /* _DRIVECYCLECODEC_HPP_ */
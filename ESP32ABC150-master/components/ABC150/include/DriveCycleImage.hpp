@@ -0,0 +1,68 @@
+/*
+ * DriveCycleImage.hpp
+ *
+ * Binary drive cycle profile, read in place from the mapped "drivecycle"
+ * partition (see DriveCycleCatalog.hpp). Created from the CSV export by
+ * tools/DriveCycleConverter.
+ *
+ * Layout (little endian):
+ *   Header
+ *   int16_t power[sampleCount]   vehicle power in units of powerScaleW
+ * or, with DRIVECYCLE_ENCODING_RICE, the same samples compressed as described
+ * in DriveCycleCodec.hpp.
+ */
+
+#ifndef _DRIVECYCLEIMAGE_HPP_
+#define _DRIVECYCLEIMAGE_HPP_
+
+#include <stdint.h>
+#include "DriveCycleCodec.hpp"
+
+#define DRIVECYCLE_MAGIC            0x31594344  // "DCY1"
+#define DRIVECYCLE_VERSION          1
+#define DRIVECYCLE_PARTITION        "drivecycle"
+/* Data partition subtype of DRIVECYCLE_PARTITION, see partitions_SPIFFS.csv */
+#define DRIVECYCLE_PARTITION_SUBTYPE 0x40
+/* Header encoding */
+#define DRIVECYCLE_ENCODING_RAW     0
+#define DRIVECYCLE_ENCODING_RICE    1
+
+class DriveCycleImage {
+public:
+  struct Header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t periodMs;      // time between two samples
+    uint32_t sampleCount;
+    uint16_t powerScaleW;   // W per LSB of a sample
+    uint16_t encoding;      // DRIVECYCLE_ENCODING_*
+  };
+
+  DriveCycleImage();
+  ~DriveCycleImage();
+
+  /* Uses the image at data, which must stay mapped until close(), and checks the header */
+  bool open(const void *data, uint32_t size);
+  void close();
+  bool isOpen();
+
+  uint32_t getPeriodMs();
+  uint32_t getSampleCount();
+  /* Vehicle power of count samples from index in kW, positive is discharge.
+   * Compressed images decode forward from the last read, reading an earlier
+   * index starts again from the first sample. Not thread safe. */
+  bool read(uint32_t index, float *powerKW, uint32_t count);
+  float getPowerKW(uint32_t index);
+
+private:
+  const Header *header;
+  /* Uncompressed samples, NULL for compressed images */
+  const int16_t *samples;
+  DriveCycleDecoder decoder;
+  uint32_t size;
+  const char* TAG = "DriveCycleImage";
+
+  bool checkHeader();
+};
+
+#endif /* _DRIVECYCLEIMAGE_HPP_ */
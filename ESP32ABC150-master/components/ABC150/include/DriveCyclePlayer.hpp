@@ -0,0 +1,71 @@
+/*
+ * DriveCyclePlayer.hpp
+ *
+ * Plays time stamped drive cycle samples at a control period shorter than
+ * the sample period. Between two samples the setpoint is interpolated, and
+ * the change per control step is limited to a slew rate. One player per
+ * ABC150 channel.
+ *
+ * The player interpolates between the second and third sample of a four
+ * sample window, so it needs up to two samples ahead of the playback time:
+ *
+ *   while (player.needsSample()) {
+ *     if (source has a sample) player.pushSample(timeMs, value);
+ *     else if (source is done) player.endOfSamples();
+ *     else break;   // late samples, the player holds the last one
+ *   }
+ *   setpoint = player.step();
+ */
+
+#ifndef _DRIVECYCLEPLAYER_HPP_
+#define _DRIVECYCLEPLAYER_HPP_
+
+#include <stdint.h>
+
+class DriveCyclePlayer {
+public:
+  enum Interpolation {Hold, Linear, Cubic};
+
+  /* slewRate in units of the samples per second, 0 disables the limit */
+  DriveCyclePlayer(Interpolation _interpolation, float _slewRate);
+
+  /* Starts a new cycle with the output at initialOutput */
+  void reset(uint32_t _controlPeriodMs, float initialOutput = 0);
+  bool needsSample();
+  /* Sample times must increase */
+  void pushSample(uint32_t timeMs, float value);
+  /* No more samples, playback ends at the time of the last one */
+  void endOfSamples();
+  /* Setpoint for the current control step, then advances by one control period */
+  float step();
+  bool isFinished();
+
+  /* Playback time relative to the first sample */
+  uint32_t getTimeMs();
+  /* Control steps in which the slew rate limited the setpoint */
+  uint32_t getSlewLimited();
+  void setInterpolation(Interpolation _interpolation);
+  void setSlewRate(float _slewRate);
+
+private:
+  Interpolation interpolation;
+  float slewRate;
+  uint32_t controlPeriodMs;
+  /* Sample window, the playback time is between times[1] and times[2] */
+  uint32_t times[4];
+  float values[4];
+  int count;
+  bool ended;
+  uint32_t startTime;
+  uint32_t endTime;
+  uint32_t time;
+  float output;
+  uint32_t slewLimited;
+
+  void append(uint32_t timeMs, float value);
+  /* Flat continuation after the last sample */
+  void pad();
+  float interpolate();
+};
+
+#endif /* _DRIVECYCLEPLAYER_HPP_ */
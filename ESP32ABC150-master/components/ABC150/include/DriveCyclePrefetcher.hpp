@@ -0,0 +1,62 @@
+/*
+ * DriveCyclePrefetcher.hpp
+ *
+ * Reads drive cycle samples ahead of playback on a low priority task, so
+ * the timed plate loop only takes samples from RAM. The ring buffer is split
+ * in two halves: whenever the loop has consumed one, the reader refills it
+ * while the loop plays the other.
+ */
+
+#ifndef _DRIVECYCLEPREFETCHER_HPP_
+#define _DRIVECYCLEPREFETCHER_HPP_
+
+#include "DriveCycleImage.hpp"
+#include "OSPort.hpp"
+#include <atomic>
+
+/* Power of two */
+#define PREFETCH_BUFFER_SAMPLES     256
+#define PREFETCH_HALF_SAMPLES       (PREFETCH_BUFFER_SAMPLES / 2)
+
+class DriveCyclePrefetcher {
+public:
+  DriveCyclePrefetcher(DriveCycleImage &_image);
+  virtual ~DriveCyclePrefetcher();
+
+  /* Fills the buffer from the first sample of the mapped image */
+  void start();
+  void stop();
+  /* Plate loop side, never blocks. Returns false at the end of the cycle or on underrun. */
+  bool next(float *powerKW);
+  /* Copies up to count samples after the next one without consuming them, returns the number copied */
+  uint32_t peek(float *powerKW, uint32_t count);
+  /* All samples have been played */
+  bool isFinished();
+  uint32_t getUnderruns();
+  uint32_t getPlayed();
+
+protected:
+  /* Reads count samples starting at index. Virtual so storage latency can be modelled on the host. */
+  virtual void fetch(uint32_t index, float *out, uint32_t count);
+
+private:
+  DriveCycleImage &image;
+  float buffer[PREFETCH_BUFFER_SAMPLES];
+  /* Absolute sample indices: written by the reader, consumed by the plate loop */
+  std::atomic<uint32_t> head;
+  std::atomic<uint32_t> tail;
+  uint32_t sampleCount;
+  std::atomic<uint32_t> underruns;
+  bool running;
+  /* Serialises refills with start/stop */
+  OSPort::Mutex fillMutex;
+  OSPort::TaskHandle readerTaskHandle;
+  const char* TAG = "DriveCyclePrefetcher";
+
+  /* Loads the next half if there is room, returns false if nothing was loaded */
+  bool fillHalf();
+  static void readerTaskWrapper(void *arg);
+  void readerTask();
+};
+
+#endif /* _DRIVECYCLEPREFETCHER_HPP_ */
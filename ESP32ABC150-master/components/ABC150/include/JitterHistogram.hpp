@@ -0,0 +1,33 @@
+/*
+ * JitterHistogram.hpp
+ *
+ * Distribution of the deviation of a periodic task's wake-up interval from
+ * its nominal period.
+ */
+
+#ifndef _JITTERHISTOGRAM_HPP_
+#define _JITTERHISTOGRAM_HPP_
+
+#include <stdint.h>
+
+#define JITTER_BUCKETS              8
+
+class JitterHistogram {
+public:
+  JitterHistogram();
+  void reset();
+  /* Records the interval between two wake-ups against the nominal period */
+  void record(int64_t intervalUs, uint32_t periodUs);
+  uint32_t getCount();
+  uint32_t getMaxUs();
+  void print();
+
+private:
+  /* Upper bound of each bucket in us, the last one is open ended */
+  static const uint32_t bucketLimitsUs[JITTER_BUCKETS];
+  uint32_t buckets[JITTER_BUCKETS];
+  uint32_t count;
+  uint32_t maxUs;
+};
+
+#endif /* _JITTERHISTOGRAM_HPP_ */
@@ -0,0 +1,91 @@
+/*
+ * LimitPredictor.hpp
+ *
+ * Look ahead on the power limits of the pack. The BMS reports availablePower
+ * and chargingPower for the state it had some time ago, so clamping to the
+ * reported value lets the command run over the real limit until the report
+ * catches up, after which the command collapses.
+ *
+ * Each limit follows a small pack model: its change over a window is fitted
+ * (recursive least squares with forgetting) to the energy drawn from the pack,
+ * the heat put into it (power squared over time, what derates a warm
+ * pack) and the time itself (sag recovery, cooling), one report lag earlier.
+ * All three are known from the power for the lag and the upcoming profile
+ * samples, so shape() predicts the limit at each upcoming sample and returns
+ * limits for the present command that stay under every prediction, ramping
+ * down at the given slew rate ahead of a drop the profile would run into.
+ *
+ * A pack that has not derated yet shows no heat sensitivity to fit, so the
+ * prediction assumes at least LIMIT_MIN_HEAT_SENSITIVITY, and it stays below
+ * the recent misses of the fit. Predictions are never above the reported
+ * limits. Powers in kW, positive for discharge, times in s.
+ */
+
+#ifndef _LIMITPREDICTOR_HPP_
+#define _LIMITPREDICTOR_HPP_
+
+#include <stdint.h>
+
+#define LIMIT_WINDOW_S              1.0f
+/* Longest report lag, in windows */
+#define LIMIT_MAX_LAG_WINDOWS       8
+/* Fitted inputs: energy [kJ], heat [(10 kW)^2 s], time [s] */
+#define LIMIT_INPUTS                3
+#define LIMIT_INPUT_ENERGY          0
+#define LIMIT_INPUT_HEAT            1
+#define LIMIT_INPUT_TIME            2
+
+class LimitPredictor {
+public:
+  /* lagSeconds: report lag of the BMS limits, slewRate: kW/s the command may ramp at */
+  LimitPredictor(float _lagSeconds, float _slewRate);
+  void reset();
+  /* Once per control period with the reported limits and the power drawn */
+  void update(float availablePower, float chargingPower, float power, float dtSeconds);
+  /*
+   * Limits for the present command. upcoming holds count profile samples, the
+   * first firstOffset after now and the rest period apart.
+   */
+  void shape(const float *upcoming, uint32_t count, float firstOffset, float period,
+             float *maxDischarge, float *maxCharge);
+  /* Fitted limit change [kW/kWh discharged] */
+  float getEnergySensitivity(bool charge);
+  /* Fitted limit change [kW/(10 kW)^2 s] */
+  float getHeatSensitivity(bool charge);
+
+private:
+  /* Fit of a limit change to the inputs of a window */
+  struct Model {
+    float theta[LIMIT_INPUTS];
+    float p[LIMIT_INPUTS][LIMIT_INPUTS];
+    /* Largest recent drop beyond the prediction, decaying per window [kW] */
+    float miss;
+    void reset();
+    void update(const float *inputs, float change);
+    float predict(const float *inputs);
+  };
+
+  float lagSeconds;
+  float slewRate;
+  int lagWindows;
+  bool started;
+  float availablePower;
+  float chargingPower;
+  float power;
+  /* Window being accumulated */
+  float window[LIMIT_INPUTS];
+  float windowStartDischarge;
+  float windowStartCharge;
+  /* Inputs of the last windows, newest first */
+  float past[LIMIT_MAX_LAG_WINDOWS + 1][LIMIT_INPUTS];
+  int pastCount;
+  Model discharge;
+  Model charge;
+
+  static void accumulate(float *inputs, float power, float seconds);
+  float limitAt(Model &model, float reported, const float *ahead);
+  void shapeLimit(Model &model, float reported, const float *upcoming, uint32_t count, float firstOffset,
+                  float period, float sign, float *limit);
+};
+
+#endif /* _LIMITPREDICTOR_HPP_ */
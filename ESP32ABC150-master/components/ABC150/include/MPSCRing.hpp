@@ -0,0 +1,112 @@
+/*
+ * MPSCRing.hpp
+ *
+ * Bounded lock-free ring for any number of producers and one consumer.
+ * Every slot carries a sequence number that says whether it is free for the
+ * next producer or written for the consumer, so neither side takes a lock
+ * and producers never wait: when the ring is full the item is dropped and
+ * counted.
+ */
+
+#ifndef _MPSCRING_HPP_
+#define _MPSCRING_HPP_
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+template <typename T, uint32_t N>
+class MPSCRing {
+  static_assert(N > 0 && (N & (N - 1)) == 0, "MPSCRing size must be a power of two");
+
+public:
+  MPSCRing() : head(0), tail(0), dropped(0) {
+    for (uint32_t i = 0; i < N; i++) {
+      slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  /* Reserves a slot to fill in place and publish(), NULL and counted as dropped when full */
+  T *claim(uint32_t *position) {
+    uint32_t pos = head.load(std::memory_order_relaxed);
+    while (1) {
+      Slot &slot = slots[pos & (N - 1)];
+      int32_t diff = (int32_t)(slot.sequence.load(std::memory_order_acquire) - pos);
+      if (diff == 0) {
+        /* On failure pos is reloaded with the current head */
+        if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          *position = pos;
+          return &slot.item;
+        }
+      } else if (diff < 0) {
+        /* The consumer has not released this slot yet */
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return NULL;
+      } else {
+        pos = head.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  void publish(uint32_t position) {
+    slots[position & (N - 1)].sequence.store(position + 1, std::memory_order_release);
+  }
+
+  bool push(const T &item) {
+    uint32_t position;
+    T *slot = claim(&position);
+    if (slot == NULL) {
+      return false;
+    }
+    *slot = item;
+    publish(position);
+    return true;
+  }
+
+  /* Consumer only: the oldest published item, NULL when empty */
+  T *front() {
+    uint32_t pos = tail.load(std::memory_order_relaxed);
+    Slot &slot = slots[pos & (N - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != pos + 1) {
+      return NULL;
+    }
+    return &slot.item;
+  }
+
+  /* Consumer only: hands the item returned by front() back to the producers */
+  void release() {
+    uint32_t pos = tail.load(std::memory_order_relaxed);
+    slots[pos & (N - 1)].sequence.store(pos + N, std::memory_order_release);
+    tail.store(pos + 1, std::memory_order_relaxed);
+  }
+
+  /* Consumer only */
+  bool pop(T *item) {
+    T *oldest = front();
+    if (oldest == NULL) {
+      return false;
+    }
+    *item = *oldest;
+    release();
+    return true;
+  }
+
+  uint32_t getPushed() { return head.load(std::memory_order_relaxed); }
+  uint32_t getPopped() { return tail.load(std::memory_order_relaxed); }
+  uint32_t getDropped() { return dropped.load(std::memory_order_relaxed); }
+
+private:
+  struct Slot {
+    /* Position the slot is free for, position + 1 once it is published */
+    std::atomic<uint32_t> sequence;
+    T item;
+  };
+
+  Slot slots[N];
+  std::atomic<uint32_t> head;
+  /* Only written by the consumer */
+  std::atomic<uint32_t> tail;
+  std::atomic<uint32_t> dropped;
+};
+
+#endif /* _MPSCRING_HPP_ */
@@ -0,0 +1,62 @@
+/*
+ * OSPort.hpp
+ *
+ * Thin OS layer used by the ABC150 component instead of calling FreeRTOS
+ * and esp_timer directly. OSPortFreeRTOS.cpp implements it on the ESP32,
+ * tools/host/OSPortPOSIX.cpp on Linux. All times are in milliseconds.
+ */
+
+#ifndef _OSPORT_HPP_
+#define _OSPORT_HPP_
+
+#include <stdint.h>
+
+#define OSPORT_WAIT_FOREVER         0xFFFFFFFF
+/* Same as configMAX_PRIORITIES in the ESP-IDF FreeRTOS config */
+#define OSPORT_MAX_PRIORITIES       25
+
+namespace OSPort {
+
+typedef void *TaskHandle;
+typedef void *Mutex;
+typedef void *Timer;
+typedef void (*TaskFunction)(void *arg);
+typedef void (*TimerFunction)(void *arg);
+
+/* Tasks */
+bool createTask(TaskFunction function, const char *name, uint32_t stackSize, void *arg,
+                int priority, TaskHandle *handle);
+void deleteTask(TaskHandle task);
+/* NULL suspends the calling task */
+void suspendTask(TaskHandle task);
+void resumeTask(TaskHandle task);
+
+/* Time */
+void delay(uint32_t ms);
+/* Periodic delay relative to lastWakeTime, which is updated. Use getTickMs() to initialise it. */
+void delayUntil(uint32_t *lastWakeTime, uint32_t period);
+/* Scheduler tick count in ms, wraps after 49 days */
+uint32_t getTickMs();
+/* Time since boot */
+int64_t getTimeMs();
+/* Time since boot in us, for measuring timing jitter */
+int64_t getTimeUs();
+
+/* Direct to task notifications, used as a binary semaphore */
+void notifyGive(TaskHandle task);
+/* Returns the pending count and clears it, 0 on timeout */
+uint32_t notifyTake(uint32_t timeout);
+
+/* Mutexes */
+Mutex createMutex();
+bool lock(Mutex mutex, uint32_t timeout = OSPORT_WAIT_FOREVER);
+void unlock(Mutex mutex);
+
+/* Software timers, the function runs in the timer task */
+Timer createTimer(const char *name, uint32_t period, bool autoReload, TimerFunction function, void *arg);
+bool startTimer(Timer timer);
+bool stopTimer(Timer timer);
+
+}
+
+#endif /* _OSPORT_HPP_ */
@@ -0,0 +1,32 @@
+/*
+ * PowerTracker.hpp
+ *
+ * Closed loop correction of a power setpoint. The target is sent as feed
+ * forward and a PI term on the measured power (DATA voltage x current)
+ * removes what the supply does not deliver. The command and the tracked
+ * target stay within the given limits, and the integral only winds up while
+ * the command is not limited.
+ */
+
+#ifndef _POWERTRACKER_HPP_
+#define _POWERTRACKER_HPP_
+
+class PowerTracker {
+public:
+  /* kp [W/W], ki [W/(W s)], integralLimit [W] */
+  PowerTracker(float _kp, float _ki, float _integralLimit);
+  void reset();
+  /* Power command for target with measured feedback, all in W, limited to [minPower, maxPower] */
+  float update(float target, float measured, float minPower, float maxPower, float dtSeconds);
+  /* Correction added to the feed forward in the last update */
+  float getCorrection();
+
+private:
+  float kp;
+  float ki;
+  float integralLimit;
+  float integral;
+  float correction;
+};
+
+#endif /* _POWERTRACKER_HPP_ */
@@ -0,0 +1,56 @@
+/*
+ * SeqLock.hpp
+ *
+ * Single writer sequence lock. The writer never blocks, readers retry until
+ * they copied a value that was not modified while it was being read.
+ */
+
+#ifndef _SEQLOCK_HPP_
+#define _SEQLOCK_HPP_
+
+#include <atomic>
+#include <stdint.h>
+#include "OSPort.hpp"
+
+/* Reader retries before yielding to a preempted writer on the same core */
+#define SEQLOCK_SPIN_LIMIT      100
+
+template <typename T>
+class SeqLock {
+public:
+  SeqLock() : sequence(0), value() {}
+
+  /* Only one context may write */
+  void write(const T &newValue) {
+    uint32_t seq = sequence.load(std::memory_order_relaxed);
+    sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    value = newValue;
+    sequence.store(seq + 2, std::memory_order_release);
+  }
+
+  T read() const {
+    T copy;
+    uint32_t before, after;
+    int spins = 0;
+    while (1) {
+      before = sequence.load(std::memory_order_acquire);
+      copy = value;
+      std::atomic_thread_fence(std::memory_order_acquire);
+      after = sequence.load(std::memory_order_relaxed);
+      if (!(before & 1) && before == after) {
+        return copy;
+      }
+      if (++spins >= SEQLOCK_SPIN_LIMIT) {
+        OSPort::delay(1);
+        spins = 0;
+      }
+    }
+  }
+
+private:
+  std::atomic<uint32_t> sequence;
+  T value;
+};
+
+#endif /* _SEQLOCK_HPP_ */
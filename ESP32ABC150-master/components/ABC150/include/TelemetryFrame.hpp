@@ -0,0 +1,134 @@
+/*
+ * TelemetryFrame.hpp
+ *
+ * Frames of the binary telemetry stream, shared by TelemetryStream and the
+ * host decoder. A frame is COBS encoded and sent between two zero bytes, so a
+ * reader that lost bytes, or sees console text on the same UART, drops one
+ * frame and finds the next delimiter. Before COBS (little endian):
+ *   type u8, sequence u8, payload, crc32 u32 of type to payload
+ * The sequence counts every frame built, a gap is a lost frame. pack() and
+ * unpack() do the CRC, COBS and delimiters for any frame type; the command
+ * protocol (CommandProtocol.hpp) uses them with types of its own.
+ *
+ * Samples payload, up to TELEMETRY_MAX_SAMPLES per frame:
+ *   time ms u32, count u8, timestamp A u32, timestamp B u32 (of the first sample)
+ *   per sample: time delta ms u8, per channel: voltage i16, current i16, timestamp delta u8
+ * Voltage and current are in the ABC150 wire units of ABC150Units.hpp. A
+ * sample whose deltas do not fit a byte starts a new frame, see fits().
+ *
+ * Status payload:
+ *   time ms u32
+ *   per channel: converter status u8, control mode u8, enable u8, command i16 (wire units of the mode),
+ *                lower voltage, current, power limit i16, upper voltage, current, power limit i16 (wire units)
+ *   tests u8, test state u8 per test
+ *   battery: voltage i16 (wire units), current i16 (wire units), soc i16 (0.01 %), online u8, HV on u8,
+ *            max and avg temp i16 (0.1 C), min and max cell voltage i16 (mV), available power i16 (0.01 kW),
+ *            available energy i16 (0.01 kWh), charging power i16 (0.01 kW)
+ */
+
+#ifndef _TELEMETRYFRAME_HPP_
+#define _TELEMETRYFRAME_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define TELEMETRY_CHANNELS          2
+#define TELEMETRY_MAX_SAMPLES       10
+#define TELEMETRY_MAX_TESTS         16
+#define TELEMETRY_SAMPLE_SIZE       (1 + 5 * TELEMETRY_CHANNELS)
+#define TELEMETRY_SAMPLES_HEADER    (5 + 4 * TELEMETRY_CHANNELS)
+#define TELEMETRY_STATUS_SIZE       (4 + 17 * TELEMETRY_CHANNELS + 1 + TELEMETRY_MAX_TESTS + 22)
+/* Type, sequence and CRC */
+#define TELEMETRY_OVERHEAD          6
+#define TELEMETRY_MAX_PAYLOAD       (TELEMETRY_SAMPLES_HEADER + TELEMETRY_MAX_SAMPLES * TELEMETRY_SAMPLE_SIZE)
+/* COBS adds a byte per 254 and the frame is sent between two delimiters */
+#define TELEMETRY_MAX_FRAME         (TELEMETRY_OVERHEAD + TELEMETRY_MAX_PAYLOAD + \
+                                     (TELEMETRY_OVERHEAD + TELEMETRY_MAX_PAYLOAD) / 254 + 3)
+
+struct TelemetryChannelSample {
+  int16_t voltage;
+  int16_t current;
+  uint32_t timestamp;
+};
+
+struct TelemetrySample {
+  uint32_t timeMs;
+  TelemetryChannelSample channels[TELEMETRY_CHANNELS];
+};
+
+struct TelemetryChannelStatus {
+  uint8_t converterStatus;
+  uint8_t controlMode;
+  uint8_t enable;
+  int16_t command;
+  int16_t lowerVoltageLimit;
+  int16_t lowerCurrentLimit;
+  int16_t lowerPowerLimit;
+  int16_t upperVoltageLimit;
+  int16_t upperCurrentLimit;
+  int16_t upperPowerLimit;
+};
+
+struct TelemetryBattery {
+  int16_t voltage;
+  int16_t current;
+  int16_t soc;
+  uint8_t onlineCount;
+  uint8_t hvOnCount;
+  int16_t maxTemp;
+  int16_t avgTemp;
+  int16_t minCellVoltage;
+  int16_t maxCellVoltage;
+  int16_t availablePower;
+  int16_t availableEnergy;
+  int16_t chargingPower;
+};
+
+struct TelemetryStatus {
+  uint32_t timeMs;
+  TelemetryChannelStatus channels[TELEMETRY_CHANNELS];
+  uint8_t testCount;
+  uint8_t testStates[TELEMETRY_MAX_TESTS];
+  TelemetryBattery battery;
+};
+
+class TelemetryFrame {
+public:
+  enum Type : uint8_t           {Samples = 1, Status = 2};
+
+  /* A decoded frame, samples or status depending on type */
+  struct Decoded {
+    Type type;
+    uint8_t sequence;
+    uint8_t count;
+    TelemetrySample samples[TELEMETRY_MAX_SAMPLES];
+    TelemetryStatus status;
+  };
+
+  /* Whether next can follow previous in one frame of samples */
+  static bool fits(const TelemetrySample &previous, const TelemetrySample &next);
+  /* Delimited and COBS encoded frames, return the length written to out, 0 if it does not fit */
+  static size_t encodeSamples(const TelemetrySample *samples, uint8_t count, uint8_t sequence, uint8_t *out,
+                              size_t size);
+  static size_t encodeStatus(const TelemetryStatus &status, uint8_t sequence, uint8_t *out, size_t size);
+  /* Decodes the bytes between two delimiters, false if the frame is corrupt */
+  static bool decode(const uint8_t *in, size_t length, Decoded *decoded);
+  /* Status payload without time, returns the length written, TELEMETRY_STATUS_SIZE at most */
+  static size_t putStatus(const TelemetryStatus &status, uint8_t *out);
+  /* Reads a status payload without time of exactly length bytes, false if it does not add up */
+  static bool getStatus(const uint8_t *in, size_t length, TelemetryStatus *status);
+
+  /* Appends the CRC to the length bytes of frame, which needs 4 spare bytes, then COBS encodes it
+   * between two delimiters into out. Returns the length written, 0 if it does not fit. */
+  static size_t pack(uint8_t *frame, size_t length, uint8_t *out, size_t size);
+  /* Reverses pack() for the bytes between two delimiters into frame, which needs length bytes; size is
+   * that of frame. Returns the length without CRC, 0 if the frame is corrupt or does not fit. */
+  static size_t unpack(const uint8_t *in, size_t length, uint8_t *frame, size_t size);
+
+  /* out needs length + length / 254 + 1 bytes, returns the encoded length */
+  static size_t cobsEncode(const uint8_t *in, size_t length, uint8_t *out);
+  /* out needs length bytes, returns the decoded length, 0 if the encoding is invalid */
+  static size_t cobsDecode(const uint8_t *in, size_t length, uint8_t *out);
+};
+
+#endif /* _TELEMETRYFRAME_HPP_ */
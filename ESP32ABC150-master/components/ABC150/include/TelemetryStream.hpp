@@ -0,0 +1,106 @@
+/*
+ * TelemetryStream.hpp
+ *
+ * Live binary telemetry. A Monitor job on the TestScheduler takes a sample of
+ * both ABC150 channels at 10-100 Hz and sends the samples of every
+ * TELEMETRY_FRAME_PERIOD_MS as one frame, and a status frame with the
+ * setpoints, test states and battery aggregates once a second. Frames are
+ * built by TelemetryFrame into a lock-free ring; a low priority task writes
+ * them to the sinks, so a slow UART never holds up the scheduler. A frame
+ * that finds the ring full is dropped and shows up as a sequence gap.
+ *
+ * main attaches a UART of the stream's own (CONFIG::TELEMETRY) and the
+ * WebSocket of AmpleProtocolTask; the console UART stays with the menus and
+ * AsyncConsole. At 100 Hz the stream takes about 1.4 kB/s, 12 % of a 115200
+ * baud UART and more than ten times the 1 Hz debug log line it replaces.
+ */
+
+#ifndef _TELEMETRYSTREAM_HPP_
+#define _TELEMETRYSTREAM_HPP_
+
+#include "TelemetryFrame.hpp"
+#include "TestScheduler.hpp"
+#include "MPSCRing.hpp"
+#include "OSPort.hpp"
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TELEMETRY_MIN_RATE_HZ       10
+#define TELEMETRY_MAX_RATE_HZ       100
+#define TELEMETRY_FRAME_PERIOD_MS   100
+#define TELEMETRY_STATUS_PERIOD_MS  1000
+/* Frames waiting for the writer task, power of two */
+#define TELEMETRY_FRAMES            4
+#define TELEMETRY_MAX_SINKS         2
+
+class TelemetryStream {
+public:
+  /* Fill in everything but the time */
+  typedef void (*SampleFunction)(void *arg, TelemetrySample &sample);
+  typedef void (*StatusFunction)(void *arg, TelemetryStatus &status);
+  /* Writes one frame, may block */
+  typedef void (*Writer)(const uint8_t *data, size_t length, void *arg);
+
+  TelemetryStream(SampleFunction _sampleFunction, StatusFunction _statusFunction, void *_arg);
+  virtual ~TelemetryStream();
+  /* Creates the writer task */
+  bool start();
+  /* Adds the sampling job, which stays inactive until setRate() */
+  void schedule(TestScheduler &_scheduler);
+  bool addSink(Writer writer, void *arg);
+  /* 0 stops the stream, otherwise TELEMETRY_MIN_RATE_HZ to TELEMETRY_MAX_RATE_HZ */
+  bool setRate(uint32_t hz);
+  uint32_t getRate();
+
+  /* Takes a sample and queues the frames that are due */
+  void sample();
+  /* Writes the queued frames to the sinks. One consumer only: the writer task once started. */
+  uint32_t write();
+
+  uint32_t getFrames();
+  uint32_t getBytes();
+  uint32_t getDropped();
+  void printStats();
+
+  static bool sampleJob(void *arg);
+
+private:
+  struct Frame {
+    uint16_t length;
+    uint8_t data[TELEMETRY_MAX_FRAME];
+  };
+  struct Sink {
+    Writer writer;
+    void *arg;
+  };
+
+  SampleFunction sampleFunction;
+  StatusFunction statusFunction;
+  void *arg;
+  /* Only touched by the sampling job */
+  TelemetrySample samples[TELEMETRY_MAX_SAMPLES];
+  uint8_t sampleCount;
+  uint8_t sequence;
+  uint32_t lastStatusMs;
+  std::atomic<uint32_t> rateHz;
+  /* Counted by setRate(), a batch started before the last change is discarded */
+  std::atomic<uint32_t> rateChanges;
+  uint32_t seenRateChanges;
+  MPSCRing<Frame, TELEMETRY_FRAMES> frames;
+  /* Only written by the writer task */
+  uint32_t bytes;
+  Sink sinks[TELEMETRY_MAX_SINKS];
+  int sinkCount;
+  TestScheduler *scheduler;
+  int job;
+  OSPort::TaskHandle taskHandle;
+  const char* TAG = "TelemetryStream";
+
+  void queueSamples();
+  void queueStatus(uint32_t timeMs);
+  static void writerTaskWrapper(void *arg);
+  void writerTask();
+};
+
+#endif /* _TELEMETRYSTREAM_HPP_ */
@@ -0,0 +1,59 @@
+/*
+ * TelemetryWatchdog.hpp
+ *
+ * Freshness of the DATA_x and STATUS_x telemetry of the ABC150 channels. A
+ * channel is stale when either frame has not been received for longer than
+ * the limit, or when DATA keeps arriving but its ABC150 timestamp has stopped
+ * advancing. The receive path is the only writer; the tests read the ages from
+ * their own task, so the times are relaxed 32 bit atomics in ms.
+ */
+
+#ifndef _TELEMETRYWATCHDOG_HPP_
+#define _TELEMETRYWATCHDOG_HPP_
+
+#include <stdint.h>
+#include <atomic>
+
+#define TELEMETRY_CHANNELS          2
+
+class TelemetryWatchdog {
+public:
+  enum Source                   {Data, Status, Timestamp, Sources};
+
+  TelemetryWatchdog(uint32_t _staleLimitMs);
+  void setStaleLimit(uint32_t ms);
+  uint32_t getStaleLimit();
+  /* Forgets all frames, every channel is stale until it is heard again */
+  void reset();
+
+  /* DATA frame of a channel with the ABC150 timestamp */
+  void data(int channel, uint32_t timestamp);
+  /* STATUS frame of a channel */
+  void status(int channel);
+
+  /* Time since a source was last seen, UINT32_MAX before the first frame */
+  uint32_t getAgeMs(int channel, Source source);
+  /* Oldest of the sources of a channel */
+  uint32_t getAgeMs(int channel);
+  /* Source with the oldest age */
+  Source getOldest(int channel);
+  bool isFresh(int channel);
+  static const char *getSourceName(Source source);
+
+  void print();
+
+private:
+  struct ChannelTimes {
+    std::atomic<uint32_t> lastMs[Sources];
+    std::atomic<bool> seen[Sources];
+    /* Only touched by the receive path */
+    uint32_t lastTimestamp;
+  };
+
+  std::atomic<uint32_t> staleLimitMs;
+  ChannelTimes channels[TELEMETRY_CHANNELS];
+
+  void mark(ChannelTimes &times, Source source, uint32_t now);
+};
+
+#endif /* _TELEMETRYWATCHDOG_HPP_ */
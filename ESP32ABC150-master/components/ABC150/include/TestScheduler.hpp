@@ -0,0 +1,86 @@
+/*
+ * TestScheduler.hpp
+ *
+ * Periodic jobs of the ABC150 tests. Each job declares a period and a
+ * deadline relative to its release and is only released while it is active.
+ * Every lane is one task: Control runs above Monitor, so a slow monitoring
+ * job cannot hold up a control loop. Within a lane the released job with the
+ * earliest deadline runs first. A job finishing after its deadline is an
+ * overrun; releases that pass while it still runs are skipped rather than
+ * run late in a burst.
+ */
+
+#ifndef _TESTSCHEDULER_HPP_
+#define _TESTSCHEDULER_HPP_
+
+#include "OSPort.hpp"
+#include <stdint.h>
+
+#define TEST_SCHEDULER_MAX_JOBS     16
+
+class TestScheduler {
+public:
+  enum Lane                     {Control, Monitor, Lanes};
+  /* Runs one release of a job, returns false to deactivate it */
+  typedef bool (*JobFunction)(void *arg);
+
+  TestScheduler();
+  virtual ~TestScheduler();
+  /* Creates the lane tasks */
+  bool start();
+  /* Returns the job, -1 if the table is full */
+  int addJob(const char *name, JobFunction function, void *arg, Lane lane, uint32_t periodMs, uint32_t deadlineMs);
+  bool setPeriod(int job, uint32_t periodMs, uint32_t deadlineMs);
+  /* First release now, then one every period */
+  bool activate(int job);
+  /* No further releases, a running release completes */
+  bool deactivate(int job);
+  bool isActive(int job);
+
+  uint32_t getRuns(int job);
+  uint32_t getOverruns(int job);
+  uint32_t getSkipped(int job);
+  /* Release to completion, us */
+  uint32_t getMaxResponseUs(int job);
+  void resetStats();
+  void print();
+
+private:
+  struct Job {
+    const char *name;
+    JobFunction function;
+    void *arg;
+    Lane lane;
+    uint32_t periodMs;
+    uint32_t deadlineMs;
+    bool active;
+    /* Changed by activate(), a release that was running when it changed does not reschedule */
+    uint32_t activation;
+    int64_t releaseMs;
+    uint32_t runs;
+    uint32_t overruns;
+    uint32_t skipped;
+    uint32_t maxLatencyUs;
+    uint32_t maxResponseUs;
+  };
+  struct LaneTask {
+    TestScheduler *scheduler;
+    Lane lane;
+    OSPort::TaskHandle handle;
+  };
+
+  static const int lanePriorities[Lanes];
+  Job jobs[TEST_SCHEDULER_MAX_JOBS];
+  int jobCount;
+  LaneTask lanes[Lanes];
+  OSPort::Mutex mutex;
+  const char* TAG = "TestScheduler";
+
+  static void laneTaskWrapper(void *arg);
+  void laneTask(Lane lane);
+  /* Books a completed release and schedules the next one */
+  void complete(int job, uint32_t activation, int64_t releaseMs, int64_t startUs, int64_t endUs, bool keep);
+  bool jobCheck(int job);
+};
+
+#endif /* _TESTSCHEDULER_HPP_ */
@@ -42,6 +42,19 @@ namespace SIM100 {
 const uint16_t MAX_WORKING_VOLTAGE          = 402;
 }
 
+namespace COMMANDS {
+const uart_port_t UART                      = UART_NUM_2;
+const int BAUD_RATE                         = 115200;
+const int TX_PIN                            = 17;
+const int RX_PIN                            = 16;
+}
+
+namespace TELEMETRY {
+const uart_port_t UART                      = UART_NUM_1;
+const int BAUD_RATE                         = 115200;
+const int TX_PIN                            = 4;
+}
+
 
 namespace NVS {
 
@@ -10,6 +10,7 @@
 #include "RingLog.hpp"
 #include "PCAL6416a.hpp"
 #include <driver/adc.h>
+#include <driver/uart.h>
 
 namespace CONFIG {
 
@@ -43,6 +44,21 @@ namespace SIM100 {
 extern const uint16_t MAX_WORKING_VOLTAGE;
 }
 
+namespace COMMANDS {
+/* UART of the binary command protocol, the console UART stays with the menus */
+extern const uart_port_t UART;
+extern const int BAUD_RATE;
+extern const int TX_PIN;
+extern const int RX_PIN;
+}
+
+namespace TELEMETRY {
+/* UART of the binary telemetry stream, transmit only */
+extern const uart_port_t UART;
+extern const int BAUD_RATE;
+extern const int TX_PIN;
+}
+
 namespace NVS {
 extern const char wifiSsid[];
 extern const char wifiPass[];
@@ -31,6 +31,11 @@
 using namespace CONFIG::WAITTIMES;
 using namespace std;
 
+#define COMMAND_UART_BUFFER_SIZE    1024
+#define COMMAND_UART_READ_MS        20
+/* The driver wants a receive buffer above the FIFO size even when nothing is received */
+#define TELEMETRY_UART_BUFFER_SIZE  1024
+
 extern "C" {
 	void app_main(void);
 }
@@ -51,6 +56,56 @@ void help() {
 
 }
 
+/* Link of the command server */
+bool commandUartInit() {
+  uart_config_t config = {};
+  config.baud_rate = CONFIG::COMMANDS::BAUD_RATE;
+  config.data_bits = UART_DATA_8_BITS;
+  config.parity = UART_PARITY_DISABLE;
+  config.stop_bits = UART_STOP_BITS_1;
+  config.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+  return uart_param_config(CONFIG::COMMANDS::UART, &config) == ESP_OK &&
+         uart_set_pin(CONFIG::COMMANDS::UART, CONFIG::COMMANDS::TX_PIN, CONFIG::COMMANDS::RX_PIN,
+                      UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE) == ESP_OK &&
+         uart_driver_install(CONFIG::COMMANDS::UART, COMMAND_UART_BUFFER_SIZE, COMMAND_UART_BUFFER_SIZE, 0, NULL,
+                             0) == ESP_OK;
+}
+
+int commandUartRead(uint8_t *data, size_t size, void *arg) {
+  return uart_read_bytes(CONFIG::COMMANDS::UART, data, size, COMMAND_UART_READ_MS / portTICK_PERIOD_MS);
+}
+
+void commandUartWrite(const uint8_t *data, size_t length, void *arg) {
+  uart_write_bytes(CONFIG::COMMANDS::UART, (const char *)data, length);
+}
+
+/* Link of the telemetry stream, the console UART stays with the menus */
+bool telemetryUartInit() {
+  uart_config_t config = {};
+  config.baud_rate = CONFIG::TELEMETRY::BAUD_RATE;
+  config.data_bits = UART_DATA_8_BITS;
+  config.parity = UART_PARITY_DISABLE;
+  config.stop_bits = UART_STOP_BITS_1;
+  config.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+  return uart_param_config(CONFIG::TELEMETRY::UART, &config) == ESP_OK &&
+         uart_set_pin(CONFIG::TELEMETRY::UART, CONFIG::TELEMETRY::TX_PIN, UART_PIN_NO_CHANGE,
+                      UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE) == ESP_OK &&
+         uart_driver_install(CONFIG::TELEMETRY::UART, TELEMETRY_UART_BUFFER_SIZE, TELEMETRY_UART_BUFFER_SIZE, 0,
+                             NULL, 0) == ESP_OK;
+}
+
+void telemetryUartWrite(const uint8_t *data, size_t length, void *arg) {
+  uart_write_bytes(CONFIG::TELEMETRY::UART, (const char *)data, length);
+}
+
+/* Each telemetry frame as one binary message on the WebSocket of the Ample protocol, dropped while it is down */
+void telemetryWebSocketWrite(const uint8_t *data, size_t length, void *arg) {
+  AmpleProtocolTask *protocolTask = (AmpleProtocolTask *)arg;
+  if (protocolTask->client.isConnected()) {
+    protocolTask->client.sendBinary(data, length);
+  }
+}
+
 void app_main(void)
 {
   AmpleSerial serial(UART_NUM_0);
@@ -88,7 +143,15 @@ void app_main(void)
 
   ABC150Controller abc150Controller(ampleID);
   ABC150TestManager testManager(abc150Controller);
-
+  /* Telemetry frames go to their own UART and, when the Ample protocol runs, its WebSocket */
+  if (!telemetryUartInit() ||
+      !testManager.getTelemetry().addSink(&telemetryUartWrite, NULL)) {
+    ESP_LOGE("main", "Failed to attach the telemetry UART");
+  }
+  if (NVSConfig::getInt(AMPLE_PROTOCOL_ENABLE) &&
+      !testManager.getTelemetry().addSink(&telemetryWebSocketWrite, &protocolTask)) {
+    ESP_LOGE("main", "Failed to attach the telemetry WebSocket");
+  }
 
   ABC150CANHandler *abc150Handler = abc150Controller.getABC150CANHandler();
   PlateCANHandler *plateHandler = abc150Controller.getPlateCANHandler();
@@ -112,6 +175,12 @@ void app_main(void)
   testManager.addDualChannelTest(plateDriveCycleTest);
   testManager.addDualChannelTest(plateChargeDischargeTest);
 
+  /* Binary commands for scripts, served next to the menus */
+  if (!commandUartInit() ||
+      !testManager.getCommandServer().start(&commandUartRead, &commandUartWrite, NULL)) {
+    ESP_LOGE("main", "Failed to start the command server");
+  }
+
   while (1) {
     // if in packet mode, the loop call will block
     serial.clear();
@@ -0,0 +1,431 @@
+/*
+ * main.cpp
+ *
+ * Checks and times the signal layouts of ABC150Codec.hpp:
+ *
+ *  - golden frames: a payload written out by hand for every layout, with
+ *    sign, full width and neighbouring bit fields. decodeRaw() must give the
+ *    raw values and encodeRaw() the exact payload, unused bytes zero. DATA
+ *    and LIMITS are also decoded and encoded scaled.
+ *  - the shifts ABC150CANHandler hand-rolled before the layouts: random
+ *    payloads must decode to the same values as the old receive handlers,
+ *    and random values must encode to the same payloads as the old send
+ *    functions
+ *
+ * Then times decoding DATA, STATUS and STATION_ID and encoding COMMAND and
+ * LIMITS_OUT through the layouts against the old shifts. Exits with 1 if a
+ * check fails.
+ *
+ *   ABC150CodecBench [iterations]     default 10000000
+ */
+
+#include "ABC150Codec.hpp"
+#include "OSPort.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define RANDOM_FRAMES               100000
+/* Frames cycled through while timing */
+#define BENCH_FRAMES                256
+
+/* STATUS bits the old handler masked out of byte 3 and 4 */
+#define CONTROL_MODE                0x03
+#define NORMAL_MODE                 0x04
+#define ENABLE_MODE                 0x08
+#define LOAD_MODE                   0x30
+#define RVS_MODE                    0x40
+#define CONNECTOR_STATUS_NEGATIVE   0x01
+#define CONNECTOR_STATUS_POSITIVE   0x02
+#define CONNECTOR_STATUS_INTERLOCK  0x04
+
+using namespace ABC150Codec;
+
+static bool passed = true;
+
+static void printBytes(const uint8_t *data, int count) {
+  for (int i = 0; i < count; i++) {
+    printf(" %02X", data[i]);
+  }
+}
+
+/* Golden frames */
+
+template <size_t N>
+static void checkGolden(const char *name, const Message<N> &layout, uint8_t dlc, const uint8_t (&golden)[8],
+                        const int64_t (&raws)[N]) {
+  int64_t decoded[N];
+  decodeRaw(layout, golden, decoded);
+  bool decodeOk = true;
+  for (size_t i = 0; i < N; i++) {
+    decodeOk = decodeOk && decoded[i] == raws[i];
+  }
+  uint8_t encoded[8];
+  memset(encoded, 0xA5, sizeof(encoded));
+  encodeRaw(layout, encoded, raws);
+  bool encodeOk = memcmp(encoded, golden, sizeof(encoded)) == 0;
+  bool ok = layout.dlc == dlc && decodeOk && encodeOk;
+  printf("  %-22s", name);
+  printBytes(golden, dlc);
+  printf("%*s  %s\n", 3 * (8 - dlc), "", ok ? "ok" : "WRONG");
+  if (!ok) {
+    printf("    dlc %d, decode %s, encoded", layout.dlc, decodeOk ? "ok" : "wrong");
+    printBytes(encoded, 8);
+    printf("\n");
+  }
+  passed = passed && ok;
+}
+
+template <size_t N>
+static void checkScaled(const char *name, const Message<N> &layout, const uint8_t (&golden)[8],
+                        const double (&values)[N]) {
+  double decoded[N];
+  decode(layout, golden, decoded);
+  bool decodeOk = true;
+  for (size_t i = 0; i < N; i++) {
+    decodeOk = decodeOk && fabs(decoded[i] - values[i]) < 1e-9;
+  }
+  uint8_t encoded[8];
+  encode(layout, encoded, values);
+  bool ok = decodeOk && memcmp(encoded, golden, sizeof(encoded)) == 0;
+  printf("  %-22s scaled%*s  %s\n", name, 18, "", ok ? "ok" : "WRONG");
+  passed = passed && ok;
+}
+
+static void checkGoldenFrames() {
+  printf("Golden frames\n");
+  {
+    /* 321.60 V, -10.00 A */
+    const uint8_t golden[8] = {0x3E, 0xD0, 0xFE, 0x0C, 0x12, 0x34, 0x56, 0x78};
+    checkGolden("DATA", DATA_LAYOUT, 8, golden, {16080, -500, 0x12345678});
+    checkScaled("DATA", DATA_LAYOUT, golden, {321.6, -10.0, 0x12345678});
+    const uint8_t extremes[8] = {0x80, 0x00, 0x7F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    checkGolden("DATA extremes", DATA_LAYOUT, 8, extremes, {-32768, 32767, 0xFFFFFFFF});
+  }
+  {
+    /* 240 V, -15 A, -3600 W */
+    const uint8_t golden[8] = {0x2E, 0xE0, 0xFD, 0x12, 0xFD, 0x30};
+    checkGolden("LIMITS", LIMITS_LAYOUT, 6, golden, {12000, -750, -720});
+    checkScaled("LIMITS", LIMITS_LAYOUT, golden, {240.0, -15.0, -3600.0});
+  }
+  {
+    /* Remote, power, normal, enabled, parallel, RVS, negative connector and interlock */
+    const uint8_t golden[8] = {0xFE, 0x70, 0x01, 0x5E, 0x05};
+    checkGolden("STATUS", STATUS_LAYOUT, 5, golden, {-400, 1, 2, 1, 1, 1, 1, 1, 0, 1});
+    /* The fields cleared above set, and the other way round */
+    const uint8_t inverse[8] = {0x7F, 0xFF, 0x02, 0x33, 0x02};
+    checkGolden("STATUS inverse bits", STATUS_LAYOUT, 5, inverse, {32767, 2, 3, 0, 0, 3, 0, 0, 1, 0});
+  }
+  {
+    const uint8_t golden[8] = {0x15, 0x00, 0x00, 0x00, 0x01};
+    checkGolden("STATION_ID", STATION_ID_LAYOUT, 5, golden, {0x1500000001LL});
+    const uint8_t full[8] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    checkGolden("STATION_ID 40 bits", STATION_ID_LAYOUT, 5, full, {0xFFFFFFFFFFLL});
+  }
+  {
+    const uint8_t golden[8] = {0x00, 0x01, 0x00, 0x00, 0x0D};
+    checkGolden("GREETING", GREETING_LAYOUT, 5, golden, {0x00010000, 0x0D});
+  }
+  {
+    const uint8_t golden[8] = {0x2A, 0x07};
+    checkGolden("FAULT_DATA", FAULT_DATA_LAYOUT, 2, golden, {0x2A, 0x07});
+  }
+  {
+    /* Invalid station ID, channel B */
+    const uint8_t golden[8] = {0x21, 0x01};
+    checkGolden("PACKET_PROBLEM", PACKET_PROBLEM_LAYOUT, 2, golden, {0x21, 0x01});
+  }
+  {
+    const uint8_t golden[8] = {0x01, 0x40};
+    checkGolden("REQUEST", REQUEST_LAYOUT, 2, golden, {GREETING});
+  }
+  {
+    /* -2500 W in power control, parallel */
+    const uint8_t golden[8] = {0x7F, 0xFE, 0x0C, 0x12};
+    checkGolden("COMMAND", COMMAND_LAYOUT, 4, golden, {0x7F, -500, 2, 1});
+    /* Standby, do not change the load mode */
+    const uint8_t standby[8] = {0xFF, 0x00, 0x00, 0x33};
+    checkGolden("COMMAND standby", COMMAND_LAYOUT, 4, standby, {0xFF, 0, 3, 3});
+  }
+  {
+    /* 401.5 V, -10 A, -4000 W */
+    const uint8_t golden[8] = {0x05, 0x4E, 0x6B, 0xFE, 0x0C, 0xFC, 0xE0};
+    checkGolden("LIMITS_OUT", LIMITS_OUT_LAYOUT, 7, golden, {5, 20075, -500, -800});
+  }
+  {
+    /* Channel B from local to remote */
+    const uint8_t golden[8] = {0x11, 0x0D, 0x00, 0x15, 0x00, 0x00, 0x00, 0x01};
+    checkGolden("CHANGE_CONTROL", CHANGE_CONTROL_LAYOUT, 8, golden, {1, 0, 1, 0x0D, 0x1500000001LL});
+    /* Channel A from J1850 to local */
+    const uint8_t j1850[8] = {0x04, 0x0D, 0x00, 0x15, 0x00, 0x00, 0x00, 0x00};
+    checkGolden("CHANGE_CONTROL J1850", CHANGE_CONTROL_LAYOUT, 8, j1850, {0, 2, 0, 0x0D, 0x1500000000LL});
+  }
+}
+
+/* The shifts of the handler before the layouts */
+
+struct OldData {
+  int16_t voltage;
+  int16_t current;
+  uint32_t timestamp;
+};
+
+struct OldStatus {
+  int16_t command;
+  uint8_t converterStatus;
+  uint8_t controlMode;
+  uint8_t normalMode;
+  uint8_t enableMode;
+  uint8_t loadMode;
+  uint8_t rvsMode;
+  bool negative;
+  bool positive;
+  bool interlock;
+};
+
+static int16_t oldInt16(const uint8_t *data) {
+  return (int16_t)((uint16_t)data[0] << 8) | (uint16_t)data[1];
+}
+
+static OldData oldDecodeData(const uint8_t *data) {
+  OldData out;
+  out.voltage = oldInt16(data);
+  out.current = oldInt16(data + 2);
+  out.timestamp = ((uint32_t)data[4] << 24) | ((uint32_t)data[5] << 16) | ((uint32_t)data[6] << 8) |
+                  (uint32_t)data[7];
+  return out;
+}
+
+static OldStatus oldDecodeStatus(const uint8_t *data) {
+  OldStatus out;
+  out.command = oldInt16(data);
+  out.converterStatus = data[2];
+  out.negative = (data[4] & CONNECTOR_STATUS_NEGATIVE) == CONNECTOR_STATUS_NEGATIVE;
+  out.positive = (data[4] & CONNECTOR_STATUS_POSITIVE) == CONNECTOR_STATUS_POSITIVE;
+  out.interlock = (data[4] & CONNECTOR_STATUS_INTERLOCK) == CONNECTOR_STATUS_INTERLOCK;
+  out.controlMode = data[3] & CONTROL_MODE;
+  out.normalMode = (data[3] & NORMAL_MODE) >> 2;
+  out.enableMode = (data[3] & ENABLE_MODE) >> 3;
+  out.loadMode = (data[3] & LOAD_MODE) >> 4;
+  out.rvsMode = (data[3] & RVS_MODE) >> 6;
+  return out;
+}
+
+static uint64_t oldDecodeStationID(const uint8_t *data) {
+  return ((uint64_t)data[0] << 32) | ((uint64_t)data[1] << 24) | ((uint64_t)data[2] << 16) |
+         ((uint64_t)data[3] << 8) | data[4];
+}
+
+static void oldEncodeCommand(uint8_t *data, uint8_t counter, int16_t value, uint8_t controlMode, uint8_t loadMode) {
+  memset(data, 0, 8);
+  data[0] = counter;
+  data[1] = (value >> 8) & 0xFF;
+  data[2] = value & 0xFF;
+  data[3] = controlMode | (loadMode << 4);
+}
+
+static void oldEncodeLimits(uint8_t *data, uint8_t counter, int16_t voltage, int16_t current, int16_t power) {
+  memset(data, 0, 8);
+  data[0] = counter;
+  data[1] = (voltage >> 8) & 0xFF;
+  data[2] = voltage & 0xFF;
+  data[3] = (current >> 8) & 0xFF;
+  data[4] = current & 0xFF;
+  data[5] = (power >> 8) & 0xFF;
+  data[6] = power & 0xFF;
+}
+
+static void oldEncodeChangeControl(uint8_t *data, uint8_t channel, uint8_t from, uint8_t to, uint8_t hardwareID,
+                                   uint64_t stationID) {
+  memset(data, 0, 8);
+  data[0] = channel | (from << 1) | (to << 4);
+  data[1] = hardwareID;
+  data[3] = (stationID >> 32) & 0xFF;
+  data[4] = (stationID >> 24) & 0xFF;
+  data[5] = (stationID >> 16) & 0xFF;
+  data[6] = (stationID >> 8) & 0xFF;
+  data[7] = stationID & 0xFF;
+}
+
+static void randomPayload(uint8_t *data) {
+  for (int i = 0; i < 8; i++) {
+    data[i] = rand() & 0xFF;
+  }
+}
+
+static void report(const char *name, long mismatches) {
+  printf("  %-22s %ld of %d differ  %s\n", name, mismatches, RANDOM_FRAMES, mismatches == 0 ? "ok" : "WRONG");
+  passed = passed && mismatches == 0;
+}
+
+static void checkOldShifts() {
+  printf("\nAgainst the old shifts, %d random frames each\n", RANDOM_FRAMES);
+  long data = 0, limits = 0, status = 0, stationID = 0, command = 0, limitsOut = 0, changeControl = 0;
+  for (int n = 0; n < RANDOM_FRAMES; n++) {
+    uint8_t payload[8];
+    randomPayload(payload);
+
+    int64_t dataRaws[DATA_FIELDS];
+    decodeRaw(DATA_LAYOUT, payload, dataRaws);
+    OldData oldData = oldDecodeData(payload);
+    data += dataRaws[DATA_VOLTAGE] != oldData.voltage || dataRaws[DATA_CURRENT] != oldData.current ||
+            dataRaws[DATA_TIMESTAMP] != oldData.timestamp;
+
+    int64_t limitsRaws[LIMITS_FIELDS];
+    decodeRaw(LIMITS_LAYOUT, payload, limitsRaws);
+    limits += limitsRaws[LIMITS_VOLTAGE] != oldInt16(payload) || limitsRaws[LIMITS_CURRENT] != oldInt16(payload + 2) ||
+              limitsRaws[LIMITS_POWER] != oldInt16(payload + 4);
+
+    int64_t statusRaws[STATUS_FIELDS];
+    decodeRaw(STATUS_LAYOUT, payload, statusRaws);
+    OldStatus oldStatus = oldDecodeStatus(payload);
+    status += statusRaws[STATUS_COMMAND] != oldStatus.command ||
+              statusRaws[STATUS_CONVERTER] != oldStatus.converterStatus ||
+              statusRaws[STATUS_CONTROL_MODE] != oldStatus.controlMode ||
+              statusRaws[STATUS_NORMAL_MODE] != oldStatus.normalMode ||
+              statusRaws[STATUS_ENABLE_MODE] != oldStatus.enableMode ||
+              statusRaws[STATUS_LOAD_MODE] != oldStatus.loadMode ||
+              statusRaws[STATUS_RVS_MODE] != oldStatus.rvsMode ||
+              statusRaws[STATUS_CONNECTOR_NEGATIVE] != oldStatus.negative ||
+              statusRaws[STATUS_CONNECTOR_POSITIVE] != oldStatus.positive ||
+              statusRaws[STATUS_CONNECTOR_INTERLOCK] != oldStatus.interlock;
+
+    stationID += (uint64_t)decodeRaw(STATION_ID_LAYOUT.signals[STATION_ID], payload) != oldDecodeStationID(payload);
+
+    /* Field values in range, as the handler sends them */
+    uint8_t counter = payload[0];
+    int16_t value = (int16_t)((payload[1] << 8) | payload[2]);
+    uint8_t controlMode = payload[3] & 3;
+    uint8_t loadMode = (payload[3] >> 4) & 3;
+    uint8_t expected[8], encoded[8];
+    oldEncodeCommand(expected, counter, value, controlMode, loadMode);
+    encodeRaw(COMMAND_LAYOUT, encoded, {counter, value, controlMode, loadMode});
+    command += memcmp(encoded, expected, sizeof(encoded)) != 0;
+
+    int16_t current = (int16_t)((payload[3] << 8) | payload[4]);
+    int16_t power = (int16_t)((payload[5] << 8) | payload[6]);
+    oldEncodeLimits(expected, counter, value, current, power);
+    encodeRaw(LIMITS_OUT_LAYOUT, encoded, {counter, value, current, power});
+    limitsOut += memcmp(encoded, expected, sizeof(encoded)) != 0;
+
+    uint64_t station = oldDecodeStationID(payload + 3);
+    oldEncodeChangeControl(expected, payload[0] & 1, payload[1] % 3, payload[2] % 3, payload[7], station);
+    encodeRaw(CHANGE_CONTROL_LAYOUT, encoded,
+              {payload[0] & 1, payload[1] % 3, payload[2] % 3, payload[7], (int64_t)station});
+    changeControl += memcmp(encoded, expected, sizeof(encoded)) != 0;
+  }
+  report("DATA", data);
+  report("LIMITS", limits);
+  report("STATUS", status);
+  report("STATION_ID", stationID);
+  report("COMMAND", command);
+  report("LIMITS_OUT", limitsOut);
+  report("CHANGE_CONTROL", changeControl);
+}
+
+/* Timing */
+
+static uint8_t frames[BENCH_FRAMES][8];
+static volatile int64_t sink;
+
+/* ns per call of function(frame) over iterations frames */
+template <typename Function>
+static double timeFrames(long iterations, Function function) {
+  int64_t sum = 0;
+  int64_t start = OSPort::getTimeUs();
+  for (long i = 0; i < iterations; i++) {
+    sum += function(frames[i & (BENCH_FRAMES - 1)]);
+  }
+  double ns = (OSPort::getTimeUs() - start) * 1000.0 / iterations;
+  sink = sum;
+  return ns;
+}
+
+static void printTiming(const char *name, double layoutNs, double oldNs) {
+  printf("  %-22s %8.1f ns  %8.1f ns\n", name, layoutNs, oldNs);
+}
+
+static void timeCodec(long iterations) {
+  for (int i = 0; i < BENCH_FRAMES; i++) {
+    randomPayload(frames[i]);
+  }
+  printf("\n%ld frames, ns per frame\n", iterations);
+  printf("  %-22s %11s  %11s\n", "", "Layout", "Old shifts");
+
+  printTiming("decode DATA",
+              timeFrames(iterations, [](const uint8_t *data) {
+                int64_t raws[DATA_FIELDS];
+                decodeRaw(DATA_LAYOUT, data, raws);
+                return raws[DATA_VOLTAGE] + raws[DATA_CURRENT] + raws[DATA_TIMESTAMP];
+              }),
+              timeFrames(iterations, [](const uint8_t *data) {
+                OldData out = oldDecodeData(data);
+                return (int64_t)out.voltage + out.current + out.timestamp;
+              }));
+
+  printTiming("decode STATUS",
+              timeFrames(iterations, [](const uint8_t *data) {
+                int64_t raws[STATUS_FIELDS];
+                decodeRaw(STATUS_LAYOUT, data, raws);
+                int64_t sum = 0;
+                for (int i = 0; i < STATUS_FIELDS; i++) {
+                  sum += raws[i];
+                }
+                return sum;
+              }),
+              timeFrames(iterations, [](const uint8_t *data) {
+                OldStatus out = oldDecodeStatus(data);
+                return (int64_t)out.command + out.converterStatus + out.controlMode + out.normalMode +
+                       out.enableMode + out.loadMode + out.rvsMode + out.negative + out.positive + out.interlock;
+              }));
+
+  printTiming("decode STATION_ID",
+              timeFrames(iterations, [](const uint8_t *data) {
+                return decodeRaw(STATION_ID_LAYOUT.signals[STATION_ID], data);
+              }),
+              timeFrames(iterations, [](const uint8_t *data) {
+                return (int64_t)oldDecodeStationID(data);
+              }));
+
+  printTiming("encode COMMAND",
+              timeFrames(iterations, [](const uint8_t *data) {
+                uint8_t out[8];
+                encodeRaw(COMMAND_LAYOUT, out, {data[0], (int16_t)((data[1] << 8) | data[2]), data[3] & 3,
+                                                (data[3] >> 4) & 3});
+                return (int64_t)out[1] + out[3];
+              }),
+              timeFrames(iterations, [](const uint8_t *data) {
+                uint8_t out[8];
+                oldEncodeCommand(out, data[0], (int16_t)((data[1] << 8) | data[2]), data[3] & 3, (data[3] >> 4) & 3);
+                return (int64_t)out[1] + out[3];
+              }));
+
+  printTiming("encode LIMITS_OUT",
+              timeFrames(iterations, [](const uint8_t *data) {
+                uint8_t out[8];
+                encodeRaw(LIMITS_OUT_LAYOUT, out, {data[0], (int16_t)((data[1] << 8) | data[2]),
+                                                   (int16_t)((data[3] << 8) | data[4]),
+                                                   (int16_t)((data[5] << 8) | data[6])});
+                return (int64_t)out[2] + out[6];
+              }),
+              timeFrames(iterations, [](const uint8_t *data) {
+                uint8_t out[8];
+                oldEncodeLimits(out, data[0], (int16_t)((data[1] << 8) | data[2]), (int16_t)((data[3] << 8) | data[4]),
+                                (int16_t)((data[5] << 8) | data[6]));
+                return (int64_t)out[2] + out[6];
+              }));
+}
+
+int main(int argc, char **argv) {
+  long iterations = (argc > 1) ? atol(argv[1]) : 10000000;
+  if (iterations <= 0) {
+    return 1;
+  }
+  srand(1);
+  checkGoldenFrames();
+  checkOldShifts();
+  timeCodec(iterations);
+  printf("\n%s\n", passed ? "All layouts match the golden frames and the old shifts" : "ABC150CodecBench FAILED");
+  return passed ? 0 : 1;
+}
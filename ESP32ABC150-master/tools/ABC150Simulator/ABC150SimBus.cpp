@@ -0,0 +1,84 @@
+/*
+ * ABC150SimBus.cpp
+ */
+
+#include "ABC150SimBus.hpp"
+#include <string.h>
+#include <vector>
+
+#define BUS_STACK_SIZE              4096
+
+
+ABC150SimBus::ABC150SimBus() :
+                           can(driver),
+                           sim([this](const SimFrame &frame) { deliver(frame); }),
+                           delivered(0),
+                           dropped(0),
+                           taskHandle(NULL){
+}
+
+ABC150SimBus::~ABC150SimBus() {
+  if (taskHandle != NULL) {
+    OSPort::deleteTask(taskHandle);
+  }
+}
+
+bool ABC150SimBus::start(int priority) {
+  return OSPort::createTask(&ABC150SimBus::busTaskWrapper, "ABC150 bus", BUS_STACK_SIZE, this, priority,
+                            &taskHandle);
+}
+
+AmpleCAN &ABC150SimBus::getCAN() {
+  return can;
+}
+
+ABC150Simulator &ABC150SimBus::getSimulator() {
+  return sim;
+}
+
+void ABC150SimBus::setFilter(Filter _filter) {
+  filter = _filter;
+}
+
+uint32_t ABC150SimBus::getDelivered() {
+  return delivered;
+}
+
+uint32_t ABC150SimBus::getDropped() {
+  return dropped;
+}
+
+void ABC150SimBus::deliver(const SimFrame &frame) {
+  if (filter && !filter(frame)) {
+    dropped++;
+    return;
+  }
+  CAN_frame_t msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.MsgID = frame.id;
+  msg.FIR.B.FF = CAN_frame_std;
+  msg.FIR.B.DLC = frame.dlc;
+  memcpy(msg.data.u8, frame.data, sizeof(msg.data.u8));
+  can.receive(msg);
+  delivered++;
+}
+
+void ABC150SimBus::busTaskWrapper(void *arg) {
+  ABC150SimBus *obj = (ABC150SimBus *)arg;
+  obj->busTask();
+}
+
+void ABC150SimBus::busTask() {
+  while (1) {
+    OSPort::delay(1);
+    std::vector<CAN_frame_t> frames = driver.takeFrames();
+    for (size_t i = 0; i < frames.size(); i++) {
+      SimFrame frame;
+      frame.id = frames[i].MsgID;
+      frame.dlc = frames[i].FIR.B.DLC;
+      memcpy(frame.data, frames[i].data.u8, sizeof(frame.data));
+      sim.receive(frame);
+    }
+    sim.step(1);
+  }
+}
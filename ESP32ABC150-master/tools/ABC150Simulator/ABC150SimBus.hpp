@@ -0,0 +1,50 @@
+/*
+ * ABC150SimBus.hpp
+ *
+ * Puts the simulator on the other end of the CAN bus of the real
+ * ABC150CANHandler of the host build. Construct the handler on getCAN() and
+ * call start(). The bus task steps the simulator every ms; the frames the
+ * handler wrote reach the simulator at the start of the next ms, the
+ * simulator's frames go through AmpleCAN::receive() to msgReceived() from
+ * the bus task, like the receive task on the ESP32. Meant for virtual time.
+ */
+
+#ifndef _ABC150SIMBUS_HPP_
+#define _ABC150SIMBUS_HPP_
+
+#include "ABC150Simulator.hpp"
+#include "AmpleCAN.hpp"
+#include "OSPort.hpp"
+#include <functional>
+
+class ABC150SimBus {
+public:
+  /* Returns false to drop a simulator frame before it reaches the handler */
+  typedef std::function<bool(const SimFrame &frame)> Filter;
+
+  ABC150SimBus();
+  virtual ~ABC150SimBus();
+  /* Creates the bus task */
+  bool start(int priority = OSPORT_MAX_PRIORITIES-1);
+  AmpleCAN &getCAN();
+  ABC150Simulator &getSimulator();
+  void setFilter(Filter _filter);
+  /* Simulator frames passed to AmpleCAN::receive(), and dropped by the filter */
+  uint32_t getDelivered();
+  uint32_t getDropped();
+
+private:
+  CANDriver driver;
+  AmpleCAN can;
+  ABC150Simulator sim;
+  Filter filter;
+  uint32_t delivered;
+  uint32_t dropped;
+  OSPort::TaskHandle taskHandle;
+
+  void deliver(const SimFrame &frame);
+  static void busTaskWrapper(void *arg);
+  void busTask();
+};
+
+#endif /* _ABC150SIMBUS_HPP_ */
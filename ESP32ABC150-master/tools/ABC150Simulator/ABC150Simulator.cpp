@@ -0,0 +1,369 @@
+/*
+ * ABC150Simulator.cpp
+ */
+
+#include "ABC150Simulator.hpp"
+#include <math.h>
+
+#define HARDWARE_VERSION            0x0D
+#define SOFTWARE_VERSION            0x00010000
+#define STATION_ID_BASE             0x1500000000ULL
+
+#define DATA_PERIOD_MS              10
+#define STATUS_PERIOD_MS            100
+#define STATION_ID_PERIOD_MS        1000
+#define COMMAND_TIMEOUT_MS          2000
+
+/* Packet problem IDs, see ABC150CANHandler::Problem_ID */
+#define COMMAND_OUT_OF_LIMITS       0x01
+#define NOT_IN_REMOTE_CONTROL       0x20
+#define INVALID_STATION_ID          0x21
+
+
+BatteryModel::BatteryModel(double _capacityAh, double _emptyVoltage, double _fullVoltage,
+                           double _r0, double _r1, double _c1, double _soc) :
+                           capacityAh(_capacityAh),
+                           emptyVoltage(_emptyVoltage),
+                           fullVoltage(_fullVoltage),
+                           r0(_r0),
+                           r1(_r1),
+                           c1(_c1),
+                           soc(_soc),
+                           rcVoltage(0){
+}
+
+double BatteryModel::openCircuitVoltage() const {
+  return emptyVoltage + (fullVoltage - emptyVoltage) * soc;
+}
+
+double BatteryModel::terminalVoltage(double current) const {
+  return openCircuitVoltage() + rcVoltage + current * r0;
+}
+
+double BatteryModel::currentForVoltage(double voltage) const {
+  return (voltage - openCircuitVoltage() - rcVoltage) / r0;
+}
+
+double BatteryModel::currentForPower(double power) const {
+  /* r0 * I^2 + E * I - P = 0 */
+  double e = openCircuitVoltage() + rcVoltage;
+  double discriminant = e * e + 4 * r0 * power;
+  if (discriminant < 0) {
+    /* More discharge power than the battery can deliver */
+    return -e / (2 * r0);
+  }
+  return (-e + sqrt(discriminant)) / (2 * r0);
+}
+
+void BatteryModel::step(double current, double dtSeconds) {
+  soc += current * dtSeconds / (capacityAh * 3600);
+  if (soc < 0) soc = 0;
+  if (soc > 1) soc = 1;
+  rcVoltage += (current / c1 - rcVoltage / (r1 * c1)) * dtSeconds;
+}
+
+
+ABC150Simulator::ABC150Simulator(FrameSink _sink) :
+                                 commandTimeoutMs(COMMAND_TIMEOUT_MS),
+                                 powerGain(1),
+                                 responseTimeMs(0),
+                                 sink(_sink),
+                                 timeMs(0),
+                                 channels{}{
+  for (int i = 0; i < 2; i++) {
+    channels[i].converterStatus = Local;
+    channels[i].controlMode = Standby;
+    channels[i].loadMode = Independent;
+    channels[i].stationID = STATION_ID_BASE + i;
+    channels[i].voltage = channels[i].battery.terminalVoltage(0);
+  }
+}
+
+uint64_t ABC150Simulator::getTimeMs() const {
+  return timeMs;
+}
+
+BatteryModel &ABC150Simulator::getBattery(int channel) {
+  return channels[channel].battery;
+}
+
+float ABC150Simulator::getVoltage(int channel) const {
+  return channels[channel].voltage;
+}
+
+float ABC150Simulator::getCurrent(int channel) const {
+  return channels[channel].current;
+}
+
+ABC150Simulator::ConverterStatus ABC150Simulator::getConverterStatus(int channel) const {
+  return channels[channel].converterStatus;
+}
+
+void ABC150Simulator::regulate(ChannelState &ch) {
+  BatteryModel &battery = ch.battery;
+  float current = 0;
+
+  if (ch.converterStatus == Remote) {
+    switch (ch.controlMode) {
+    case Voltage:
+      current = battery.currentForVoltage(ch.command);
+      break;
+    case Current:
+      current = ch.command;
+      break;
+    case Power:
+      current = battery.currentForPower(ch.command * powerGain);
+      break;
+    default:
+      current = 0;
+      break;
+    }
+
+    if (ch.controlMode != Standby) {
+      /* Current limits, then voltage and power limits */
+      current = fminf(fmaxf(current, ch.lowerCurrentLimit), ch.upperCurrentLimit);
+      float voltage = battery.terminalVoltage(current);
+      if (voltage > ch.upperVoltageLimit) {
+        current = battery.currentForVoltage(ch.upperVoltageLimit);
+      } else if (voltage < ch.lowerVoltageLimit) {
+        current = battery.currentForVoltage(ch.lowerVoltageLimit);
+      }
+      float power = battery.terminalVoltage(current) * current;
+      if (power > ch.upperPowerLimit) {
+        current = battery.currentForPower(ch.upperPowerLimit);
+      } else if (power < ch.lowerPowerLimit) {
+        current = battery.currentForPower(ch.lowerPowerLimit);
+      }
+      current = fminf(fmaxf(current, ch.lowerCurrentLimit), ch.upperCurrentLimit);
+    }
+  }
+
+  if (responseTimeMs > 1) {
+    current = ch.current + (current - ch.current) / responseTimeMs;
+  }
+  battery.step(current, 0.001);
+  ch.current = current;
+  ch.voltage = battery.terminalVoltage(current);
+}
+
+void ABC150Simulator::step(uint32_t ms) {
+  for (uint32_t i = 0; i < ms; i++) {
+    timeMs++;
+    for (int channel = 0; channel < 2; channel++) {
+      ChannelState &ch = channels[channel];
+      if (ch.converterStatus == Remote && (timeMs - ch.lastCommandTime) > commandTimeoutMs) {
+        ch.converterStatus = Local;
+        ch.controlMode = Standby;
+      }
+      regulate(ch);
+      if (timeMs % DATA_PERIOD_MS == 0) {
+        sendData(channel);
+      }
+      if (timeMs % STATUS_PERIOD_MS == 0) {
+        sendStatus(channel);
+        sendLimits(channel);
+      }
+      if (timeMs % STATION_ID_PERIOD_MS == 0) {
+        sendStationID(channel);
+      }
+    }
+  }
+}
+
+void ABC150Simulator::send(uint32_t id, uint8_t dlc, const uint8_t *data) {
+  SimFrame frame;
+  frame.id = id;
+  frame.dlc = dlc;
+  memcpy(frame.data, data, sizeof(frame.data));
+  sink(frame);
+}
+
+void ABC150Simulator::sendGreeting() {
+  uint8_t data[8];
+  double values[ABC150Codec::GREETING_FIELDS];
+  values[ABC150Codec::GREETING_SW_VERSION] = SOFTWARE_VERSION;
+  values[ABC150Codec::GREETING_HW_VERSION] = HARDWARE_VERSION;
+  ABC150Codec::encode(ABC150Codec::GREETING_LAYOUT, data, values);
+  send(GREETING, ABC150Codec::GREETING_LAYOUT.dlc, data);
+}
+
+void ABC150Simulator::sendData(int channel) {
+  uint8_t data[8];
+  double values[ABC150Codec::DATA_FIELDS];
+  values[ABC150Codec::DATA_VOLTAGE] = channels[channel].voltage;
+  values[ABC150Codec::DATA_CURRENT] = channels[channel].current;
+  values[ABC150Codec::DATA_TIMESTAMP] = (uint32_t)timeMs;
+  ABC150Codec::encode(ABC150Codec::DATA_LAYOUT, data, values);
+  send(DATA_A + channel * CHANNEL_ID_STRIDE, ABC150Codec::DATA_LAYOUT.dlc, data);
+}
+
+void ABC150Simulator::sendStatus(int channel) {
+  ChannelState &ch = channels[channel];
+  uint8_t data[8];
+  double values[ABC150Codec::STATUS_FIELDS];
+  double scale = 1;
+  if (ch.controlMode == Voltage) scale = VOLTAGE_SCALE;
+  else if (ch.controlMode == Current) scale = CURRENT_SCALE;
+  else if (ch.controlMode == Power) scale = POWER_SCALE;
+  values[ABC150Codec::STATUS_COMMAND] = (ch.controlMode == Standby) ? 0 : (int64_t)(ch.command / scale);
+  values[ABC150Codec::STATUS_CONVERTER] = ch.converterStatus;
+  values[ABC150Codec::STATUS_CONTROL_MODE] = ch.controlMode;
+  values[ABC150Codec::STATUS_NORMAL_MODE] = 0;
+  values[ABC150Codec::STATUS_ENABLE_MODE] = (ch.controlMode == Standby) ? 1 : 0;
+  values[ABC150Codec::STATUS_LOAD_MODE] = ch.loadMode;
+  values[ABC150Codec::STATUS_RVS_MODE] = 0;
+  values[ABC150Codec::STATUS_CONNECTOR_NEGATIVE] = 1;
+  values[ABC150Codec::STATUS_CONNECTOR_POSITIVE] = 1;
+  values[ABC150Codec::STATUS_CONNECTOR_INTERLOCK] = 1;
+  ABC150Codec::encode(ABC150Codec::STATUS_LAYOUT, data, values);
+  send(STATUS_A + channel * CHANNEL_ID_STRIDE, ABC150Codec::STATUS_LAYOUT.dlc, data);
+}
+
+void ABC150Simulator::sendLimits(int channel) {
+  ChannelState &ch = channels[channel];
+  uint8_t data[8];
+  double values[ABC150Codec::LIMITS_FIELDS];
+  values[ABC150Codec::LIMITS_VOLTAGE] = ch.lowerVoltageLimit;
+  values[ABC150Codec::LIMITS_CURRENT] = ch.lowerCurrentLimit;
+  values[ABC150Codec::LIMITS_POWER] = ch.lowerPowerLimit;
+  ABC150Codec::encode(ABC150Codec::LIMITS_LAYOUT, data, values);
+  send(LOWER_LIMITS_A + channel * CHANNEL_ID_STRIDE, ABC150Codec::LIMITS_LAYOUT.dlc, data);
+  values[ABC150Codec::LIMITS_VOLTAGE] = ch.upperVoltageLimit;
+  values[ABC150Codec::LIMITS_CURRENT] = ch.upperCurrentLimit;
+  values[ABC150Codec::LIMITS_POWER] = ch.upperPowerLimit;
+  ABC150Codec::encode(ABC150Codec::LIMITS_LAYOUT, data, values);
+  send(UPPER_LIMITS_A + channel * CHANNEL_ID_STRIDE, ABC150Codec::LIMITS_LAYOUT.dlc, data);
+}
+
+void ABC150Simulator::sendStationID(int channel) {
+  uint8_t data[8];
+  double values[ABC150Codec::STATION_ID_FIELDS];
+  values[ABC150Codec::STATION_ID] = channels[channel].stationID;
+  ABC150Codec::encode(ABC150Codec::STATION_ID_LAYOUT, data, values);
+  send(STATION_ID_A + channel * CHANNEL_ID_STRIDE, ABC150Codec::STATION_ID_LAYOUT.dlc, data);
+}
+
+void ABC150Simulator::sendPacketProblem(uint8_t problem, uint8_t supp) {
+  uint8_t data[8];
+  double values[ABC150Codec::PROBLEM_FIELDS];
+  values[ABC150Codec::PROBLEM_ID] = problem;
+  values[ABC150Codec::PROBLEM_SUPP_ID] = supp;
+  ABC150Codec::encode(ABC150Codec::PACKET_PROBLEM_LAYOUT, data, values);
+  send(PACKET_PROBLEM, ABC150Codec::PACKET_PROBLEM_LAYOUT.dlc, data);
+}
+
+void ABC150Simulator::handleCommand(int channel, const SimFrame &frame) {
+  ChannelState &ch = channels[channel];
+  double values[ABC150Codec::COMMAND_FIELDS];
+  ABC150Codec::decode(ABC150Codec::COMMAND_LAYOUT, frame.data, values);
+  if (ch.converterStatus != Remote) {
+    sendPacketProblem(NOT_IN_REMOTE_CONTROL, channel);
+    return;
+  }
+  ch.lastCommandTime = timeMs;
+  ch.controlMode = (ControlMode)values[ABC150Codec::COMMAND_CONTROL_MODE];
+  if (values[ABC150Codec::COMMAND_LOAD_MODE] != Do_not_Change) {
+    ch.loadMode = (LoadMode)values[ABC150Codec::COMMAND_LOAD_MODE];
+  }
+  double value = values[ABC150Codec::COMMAND_VALUE];
+  switch (ch.controlMode) {
+  case Voltage:
+    ch.command = value * VOLTAGE_SCALE;
+    if (ch.command < ch.lowerVoltageLimit || ch.command > ch.upperVoltageLimit) {
+      sendPacketProblem(COMMAND_OUT_OF_LIMITS, channel);
+    }
+    break;
+  case Current:
+    ch.command = value * CURRENT_SCALE;
+    if (ch.command < ch.lowerCurrentLimit || ch.command > ch.upperCurrentLimit) {
+      sendPacketProblem(COMMAND_OUT_OF_LIMITS, channel);
+    }
+    break;
+  case Power:
+    ch.command = value * POWER_SCALE;
+    if (ch.command < ch.lowerPowerLimit || ch.command > ch.upperPowerLimit) {
+      sendPacketProblem(COMMAND_OUT_OF_LIMITS, channel);
+    }
+    break;
+  default:
+    ch.command = 0;
+    break;
+  }
+}
+
+void ABC150Simulator::handleLimits(int channel, bool upper, const SimFrame &frame) {
+  ChannelState &ch = channels[channel];
+  double values[ABC150Codec::LIMITS_OUT_FIELDS];
+  ABC150Codec::decode(ABC150Codec::LIMITS_OUT_LAYOUT, frame.data, values);
+  if (ch.converterStatus != Remote) {
+    sendPacketProblem(NOT_IN_REMOTE_CONTROL, channel);
+    return;
+  }
+  if (upper) {
+    ch.upperVoltageLimit = values[ABC150Codec::LIMITS_OUT_VOLTAGE];
+    ch.upperCurrentLimit = values[ABC150Codec::LIMITS_OUT_CURRENT];
+    ch.upperPowerLimit = values[ABC150Codec::LIMITS_OUT_POWER];
+  } else {
+    ch.lowerVoltageLimit = values[ABC150Codec::LIMITS_OUT_VOLTAGE];
+    ch.lowerCurrentLimit = values[ABC150Codec::LIMITS_OUT_CURRENT];
+    ch.lowerPowerLimit = values[ABC150Codec::LIMITS_OUT_POWER];
+  }
+}
+
+void ABC150Simulator::handleChangeControl(const SimFrame &frame) {
+  double values[ABC150Codec::CHANGE_CONTROL_FIELDS];
+  ABC150Codec::decode(ABC150Codec::CHANGE_CONTROL_LAYOUT, frame.data, values);
+  int channel = values[ABC150Codec::CHANGE_CONTROL_CHANNEL];
+  ChannelState &ch = channels[channel];
+  if ((uint64_t)values[ABC150Codec::CHANGE_CONTROL_STATION_ID] != ch.stationID) {
+    sendPacketProblem(INVALID_STATION_ID, channel);
+    return;
+  }
+  ch.converterStatus = (ConverterStatus)values[ABC150Codec::CHANGE_CONTROL_TO];
+  ch.lastCommandTime = timeMs;
+  sendStatus(channel);
+}
+
+void ABC150Simulator::handleRequest(const SimFrame &frame) {
+  double values[ABC150Codec::REQUEST_FIELDS];
+  ABC150Codec::decode(ABC150Codec::REQUEST_LAYOUT, frame.data, values);
+  switch ((uint32_t)values[ABC150Codec::REQUEST_CAN_ID]) {
+  case GREETING:
+    sendGreeting();
+    break;
+  case STATION_ID_A:
+    sendStationID(0);
+    break;
+  case STATION_ID_B:
+    sendStationID(1);
+    break;
+  default:
+    break;
+  }
+}
+
+void ABC150Simulator::receive(const SimFrame &frame) {
+  switch (frame.id) {
+  case COMMAND_A:
+  case COMMAND_B:
+    handleCommand((frame.id - COMMAND_A) / CHANNEL_ID_STRIDE, frame);
+    break;
+  case LOWER_LIMITS_A_OUT:
+  case LOWER_LIMITS_B_OUT:
+    handleLimits((frame.id - LOWER_LIMITS_A_OUT) / CHANNEL_ID_STRIDE, false, frame);
+    break;
+  case UPPER_LIMITS_A_OUT:
+  case UPPER_LIMIT_B_OUT:
+    handleLimits((frame.id - UPPER_LIMITS_A_OUT) / CHANNEL_ID_STRIDE, true, frame);
+    break;
+  case CHANGE_CONTROL:
+    handleChangeControl(frame);
+    break;
+  case REQUEST_ABC:
+    handleRequest(frame);
+    break;
+  case PC_GREETING:
+  default:
+    break;
+  }
+}
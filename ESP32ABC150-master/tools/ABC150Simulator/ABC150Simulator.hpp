@@ -0,0 +1,110 @@
+/*
+ * ABC150Simulator.hpp
+ *
+ * Host-side model of the ABC150 power supply. It consumes the PC → PPS
+ * frames of the protocol in ABC150CANHandler.cpp, regulates each channel in
+ * voltage, current or power mode against a battery RC model and produces the
+ * PPS → PC frames. Time only advances through step(), so a simulation runs
+ * as fast as the host can compute it.
+ */
+
+#ifndef _ABC150SIMULATOR_HPP_
+#define _ABC150SIMULATOR_HPP_
+
+#include "ABC150Codec.hpp"
+#include <functional>
+
+struct SimFrame {
+  uint32_t id;
+  uint8_t dlc;
+  uint8_t data[8];
+};
+
+/* Open circuit voltage linear in SOC, series resistance and one RC pair.
+ * Double precision, a 1 ms SOC step is below the resolution of a float. */
+class BatteryModel {
+public:
+  BatteryModel(double _capacityAh = 60, double _emptyVoltage = 240, double _fullVoltage = 403.2,
+               double _r0 = 0.1, double _r1 = 0.05, double _c1 = 2000, double _soc = 0.5);
+  double openCircuitVoltage() const;
+  double terminalVoltage(double current) const;
+  double currentForVoltage(double voltage) const;
+  double currentForPower(double power) const;
+  /* Positive current charges the battery */
+  void step(double current, double dtSeconds);
+
+  double capacityAh;
+  double emptyVoltage;
+  double fullVoltage;
+  double r0;
+  double r1;
+  double c1;
+  double soc;
+  double rcVoltage;
+};
+
+class ABC150Simulator {
+public:
+  enum ConverterStatus          {Local, Remote, J1850};
+  enum ControlMode              {Voltage, Current, Power, Standby};
+  enum LoadMode                 {Independent, Parallel, Differential, Do_not_Change};
+
+  typedef std::function<void(const SimFrame &frame)> FrameSink;
+
+  ABC150Simulator(FrameSink _sink);
+  /* PC → PPS frame */
+  void receive(const SimFrame &frame);
+  /* Advance virtual time in 1 ms steps */
+  void step(uint32_t ms);
+  uint64_t getTimeMs() const;
+
+  BatteryModel &getBattery(int channel);
+  float getVoltage(int channel) const;
+  float getCurrent(int channel) const;
+  ConverterStatus getConverterStatus(int channel) const;
+
+  /* Time without COMMAND_x after which a channel falls back to local control */
+  uint32_t commandTimeoutMs;
+  /* Delivered / commanded power in power control, 1 is ideal */
+  float powerGain;
+  /* Time constant of the output current, 0 follows the command at once */
+  float responseTimeMs;
+
+private:
+  struct ChannelState {
+    ConverterStatus converterStatus;
+    ControlMode controlMode;
+    LoadMode loadMode;
+    float command;
+    float lowerVoltageLimit;
+    float lowerCurrentLimit;
+    float lowerPowerLimit;
+    float upperVoltageLimit;
+    float upperCurrentLimit;
+    float upperPowerLimit;
+    float voltage;
+    float current;
+    uint64_t stationID;
+    uint64_t lastCommandTime;
+    BatteryModel battery;
+  };
+
+  FrameSink sink;
+  uint64_t timeMs;
+  ChannelState channels[2];
+
+  void regulate(ChannelState &ch);
+  void send(uint32_t id, uint8_t dlc, const uint8_t *data);
+  void sendGreeting();
+  void sendData(int channel);
+  void sendStatus(int channel);
+  void sendLimits(int channel);
+  void sendStationID(int channel);
+  void sendPacketProblem(uint8_t problem, uint8_t supp);
+  void handleCommand(int channel, const SimFrame &frame);
+  void handleLimits(int channel, bool upper, const SimFrame &frame);
+  void handleChangeControl(const SimFrame &frame);
+  void handleRequest(const SimFrame &frame);
+};
+
+#endif /* _ABC150SIMULATOR_HPP_ */
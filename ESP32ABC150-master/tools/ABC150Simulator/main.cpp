@@ -0,0 +1,229 @@
+/*
+ * main.cpp
+ *
+ * Runs one capacity cycle of channel A against the simulator: handshake,
+ * CC charge, CV charge until the current tapers off, rest, CC discharge and
+ * rest. The PC side sends the same frames as ABC150CANHandler.
+ */
+
+#include "ABC150Simulator.hpp"
+#include <stdio.h>
+#include <chrono>
+
+#define PACKAGE_PERIOD_MS           500
+#define WAIT_TIME_MS                900000
+#define CHARGE_CURRENT              6
+#define CV_END_CURRENT              0.2
+#define MAX_VOLTAGE                 403.2
+#define MIN_VOLTAGE                 240
+#define BATTERY_CAPACITY_AH         6
+
+class PC {
+public:
+  enum State {Greeting, ChangeControl, Charge, ChargeCV, WaitCharged, Discharge, WaitDischarged, Done};
+
+  PC(ABC150Simulator &_sim) : sim(_sim), state(Greeting), counter(0), stationID(0),
+                              abcDetected(false), remote(false), voltage(0), current(0),
+                              ah(0), stateTime(0), lastPackage(0),
+                              mode(ABC150Simulator::Standby), command(0){}
+
+  void receive(const SimFrame &frame) {
+    switch (frame.id) {
+    case GREETING:
+      abcDetected = true;
+      break;
+    case STATION_ID_A: {
+      double values[ABC150Codec::STATION_ID_FIELDS];
+      ABC150Codec::decode(ABC150Codec::STATION_ID_LAYOUT, frame.data, values);
+      stationID = values[ABC150Codec::STATION_ID];
+      break;
+    }
+    case DATA_A: {
+      double values[ABC150Codec::DATA_FIELDS];
+      ABC150Codec::decode(ABC150Codec::DATA_LAYOUT, frame.data, values);
+      voltage = values[ABC150Codec::DATA_VOLTAGE];
+      current = values[ABC150Codec::DATA_CURRENT];
+      break;
+    }
+    case STATUS_A: {
+      double values[ABC150Codec::STATUS_FIELDS];
+      ABC150Codec::decode(ABC150Codec::STATUS_LAYOUT, frame.data, values);
+      remote = values[ABC150Codec::STATUS_CONVERTER] == ABC150Simulator::Remote;
+      break;
+    }
+    case PACKET_PROBLEM: {
+      double values[ABC150Codec::PROBLEM_FIELDS];
+      ABC150Codec::decode(ABC150Codec::PACKET_PROBLEM_LAYOUT, frame.data, values);
+      printf("Packet problem 0x%02X supp %d\n", (int)values[ABC150Codec::PROBLEM_ID], (int)values[ABC150Codec::PROBLEM_SUPP_ID]);
+      break;
+    }
+    default:
+      break;
+    }
+  }
+
+  /* Called once per simulated millisecond */
+  void loop() {
+    uint64_t now = sim.getTimeMs();
+    ah += current / 3600000.0;
+
+    switch (state) {
+    case Greeting:
+      if (abcDetected) {
+        enterState(ChangeControl);
+      } else if (now - lastPackage >= PACKAGE_PERIOD_MS) {
+        lastPackage = now;
+        sendRequest(GREETING);
+      }
+      return;
+    case ChangeControl:
+      if (remote) {
+        printf("%8.1f s: remote control, station ID 0x%010llX\n", now / 1000.0, (unsigned long long)stationID);
+        enterState(Charge);
+      } else if (stationID && now - lastPackage >= PACKAGE_PERIOD_MS) {
+        lastPackage = now;
+        sendChangeControl();
+      }
+      return;
+    case Charge:
+      mode = ABC150Simulator::Current;
+      command = CHARGE_CURRENT;
+      if (voltage >= MAX_VOLTAGE - 0.1) {
+        enterState(ChargeCV);
+      }
+      break;
+    case ChargeCV:
+      mode = ABC150Simulator::Voltage;
+      command = MAX_VOLTAGE;
+      if (now - stateTime > 1000 && current < CV_END_CURRENT) {
+        enterState(WaitCharged);
+      }
+      break;
+    case WaitCharged:
+      mode = ABC150Simulator::Standby;
+      command = 0;
+      if (now - stateTime >= WAIT_TIME_MS) {
+        ah = 0;
+        enterState(Discharge);
+      }
+      break;
+    case Discharge:
+      mode = ABC150Simulator::Current;
+      command = -CHARGE_CURRENT;
+      if (voltage <= MIN_VOLTAGE + 0.1) {
+        printf("%8.1f s: discharged %.2f Ah\n", now / 1000.0, -ah);
+        enterState(WaitDischarged);
+      }
+      break;
+    case WaitDischarged:
+      mode = ABC150Simulator::Standby;
+      command = 0;
+      if (now - stateTime >= WAIT_TIME_MS) {
+        enterState(Done);
+      }
+      break;
+    case Done:
+      return;
+    }
+
+    if (now - lastPackage >= PACKAGE_PERIOD_MS) {
+      lastPackage = now;
+      sendPackage();
+    }
+  }
+
+  bool done() {
+    return state == Done;
+  }
+
+private:
+  ABC150Simulator &sim;
+  State state;
+  uint8_t counter;
+  uint64_t stationID;
+  bool abcDetected;
+  bool remote;
+  float voltage;
+  float current;
+  double ah;
+  uint64_t stateTime;
+  uint64_t lastPackage;
+  ABC150Simulator::ControlMode mode;
+  float command;
+
+  void enterState(State newState) {
+    static const char *names[] = {"Greeting", "ChangeControl", "Charge", "ChargeCV",
+                                  "WaitCharged", "Discharge", "WaitDischarged", "Done"};
+    printf("%8.1f s: %s, %.2f V %.2f A\n", sim.getTimeMs() / 1000.0, names[newState], voltage, current);
+    state = newState;
+    stateTime = sim.getTimeMs();
+  }
+
+  void sendRequest(uint32_t id) {
+    SimFrame frame = {REQUEST_ABC, ABC150Codec::REQUEST_LAYOUT.dlc, {}};
+    double values[ABC150Codec::REQUEST_FIELDS] = {(double)id};
+    ABC150Codec::encode(ABC150Codec::REQUEST_LAYOUT, frame.data, values);
+    sim.receive(frame);
+  }
+
+  void sendChangeControl() {
+    SimFrame frame = {CHANGE_CONTROL, ABC150Codec::CHANGE_CONTROL_LAYOUT.dlc, {}};
+    double values[ABC150Codec::CHANGE_CONTROL_FIELDS];
+    values[ABC150Codec::CHANGE_CONTROL_CHANNEL] = 0;
+    values[ABC150Codec::CHANGE_CONTROL_FROM] = ABC150Simulator::Local;
+    values[ABC150Codec::CHANGE_CONTROL_TO] = ABC150Simulator::Remote;
+    values[ABC150Codec::CHANGE_CONTROL_HW_ID] = 0x0D;
+    values[ABC150Codec::CHANGE_CONTROL_STATION_ID] = stationID;
+    ABC150Codec::encode(ABC150Codec::CHANGE_CONTROL_LAYOUT, frame.data, values);
+    sim.receive(frame);
+  }
+
+  void sendLimits(uint32_t id, float voltageLimit, float currentLimit, float powerLimit) {
+    SimFrame frame = {id, ABC150Codec::LIMITS_OUT_LAYOUT.dlc, {}};
+    double values[ABC150Codec::LIMITS_OUT_FIELDS];
+    values[ABC150Codec::LIMITS_OUT_COUNTER] = counter;
+    values[ABC150Codec::LIMITS_OUT_VOLTAGE] = voltageLimit;
+    values[ABC150Codec::LIMITS_OUT_CURRENT] = currentLimit;
+    values[ABC150Codec::LIMITS_OUT_POWER] = powerLimit;
+    ABC150Codec::encode(ABC150Codec::LIMITS_OUT_LAYOUT, frame.data, values);
+    sim.receive(frame);
+  }
+
+  void sendPackage() {
+    sendLimits(LOWER_LIMITS_A_OUT, MIN_VOLTAGE - 10, -50, -20000);
+    sendLimits(UPPER_LIMITS_A_OUT, MAX_VOLTAGE + 10, 50, 20000);
+
+    SimFrame frame = {COMMAND_A, ABC150Codec::COMMAND_LAYOUT.dlc, {}};
+    double values[ABC150Codec::COMMAND_FIELDS];
+    double scale = (mode == ABC150Simulator::Voltage) ? VOLTAGE_SCALE :
+                   (mode == ABC150Simulator::Power) ? POWER_SCALE : CURRENT_SCALE;
+    values[ABC150Codec::COMMAND_COUNTER] = counter++;
+    values[ABC150Codec::COMMAND_VALUE] = (int16_t)(command / scale);
+    values[ABC150Codec::COMMAND_CONTROL_MODE] = mode;
+    values[ABC150Codec::COMMAND_LOAD_MODE] = ABC150Simulator::Independent;
+    ABC150Codec::encode(ABC150Codec::COMMAND_LAYOUT, frame.data, values);
+    sim.receive(frame);
+  }
+};
+
+int main() {
+  PC *pc = NULL;
+  ABC150Simulator sim([&pc](const SimFrame &frame) {
+    if (pc) pc->receive(frame);
+  });
+  PC client(sim);
+  pc = &client;
+  /* Small module so one full cycle stays short */
+  sim.getBattery(0).capacityAh = BATTERY_CAPACITY_AH;
+  setvbuf(stdout, NULL, _IOLBF, 0);
+
+  auto start = std::chrono::steady_clock::now();
+  while (!client.done()) {
+    sim.step(1);
+    client.loop();
+  }
+  double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  double simulated = sim.getTimeMs() / 1000.0;
+  printf("Simulated %.1f s in %.2f s wall clock, speedup %.0fx\n", simulated, wall, simulated / wall);
+  return 0;
+}
@@ -0,0 +1,292 @@
+/*
+ * main.cpp
+ *
+ * Checks AsyncConsole and shows what it does to the plate control loop.
+ *
+ * First the ring on its own, in real threads: the plate and debug log lines
+ * must format like printf, and producers hammering the ring from several
+ * threads while one thread drains it must lose nothing but the counted drops,
+ * with every producer's records in order and intact.
+ *
+ * Then, in virtual time, a 20 ms control job on TestScheduler prints its line
+ * every step like PlateDriveCycleTest::loopPlate and a 1 s timer prints the
+ * battery line like ABC150TestManager::debugLog, three ways: no output,
+ * printf straight to a 115200 baud UART that one writer holds at a time like
+ * stdout, and through AsyncConsole. Finally a burst of records much larger
+ * than the ring must return at once and count its drops.
+ *
+ * Exits with 1 if a check fails or the control loop's start jitter, response
+ * time or overruns with the console differ from those without output.
+ *
+ *   AsyncConsoleBench [seconds]     default 60
+ */
+
+#include "AsyncConsole.hpp"
+#include "JitterHistogram.hpp"
+#include "TestScheduler.hpp"
+#include "OSPort.hpp"
+#include "OSPortHost.hpp"
+#include <atomic>
+#include <thread>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UART_BAUD                   115200
+/* Start, 8 data and stop bit */
+#define UART_BITS_PER_BYTE          10
+#define CONTROL_PERIOD_MS           20
+#define CONTROL_EXEC_MS             2
+#define DEBUG_LOG_PERIOD_MS         1000
+#define STRESS_PRODUCERS            4
+#define STRESS_RECORDS              20000
+#define BURST_RECORDS               1000
+
+#define PLATE_FORMAT                "%f\t|\t%f\t|\t%f\t|\t%c\t|\t%f\t|\t%f\t|\t%f\t|\t\n"
+#define DEBUG_LOG_FORMAT            "%.02fV | %.02fA | %.02f%% | %d online | %d HV_ON | %.02fC_Max | %.02fC_Avg | " \
+                                    "%.02fkw_AP | %.02fkwh_AE | %.02fkw_CP\r\n"
+
+/* Formatting */
+
+static char lastLine[CONSOLE_LINE_SIZE];
+
+static void captureWriter(const char *text, size_t length) {
+  memcpy(lastLine, text, length);
+  lastLine[length] = 0;
+}
+
+static bool checkFormat(AsyncConsole &console, const char *expected, const char *name) {
+  console.drain();
+  bool ok = strcmp(lastLine, expected) == 0;
+  printf("  %-28s %s\n", name, ok ? "ok" : "WRONG");
+  if (!ok) {
+    printf("    got      %s\n    expected %s\n", lastLine, expected);
+  }
+  return ok;
+}
+
+static bool checkFormats() {
+  AsyncConsole console;
+  console.setWriter(&captureWriter);
+  char expected[CONSOLE_LINE_SIZE];
+  bool passed = true;
+  printf("Formatting\n");
+
+  float plate[] = {35.5f, 61.25f, -40.125f, -35.5f, -122.75f, 3.75f};
+  console.print(PLATE_FORMAT, plate[0], plate[1], plate[2], 'D', plate[3], plate[4], plate[5]);
+  snprintf(expected, sizeof(expected), PLATE_FORMAT, plate[0], plate[1], plate[2], 'D', plate[3], plate[4], plate[5]);
+  passed = checkFormat(console, expected, "plate line") && passed;
+
+  console.print(DEBUG_LOG_FORMAT, 403.2f, -12.5f, 87.25f, 16, 16, 31.5f, 28.25f, 70.0f, 51.2f, 45.5f);
+  snprintf(expected, sizeof(expected), DEBUG_LOG_FORMAT, 403.2f, -12.5f, 87.25f, 16, 16, 31.5f, 28.25f, 70.0f, 51.2f,
+           45.5f);
+  passed = checkFormat(console, expected, "debug log line") && passed;
+
+  int64_t big = -1234567890123LL;
+  uint32_t counter = 4000000000u;
+  console.print("%-6s|%5d|%u|%lld|%08x|%c|%e|%%\r\n", "abc", -42, counter, big, 0xBEEFu, 'x', 1.5e-7);
+  snprintf(expected, sizeof(expected), "%-6s|%5d|%u|%lld|%08x|%c|%e|%%\r\n", "abc", -42, counter, (long long)big,
+           0xBEEFu, 'x', 1.5e-7);
+  passed = checkFormat(console, expected, "widths, lengths, %%") && passed;
+  printf("\n");
+  return passed;
+}
+
+/* Many producers, one consumer */
+
+static std::atomic<uint32_t> stressWritten;
+static uint32_t lastSeq[STRESS_PRODUCERS];
+static std::atomic<bool> stressBroken;
+
+static void stressWriter(const char *text, size_t) {
+  unsigned producer, seq, check;
+  if (text[0] == '[') {
+    return;
+  }
+  if (sscanf(text, "%u %u %u", &producer, &seq, &check) != 3 || producer >= STRESS_PRODUCERS ||
+      check != (producer * 7919u + seq) % 100000u || seq <= lastSeq[producer]) {
+    stressBroken = true;
+    return;
+  }
+  lastSeq[producer] = seq;
+  stressWritten++;
+}
+
+static bool checkStress() {
+  AsyncConsole console;
+  console.setWriter(&stressWriter);
+  std::atomic<uint32_t> accepted(0);
+  std::atomic<bool> done(false);
+  std::thread consumer([&]() {
+    while (!done) {
+      console.drain();
+    }
+    console.drain();
+  });
+  std::thread producers[STRESS_PRODUCERS];
+  for (unsigned p = 0; p < STRESS_PRODUCERS; p++) {
+    producers[p] = std::thread([&, p]() {
+      for (unsigned seq = 1; seq <= STRESS_RECORDS; seq++) {
+        if (console.print("%u %u %u\n", p, seq, (p * 7919u + seq) % 100000u)) {
+          accepted++;
+        } else {
+          /* Give the consumer a chance on a single core host */
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (unsigned p = 0; p < STRESS_PRODUCERS; p++) {
+    producers[p].join();
+  }
+  done = true;
+  consumer.join();
+
+  uint32_t total = STRESS_PRODUCERS * STRESS_RECORDS;
+  bool passed = !stressBroken && stressWritten == accepted && accepted + console.getDropped() == total &&
+                console.getWritten() == accepted;
+  printf("Stress, %d producers\n  %u records, %u written, %u dropped, %s\n\n", STRESS_PRODUCERS, total,
+         stressWritten.load(), console.getDropped(), passed ? "in order and intact" : "WRONG");
+  return passed;
+}
+
+/* Control loop next to console output, in virtual time */
+
+enum Mode {Silent, Blocking, Async};
+static const char *modeNames[] = {"no output", "printf to the UART", "AsyncConsole"};
+
+static OSPort::Mutex uartMutex;
+static uint64_t uartBytes;
+
+/* Transmits like printf on a blocking UART, one writer at a time */
+static void uartWriter(const char *, size_t length) {
+  OSPort::lock(uartMutex);
+  uartBytes += length;
+  uint32_t bits = length * UART_BITS_PER_BYTE;
+  OSPort::delay((bits * 1000 + UART_BAUD - 1) / UART_BAUD);
+  OSPort::unlock(uartMutex);
+}
+
+struct Loop {
+  Mode mode;
+  AsyncConsole *console;
+  JitterHistogram jitter;
+  int64_t lastStartUs;
+  uint32_t steps;
+};
+
+static Loop loop;
+
+template <typename... Args>
+static void output(const char *format, Args... args) {
+  if (loop.mode == Blocking) {
+    char text[CONSOLE_LINE_SIZE];
+    int length = snprintf(text, sizeof(text), format, args...);
+    uartWriter(text, length);
+  } else if (loop.mode == Async) {
+    loop.console->print(format, args...);
+  }
+}
+
+static bool controlJob(void *) {
+  int64_t now = OSPort::getTimeUs();
+  if (loop.lastStartUs != 0) {
+    loop.jitter.record(now - loop.lastStartUs, CONTROL_PERIOD_MS * 1000);
+  }
+  loop.lastStartUs = now;
+  loop.steps++;
+  OSPort::delay(CONTROL_EXEC_MS);
+  float step = loop.steps * 0.02f;
+  output(PLATE_FORMAT, 35.5f + step, 61.25f, -40.125f, 'D', -35.5f - step, -122.75f, 3.75f);
+  return true;
+}
+
+static void debugLog(void *) {
+  output(DEBUG_LOG_FORMAT, 403.2f, -12.5f, 87.25f, 16, 16, 31.5f, 28.25f, 70.0f, 51.2f, 45.5f);
+}
+
+struct LoopResult {
+  uint32_t maxJitterUs;
+  uint32_t maxResponseUs;
+  uint32_t overruns;
+};
+
+static LoopResult runLoop(Mode mode, AsyncConsole &console, TestScheduler &scheduler, int job, uint32_t seconds) {
+  loop.mode = mode;
+  loop.console = &console;
+  loop.jitter.reset();
+  loop.lastStartUs = 0;
+  loop.steps = 0;
+  uartBytes = 0;
+  uint32_t droppedBefore = console.getDropped();
+  scheduler.resetStats();
+  OSPort::Timer timer = OSPort::createTimer("debugLog", DEBUG_LOG_PERIOD_MS, true, &debugLog, NULL);
+  OSPort::startTimer(timer);
+  scheduler.activate(job);
+  OSPort::delay(seconds * 1000);
+  scheduler.deactivate(job);
+  OSPort::stopTimer(timer);
+  /* Let the UART drain */
+  OSPort::delay(1000);
+
+  LoopResult result = {loop.jitter.getMaxUs(), scheduler.getMaxResponseUs(job), scheduler.getOverruns(job)};
+  printf("  %-20s %-9u %-15u %-15u %-9u %-10llu %u\n", modeNames[mode], loop.steps, result.maxJitterUs,
+         result.maxResponseUs, result.overruns, (unsigned long long)uartBytes, console.getDropped() - droppedBefore);
+  return result;
+}
+
+static bool checkBurst(AsyncConsole &console) {
+  loop.mode = Async;
+  uint32_t droppedBefore = console.getDropped();
+  uint32_t writtenBefore = console.getWritten();
+  int64_t start = OSPort::getTimeUs();
+  uint32_t accepted = 0;
+  for (int i = 0; i < BURST_RECORDS; i++) {
+    if (console.print(PLATE_FORMAT, 1.0f, 2.0f, 3.0f, 'C', 4.0f, 5.0f, (float)i)) {
+      accepted++;
+    }
+  }
+  int64_t blockedUs = OSPort::getTimeUs() - start;
+  OSPort::delay(5000);
+  uint32_t dropped = console.getDropped() - droppedBefore;
+  uint32_t written = console.getWritten() - writtenBefore;
+  bool passed = blockedUs == 0 && accepted == CONSOLE_RECORDS && dropped == BURST_RECORDS - accepted &&
+                written == accepted;
+  printf("\nBurst of %d records: returned after %lld us, %u written, %u dropped, %s\n", BURST_RECORDS,
+         (long long)blockedUs, written, dropped, passed ? "ok" : "WRONG");
+  return passed;
+}
+
+int main(int argc, char **argv) {
+  int seconds = (argc > 1) ? atoi(argv[1]) : 60;
+  if (seconds <= 0) {
+    return 1;
+  }
+  bool passed = checkFormats();
+  passed = checkStress() && passed;
+
+  OSPortHost::enableVirtualTime();
+  uartMutex = OSPort::createMutex();
+  AsyncConsole console;
+  console.setWriter(&uartWriter);
+  console.start();
+  TestScheduler scheduler;
+  scheduler.start();
+  int job = scheduler.addJob("plate", &controlJob, NULL, TestScheduler::Control, CONTROL_PERIOD_MS,
+                             CONTROL_PERIOD_MS);
+
+  printf("Control loop, %d ms period, %d s\n", CONTROL_PERIOD_MS, seconds);
+  printf("  %-20s %-9s %-15s %-15s %-9s %-10s %s\n", "Output", "Steps", "Start jitter us", "Max response us",
+         "Overruns", "UART bytes", "Dropped");
+  LoopResult silent = runLoop(Silent, console, scheduler, job, seconds);
+  runLoop(Blocking, console, scheduler, job, seconds);
+  LoopResult async = runLoop(Async, console, scheduler, job, seconds);
+  bool flat = async.maxJitterUs == silent.maxJitterUs && async.maxResponseUs == silent.maxResponseUs &&
+              async.overruns == silent.overruns;
+  passed = flat && passed;
+  passed = checkBurst(console) && passed;
+
+  printf("%s\n", passed ? "Control loop timing is the same with console output as without" :
+                          "AsyncConsole checks FAILED");
+  return passed ? 0 : 1;
+}
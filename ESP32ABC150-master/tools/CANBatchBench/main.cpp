@@ -0,0 +1,186 @@
+/*
+ * main.cpp
+ *
+ * Counts the SPI transactions the real ABC150CANHandler of the host build
+ * costs the MCP2515 per command package, in virtual time. Two handlers run
+ * the same setpoints on the register model of the host MCP2515 driver:
+ *
+ *  - batch: writeFrames() of the driver, one READ STATUS, one WRITE of all
+ *    free transmit buffers and one RTS per batch
+ *  - per frame: the default writeFrames(), one CAN_write_frame() per frame
+ *    with READ STATUS, LOAD TX BUFFER and RTS each
+ *
+ * Both channels are put in remote control with STATUS frames and
+ * takeControl() and get a new setpoint every SETPOINT_PERIOD_MS, so each
+ * handler sends both packages every SEND_MIN_INTERVAL_MS. Checks that
+ *
+ *  - a package costs 3 SPI transactions batched and 9 per frame
+ *  - no frame finds the transmit buffers full
+ *  - every frame written leaves the bus, batched in the order written
+ *
+ * Prints SPI transactions and bytes per package and the frames that left the
+ * bus out of write order. Exits with 1 if a check fails.
+ *
+ *   CANBatchBench [cycles]     default 500
+ */
+
+#include "ABC150CANHandler.hpp"
+#include "ABC150Codec.hpp"
+#include "MCP2515_CAN.hpp"
+#include "ESP32_CAN.hpp"
+#include "OSPort.hpp"
+#include "OSPortHost.hpp"
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* As in ABC150CANHandler.cpp */
+#define SEND_MIN_INTERVAL_MS        10
+#define PACKAGE_FRAMES              3
+#define SETPOINT_PERIOD_MS          5
+#define CHANNELS                    2
+#define POWER_W                     -1000.0f
+/* READ STATUS, WRITE, RTS per batch and per frame READ STATUS, LOAD TX BUFFER, RTS */
+#define BATCH_TRANSACTIONS          3
+#define FRAME_TRANSACTIONS          3
+
+static bool passed = true;
+
+/* The MCP2515 driver without its batch write */
+
+class PerFrameMCP2515 : public MCP2515_CAN {
+public:
+  PerFrameMCP2515() : MCP2515_CAN(CAN_SPEED_250KBPS, 1) {}
+
+  int writeFrames(const CAN_frame_t *frames, int count) {
+    return CANDriver::writeFrames(frames, count);
+  }
+};
+
+struct Path {
+  const char *name;
+  MCP2515_CAN &driver;
+  ABC150CANHandler &handler;
+  uint32_t startTransactions;
+  uint32_t startBytes;
+  std::vector<CAN_frame_t> written;
+  std::vector<CAN_frame_t> transmitted;
+
+  Path(const char *_name, MCP2515_CAN &_driver, ABC150CANHandler &_handler) :
+       name(_name), driver(_driver), handler(_handler), startTransactions(0), startBytes(0) {}
+};
+
+static void putInRemoteControl(ABC150CANHandler &handler) {
+  for (int channel = 0; channel < CHANNELS; channel++) {
+    CAN_frame_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.MsgID = STATUS_A + channel * CHANNEL_ID_STRIDE;
+    msg.FIR.B.FF = CAN_frame_std;
+    msg.FIR.B.DLC = ABC150Codec::STATUS_LAYOUT.dlc;
+    int64_t raws[ABC150Codec::STATUS_FIELDS] = {0};
+    raws[ABC150Codec::STATUS_CONVERTER] = ABC150CANHandler::Remote;
+    ABC150Codec::encodeRaw(ABC150Codec::STATUS_LAYOUT, msg.data.u8, raws);
+    handler.msgReceived(msg);
+  }
+  handler.takeControl(ABC150CANHandler::A);
+  handler.takeControl(ABC150CANHandler::B);
+}
+
+static void check(const char *name, bool ok) {
+  printf("  %-52s %s\n", name, ok ? "ok" : "WRONG");
+  passed = passed && ok;
+}
+
+static bool sameFrame(const CAN_frame_t &a, const CAN_frame_t &b) {
+  return a.MsgID == b.MsgID && a.FIR.B.DLC == b.FIR.B.DLC && memcmp(a.data.u8, b.data.u8, a.FIR.B.DLC) == 0;
+}
+
+static int countPackages(const std::vector<CAN_frame_t> &frames) {
+  int packages = 0;
+  for (size_t i = 0; i < frames.size(); i++) {
+    packages += (frames[i].MsgID == COMMAND_A || frames[i].MsgID == COMMAND_B);
+  }
+  return packages;
+}
+
+/* Frames that left the bus at another position than they were written at */
+static int outOfOrder(const Path &path) {
+  int count = 0;
+  for (size_t i = 0; i < path.written.size() && i < path.transmitted.size(); i++) {
+    count += !sameFrame(path.written[i], path.transmitted[i]);
+  }
+  return count;
+}
+
+static double transactionsPerPackage(const Path &path) {
+  return (path.driver.getSPITransactions() - path.startTransactions) / (double)countPackages(path.written);
+}
+
+static void print(const Path &path) {
+  int packages = countPackages(path.written);
+  printf("  %-10s %8d %14.2f %11.1f %14d\n", path.name, packages, transactionsPerPackage(path),
+         (path.driver.getSPIBytes() - path.startBytes) / (double)packages, outOfOrder(path));
+}
+
+int main(int argc, char **argv) {
+  int cycles = (argc > 1) ? atoi(argv[1]) : 500;
+  if (cycles <= 0) {
+    return 1;
+  }
+  OSPortHost::enableVirtualTime();
+  MCP2515_CAN batchDriver(CAN_SPEED_250KBPS, 1);
+  AmpleCAN batchCAN(batchDriver);
+  ABC150CANHandler batchHandler(batchCAN);
+  PerFrameMCP2515 frameDriver;
+  AmpleCAN frameCAN(frameDriver);
+  ABC150CANHandler frameHandler(frameCAN);
+  Path paths[] = {Path("batch", batchDriver, batchHandler), Path("per frame", frameDriver, frameHandler)};
+  const int pathCount = sizeof(paths) / sizeof(paths[0]);
+
+  for (int p = 0; p < pathCount; p++) {
+    putInRemoteControl(paths[p].handler);
+  }
+  OSPort::delay(SEND_MIN_INTERVAL_MS);
+  for (int p = 0; p < pathCount; p++) {
+    paths[p].driver.takeFrames();
+    paths[p].driver.takeTransmitted();
+    paths[p].startTransactions = paths[p].driver.getSPITransactions();
+    paths[p].startBytes = paths[p].driver.getSPIBytes();
+  }
+  for (int i = 0; i < cycles * SEND_MIN_INTERVAL_MS / SETPOINT_PERIOD_MS; i++) {
+    OSPort::delay(SETPOINT_PERIOD_MS);
+    for (int p = 0; p < pathCount; p++) {
+      paths[p].handler.setPower(ABC150CANHandler::A, POWER_W - i % 100);
+      paths[p].handler.setPower(ABC150CANHandler::B, POWER_W + i % 100);
+    }
+  }
+  OSPort::delay(SEND_MIN_INTERVAL_MS);
+  for (int p = 0; p < pathCount; p++) {
+    paths[p].written = paths[p].driver.takeFrames();
+    paths[p].transmitted = paths[p].driver.takeTransmitted();
+  }
+
+  printf("Per package of %d frames\n", PACKAGE_FRAMES);
+  printf("  %-10s %8s %14s %11s %14s\n", "", "packages", "transactions", "SPI bytes", "out of order");
+  for (int p = 0; p < pathCount; p++) {
+    print(paths[p]);
+  }
+  printf("\n");
+
+  Path &batch = paths[0];
+  Path &frame = paths[1];
+  check("a package every cycle", countPackages(batch.written) >= CHANNELS * (cycles - 1) &&
+                                 countPackages(frame.written) >= CHANNELS * (cycles - 1));
+  check("3 SPI transactions per package batched", transactionsPerPackage(batch) == BATCH_TRANSACTIONS);
+  check("9 SPI transactions per package per frame",
+        transactionsPerPackage(frame) == PACKAGE_FRAMES * FRAME_TRANSACTIONS);
+  check("no frame finds the transmit buffers full",
+        batch.driver.getRejectedFrames() == 0 && frame.driver.getRejectedFrames() == 0);
+  check("every frame written leaves the bus", batch.transmitted.size() == batch.written.size() &&
+                                              frame.transmitted.size() == frame.written.size());
+  check("batched frames leave the bus in write order", outOfOrder(batch) == 0);
+
+  printf("\n%s\n", passed ? "Packages written in one SPI batch" : "CANBatchBench FAILED");
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,363 @@
+/*
+ * main.cpp
+ *
+ * Worst case time ABC150CANHandler spends in the CAN receive callback for the
+ * frames that report something: a converter status change, a greeting, fault
+ * data, a packet problem and a request for an unknown ID. The callback as it
+ * was, logging with ESP_LOG and building the packet problem text in a
+ * stringstream, is reproduced below; the one timed against it is the real
+ * ABC150CANHandler::msgReceived() of the host build, which pushes an Event
+ * into an MPSCRing that the handler's event task pops and logs.
+ *
+ * The same frame stream (one reporting frame in ten, the rest unchanged
+ * STATUS frames) goes through both, and every callback is timed. The old
+ * path logs to /dev/null; the event task's log is captured and read back. The
+ * longest log line is also converted to the time it holds a 115200 baud UART,
+ * which on the ESP32 the callback waits for once the transmit FIFO is full.
+ * Exits with 1 if the handler's 99th percentile is not below the logging
+ * path's, or the events logged and dropped by the event task do not add up to
+ * the reports, in order.
+ *
+ *   CANEventBench [frames]     default 20000
+ */
+
+#include "ABC150CANHandler.hpp"
+#include "ABC150Codec.hpp"
+#include "AmpleCAN.hpp"
+#include "OSPort.hpp"
+#include "esp_log.h"
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define FRAME_INTERVAL_US           100
+/* Ten event task periods to log what is left in the ring */
+#define DRAIN_MS                    100
+/* One frame in REPORT_EVERY reports something */
+#define REPORT_EVERY                10
+#define UART_BAUD                   115200
+#define UART_BITS_PER_BYTE          10
+#define HARDWARE_VERSION            0x0D
+#define PROBLEMS                    30
+
+static const char *TAG = "ABC150CANHandler";
+
+struct Frame {
+  uint16_t id;
+  uint8_t data[8];
+};
+
+/* Frames */
+
+static Frame statusFrame(int channel, int converterStatus) {
+  Frame frame;
+  int64_t raws[ABC150Codec::STATUS_FIELDS] = {0};
+  raws[ABC150Codec::STATUS_CONVERTER] = converterStatus;
+  frame.id = STATUS_A + channel * CHANNEL_ID_STRIDE;
+  ABC150Codec::encodeRaw(ABC150Codec::STATUS_LAYOUT, frame.data, raws);
+  return frame;
+}
+
+static std::vector<Frame> buildStream(long frames) {
+  std::vector<Frame> stream;
+  int converterStatus[2] = {0, 0};
+  for (long i = 0; i < frames; i++) {
+    int channel = (i / REPORT_EVERY) & 1;
+    if (i % REPORT_EVERY != 0) {
+      stream.push_back(statusFrame(channel, converterStatus[channel]));
+      continue;
+    }
+    long report = i / REPORT_EVERY;
+    Frame frame;
+    switch (report % 5) {
+    case 0:
+      converterStatus[channel] ^= 1;
+      frame = statusFrame(channel, converterStatus[channel]);
+      break;
+    case 1: {
+      int64_t raws[ABC150Codec::GREETING_FIELDS] = {0x0102, (report % 3) ? HARDWARE_VERSION : 0x0C};
+      frame.id = GREETING;
+      ABC150Codec::encodeRaw(ABC150Codec::GREETING_LAYOUT, frame.data, raws);
+      break;
+    }
+    case 2: {
+      int64_t raws[ABC150Codec::FAULT_FIELDS] = {report % 256, report % 7};
+      frame.id = FAULT_DATA;
+      ABC150Codec::encodeRaw(ABC150Codec::FAULT_DATA_LAYOUT, frame.data, raws);
+      break;
+    }
+    case 3: {
+      /* Changes every time, so every one is reported */
+      int64_t raws[ABC150Codec::PROBLEM_FIELDS] = {1 + report % PROBLEMS, report & 1};
+      frame.id = PACKET_PROBLEM;
+      ABC150Codec::encodeRaw(ABC150Codec::PACKET_PROBLEM_LAYOUT, frame.data, raws);
+      break;
+    }
+    default: {
+      int64_t raws[ABC150Codec::REQUEST_FIELDS] = {CHANGE_CONTROL};
+      frame.id = REQUEST_PC;
+      ABC150Codec::encodeRaw(ABC150Codec::REQUEST_LAYOUT, frame.data, raws);
+      break;
+    }
+    }
+    stream.push_back(frame);
+  }
+  return stream;
+}
+
+static const char *problemNames[PROBLEMS + 1] = {
+  "Problem not in list", "Command_out_of_limits", "UVL_too_high", "UVL_too_low", "LVL_too_high", "LVL_too_low",
+  "UCL_too_high", "UCL_too_low", "LCL_too_high", "LCL_too_low", "UPL_too_high", "UPL_too_low", "LPL_too_high",
+  "LPL_too_low", "Invalid_config", "Invalid_mode", "UV_lower_than_LV", "UI_lower_than_LI", "UP_lower_than_LP",
+  "Invalid_control_source", "Invalid_mode1", "Not_in_remote_control", "Invalid_station_id_received",
+  "load_v_incompatible", "power_allocation_erro", "too_much_command", "out_of_op_space", "invalid_channel",
+  "invalid_sw_version", "wrong_length", "unknown_type"};
+
+static const char *problemName(uint8_t problem) {
+  return (problem <= PROBLEMS) ? problemNames[problem] : problemNames[0];
+}
+
+static const char *suppName(uint8_t supp) {
+  return (supp == 0) ? "Channel A" : (supp == 1) ? "Channel B" : "Channel Unknown";
+}
+
+/* State both paths keep, like the handler */
+struct Receiver {
+  int converterStatus[2];
+  uint8_t problemID;
+  uint8_t suppID;
+  uint32_t reports;
+};
+
+/* Before: the callback logs */
+
+static std::string packetProblemString(uint8_t problem, uint8_t supp) {
+  std::stringstream ss;
+  ss << suppName(supp) << "\t" << problemName(problem) << std::endl;
+  return ss.str();
+}
+
+static void receiveLogging(Receiver &rx, const Frame &frame) {
+  int channel = (frame.id >= DATA_B && frame.id < GREETING) ? 1 : 0;
+  switch (frame.id) {
+  case STATUS_A:
+  case STATUS_B: {
+    int64_t raws[ABC150Codec::STATUS_FIELDS];
+    ABC150Codec::decodeRaw(ABC150Codec::STATUS_LAYOUT, frame.data, raws);
+    int converterStatus = raws[ABC150Codec::STATUS_CONVERTER];
+    if (rx.converterStatus[channel] != converterStatus) {
+      ESP_LOGI(TAG, "Converter status changed to %d", converterStatus);
+      rx.reports++;
+    }
+    rx.converterStatus[channel] = converterStatus;
+    break;
+  }
+  case GREETING: {
+    int64_t raws[ABC150Codec::GREETING_FIELDS];
+    ABC150Codec::decodeRaw(ABC150Codec::GREETING_LAYOUT, frame.data, raws);
+    uint16_t hardwareVersion = raws[ABC150Codec::GREETING_HW_VERSION];
+    if (hardwareVersion == HARDWARE_VERSION) {
+      ESP_LOGI(TAG, "ABC150 Detected");
+    } else {
+      ESP_LOGE(TAG, "Hardware Version: %d", hardwareVersion);
+    }
+    rx.reports++;
+    break;
+  }
+  case FAULT_DATA: {
+    int64_t raws[ABC150Codec::FAULT_FIELDS];
+    ABC150Codec::decodeRaw(ABC150Codec::FAULT_DATA_LAYOUT, frame.data, raws);
+    ESP_LOGE(TAG, "Received faultID: %d; moduleID: %d", (uint8_t)raws[ABC150Codec::FAULT_ID],
+             (uint8_t)raws[ABC150Codec::FAULT_MODULE_ID]);
+    rx.reports++;
+    break;
+  }
+  case PACKET_PROBLEM: {
+    int64_t raws[ABC150Codec::PROBLEM_FIELDS];
+    ABC150Codec::decodeRaw(ABC150Codec::PACKET_PROBLEM_LAYOUT, frame.data, raws);
+    uint8_t problem = raws[ABC150Codec::PROBLEM_ID];
+    uint8_t supp = raws[ABC150Codec::PROBLEM_SUPP_ID];
+    if (rx.problemID != problem || rx.suppID != supp) {
+      ESP_LOGE(TAG, "%s", packetProblemString(problem, supp).c_str());
+      rx.reports++;
+    }
+    rx.problemID = problem;
+    rx.suppID = supp;
+    break;
+  }
+  case REQUEST_PC: {
+    uint16_t canID = ABC150Codec::decodeRaw(ABC150Codec::REQUEST_LAYOUT.signals[ABC150Codec::REQUEST_CAN_ID],
+                                            frame.data);
+    ESP_LOGI(TAG, "Request for CAN ID 0x%02x", canID);
+    rx.reports++;
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+/* After: the real msgReceived(), the handler's event task logs */
+
+static CAN_frame_t toCAN(const Frame &frame) {
+  CAN_frame_t msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.MsgID = frame.id;
+  msg.FIR.B.FF = CAN_frame_std;
+  msg.FIR.B.DLC = 8;
+  memcpy(msg.data.u8, frame.data, sizeof(msg.data.u8));
+  return msg;
+}
+
+struct EventLog {
+  uint32_t logged;
+  uint32_t dropped;
+  bool inOrder;
+};
+
+/* Event lines of the handler in the captured output, "<tick> ms: ..." and "<n> events dropped" */
+static EventLog readEventLog(FILE *file) {
+  EventLog log = {0, 0, true};
+  uint32_t lastTimeMs = 0;
+  char line[256];
+  rewind(file);
+  while (fgets(line, sizeof(line), file) != NULL) {
+    const char *text = strstr(line, "ABC150CANHandler: ");
+    if (text == NULL) {
+      continue;
+    }
+    text += strlen("ABC150CANHandler: ");
+    unsigned value;
+    char word[16];
+    if (sscanf(text, "%u %15s", &value, word) != 2) {
+      continue;
+    }
+    if (strcmp(word, "ms:") == 0) {
+      log.inOrder = log.inOrder && value >= lastTimeMs;
+      lastTimeMs = value;
+      log.logged++;
+    } else if (strcmp(word, "events") == 0) {
+      log.dropped += value;
+    }
+  }
+  return log;
+}
+
+/* Timing */
+
+struct Result {
+  double meanNs;
+  int64_t p99Ns;
+  int64_t maxNs;
+  uint32_t reports;
+};
+
+/* Every frame of the stream through receive(i), the times of the reporting ones count */
+template <typename Receive>
+static Result run(Receive receive, size_t frames) {
+  std::vector<int64_t> reportNs;
+  for (size_t i = 0; i < frames; i++) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    receive(i);
+    int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    if (i % REPORT_EVERY == 0) {
+      reportNs.push_back(ns);
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(FRAME_INTERVAL_US));
+  }
+  std::sort(reportNs.begin(), reportNs.end());
+  Result result = {0, 0, 0, (uint32_t)reportNs.size()};
+  if (!reportNs.empty()) {
+    double sum = 0;
+    for (size_t i = 0; i < reportNs.size(); i++) {
+      sum += reportNs[i];
+    }
+    result.meanNs = sum / reportNs.size();
+    result.p99Ns = reportNs[reportNs.size() * 99 / 100];
+    result.maxNs = reportNs.back();
+  }
+  return result;
+}
+
+/* Longest line the old callback wrote, in the host ESP_LOG format */
+static size_t longestLogLine() {
+  size_t longest = 0;
+  for (int problem = 0; problem <= PROBLEMS; problem++) {
+    char line[128];
+    int length = snprintf(line, sizeof(line), "E (%lld) %s: %s\n", 1000000LL, TAG,
+                          packetProblemString(problem, 2).c_str());
+    longest = std::max(longest, (size_t)length);
+  }
+  return longest;
+}
+
+static int redirectStdout(int fd) {
+  fflush(stdout);
+  int saved = dup(STDOUT_FILENO);
+  dup2(fd, STDOUT_FILENO);
+  return saved;
+}
+
+static void restoreStdout(int saved) {
+  fflush(stdout);
+  dup2(saved, STDOUT_FILENO);
+  close(saved);
+}
+
+int main(int argc, char **argv) {
+  long frames = (argc > 1) ? atol(argv[1]) : 20000;
+  if (frames <= 0) {
+    return 1;
+  }
+  std::vector<Frame> stream = buildStream(frames);
+  std::vector<CAN_frame_t> messages;
+  for (size_t i = 0; i < stream.size(); i++) {
+    messages.push_back(toCAN(stream[i]));
+  }
+  CANDriver driver;
+  AmpleCAN can(driver);
+  ABC150CANHandler handler(can);
+
+  /* Every reporting frame reports in the old callback too */
+  Receiver rx = {{0, 0}, 0, 0, 0};
+  int devNull = open("/dev/null", O_WRONLY);
+  int console = redirectStdout(devNull);
+  Result logging = run([&](size_t i) { receiveLogging(rx, stream[i]); }, stream.size());
+  restoreStdout(console);
+  close(devNull);
+
+  FILE *capture = tmpfile();
+  console = redirectStdout(fileno(capture));
+  Result pushing = run([&](size_t i) { handler.msgReceived(messages[i]); }, messages.size());
+  OSPort::delay(DRAIN_MS);
+  restoreStdout(console);
+  EventLog log = readEventLog(capture);
+  fclose(capture);
+
+  printf("%ld frames, %u report something, every %d us\n\n", frames, pushing.reports, FRAME_INTERVAL_US);
+  printf("  %-36s %-10s %-10s %s\n", "Receive callback", "Mean ns", "p99 ns", "Max ns");
+  printf("  %-36s %-10.0f %-10lld %lld\n", "ESP_LOG in the callback (as it was)", logging.meanNs,
+         (long long)logging.p99Ns, (long long)logging.maxNs);
+  printf("  %-36s %-10.0f %-10lld %lld\n", "ABC150CANHandler::msgReceived()", pushing.meanNs,
+         (long long)pushing.p99Ns, (long long)pushing.maxNs);
+
+  size_t longest = longestLogLine();
+  printf("\nLongest line logged in the callback: %u bytes, %u us on a %d baud UART\n", (unsigned)longest,
+         (unsigned)(longest * UART_BITS_PER_BYTE * 1000000 / UART_BAUD), UART_BAUD);
+
+  bool accounted = log.logged + log.dropped == pushing.reports && log.inOrder;
+  printf("Events: %u reported, %u logged, %u dropped, %s\n", pushing.reports, log.logged, log.dropped,
+         accounted ? "in order" : "WRONG");
+
+  bool passed = accounted && rx.reports == pushing.reports && pushing.p99Ns < logging.p99Ns;
+  printf("%s\n", passed ? "The receive callback no longer formats or writes log output" : "CANEventBench FAILED");
+  return passed ? 0 : 1;
+}
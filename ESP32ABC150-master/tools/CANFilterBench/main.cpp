@@ -0,0 +1,174 @@
+/*
+ * main.cpp
+ *
+ * Runs a busy 250 kbps bus through the receive path of ABC150Controller: the
+ * ABC150 frames of both channels plus unrelated traffic with random standard
+ * IDs up to the given bus load. The controller programs the masks and filters
+ * ABC150CANHandler compiles into the MCP2515 at construction, the register
+ * model of the host MCP2515 driver decides which frames interrupt the ESP32
+ * and those are passed to the handler like the receive task does. An MCP2515
+ * that was never programmed shows the load with open filters.
+ *
+ * Checks that
+ *
+ *  - the masks and filters read back from the MCP2515 are the compiled ones
+ *    and the chip is back in normal mode
+ *  - every ABC150 frame interrupts and reaches its route, per route
+ *  - the frames the filters let through without being ours are dropped by
+ *    the software check
+ *
+ * Prints the interrupts and ISR load with open and programmed filters.
+ * Exits with 1 if a check fails.
+ *
+ *   CANFilterBench [bus load %]     default 80
+ */
+
+#include "ABC150Controller.hpp"
+#include "ABC150Codec.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define BUS_KBPS                    250.0
+#define BIT_STUFFING                1.1
+#define FRAME_DLC                   8
+#define SIMULATED_S                 60
+/* MCP2515 interrupt: READ STATUS, READ RX BUFFER and clearing CANINTF over SPI */
+#define ISR_US                      50.0
+/* Register addresses of the masks and filters, datasheet table 11-1 */
+#define RXM0SIDH                    0x20
+#define RXF0SIDH                    0x00
+#define RXF3SIDH                    0x10
+
+static bool passed = true;
+
+struct Periodic {
+  uint16_t id;
+  uint32_t periodMs;
+};
+
+/* Frames of an ABC150 with both channels in remote control, in the route order of ABC150CANHandler */
+static const Periodic abc150Frames[] = {
+    {DATA_A, 10}, {DATA_B, 10}, {STATUS_A, 10}, {STATUS_B, 10},
+    {LOWER_LIMITS_A, 100}, {UPPER_LIMITS_A, 100}, {STATION_ID_A, 1000},
+    {LOWER_LIMITS_B, 100}, {UPPER_LIMITS_B, 100}, {STATION_ID_B, 1000},
+    {GREETING, 1000}, {FAULT_DATA, 1000}, {PACKET_PROBLEM, 1000}, {REQUEST_PC, 1000},
+};
+
+#define ABC150_FRAME_IDS            (sizeof(abc150Frames) / sizeof(abc150Frames[0]))
+
+static void check(const char *name, bool ok) {
+  printf("  %-52s %s\n", name, ok ? "ok" : "WRONG");
+  passed = passed && ok;
+}
+
+static uint16_t readID(MCP2515_CAN &mcp, uint8_t address) {
+  return (mcp.readRegister(address) << 3) | (mcp.readRegister(address + 1) >> 5);
+}
+
+static bool registersProgrammed(MCP2515_CAN &mcp, const CANAcceptanceFilter::Registers &registers) {
+  bool ok = (mcp.readRegister(MCP2515_CANSTAT) & MCP2515_MODE_MASK) == MCP2515_MODE_NORMAL;
+  for (int i = 0; i < CAN_FILTER_MASKS; i++) {
+    ok = ok && readID(mcp, RXM0SIDH + 4 * i) == registers.mask[i];
+  }
+  for (int i = 0; i < CAN_FILTERS; i++) {
+    uint8_t address = (i < 3) ? RXF0SIDH + 4 * i : RXF3SIDH + 4 * (i - 3);
+    ok = ok && readID(mcp, address) == registers.filter[i];
+  }
+  return ok;
+}
+
+static CAN_frame_t frame(uint16_t id) {
+  CAN_frame_t msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.MsgID = id;
+  msg.FIR.B.FF = CAN_frame_std;
+  msg.FIR.B.DLC = FRAME_DLC;
+  return msg;
+}
+
+int main(int argc, char **argv) {
+  double load = (argc > 1) ? atof(argv[1]) / 100 : 0.8;
+  ABC150Controller controller(0);
+  ABC150CANHandler *handler = controller.getABC150CANHandler();
+  MCP2515_CAN &mcp = *controller.getMCP2515CAN();
+  MCP2515_CAN open(CAN_SPEED_250KBPS, 1);
+  const CANAcceptanceFilter::Registers &registers = handler->getAcceptanceFilter();
+  printf("RXM0 0x%03x  RXF0 0x%03x RXF1 0x%03x\n", registers.mask[0], registers.filter[0], registers.filter[1]);
+  printf("RXM1 0x%03x  RXF2 0x%03x RXF3 0x%03x RXF4 0x%03x RXF5 0x%03x\n", registers.mask[1], registers.filter[2],
+         registers.filter[3], registers.filter[4], registers.filter[5]);
+  uint32_t passing = 0;
+  for (uint16_t id = 0; id < CAN_STD_ID_COUNT; id++) {
+    passing += mcp.accepts(id);
+  }
+  printf("%u IDs, %u of %d standard IDs pass the MCP2515\n\n", (unsigned)ABC150_FRAME_IDS, passing,
+         CAN_STD_ID_COUNT);
+
+  double frameUs = (47 + 8 * FRAME_DLC) * BIT_STUFFING * 1000 / BUS_KBPS;
+  uint64_t slots = (uint64_t)(SIMULATED_S * 1e6 / frameUs);
+  uint32_t sent[ABC150_FRAME_IDS] = {};
+  uint64_t abc150 = 0;
+  uint64_t other = 0;
+  uint64_t interruptsOpen = 0;
+  uint64_t interruptsFiltered = 0;
+  uint64_t otherInterrupts = 0;
+  bool ours[CAN_STD_ID_COUNT] = {};
+  for (unsigned i = 0; i < ABC150_FRAME_IDS; i++) {
+    ours[abc150Frames[i].id] = true;
+  }
+  CANStats &stats = handler->getStats();
+  stats.reset();
+  srand(1);
+  /* One frame slot at a time: an ABC150 frame when one is due, else other traffic at the given load */
+  uint32_t nextDue[ABC150_FRAME_IDS] = {};
+  for (uint64_t slot = 0; slot < slots; slot++) {
+    double ms = slot * frameUs / 1000;
+    int id = -1;
+    for (unsigned i = 0; i < ABC150_FRAME_IDS; i++) {
+      if (ms >= nextDue[i]) {
+        nextDue[i] += abc150Frames[i].periodMs;
+        id = abc150Frames[i].id;
+        sent[i]++;
+        break;
+      }
+    }
+    if (id < 0) {
+      if (rand() > load * RAND_MAX) {
+        continue;
+      }
+      /* IDs of our own receive set belong to the ABC150 only */
+      do {
+        id = rand() % CAN_STD_ID_COUNT;
+      } while (ours[id]);
+    }
+    (ours[id] ? abc150 : other)++;
+    interruptsOpen += open.accepts(id);
+    if (!mcp.accepts(id)) {
+      continue;
+    }
+    interruptsFiltered++;
+    otherInterrupts += !ours[id];
+    CAN_frame_t msg = frame(id);
+    handler->msgReceived(msg);
+  }
+  printf("%.0f s at %.0f %% load: %llu ABC150 frames, %llu others\n\n", (double)SIMULATED_S, load * 100,
+         (unsigned long long)abc150, (unsigned long long)other);
+  printf("filters     interrupts/s   ISR load   to handlers/s\n");
+  printf("open        %10.0f   %7.1f %%   %12.0f\n", interruptsOpen / (double)SIMULATED_S,
+         interruptsOpen * ISR_US / (SIMULATED_S * 1e4), abc150 / (double)SIMULATED_S);
+  printf("programmed  %10.0f   %7.1f %%   %12.0f\n\n", interruptsFiltered / (double)SIMULATED_S,
+         interruptsFiltered * ISR_US / (SIMULATED_S * 1e4), abc150 / (double)SIMULATED_S);
+
+  bool routed = true;
+  for (unsigned i = 0; i < ABC150_FRAME_IDS; i++) {
+    routed = routed && stats.getFrames(i) == sent[i];
+  }
+  check("MCP2515 masks and filters are the compiled ones", registersProgrammed(mcp, registers));
+  check("every ABC150 frame handled by its route", routed);
+  check("other frames through the filters dropped in software", stats.getOtherFrames() == otherInterrupts);
+  check("programmed filters interrupt less than open ones", interruptsFiltered < interruptsOpen);
+
+  printf("\n%s\n", passed ? "Only the ABC150 frames reach the handlers" : "CANFilterBench FAILED");
+  return passed ? 0 : 1;
+}
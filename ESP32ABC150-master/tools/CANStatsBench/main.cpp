@@ -0,0 +1,165 @@
+/*
+ * main.cpp
+ *
+ * Cost of CANStats on the receive path of ABC150CANHandler. Feeds a stream of
+ * the DATA, STATUS, LIMITS and STATION_ID frames of both channels through the
+ * real ABC150CANHandler::msgReceived() of the host build, once with the
+ * statistics switched on and once off, and reports the difference per frame:
+ * against the whole msgReceived(), against the time an 8 byte frame takes on
+ * the 250 kbps ABC150 bus and the 500 kbps plate bus, and against a us clock
+ * read, which CANStats::received() did per frame before the tick was passed
+ * in. On the host the tick is read from the same clock, so most of the
+ * difference is that read; on the ESP32 it is the scheduler tick counter.
+ * The frames that make the handler log or answer are left out, they would
+ * time the log and not the statistics.
+ *
+ * Then checks that inter-arrival intervals across the 32 bit tick wrap land
+ * in the right bucket and reads back the binary record. Exits with 1 if the
+ * statistics take 1 % of a 500 kbps frame or more, or a check fails.
+ *
+ *   CANStatsBench [frames]     default 2000000
+ */
+
+#include "ABC150CANHandler.hpp"
+#include "AmpleCAN.hpp"
+#include "CANStats.hpp"
+#include "ABC150Codec.hpp"
+#include "OSPort.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FRAME_DLC                   8
+#define BIT_STUFFING                1.1
+/* Runs of each configuration, the fastest counts */
+#define RUNS                        5
+#define WRAP_IDS                    2
+
+/* Received IDs that neither log nor answer */
+static const uint16_t streamIDs[] = {
+    DATA_A, DATA_B, STATUS_A, STATUS_B, LOWER_LIMITS_A, UPPER_LIMITS_A, STATION_ID_A,
+    LOWER_LIMITS_B, UPPER_LIMITS_B, STATION_ID_B,
+};
+#define STREAM_IDS                  (sizeof(streamIDs) / sizeof(streamIDs[0]))
+
+static uint32_t get32(const uint8_t *in) {
+  return in[0] | (in[1] << 8) | (in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+static double frameUs(double kbps) {
+  return (47 + 8 * FRAME_DLC) * BIT_STUFFING * 1000 / kbps;
+}
+
+/* ns per frame of msgReceived() over the stream */
+static double timeHandler(ABC150CANHandler &handler, CAN_frame_t *stream, long frames) {
+  int64_t start = OSPort::getTimeUs();
+  for (long i = 0; i < frames; i++) {
+    CAN_frame_t &msg = stream[i % STREAM_IDS];
+    /* Advancing DATA timestamp like the ABC150 */
+    msg.data.u8[7] = i;
+    handler.msgReceived(msg);
+  }
+  return (OSPort::getTimeUs() - start) * 1000.0 / frames;
+}
+
+/* Intervals across the tick wrap, 10 and 150 ms apart */
+static bool checkWrap() {
+  CANStats stats(250000);
+  stats.addID(DATA_A, "DATA_A");
+  stats.addID(STATUS_A, "STATUS_A");
+  uint32_t now = UINT32_MAX - 25;
+  for (int i = 0; i < 6; i++) {
+    stats.received(0, FRAME_DLC, now + 10 * i);
+    stats.received(1, FRAME_DLC, now + 150 * i);
+  }
+  uint8_t record[CAN_STATS_RECORD_SIZE];
+  size_t size = stats.serialize(record, sizeof(record));
+  const uint8_t *data = record + CAN_STATS_HEADER_SIZE;
+  const uint8_t *status = data + CAN_STATS_SLOT_SIZE;
+  /* 10 ms is in the <20 bucket, 150 ms in the <200 one */
+  bool passed = size == CAN_STATS_HEADER_SIZE + WRAP_IDS * CAN_STATS_SLOT_SIZE &&
+                get32(data + 10 + 4 * 4) == 5 && get32(status + 10 + 4 * 7) == 5;
+  printf("Intervals across the 32 bit tick wrap %s\n", passed ? "ok" : "WRONG");
+  return passed;
+}
+
+int main(int argc, char **argv) {
+  long frames = (argc > 1) ? atol(argv[1]) : 2000000;
+  if (frames <= 0) {
+    return 1;
+  }
+
+  CANDriver driver;
+  AmpleCAN can(driver);
+  ABC150CANHandler handler(can);
+  CAN_frame_t stream[STREAM_IDS];
+  memset(stream, 0, sizeof(stream));
+  for (unsigned i = 0; i < STREAM_IDS; i++) {
+    stream[i].MsgID = streamIDs[i];
+    stream[i].FIR.B.FF = CAN_frame_std;
+    stream[i].FIR.B.DLC = FRAME_DLC;
+  }
+
+  double onNs = 1e9, offNs = 1e9;
+  for (int run = 0; run < RUNS; run++) {
+    handler.getStats().setEnabled(true);
+    double ns = timeHandler(handler, stream, frames);
+    onNs = (ns < onNs) ? ns : onNs;
+    handler.getStats().setEnabled(false);
+    ns = timeHandler(handler, stream, frames);
+    offNs = (ns < offNs) ? ns : offNs;
+  }
+  handler.getStats().setEnabled(true);
+  double statsNs = (onNs > offNs) ? onNs - offNs : 0;
+
+  int64_t clock = 0;
+  int64_t start = OSPort::getTimeUs();
+  for (long i = 0; i < frames; i++) {
+    clock += OSPort::getTickMs();
+  }
+  double tickNs = (OSPort::getTimeUs() - start) * 1000.0 / frames;
+  start = OSPort::getTimeUs();
+  for (long i = 0; i < frames; i++) {
+    clock += OSPort::getTimeUs();
+  }
+  double clockNs = (OSPort::getTimeUs() - start) * 1000.0 / frames;
+
+  printf("%ld frames, fastest of %d runs\n", frames, RUNS);
+  printf("  msgReceived() with statistics     %6.1f ns\n", onNs);
+  printf("  msgReceived() without statistics  %6.1f ns\n", offNs);
+  printf("  statistics                        %6.1f ns, %.1f %% of msgReceived()\n", statsNs,
+         100 * statsNs / onNs);
+  printf("  of it the tick read               %6.1f ns, on the host a clock read like\n", tickNs);
+  printf("  us clock read                     %6.1f ns\n\n", clockNs);
+  printf("  statistics of an 8 byte frame at 250 kbps (%.0f us)  %.4f %%\n", frameUs(250),
+         statsNs / frameUs(250) / 10);
+  printf("  statistics of an 8 byte frame at 500 kbps (%.0f us)  %.4f %%\n\n", frameUs(500),
+         statsNs / frameUs(500) / 10);
+  if (clock == 0) {
+    printf("\n");
+  }
+
+  bool valid = checkWrap();
+
+  /* Only the runs with statistics on were counted */
+  uint8_t record[CAN_STATS_RECORD_SIZE];
+  size_t size = handler.getStats().serialize(record, sizeof(record));
+  CANStats &stats = handler.getStats();
+  valid = valid && size > CAN_STATS_HEADER_SIZE && get32(record) == CAN_STATS_MAGIC &&
+          record[7] == CAN_STATS_BUCKETS;
+  uint32_t total = 0;
+  for (int i = 0; valid && i < record[6]; i++) {
+    const uint8_t *slot = record + CAN_STATS_HEADER_SIZE + i * CAN_STATS_SLOT_SIZE;
+    uint32_t bucketSum = 0;
+    for (int j = 0; j < CAN_STATS_BUCKETS; j++) {
+      bucketSum += get32(slot + 10 + 4 * j);
+    }
+    uint32_t count = get32(slot + 2);
+    /* One interval less than frames per ID */
+    valid = count == stats.getFrames(i) && (count == 0 || bucketSum + 1 == count);
+    total += count;
+  }
+  valid = valid && total == (uint32_t)(frames * RUNS);
+  printf("%u byte record %s\n", (unsigned)size, valid ? "reads back" : "is wrong");
+  return (valid && statsNs < frameUs(500) * 10) ? 0 : 1;
+}
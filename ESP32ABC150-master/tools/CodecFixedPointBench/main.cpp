@@ -0,0 +1,411 @@
+/*
+ * main.cpp
+ *
+ * Checks and times the fixed-point scaling of ABC150Units.hpp against the
+ * double scaling ABC150CANHandler used before. Frames are built and decoded
+ * both ways the way the handler does it:
+ *
+ *  - golden frames: COMMAND and LIMITS_OUT payloads and decoded DATA values
+ *    written out by hand, including saturation and truncation towards zero
+ *  - decoding: every 16 bit wire value of each unit must give the same float
+ *  - setpoints below a wire step: frames of setpoints whose float lies just
+ *    below a wire step, e.g. 0.06f, which truncate to the step below like
+ *    the double path, asserted both ways
+ *  - encoding: the float setpoint nearest to every wire value of each unit,
+ *    and RANDOM_SETPOINTS random floats in the wire range, must encode to
+ *    the wire value of the double path
+ *  - out of range setpoints saturate instead of wrapping around
+ *
+ * Then times building the three frames of a package and decoding a DATA
+ * frame both ways. Exits with 1 if a check fails.
+ *
+ *   CodecFixedPointBench [iterations]     default 10000000
+ */
+
+#include "ABC150Codec.hpp"
+#include "ABC150Units.hpp"
+#include "OSPort.hpp"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ControlMode and LoadMode of ABC150CANHandler */
+enum {Voltage, Current, Power, Standby};
+enum {Independent, Parallel, Differential};
+
+enum Unit {Volts, Amps, Watts, Units};
+static const char *unitNames[] = {"V", "A", "W"};
+static const double unitScales[] = {VOLTAGE_SCALE, CURRENT_SCALE, POWER_SCALE};
+
+/* Random setpoints per unit compared with the double path */
+#define RANDOM_SETPOINTS            1000000
+#define PRINTED_DIFFERENCES         5
+
+/* Setpoints of one channel as the handler keeps them */
+struct DoubleSetpoints {
+  float command;
+  int controlMode;
+  int loadMode;
+  bool enable;
+  float lowerLimits[Units];
+};
+
+struct FixedSetpoints {
+  int32_t command;
+  int controlMode;
+  int loadMode;
+  bool enable;
+  int32_t lowerLimits[Units];
+};
+
+static int32_t fromFloat(Unit unit, float value) {
+  switch (unit) {
+  case Volts:
+    return ABC150Units::fromVolts(value);
+  case Amps:
+    return ABC150Units::fromAmps(value);
+  default:
+    return ABC150Units::fromWatts(value);
+  }
+}
+
+static int16_t toWire(Unit unit, int32_t value) {
+  switch (unit) {
+  case Volts:
+    return ABC150Units::voltageToWire(value);
+  case Amps:
+    return ABC150Units::currentToWire(value);
+  default:
+    return ABC150Units::powerToWire(value);
+  }
+}
+
+static float fromWire(Unit unit, int16_t raw) {
+  switch (unit) {
+  case Volts:
+    return ABC150Units::toVolts(ABC150Units::voltageFromWire(raw));
+  case Amps:
+    return ABC150Units::toAmps(ABC150Units::currentFromWire(raw));
+  default:
+    return ABC150Units::toWatts(ABC150Units::powerFromWire(raw));
+  }
+}
+
+static FixedSetpoints toFixed(const DoubleSetpoints &in) {
+  FixedSetpoints out;
+  out.command = (in.controlMode < Standby) ? fromFloat((Unit)in.controlMode, in.command) : 0;
+  out.controlMode = in.controlMode;
+  out.loadMode = in.loadMode;
+  out.enable = in.enable;
+  for (int i = 0; i < Units; i++) {
+    out.lowerLimits[i] = fromFloat((Unit)i, in.lowerLimits[i]);
+  }
+  return out;
+}
+
+/* buildCommandFrame() and buildLowerLimitsFrame() before */
+static void buildDouble(const DoubleSetpoints &in, uint8_t counter, uint8_t *command, uint8_t *limits) {
+  double value = (in.controlMode < Standby) ? in.command / unitScales[in.controlMode] : 0;
+  double values[ABC150Codec::COMMAND_FIELDS];
+  values[ABC150Codec::COMMAND_COUNTER] = counter;
+  values[ABC150Codec::COMMAND_VALUE] = value;
+  values[ABC150Codec::COMMAND_LOAD_MODE] = in.loadMode;
+  values[ABC150Codec::COMMAND_CONTROL_MODE] = in.enable ? in.controlMode : Standby;
+  ABC150Codec::encode(ABC150Codec::COMMAND_LAYOUT, command, values);
+
+  double limitValues[ABC150Codec::LIMITS_OUT_FIELDS];
+  limitValues[ABC150Codec::LIMITS_OUT_COUNTER] = counter;
+  limitValues[ABC150Codec::LIMITS_OUT_VOLTAGE] = in.lowerLimits[Volts];
+  limitValues[ABC150Codec::LIMITS_OUT_CURRENT] = in.lowerLimits[Amps];
+  limitValues[ABC150Codec::LIMITS_OUT_POWER] = in.lowerLimits[Watts];
+  ABC150Codec::encode(ABC150Codec::LIMITS_OUT_LAYOUT, limits, limitValues);
+}
+
+/* buildCommandFrame() and buildLowerLimitsFrame() now */
+static void buildFixed(const FixedSetpoints &in, uint8_t counter, uint8_t *command, uint8_t *limits) {
+  int16_t value = (in.controlMode < Standby) ? toWire((Unit)in.controlMode, in.command) : 0;
+  int64_t raws[ABC150Codec::COMMAND_FIELDS];
+  raws[ABC150Codec::COMMAND_COUNTER] = counter;
+  raws[ABC150Codec::COMMAND_VALUE] = value;
+  raws[ABC150Codec::COMMAND_LOAD_MODE] = in.loadMode;
+  raws[ABC150Codec::COMMAND_CONTROL_MODE] = in.enable ? in.controlMode : Standby;
+  ABC150Codec::encodeRaw(ABC150Codec::COMMAND_LAYOUT, command, raws);
+
+  int64_t limitRaws[ABC150Codec::LIMITS_OUT_FIELDS];
+  limitRaws[ABC150Codec::LIMITS_OUT_COUNTER] = counter;
+  limitRaws[ABC150Codec::LIMITS_OUT_VOLTAGE] = ABC150Units::voltageToWire(in.lowerLimits[Volts]);
+  limitRaws[ABC150Codec::LIMITS_OUT_CURRENT] = ABC150Units::currentToWire(in.lowerLimits[Amps]);
+  limitRaws[ABC150Codec::LIMITS_OUT_POWER] = ABC150Units::powerToWire(in.lowerLimits[Watts]);
+  ABC150Codec::encodeRaw(ABC150Codec::LIMITS_OUT_LAYOUT, limits, limitRaws);
+}
+
+struct GoldenFrames {
+  const char *name;
+  DoubleSetpoints setpoints;
+  uint8_t counter;
+  uint8_t command[8];
+  uint8_t limits[8];
+};
+
+static const GoldenFrames goldenFrames[] = {
+    {"12.34 V, limits 0",        {12.34f, Voltage, Independent, true, {0, 0, 0}}, 0x07,
+     {0x07, 0x02, 0x69, 0x00}, {0x07}},
+    {"-3.5 A parallel",          {-3.5f, Current, Parallel, true, {0, 0, 0}}, 0xFF,
+     {0xFF, 0xFF, 0x51, 0x11}, {0xFF}},
+    {"1000 W differential",      {1000, Power, Differential, true, {0, 0, 0}}, 0x10,
+     {0x10, 0x00, 0xC8, 0x22}, {0x10}},
+    {"0.4 V disabled",           {0.4f, Voltage, Independent, false, {0, 0, 0}}, 0x01,
+     {0x01, 0x00, 0x14, 0x03}, {0x01}},
+    {"limits at the wire range", {0, Voltage, Independent, true, {655.34f, -655.37f, 163835}}, 0x02,
+     {0x02, 0x00, 0x00, 0x00}, {0x02, 0x7F, 0xFF, 0x80, 0x00, 0x7F, 0xFF}},
+    {"limits beyond the range",  {0, Voltage, Independent, true, {700, -1000, -200000}}, 0x03,
+     {0x03, 0x00, 0x00, 0x00}, {0x03, 0x7F, 0xFF, 0x80, 0x00, 0x80, 0x00}},
+    {"limits truncated",         {0, Voltage, Independent, true, {0.039f, -0.03f, 9}}, 0x04,
+     {0x04, 0x00, 0x00, 0x00}, {0x04, 0x00, 0x01, 0xFF, 0xFF, 0x00, 0x01}},
+};
+
+static void printFrame(const char *label, const uint8_t *data) {
+  printf("    %-7s", label);
+  for (int i = 0; i < 8; i++) {
+    printf(" %02X", data[i]);
+  }
+  printf("\n");
+}
+
+static bool checkGoldenFrames() {
+  bool passed = true;
+  printf("Golden frames                  COMMAND      LIMITS_OUT   double path\n");
+  for (unsigned i = 0; i < sizeof(goldenFrames) / sizeof(goldenFrames[0]); i++) {
+    const GoldenFrames &golden = goldenFrames[i];
+    uint8_t command[8], limits[8], doubleCommand[8], doubleLimits[8];
+    buildFixed(toFixed(golden.setpoints), golden.counter, command, limits);
+    buildDouble(golden.setpoints, golden.counter, doubleCommand, doubleLimits);
+    bool commandOk = memcmp(command, golden.command, 8) == 0;
+    bool limitsOk = memcmp(limits, golden.limits, 8) == 0;
+    bool same = memcmp(command, doubleCommand, 8) == 0 && memcmp(limits, doubleLimits, 8) == 0;
+    printf("  %-28s %-12s %-12s %s\n", golden.name, commandOk ? "ok" : "WRONG", limitsOk ? "ok" : "WRONG",
+           same ? "identical" : "differs");
+    if (!commandOk || !limitsOk) {
+      printFrame("COMMAND", command);
+      printFrame("LIMITS", limits);
+    }
+    if (!same) {
+      printFrame("double", doubleCommand);
+      printFrame("", doubleLimits);
+    }
+    passed = passed && commandOk && limitsOk;
+  }
+
+  /* DATA: 12.34 V, -3.5 A, timestamp 4096 */
+  const uint8_t data[8] = {0x02, 0x69, 0xFF, 0x51, 0x00, 0x00, 0x10, 0x00};
+  int64_t raws[ABC150Codec::DATA_FIELDS];
+  ABC150Codec::decodeRaw(ABC150Codec::DATA_LAYOUT, data, raws);
+  float voltage = fromWire(Volts, raws[ABC150Codec::DATA_VOLTAGE]);
+  float current = fromWire(Amps, raws[ABC150Codec::DATA_CURRENT]);
+  bool dataOk = voltage == 12.34f && current == -3.5f && raws[ABC150Codec::DATA_TIMESTAMP] == 4096;
+  printf("  %-28s %s\n\n", "DATA 12.34 V, -3.5 A", dataOk ? "ok" : "WRONG");
+  return passed && dataOk;
+}
+
+/* Setpoints whose float lies just below a wire step */
+struct StepSetpoint {
+  Unit unit;
+  float value;
+  int16_t wire;
+};
+
+static const StepSetpoint stepSetpoints[] = {
+    {Volts, 0.06f, 2},  {Volts, 0.22f, 10},  {Volts, -0.06f, -2},  {Volts, 0.26f, 12},
+    {Amps, 0.06f, 2},   {Amps, -1.14f, -56}, {Amps, 100.06f, 5002},
+};
+
+/* COMMAND and LIMITS_OUT of the setpoints below a wire step, both paths asserted */
+static bool checkStepSetpoints() {
+  bool passed = true;
+  printf("Below a wire step  wire   fixed  double path\n");
+  for (unsigned i = 0; i < sizeof(stepSetpoints) / sizeof(stepSetpoints[0]); i++) {
+    const StepSetpoint &c = stepSetpoints[i];
+    DoubleSetpoints setpoints = {c.value, c.unit, Independent, true, {0, 0, 0}};
+    setpoints.lowerLimits[c.unit] = c.value;
+    uint8_t command[8], limits[8], doubleCommand[8], doubleLimits[8];
+    buildFixed(toFixed(setpoints), 0x05, command, limits);
+    buildDouble(setpoints, 0x05, doubleCommand, doubleLimits);
+
+    uint8_t expectedCommand[8] = {0x05, (uint8_t)((uint16_t)c.wire >> 8), (uint8_t)c.wire, (uint8_t)c.unit};
+    uint8_t expectedLimits[8] = {0x05};
+    expectedLimits[1 + 2 * c.unit] = (uint16_t)c.wire >> 8;
+    expectedLimits[2 + 2 * c.unit] = (uint8_t)c.wire;
+
+    bool ok = memcmp(command, expectedCommand, 8) == 0 && memcmp(limits, expectedLimits, 8) == 0;
+    bool doubleOk = memcmp(doubleCommand, expectedCommand, 8) == 0 && memcmp(doubleLimits, expectedLimits, 8) == 0;
+    char label[24];
+    snprintf(label, sizeof(label), "%g %s", c.value, unitNames[c.unit]);
+    printf("  %-16s %-6d %-6s %s\n", label, c.wire, ok ? "ok" : "WRONG", doubleOk ? "ok" : "WRONG");
+    if (!ok) {
+      printFrame("COMMAND", command);
+      printFrame("LIMITS", limits);
+    }
+    if (!doubleOk) {
+      printFrame("double", doubleCommand);
+      printFrame("", doubleLimits);
+    }
+    passed = passed && ok && doubleOk;
+  }
+  printf("\n");
+  return passed;
+}
+
+/* Wire value of a setpoint, the double path and the fixed one */
+static int16_t doubleWire(Unit unit, float setpoint) {
+  return (int16_t)(int64_t)(setpoint / unitScales[unit]);
+}
+
+static int16_t fixedWire(Unit unit, float setpoint) {
+  return toWire(unit, fromFloat(unit, setpoint));
+}
+
+/* Every wire value of every unit, decoded and encoded both ways */
+static bool checkAllWireValues() {
+  bool passed = true;
+  printf("All wire values  decode identical  encode identical  nearest float exact\n");
+  for (int unit = 0; unit < Units; unit++) {
+    long decodeSame = 0, encodeSame = 0, encodeExact = 0;
+    for (int32_t w = INT16_MIN; w <= INT16_MAX; w++) {
+      float fixedValue = fromWire((Unit)unit, w);
+      float doubleValue = w * unitScales[unit];
+      if (memcmp(&fixedValue, &doubleValue, sizeof(float)) == 0) {
+        decodeSame++;
+      }
+      /* The float setpoint a user typing the value ends up with */
+      float setpoint = (float)(w * unitScales[unit]);
+      int16_t wire = fixedWire((Unit)unit, setpoint);
+      encodeSame += (wire == doubleWire((Unit)unit, setpoint));
+      encodeExact += (wire == w);
+    }
+    printf("  %-14s %-17ld %-17ld %ld\n", unitNames[unit], decodeSame, encodeSame, encodeExact);
+    passed = passed && decodeSame == 65536 && encodeSame == 65536;
+  }
+  printf("\n");
+  return passed;
+}
+
+/* Random floats in the wire range, uniform and with random exponents */
+static bool checkRandomSetpoints() {
+  bool passed = true;
+  srand(1);
+  printf("Random setpoints encode identical\n");
+  for (int unit = 0; unit < Units; unit++) {
+    float range = (float)(INT16_MAX * unitScales[unit]);
+    long same = 0;
+    for (long i = 0; i < RANDOM_SETPOINTS; i++) {
+      float setpoint;
+      if (i % 2 == 0) {
+        setpoint = ((float)rand() / RAND_MAX * 2 - 1) * range;
+      } else {
+        uint32_t bits = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+        memcpy(&setpoint, &bits, sizeof(setpoint));
+        if (!(fabsf(setpoint) < range)) {
+          setpoint = 0;
+        }
+      }
+      int16_t wire = fixedWire((Unit)unit, setpoint);
+      if (wire == doubleWire((Unit)unit, setpoint)) {
+        same++;
+      } else if (i - same < PRINTED_DIFFERENCES) {
+        printf("  %.9g %s: %d, double path %d\n", setpoint, unitNames[unit], wire, doubleWire((Unit)unit, setpoint));
+      }
+    }
+    printf("  %-16s %ld of %d\n", unitNames[unit], same, RANDOM_SETPOINTS);
+    passed = passed && same == RANDOM_SETPOINTS;
+  }
+  printf("\n");
+  return passed;
+}
+
+static bool checkSaturation() {
+  struct Case {
+    Unit unit;
+    float value;
+    int16_t wire;
+  };
+  const Case cases[] = {
+      {Volts, 655.36f, INT16_MAX}, {Volts, 1.0e6f, INT16_MAX}, {Volts, -655.38f, INT16_MIN},
+      {Amps, 700, INT16_MAX},      {Amps, -1.0e12f, INT16_MIN}, {Watts, 163840, INT16_MAX},
+      {Watts, -163845, INT16_MIN},
+  };
+  bool passed = true;
+  printf("Out of range     fixed   double path\n");
+  for (unsigned i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    const Case &c = cases[i];
+    int16_t wire = fixedWire(c.unit, c.value);
+    /* encodeRaw() keeps the low 16 bits */
+    int16_t wrapped = (int16_t)(uint16_t)(int64_t)(c.value / unitScales[c.unit]);
+    char label[24];
+    snprintf(label, sizeof(label), "%g %s", c.value, unitNames[c.unit]);
+    printf("  %-14s %-7d %d\n", label, wire, wrapped);
+    passed = passed && wire == c.wire;
+  }
+  printf("\n");
+  return passed;
+}
+
+int main(int argc, char **argv) {
+  long iterations = (argc > 1) ? atol(argv[1]) : 10000000;
+  if (iterations <= 0) {
+    return 1;
+  }
+  bool passed = checkGoldenFrames();
+  passed = checkStepSetpoints() && passed;
+  passed = checkAllWireValues() && passed;
+  passed = checkRandomSetpoints() && passed;
+  passed = checkSaturation() && passed;
+
+  /* Setpoints change between packages, the frames go out every 10 ms or faster */
+  DoubleSetpoints doubleSetpoints = {12.34f, Voltage, Independent, true, {-5, -100, -2000}};
+  FixedSetpoints fixedSetpoints = toFixed(doubleSetpoints);
+  uint8_t command[8], limits[8];
+  uint32_t sum = 0;
+  int64_t start = OSPort::getTimeUs();
+  for (long i = 0; i < iterations; i++) {
+    doubleSetpoints.command = (float)(i & 0x3FFF) * 0.02f;
+    buildDouble(doubleSetpoints, i, command, limits);
+    sum += command[2] + limits[2];
+  }
+  double doubleBuildNs = (OSPort::getTimeUs() - start) * 1000.0 / iterations;
+  start = OSPort::getTimeUs();
+  for (long i = 0; i < iterations; i++) {
+    fixedSetpoints.command = (i & 0x3FFF) * VOLTAGE_LSB_MV;
+    buildFixed(fixedSetpoints, i, command, limits);
+    sum += command[2] + limits[2];
+  }
+  double fixedBuildNs = (OSPort::getTimeUs() - start) * 1000.0 / iterations;
+
+  uint8_t data[8] = {0x02, 0x69, 0xFF, 0x51, 0x00, 0x00, 0x10, 0x00};
+  float decoded = 0;
+  start = OSPort::getTimeUs();
+  for (long i = 0; i < iterations; i++) {
+    data[1] = i;
+    double values[ABC150Codec::DATA_FIELDS];
+    ABC150Codec::decode(ABC150Codec::DATA_LAYOUT, data, values);
+    decoded += (float)values[ABC150Codec::DATA_VOLTAGE] + (float)values[ABC150Codec::DATA_CURRENT];
+  }
+  double doubleDecodeNs = (OSPort::getTimeUs() - start) * 1000.0 / iterations;
+  start = OSPort::getTimeUs();
+  for (long i = 0; i < iterations; i++) {
+    data[1] = i;
+    int64_t raws[ABC150Codec::DATA_FIELDS];
+    ABC150Codec::decodeRaw(ABC150Codec::DATA_LAYOUT, data, raws);
+    decoded += fromWire(Volts, raws[ABC150Codec::DATA_VOLTAGE]) + fromWire(Amps, raws[ABC150Codec::DATA_CURRENT]);
+  }
+  double fixedDecodeNs = (OSPort::getTimeUs() - start) * 1000.0 / iterations;
+
+  printf("%ld iterations         double      fixed\n", iterations);
+  printf("  COMMAND + LIMITS_OUT  %6.1f ns   %6.1f ns\n", doubleBuildNs, fixedBuildNs);
+  printf("  DATA decode           %6.1f ns   %6.1f ns\n", doubleDecodeNs, fixedDecodeNs);
+  if (sum == 1 || decoded == 0.5f) {
+    printf("\n");
+  }
+  printf("\n%s\n", passed ? "Fixed-point frames as expected" : "Fixed-point frames are WRONG");
+  return passed ? 0 : 1;
+}
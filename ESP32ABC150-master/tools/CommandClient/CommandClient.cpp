@@ -0,0 +1,318 @@
+/*
+ * CommandClient.cpp
+ */
+
+#include "CommandClient.hpp"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+static int64_t nowMs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+CommandClient::CommandClient(int _fd, uint32_t _timeoutMs, int _retries) :
+                             fd(_fd),
+                             timeoutMs(_timeoutMs),
+                             retries(_retries),
+                             frameLength(0),
+                             overflow(false),
+                             retried(0),
+                             stray(0),
+                             requestBytes(0),
+                             responseBytes(0){
+  /* A random start, so a repeat of the last sequence of a previous client is unlikely */
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  srand(ts.tv_nsec ^ getpid());
+  sequence = rand();
+}
+
+int CommandClient::openSerial(const char *device, int baudRate) {
+  speed_t speed;
+  switch (baudRate) {
+  case 9600:
+    speed = B9600;
+    break;
+  case 115200:
+    speed = B115200;
+    break;
+  case 230400:
+    speed = B230400;
+    break;
+  case 460800:
+    speed = B460800;
+    break;
+  case 921600:
+    speed = B921600;
+    break;
+  default:
+    return -1;
+  }
+  int serial = open(device, O_RDWR | O_NOCTTY);
+  if (serial < 0) {
+    return -1;
+  }
+  struct termios tty;
+  if (tcgetattr(serial, &tty) != 0) {
+    close(serial);
+    return -1;
+  }
+  cfmakeraw(&tty);
+  cfsetispeed(&tty, speed);
+  cfsetospeed(&tty, speed);
+  tty.c_cflag |= CLOCAL | CREAD;
+  tty.c_cflag &= ~(CSTOPB | CRTSCTS);
+  tty.c_cc[VMIN] = 0;
+  tty.c_cc[VTIME] = 0;
+  if (tcsetattr(serial, TCSANOW, &tty) != 0) {
+    close(serial);
+    return -1;
+  }
+  tcflush(serial, TCIOFLUSH);
+  return serial;
+}
+
+bool CommandClient::call(uint8_t command, CommandProtocol::Message &request, CommandProtocol::Message &response) {
+  request.type = CommandProtocol::Request;
+  request.sequence = ++sequence;
+  request.command = command;
+  uint8_t out[COMMAND_MAX_FRAME];
+  size_t length = CommandProtocol::encode(request, out, sizeof(out));
+  if (length == 0) {
+    return false;
+  }
+  requestBytes = length;
+  for (int attempt = 0; attempt <= retries; attempt++) {
+    if (attempt > 0) {
+      retried++;
+    }
+    if (!send(out, length)) {
+      return false;
+    }
+    if (receive(request.sequence, command, response)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool CommandClient::send(const uint8_t *data, size_t length) {
+  while (length > 0) {
+    ssize_t written = write(fd, data, length);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data += written;
+    length -= written;
+  }
+  return true;
+}
+
+bool CommandClient::receive(uint16_t expectedSequence, uint8_t command, CommandProtocol::Message &response) {
+  int64_t deadline = nowMs() + timeoutMs;
+  uint8_t data[256];
+  while (1) {
+    int64_t left = deadline - nowMs();
+    if (left <= 0) {
+      return false;
+    }
+    struct pollfd pfd = {fd, POLLIN, 0};
+    int ready = poll(&pfd, 1, left);
+    if (ready < 0 && errno != EINTR) {
+      return false;
+    }
+    if (ready <= 0) {
+      continue;
+    }
+    ssize_t length = read(fd, data, sizeof(data));
+    if (length <= 0) {
+      if (length < 0 && (errno == EINTR || errno == EAGAIN)) {
+        continue;
+      }
+      return false;
+    }
+    for (ssize_t i = 0; i < length; i++) {
+      if (data[i] != 0) {
+        if (frameLength < sizeof(frame)) {
+          frame[frameLength++] = data[i];
+        } else {
+          overflow = true;
+        }
+        continue;
+      }
+      if (frameLength == 0) {
+        continue;
+      }
+      bool matched = !overflow && CommandProtocol::decode(frame, frameLength, &response) &&
+                     response.type == CommandProtocol::Response && response.sequence == expectedSequence &&
+                     response.command == command;
+      size_t received = frameLength + 2;
+      frameLength = 0;
+      overflow = false;
+      if (!matched) {
+        stray++;
+        continue;
+      }
+      /* One request is pending at a time, nothing else is due after its response */
+      responseBytes = received;
+      return true;
+    }
+  }
+}
+
+int CommandClient::simpleCall(uint8_t command, CommandProtocol::Message &request) {
+  CommandProtocol::Message response;
+  if (!call(command, request, response)) {
+    return NoAnswer;
+  }
+  return response.result;
+}
+
+int CommandClient::ping(uint32_t *uptimeMs) {
+  CommandProtocol::Message request, response;
+  request.clear();
+  if (!call(CommandProtocol::Ping, request, response)) {
+    return NoAnswer;
+  }
+  if (response.result == CommandProtocol::Ok && !response.get32(uptimeMs)) {
+    return CommandProtocol::BadLength;
+  }
+  return response.result;
+}
+
+int CommandClient::getStatus(TelemetryStatus *status) {
+  CommandProtocol::Message request, response;
+  request.clear();
+  if (!call(CommandProtocol::GetStatus, request, response)) {
+    return NoAnswer;
+  }
+  if (response.result != CommandProtocol::Ok) {
+    return response.result;
+  }
+  if (!response.get32(&status->timeMs) ||
+      !TelemetryFrame::getStatus(response.payload + response.position, response.length - response.position,
+                                 status)) {
+    return CommandProtocol::BadLength;
+  }
+  return CommandProtocol::Ok;
+}
+
+int CommandClient::listTests(std::vector<TestInfo> *tests) {
+  CommandProtocol::Message request, response;
+  request.clear();
+  if (!call(CommandProtocol::ListTests, request, response)) {
+    return NoAnswer;
+  }
+  if (response.result != CommandProtocol::Ok) {
+    return response.result;
+  }
+  uint8_t count;
+  if (!response.get8(&count)) {
+    return CommandProtocol::BadLength;
+  }
+  tests->clear();
+  for (int i = 0; i < count; i++) {
+    TestInfo test;
+    char name[256];
+    if (!response.get8(&test.type) || !response.get8(&test.index) || !response.get8(&test.channel) ||
+        !response.get8(&test.state) || !response.get8(&test.flags) || !response.getString(name, sizeof(name))) {
+      return CommandProtocol::BadLength;
+    }
+    test.name = name;
+    tests->push_back(test);
+  }
+  return CommandProtocol::Ok;
+}
+
+int CommandClient::startTest(uint8_t type, uint8_t index, uint16_t cycles, int32_t voltageMv, uint8_t profile) {
+  CommandProtocol::Message request;
+  request.clear();
+  request.put8(type);
+  request.put8(index);
+  request.put16(cycles);
+  request.put32(voltageMv);
+  request.put8(profile);
+  return simpleCall(CommandProtocol::StartTest, request);
+}
+
+int CommandClient::stopTest(uint8_t type, uint8_t index) {
+  CommandProtocol::Message request;
+  request.clear();
+  request.put8(type);
+  request.put8(index);
+  return simpleCall(CommandProtocol::StopTest, request);
+}
+
+int CommandClient::stopAll(bool override) {
+  CommandProtocol::Message request;
+  request.clear();
+  request.put8(override ? 1 : 0);
+  return simpleCall(CommandProtocol::StopAll, request);
+}
+
+int CommandClient::setSetpoint(uint8_t channel, uint8_t setpoint, int32_t value) {
+  CommandProtocol::Message request;
+  request.clear();
+  request.put8(channel);
+  request.put8(setpoint);
+  request.put32(value);
+  return simpleCall(CommandProtocol::SetSetpoint, request);
+}
+
+int CommandClient::setControl(uint8_t channel, uint8_t control) {
+  CommandProtocol::Message request;
+  request.clear();
+  request.put8(channel);
+  request.put8(control);
+  return simpleCall(CommandProtocol::SetControl, request);
+}
+
+int CommandClient::setBMID(uint8_t channel, uint32_t id) {
+  CommandProtocol::Message request;
+  request.clear();
+  request.put8(channel);
+  request.put32(id);
+  return simpleCall(CommandProtocol::SetBMID, request);
+}
+
+int CommandClient::setTelemetryRate(uint8_t hz) {
+  CommandProtocol::Message request;
+  request.clear();
+  request.put8(hz);
+  return simpleCall(CommandProtocol::SetTelemetryRate, request);
+}
+
+int CommandClient::setPowerTracking(uint8_t type, uint8_t index, bool enable) {
+  CommandProtocol::Message request;
+  request.clear();
+  request.put8(type);
+  request.put8(index);
+  request.put8(enable ? 1 : 0);
+  return simpleCall(CommandProtocol::SetPowerTracking, request);
+}
+
+uint32_t CommandClient::getRetries() {
+  return retried;
+}
+
+uint32_t CommandClient::getStray() {
+  return stray;
+}
+
+size_t CommandClient::getRequestBytes() {
+  return requestBytes;
+}
+
+size_t CommandClient::getResponseBytes() {
+  return responseBytes;
+}
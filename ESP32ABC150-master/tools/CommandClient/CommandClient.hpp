@@ -0,0 +1,83 @@
+/*
+ * CommandClient.hpp
+ *
+ * Host side of CommandProtocol (components/ABC150/include/CommandProtocol.hpp)
+ * over a file descriptor: a serial port opened with openSerial(), or any
+ * stream socket. call() sends a request and waits for the response with its
+ * sequence and command, sending the same request again after each timeout.
+ * The typed calls return the CommandProtocol::Result, or NoAnswer.
+ */
+
+#ifndef _COMMANDCLIENT_HPP_
+#define _COMMANDCLIENT_HPP_
+
+#include "CommandProtocol.hpp"
+#include "TelemetryFrame.hpp"
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define COMMAND_CLIENT_TIMEOUT_MS   1000
+#define COMMAND_CLIENT_RETRIES      3
+
+class CommandClient {
+public:
+  enum {NoAnswer = -1};
+
+  struct TestInfo {
+    uint8_t type;
+    uint8_t index;
+    uint8_t channel;
+    uint8_t state;
+    uint8_t flags;
+    std::string name;
+  };
+
+  CommandClient(int _fd, uint32_t _timeoutMs = COMMAND_CLIENT_TIMEOUT_MS, int _retries = COMMAND_CLIENT_RETRIES);
+  /* Raw 8N1 serial port, -1 on error */
+  static int openSerial(const char *device, int baudRate);
+
+  /* Sends request with a new sequence, false if there was no answer. response is the matching response. */
+  bool call(uint8_t command, CommandProtocol::Message &request, CommandProtocol::Message &response);
+
+  int ping(uint32_t *uptimeMs);
+  int getStatus(TelemetryStatus *status);
+  int listTests(std::vector<TestInfo> *tests);
+  int startTest(uint8_t type, uint8_t index, uint16_t cycles, int32_t voltageMv, uint8_t profile);
+  int stopTest(uint8_t type, uint8_t index);
+  int stopAll(bool override);
+  int setSetpoint(uint8_t channel, uint8_t setpoint, int32_t value);
+  int setControl(uint8_t channel, uint8_t control);
+  int setBMID(uint8_t channel, uint32_t id);
+  int setTelemetryRate(uint8_t hz);
+  int setPowerTracking(uint8_t type, uint8_t index, bool enable);
+
+  /* Requests sent again after a timeout */
+  uint32_t getRetries();
+  /* Frames that were no answer to the pending request: late answers, telemetry, noise */
+  uint32_t getStray();
+  /* Bytes of the last request and response frame */
+  size_t getRequestBytes();
+  size_t getResponseBytes();
+
+private:
+  int fd;
+  uint32_t timeoutMs;
+  int retries;
+  uint16_t sequence;
+  uint8_t frame[COMMAND_MAX_FRAME];
+  size_t frameLength;
+  bool overflow;
+  uint32_t retried;
+  uint32_t stray;
+  size_t requestBytes;
+  size_t responseBytes;
+
+  bool send(const uint8_t *data, size_t length);
+  /* Waits up to timeoutMs for the response to the pending request */
+  bool receive(uint16_t expectedSequence, uint8_t command, CommandProtocol::Message &response);
+  int simpleCall(uint8_t command, CommandProtocol::Message &request);
+};
+
+#endif /* _COMMANDCLIENT_HPP_ */
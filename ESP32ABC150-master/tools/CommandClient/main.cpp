@@ -0,0 +1,188 @@
+/*
+ * main.cpp
+ *
+ * Sends one command to the test manager's command server and prints the
+ * answer, for scripts. Exits with 0 if the command was carried out, 1 if it
+ * was refused and 2 if there was no answer.
+ *
+ *   commandclient <serial device> <command> [arguments]
+ */
+
+#include "CommandClient.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BAUD_RATE                   115200
+
+static const char *testStateNames[] = {"Idle", "Running", "Success", "Failed", "Restart"};
+static const char *setpointNames[] = {"lower-voltage", "lower-current", "lower-power", "upper-voltage",
+                                      "upper-current", "upper-power", "voltage", "current", "power", "load-mode"};
+static const char *controlNames[] = {"enable", "disable", "take", "release"};
+
+static void usage(const char *name) {
+  fprintf(stderr, "Usage: %s <serial device> <command> [arguments]\n"
+          "  ping\n"
+          "  status\n"
+          "  list\n"
+          "  start single|dual <test> [cycles [voltage V [profile]]]\n"
+          "  stop single|dual <test>\n"
+          "  stopall [override]\n"
+          "  set a|b lower-voltage|lower-current|lower-power|upper-voltage|upper-current|upper-power|\n"
+          "          voltage|current|power|load-mode <V, A, W or mode>\n"
+          "  control a|b enable|disable|take|release\n"
+          "  bmid a|b <Ample ID>\n"
+          "  telemetry <Hz, 0 off>\n"
+          "  tracking single|dual <test> on|off\n", name);
+}
+
+static int find(const char *name, const char **names, int count) {
+  for (int i = 0; i < count; i++) {
+    if (strcmp(name, names[i]) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static int parseChannel(const char *name) {
+  if (strcmp(name, "a") == 0 || strcmp(name, "A") == 0) {
+    return 0;
+  }
+  if (strcmp(name, "b") == 0 || strcmp(name, "B") == 0) {
+    return 1;
+  }
+  return -1;
+}
+
+static int parseTestType(const char *name) {
+  if (strcmp(name, "single") == 0) {
+    return CommandProtocol::Single;
+  }
+  if (strcmp(name, "dual") == 0) {
+    return CommandProtocol::Dual;
+  }
+  return -1;
+}
+
+/* In the units of ABC150Units.hpp */
+static int32_t toUnits(int setpoint, double value) {
+  switch (setpoint) {
+  case CommandProtocol::LowerVoltageLimit:
+  case CommandProtocol::UpperVoltageLimit:
+  case CommandProtocol::Voltage:
+    return (int32_t)(value * 1000 + (value < 0 ? -0.5 : 0.5));
+  case CommandProtocol::LowerCurrentLimit:
+  case CommandProtocol::UpperCurrentLimit:
+  case CommandProtocol::Current:
+    return (int32_t)(value * 100 + (value < 0 ? -0.5 : 0.5));
+  default:
+    return (int32_t)value;
+  }
+}
+
+static void printStatus(const TelemetryStatus &status) {
+  printf("time %u ms\n", status.timeMs);
+  for (int ch = 0; ch < TELEMETRY_CHANNELS; ch++) {
+    const TelemetryChannelStatus &channel = status.channels[ch];
+    printf("channel %c: converter status %u, control mode %u, enable %u, command %d, "
+           "lower limits %d %d %d, upper limits %d %d %d (wire units)\n", 'A' + ch, channel.converterStatus,
+           channel.controlMode, channel.enable, channel.command, channel.lowerVoltageLimit,
+           channel.lowerCurrentLimit, channel.lowerPowerLimit, channel.upperVoltageLimit, channel.upperCurrentLimit,
+           channel.upperPowerLimit);
+  }
+  printf("tests:");
+  for (int i = 0; i < status.testCount; i++) {
+    printf(" %s", (status.testStates[i] < 5) ? testStateNames[status.testStates[i]] : "Unknown");
+  }
+  const TelemetryBattery &battery = status.battery;
+  printf("\nbattery: soc %.2f %%, %u online, %u HV on, max temp %.1f C, cells %.3f-%.3f V\n", battery.soc / 100.0,
+         battery.onlineCount, battery.hvOnCount, battery.maxTemp / 10.0, battery.minCellVoltage / 1000.0,
+         battery.maxCellVoltage / 1000.0);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    usage(argv[0]);
+    return 1;
+  }
+  int fd = CommandClient::openSerial(argv[1], BAUD_RATE);
+  if (fd < 0) {
+    perror(argv[1]);
+    return 2;
+  }
+  CommandClient client(fd);
+  const char *command = argv[2];
+  int args = argc - 3;
+  char **arg = argv + 3;
+  int result = CommandProtocol::InvalidArgument;
+  bool parsed = true;
+
+  if (strcmp(command, "ping") == 0) {
+    uint32_t uptimeMs;
+    result = client.ping(&uptimeMs);
+    if (result == CommandProtocol::Ok) {
+      printf("uptime %u ms\n", uptimeMs);
+    }
+  } else if (strcmp(command, "status") == 0) {
+    TelemetryStatus status;
+    result = client.getStatus(&status);
+    if (result == CommandProtocol::Ok) {
+      printStatus(status);
+    }
+  } else if (strcmp(command, "list") == 0) {
+    std::vector<CommandClient::TestInfo> tests;
+    result = client.listTests(&tests);
+    for (size_t i = 0; result == CommandProtocol::Ok && i < tests.size(); i++) {
+      const CommandClient::TestInfo &test = tests[i];
+      printf("%-6s %-3u %-25s %-8s %-8s%s%s%s\n", (test.type == CommandProtocol::Single) ? "single" : "dual",
+             test.index, test.name.c_str(), (test.channel == COMMAND_NO_CHANNEL) ? "dual" :
+             (test.channel == 0) ? "A" : "B", (test.state < 5) ? testStateNames[test.state] : "Unknown",
+             (test.flags & CommandProtocol::HasCycles) ? " cycles" : "",
+             (test.flags & CommandProtocol::HasVoltage) ? " voltage" : "",
+             (test.flags & CommandProtocol::HasProfile) ? " profile" : "");
+    }
+  } else if (strcmp(command, "start") == 0 && args >= 2 && args <= 5 && parseTestType(arg[0]) >= 0) {
+    int cycles = (args > 2) ? atoi(arg[2]) : 1;
+    int32_t voltageMv = (args > 3) ? toUnits(CommandProtocol::Voltage, atof(arg[3])) : 0;
+    int profile = (args > 4) ? atoi(arg[4]) : 0;
+    result = client.startTest(parseTestType(arg[0]), atoi(arg[1]), cycles, voltageMv, profile);
+  } else if (strcmp(command, "stop") == 0 && args == 2 && parseTestType(arg[0]) >= 0) {
+    result = client.stopTest(parseTestType(arg[0]), atoi(arg[1]));
+  } else if (strcmp(command, "stopall") == 0 && args <= 1) {
+    result = client.stopAll(args == 1 && strcmp(arg[0], "override") == 0);
+  } else if (strcmp(command, "set") == 0 && args == 3 && parseChannel(arg[0]) >= 0 &&
+             find(arg[1], setpointNames, sizeof(setpointNames) / sizeof(setpointNames[0])) >= 0) {
+    int setpoint = find(arg[1], setpointNames, sizeof(setpointNames) / sizeof(setpointNames[0]));
+    result = client.setSetpoint(parseChannel(arg[0]), setpoint, toUnits(setpoint, atof(arg[2])));
+  } else if (strcmp(command, "control") == 0 && args == 2 && parseChannel(arg[0]) >= 0 &&
+             find(arg[1], controlNames, sizeof(controlNames) / sizeof(controlNames[0])) >= 0) {
+    result = client.setControl(parseChannel(arg[0]),
+                               find(arg[1], controlNames, sizeof(controlNames) / sizeof(controlNames[0])));
+  } else if (strcmp(command, "bmid") == 0 && args == 2 && parseChannel(arg[0]) >= 0) {
+    result = client.setBMID(parseChannel(arg[0]), strtoul(arg[1], NULL, 0));
+  } else if (strcmp(command, "telemetry") == 0 && args == 1) {
+    result = client.setTelemetryRate(atoi(arg[0]));
+  } else if (strcmp(command, "tracking") == 0 && args == 3 && parseTestType(arg[0]) >= 0 &&
+             (strcmp(arg[2], "on") == 0 || strcmp(arg[2], "off") == 0)) {
+    result = client.setPowerTracking(parseTestType(arg[0]), atoi(arg[1]), strcmp(arg[2], "on") == 0);
+  } else {
+    parsed = false;
+  }
+  close(fd);
+
+  if (!parsed) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (result == CommandClient::NoAnswer) {
+    fprintf(stderr, "%s: no answer\n", command);
+    return 2;
+  }
+  if (result != CommandProtocol::Ok) {
+    fprintf(stderr, "%s: %s\n", command, CommandProtocol::getResultName(result));
+    return 1;
+  }
+  return 0;
+}
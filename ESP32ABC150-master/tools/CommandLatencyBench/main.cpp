@@ -0,0 +1,317 @@
+/*
+ * main.cpp
+ *
+ * Round trip latency of the binary command protocol against the POSIX build:
+ * CommandServer runs as an OSPort task on tools/host/OSPortPOSIX.cpp, reading
+ * and writing one end of a socket pair like the command UART, and
+ * CommandClient drives the other end. The handler is a stand-in for
+ * ABC150TestManager::handleCommand with the same arguments and results, as
+ * the test manager needs the AmpleNetwork components.
+ *
+ * Each command is timed from the client's write to the matching response,
+ * with the time a 115200 baud UART adds for both frames. A second run drops
+ * responses and corrupts requests on the way: every call must still be
+ * answered, and a start that was retried must run exactly once.
+ *
+ *   CommandLatencyBench [calls]      default 2000 per command
+ */
+
+#include "CommandClient.hpp"
+#include "CommandServer.hpp"
+#include "CommandProtocol.hpp"
+#include "TelemetryFrame.hpp"
+#include "OSPort.hpp"
+#include <algorithm>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+#define UART_BAUD                   115200
+#define UART_BITS_PER_BYTE          10
+#define READ_TIMEOUT_MS             20
+#define LOSSY_TIMEOUT_MS            30
+/* Lossy link: every nth response is dropped, every nth request read is corrupted */
+#define DROP_RESPONSE_EVERY         7
+#define CORRUPT_REQUEST_EVERY       11
+#define TESTS                       8
+#define SINGLE_TESTS                6
+
+/* Test manager stand-in, states as in ABC150Test::TestState */
+enum {Idle, Running};
+
+struct Manager {
+  uint8_t states[TESTS];
+  uint32_t starts[TESTS];
+  int32_t setpoints[2][CommandProtocol::LoadMode + 1];
+  uint32_t bmID[2];
+  uint8_t rate;
+};
+
+static const char *testNames[TESTS] = {"PulseTest", "PulseTest", "CapacityTest", "CapacityTest",
+                                       "ChargeDischargeTest", "ChargeDischargeTest", "PlateDriveCycleTest",
+                                       "PlateChargeDischargeTest"};
+
+static int toIndex(uint8_t type, uint8_t test) {
+  if (type == CommandProtocol::Single && test < SINGLE_TESTS) {
+    return test;
+  }
+  if (type == CommandProtocol::Dual && test < TESTS - SINGLE_TESTS) {
+    return SINGLE_TESTS + test;
+  }
+  return -1;
+}
+
+static CommandProtocol::Result handle(void *arg, CommandProtocol::Message &request,
+                                      CommandProtocol::Message &response) {
+  Manager *manager = (Manager *)arg;
+  uint8_t type, test, channel, value8, profile;
+  uint16_t cycles;
+  uint32_t value32;
+  int index;
+  TelemetryStatus status = {};
+
+  switch (request.command) {
+  case CommandProtocol::Ping:
+    response.put32(OSPort::getTickMs());
+    return CommandProtocol::Ok;
+
+  case CommandProtocol::GetStatus:
+    status.testCount = TESTS;
+    memcpy(status.testStates, manager->states, TESTS);
+    response.put32(OSPort::getTickMs());
+    response.length += TelemetryFrame::putStatus(status, response.payload + response.length);
+    return CommandProtocol::Ok;
+
+  case CommandProtocol::ListTests:
+    response.put8(TESTS);
+    for (int i = 0; i < TESTS; i++) {
+      bool single = i < SINGLE_TESTS;
+      response.put8(single ? CommandProtocol::Single : CommandProtocol::Dual);
+      response.put8(single ? i : i - SINGLE_TESTS);
+      response.put8(single ? i % 2 : COMMAND_NO_CHANNEL);
+      response.put8(manager->states[i]);
+      response.put8(CommandProtocol::HasCycles);
+      response.putString(testNames[i]);
+    }
+    return CommandProtocol::Ok;
+
+  case CommandProtocol::StartTest:
+    if (!request.get8(&type) || !request.get8(&test) || !request.get16(&cycles) || !request.get32(&value32) ||
+        !request.get8(&profile) || !request.atEnd()) {
+      return CommandProtocol::BadLength;
+    }
+    index = toIndex(type, test);
+    if (index < 0) {
+      return CommandProtocol::InvalidArgument;
+    }
+    if (manager->states[index] == Running) {
+      return CommandProtocol::Rejected;
+    }
+    manager->states[index] = Running;
+    manager->starts[index]++;
+    return CommandProtocol::Ok;
+
+  case CommandProtocol::StopTest:
+    if (!request.get8(&type) || !request.get8(&test) || !request.atEnd()) {
+      return CommandProtocol::BadLength;
+    }
+    index = toIndex(type, test);
+    if (index < 0) {
+      return CommandProtocol::InvalidArgument;
+    }
+    if (manager->states[index] != Running) {
+      return CommandProtocol::Rejected;
+    }
+    manager->states[index] = Idle;
+    return CommandProtocol::Ok;
+
+  case CommandProtocol::SetSetpoint:
+    if (!request.get8(&channel) || !request.get8(&value8) || !request.get32(&value32) || !request.atEnd()) {
+      return CommandProtocol::BadLength;
+    }
+    if (channel > 1 || value8 > CommandProtocol::LoadMode) {
+      return CommandProtocol::InvalidArgument;
+    }
+    manager->setpoints[channel][value8] = value32;
+    return CommandProtocol::Ok;
+
+  case CommandProtocol::SetBMID:
+    if (!request.get8(&channel) || !request.get32(&value32) || !request.atEnd()) {
+      return CommandProtocol::BadLength;
+    }
+    if (channel > 1) {
+      return CommandProtocol::InvalidArgument;
+    }
+    manager->bmID[channel] = value32;
+    return CommandProtocol::Ok;
+
+  case CommandProtocol::SetTelemetryRate:
+    if (!request.get8(&value8) || !request.atEnd()) {
+      return CommandProtocol::BadLength;
+    }
+    manager->rate = value8;
+    return CommandProtocol::Ok;
+
+  default:
+    return CommandProtocol::UnknownCommand;
+  }
+}
+
+/* Server end of the link */
+
+struct Link {
+  int fd;
+  bool lossy;
+  uint32_t reads;
+  uint32_t writes;
+  uint32_t dropped;
+  uint32_t corrupted;
+};
+
+static int linkRead(uint8_t *data, size_t size, void *arg) {
+  Link *link = (Link *)arg;
+  struct pollfd pfd = {link->fd, POLLIN, 0};
+  if (poll(&pfd, 1, READ_TIMEOUT_MS) <= 0) {
+    return 0;
+  }
+  ssize_t length = read(link->fd, data, size);
+  if (length <= 0) {
+    return -1;
+  }
+  if (link->lossy && ++link->reads % CORRUPT_REQUEST_EVERY == 0 && length > 4) {
+    data[length / 2] ^= 0x80;
+    link->corrupted++;
+  }
+  return length;
+}
+
+static void linkWrite(const uint8_t *data, size_t length, void *arg) {
+  Link *link = (Link *)arg;
+  if (link->lossy && ++link->writes % DROP_RESPONSE_EVERY == 0) {
+    link->dropped++;
+    return;
+  }
+  while (length > 0) {
+    ssize_t written = write(link->fd, data, length);
+    if (written <= 0) {
+      return;
+    }
+    data += written;
+    length -= written;
+  }
+}
+
+/* Timing */
+
+struct Timing {
+  const char *name;
+  std::vector<int64_t> us;
+  size_t bytes;
+  uint32_t failed;
+
+  Timing(const char *_name) : name(_name), bytes(0), failed(0) {}
+};
+
+static void report(Timing &timing) {
+  std::sort(timing.us.begin(), timing.us.end());
+  size_t n = timing.us.size();
+  double uartUs = (double)timing.bytes * UART_BITS_PER_BYTE * 1000000 / UART_BAUD;
+  printf("  %-12s %-8zu %-9lld %-9lld %-9lld %-7zu %-10.0f %u\n", timing.name, n,
+         (long long)(n ? timing.us[n / 2] : 0), (long long)(n ? timing.us[n * 99 / 100] : 0),
+         (long long)(n ? timing.us[n - 1] : 0), timing.bytes, uartUs, timing.failed);
+}
+
+static void record(Timing &timing, CommandClient &client, int64_t start, int result) {
+  if (result != CommandProtocol::Ok) {
+    timing.failed++;
+    return;
+  }
+  timing.us.push_back(OSPort::getTimeUs() - start);
+  timing.bytes = client.getRequestBytes() + client.getResponseBytes();
+}
+
+int main(int argc, char **argv) {
+  int calls = (argc > 1) ? atoi(argv[1]) : 2000;
+  if (calls <= 0) {
+    return 1;
+  }
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+    perror("socketpair");
+    return 1;
+  }
+  Manager manager = {};
+  Link link = {fds[0], false, 0, 0, 0, 0};
+  CommandServer server(&handle, &manager);
+  if (!server.start(&linkRead, &linkWrite, &link)) {
+    return 1;
+  }
+  CommandClient client(fds[1]);
+
+  Timing timings[] = {{"Ping"}, {"GetStatus"}, {"ListTests"}, {"StartTest"}, {"StopTest"}, {"SetSetpoint"},
+                      {"SetBMID"}};
+  uint32_t uptimeMs;
+  TelemetryStatus status;
+  std::vector<CommandClient::TestInfo> tests;
+  for (int i = 0; i < calls; i++) {
+    int64_t start = OSPort::getTimeUs();
+    record(timings[0], client, start, client.ping(&uptimeMs));
+    start = OSPort::getTimeUs();
+    record(timings[1], client, start, client.getStatus(&status));
+    start = OSPort::getTimeUs();
+    int result = client.listTests(&tests);
+    record(timings[2], client, start, (tests.size() == TESTS) ? result : CommandProtocol::BadLength);
+    start = OSPort::getTimeUs();
+    record(timings[3], client, start, client.startTest(CommandProtocol::Single, i % SINGLE_TESTS, 1, 380000, 0));
+    start = OSPort::getTimeUs();
+    record(timings[4], client, start, client.stopTest(CommandProtocol::Single, i % SINGLE_TESTS));
+    start = OSPort::getTimeUs();
+    record(timings[5], client, start, client.setSetpoint(i % 2, CommandProtocol::UpperCurrentLimit, 15000 + i));
+    start = OSPort::getTimeUs();
+    record(timings[6], client, start, client.setBMID(i % 2, 0x0F000100 + i));
+  }
+
+  printf("%d calls per command, socket pair, times in us\n\n", calls);
+  printf("  %-12s %-8s %-9s %-9s %-9s %-7s %-10s %s\n", "Command", "Calls", "Median", "p99", "Max", "Bytes",
+         "UART us", "Failed");
+  bool passed = true;
+  for (size_t t = 0; t < sizeof(timings) / sizeof(timings[0]); t++) {
+    report(timings[t]);
+    passed = timings[t].failed == 0 && passed;
+  }
+  passed = client.getRetries() == 0 && server.getRepeats() == 0 && passed;
+
+  /* Lossy link, every start must run exactly once despite the retries */
+  CommandClient lossyClient(fds[1], LOSSY_TIMEOUT_MS, COMMAND_CLIENT_RETRIES + 2);
+  Timing lossy = {"Start/Stop"};
+  uint32_t startsBefore = manager.starts[0];
+  uint32_t repeatsBefore = server.getRepeats();
+  link.lossy = true;
+  int lossyCalls = calls / 10;
+  for (int i = 0; i < lossyCalls; i++) {
+    int64_t start = OSPort::getTimeUs();
+    record(lossy, lossyClient, start, lossyClient.startTest(CommandProtocol::Single, 0, 1, 0, 0));
+    start = OSPort::getTimeUs();
+    record(lossy, lossyClient, start, lossyClient.stopTest(CommandProtocol::Single, 0));
+  }
+  link.lossy = false;
+  uint32_t starts = manager.starts[0] - startsBefore;
+  printf("\nLossy link, 1 in %d responses dropped, 1 in %d request reads corrupted, %d ms timeout\n\n",
+         DROP_RESPONSE_EVERY, CORRUPT_REQUEST_EVERY, LOSSY_TIMEOUT_MS);
+  printf("  %-12s %-8s %-9s %-9s %-9s %-7s %-10s %s\n", "Command", "Calls", "Median", "p99", "Max", "Bytes",
+         "UART us", "Failed");
+  report(lossy);
+  printf("\n  %u responses dropped, %u requests corrupted, %u retries, %u answered again, "
+         "%u of %d starts run\n", link.dropped, link.corrupted, lossyClient.getRetries(),
+         server.getRepeats() - repeatsBefore, starts, lossyCalls);
+  passed = lossy.failed == 0 && starts == (uint32_t)lossyCalls && lossyClient.getRetries() > 0 &&
+           server.getRepeats() > repeatsBefore && passed;
+
+  printf("\n%s\n", passed ? "All commands answered, retried commands ran once" : "CommandLatencyBench FAILED");
+  close(fds[1]);
+  return passed ? 0 : 1;
+}
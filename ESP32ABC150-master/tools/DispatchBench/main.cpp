@@ -0,0 +1,256 @@
+/*
+ * main.cpp
+ *
+ * Time per received frame of ABC150CANHandler's message ID dispatch, under
+ * the traffic the simulator puts on the bus: DATA every 10 ms, STATUS and
+ * LIMITS every 100 ms, STATION_ID every second, per channel.
+ *
+ *  - msgReceived(): the real ABC150CANHandler::msgReceived() of the host
+ *    build, called directly like the CAN driver calls its listener, and
+ *    through AmpleCAN::receive() with the listener lookup of the host stub
+ *  - dispatch alone: the 14-arm switch msgReceived() was before, reproduced
+ *    below, against the routes[] and routeIndex[] lookup that replaced it.
+ *    Both call the same empty handlers through a member function pointer
+ *    signature like the handler's, so only the dispatch differs.
+ *
+ * The switch and the table must pick the same handler and channel for every
+ * 11 bit ID and for the recorded traffic, and the handler must end up with
+ * the simulator's voltage. Exits with 1 otherwise.
+ *
+ *   DispatchBench [passes]     default 1000
+ */
+
+#include "ABC150CANHandler.hpp"
+#include "ABC150Codec.hpp"
+#include "ABC150Simulator.hpp"
+#include "AmpleCAN.hpp"
+#include "OSPort.hpp"
+#include <vector>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Simulated bus time recorded, ms */
+#define RECORD_MS                   10000
+#define STANDARD_IDS                0x800
+#define VOLTAGE_TOLERANCE           0.01f
+
+static bool passed = true;
+
+/* Recorded traffic */
+
+static void record(std::vector<CAN_frame_t> &frames, const SimFrame &frame) {
+  CAN_frame_t msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.MsgID = frame.id;
+  msg.FIR.B.FF = CAN_frame_std;
+  msg.FIR.B.DLC = frame.dlc;
+  memcpy(msg.data.u8, frame.data, sizeof(msg.data.u8));
+  frames.push_back(msg);
+}
+
+/* Empty handlers, counting the calls per route */
+
+enum Handler {
+  Data, LowerLimits, UpperLimits, Status, StationID, Greeting, FaultData, PacketProblem, RequestPC, HANDLERS
+};
+
+class Receiver {
+public:
+  typedef ABC150CANHandler::Channel Channel;
+  typedef void (Receiver::*MessageHandler)(Channel channel, CAN_frame_t &msg);
+
+  uint32_t calls[HANDLERS][2];
+
+  Receiver() : calls{} {}
+  __attribute__((noinline)) void handleData(Channel channel, CAN_frame_t &) { calls[Data][channel]++; }
+  __attribute__((noinline)) void handleLowerLimits(Channel channel, CAN_frame_t &) {
+    calls[LowerLimits][channel]++;
+  }
+  __attribute__((noinline)) void handleUpperLimits(Channel channel, CAN_frame_t &) {
+    calls[UpperLimits][channel]++;
+  }
+  __attribute__((noinline)) void handleStatus(Channel channel, CAN_frame_t &) { calls[Status][channel]++; }
+  __attribute__((noinline)) void handleStationID(Channel channel, CAN_frame_t &) {
+    calls[StationID][channel]++;
+  }
+  __attribute__((noinline)) void handleGreeting(Channel channel, CAN_frame_t &) { calls[Greeting][channel]++; }
+  __attribute__((noinline)) void handleFaultData(Channel channel, CAN_frame_t &) {
+    calls[FaultData][channel]++;
+  }
+  __attribute__((noinline)) void handlePacketProblem(Channel channel, CAN_frame_t &) {
+    calls[PacketProblem][channel]++;
+  }
+  __attribute__((noinline)) void handleRequestPC(Channel channel, CAN_frame_t &) {
+    calls[RequestPC][channel]++;
+  }
+};
+
+/* Before: the switch */
+
+__attribute__((noinline)) static void dispatchSwitch(Receiver &rx, CAN_frame_t &msg) {
+  switch(msg.MsgID) {
+  case DATA_A:
+    rx.handleData(ABC150CANHandler::A, msg);
+    break;
+  case DATA_B:
+    rx.handleData(ABC150CANHandler::B, msg);
+    break;
+  case LOWER_LIMITS_A:
+    rx.handleLowerLimits(ABC150CANHandler::A, msg);
+    break;
+  case UPPER_LIMITS_A:
+    rx.handleUpperLimits(ABC150CANHandler::A, msg);
+    break;
+  case STATUS_A:
+    rx.handleStatus(ABC150CANHandler::A, msg);
+    break;
+  case STATION_ID_A:
+    rx.handleStationID(ABC150CANHandler::A, msg);
+    break;
+  case LOWER_LIMITS_B:
+    rx.handleLowerLimits(ABC150CANHandler::B, msg);
+    break;
+  case UPPER_LIMITS_B:
+    rx.handleUpperLimits(ABC150CANHandler::B, msg);
+    break;
+  case STATUS_B:
+    rx.handleStatus(ABC150CANHandler::B, msg);
+    break;
+  case STATION_ID_B:
+    rx.handleStationID(ABC150CANHandler::B, msg);
+    break;
+  case GREETING:
+    rx.handleGreeting(ABC150CANHandler::A, msg);
+    break;
+  case FAULT_DATA:
+    rx.handleFaultData(ABC150CANHandler::A, msg);
+    break;
+  case PACKET_PROBLEM:
+    rx.handlePacketProblem(ABC150CANHandler::A, msg);
+    break;
+  case REQUEST_PC:
+    rx.handleRequestPC(ABC150CANHandler::A, msg);
+    break;
+  }
+}
+
+/* After: routes[] and routeIndex[] as in ABC150CANHandler.cpp */
+
+struct Route {
+  uint16_t id;
+  ABC150CANHandler::Channel channel;
+  Receiver::MessageHandler handler;
+};
+
+static const Route routes[] = {
+    {DATA_A,          ABC150CANHandler::A, &Receiver::handleData},
+    {DATA_B,          ABC150CANHandler::B, &Receiver::handleData},
+    {STATUS_A,        ABC150CANHandler::A, &Receiver::handleStatus},
+    {STATUS_B,        ABC150CANHandler::B, &Receiver::handleStatus},
+    {LOWER_LIMITS_A,  ABC150CANHandler::A, &Receiver::handleLowerLimits},
+    {UPPER_LIMITS_A,  ABC150CANHandler::A, &Receiver::handleUpperLimits},
+    {STATION_ID_A,    ABC150CANHandler::A, &Receiver::handleStationID},
+    {LOWER_LIMITS_B,  ABC150CANHandler::B, &Receiver::handleLowerLimits},
+    {UPPER_LIMITS_B,  ABC150CANHandler::B, &Receiver::handleUpperLimits},
+    {STATION_ID_B,    ABC150CANHandler::B, &Receiver::handleStationID},
+    {GREETING,        ABC150CANHandler::A, &Receiver::handleGreeting},
+    {FAULT_DATA,      ABC150CANHandler::A, &Receiver::handleFaultData},
+    {PACKET_PROBLEM,  ABC150CANHandler::A, &Receiver::handlePacketProblem},
+    {REQUEST_PC,      ABC150CANHandler::A, &Receiver::handleRequestPC},
+    {0,               ABC150CANHandler::A, NULL}
+};
+
+static uint8_t routeIndex[RECEIVE_ID_SPAN];
+
+__attribute__((noinline)) static void dispatchTable(Receiver &rx, CAN_frame_t &msg) {
+  /* The handler leaves the range check to its acceptance filter, which passes only routed IDs */
+  uint32_t offset = msg.MsgID - RECEIVE_ID_BASE;
+  if (offset >= RECEIVE_ID_SPAN || routeIndex[offset] == 0) {
+    return;
+  }
+  const Route &route = routes[routeIndex[offset] - 1];
+  (rx.*route.handler)(route.channel, msg);
+}
+
+/* Checks */
+
+static void check(const char *name, bool ok) {
+  printf("  %-44s %s\n", name, ok ? "ok" : "WRONG");
+  passed = passed && ok;
+}
+
+static bool sameCalls(const Receiver &a, const Receiver &b) {
+  return memcmp(a.calls, b.calls, sizeof(a.calls)) == 0;
+}
+
+static bool sameRoutes() {
+  CAN_frame_t msg;
+  memset(&msg, 0, sizeof(msg));
+  for (uint32_t id = 0; id < STANDARD_IDS; id++) {
+    Receiver bySwitch;
+    Receiver byTable;
+    msg.MsgID = id;
+    dispatchSwitch(bySwitch, msg);
+    dispatchTable(byTable, msg);
+    if (!sameCalls(bySwitch, byTable)) {
+      printf("  0x%03x routed differently\n", id);
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Timing */
+
+/* ns per frame of receive(frame) over passes of the recorded frames */
+template <typename Receive>
+static double timeFrames(std::vector<CAN_frame_t> &frames, long passes, Receive receive) {
+  int64_t start = OSPort::getTimeUs();
+  for (long pass = 0; pass < passes; pass++) {
+    for (size_t i = 0; i < frames.size(); i++) {
+      receive(frames[i]);
+    }
+  }
+  return (OSPort::getTimeUs() - start) * 1000.0 / (passes * frames.size());
+}
+
+int main(int argc, char **argv) {
+  long passes = (argc > 1) ? atol(argv[1]) : 1000;
+  if (passes <= 0) {
+    return 1;
+  }
+  for (uint8_t i = 0; routes[i].handler != NULL; i++) {
+    routeIndex[routes[i].id - RECEIVE_ID_BASE] = i + 1;
+  }
+  std::vector<CAN_frame_t> frames;
+  ABC150Simulator sim([&frames](const SimFrame &frame) { record(frames, frame); });
+  sim.step(RECORD_MS);
+  printf("%u frames in %u ms of simulated bus traffic\n\n", (unsigned)frames.size(), RECORD_MS);
+
+  check("switch and table route every 11 bit ID alike", sameRoutes());
+  Receiver bySwitch;
+  Receiver byTable;
+  double switchNs = timeFrames(frames, passes, [&](CAN_frame_t &msg) { dispatchSwitch(bySwitch, msg); });
+  double tableNs = timeFrames(frames, passes, [&](CAN_frame_t &msg) { dispatchTable(byTable, msg); });
+  check("switch and table route the traffic alike", sameCalls(bySwitch, byTable));
+
+  CANDriver driver;
+  AmpleCAN can(driver);
+  ABC150CANHandler handler(can);
+  double handlerNs = timeFrames(frames, passes, [&](CAN_frame_t &msg) { handler.msgReceived(msg); });
+  double listenerNs = timeFrames(frames, passes, [&](CAN_frame_t &msg) { can.receive(msg); });
+  check("handler decoded the simulator's voltage",
+        fabsf(handler.getVoltage(ABC150CANHandler::A) - sim.getVoltage(0)) <= VOLTAGE_TOLERANCE &&
+        fabsf(handler.getVoltage(ABC150CANHandler::B) - sim.getVoltage(1)) <= VOLTAGE_TOLERANCE);
+
+  printf("\n%ld passes, ns per frame\n", passes);
+  printf("  %-44s %8.1f ns\n", "dispatch, switch (before)", switchNs);
+  printf("  %-44s %8.1f ns\n", "dispatch, routes[] table", tableNs);
+  printf("  %-44s %8.1f ns\n", "ABC150CANHandler::msgReceived()", handlerNs);
+  printf("  %-44s %8.1f ns\n", "AmpleCAN::receive() and msgReceived()", listenerNs);
+
+  printf("\n%s\n", passed ? "Dispatch ok" : "DispatchBench FAILED");
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,119 @@
+/*
+ * DriveCycleCatalogBuilder.cpp
+ *
+ * Packs drive cycle images written by DriveCycleConverter into a
+ * DriveCycleCatalog for the drivecycle partition.
+ *
+ *   DriveCycleCatalogBuilder [-m maxBytes] output.bin name=image.bin [name=image.bin ...]
+ */
+
+#include "DriveCycleCatalog.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+/* Size of the drivecycle partition in partitions_SPIFFS.csv */
+#define DEFAULT_MAX_BYTES           0x100000
+
+static void usage(const char *name) {
+  fprintf(stderr, "Usage: %s [-m maxBytes] output.bin name=image.bin [name=image.bin ...]\n", name);
+  fprintf(stderr, "  -m  partition size (default 0x%X)\n", DEFAULT_MAX_BYTES);
+}
+
+static bool readFile(const char *path, std::vector<uint8_t> &content) {
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) {
+    perror(path);
+    return false;
+  }
+  uint8_t buffer[4096];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    content.insert(content.end(), buffer, buffer + n);
+  }
+  fclose(file);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  unsigned long maxBytes = DEFAULT_MAX_BYTES;
+  int opt;
+  while ((opt = getopt(argc, argv, "m:")) != -1) {
+    switch (opt) {
+    case 'm':
+      maxBytes = strtoul(optarg, NULL, 0);
+      break;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  int count = argc - optind - 1;
+  if (count < 1 || count > DRIVECYCLE_CATALOG_MAX_ENTRIES) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::vector<DriveCycleCatalog::Entry> entries(count);
+  std::vector<std::vector<uint8_t> > images(count);
+  uint32_t offset = sizeof(DriveCycleCatalog::Header) + count * sizeof(DriveCycleCatalog::Entry);
+  for (int i = 0; i < count; i++) {
+    const char *arg = argv[optind + 1 + i];
+    const char *separator = strchr(arg, '=');
+    if (separator == NULL || separator == arg || separator - arg >= DRIVECYCLE_NAME_LENGTH) {
+      fprintf(stderr, "%s: expected name=image.bin, names up to %d characters\n", arg, DRIVECYCLE_NAME_LENGTH - 1);
+      return 1;
+    }
+    DriveCycleCatalog::Entry &entry = entries[i];
+    memset(&entry, 0, sizeof(entry));
+    memcpy(entry.name, arg, separator - arg);
+    for (int j = 0; j < i; j++) {
+      if (strcmp(entries[j].name, entry.name) == 0) {
+        fprintf(stderr, "Duplicate name %s\n", entry.name);
+        return 1;
+      }
+    }
+    if (!readFile(separator + 1, images[i])) {
+      return 1;
+    }
+    DriveCycleImage image;
+    if (!image.open(images[i].data(), images[i].size())) {
+      fprintf(stderr, "%s: not a drive cycle image\n", separator + 1);
+      return 1;
+    }
+    offset = (offset + 3) & ~3u;
+    entry.offset = offset;
+    entry.size = images[i].size();
+    entry.crc = DriveCycleCatalog::crc32(images[i].data(), images[i].size());
+    offset += entry.size;
+    printf("%-3d %-24s %8d bytes  %6d samples  %5d ms  crc 0x%08x\n", i, entry.name, entry.size,
+           image.getSampleCount(), image.getPeriodMs(), entry.crc);
+  }
+  if (offset > maxBytes) {
+    fprintf(stderr, "Catalog needs %d bytes, partition has %lu\n", offset, maxBytes);
+    return 1;
+  }
+
+  DriveCycleCatalog::Header header = {};
+  header.magic = DRIVECYCLE_CATALOG_MAGIC;
+  header.version = DRIVECYCLE_CATALOG_VERSION;
+  header.count = count;
+  std::vector<uint8_t> out(offset, 0xFF);
+  memcpy(out.data(), &header, sizeof(header));
+  memcpy(out.data() + sizeof(header), entries.data(), count * sizeof(DriveCycleCatalog::Entry));
+  for (int i = 0; i < count; i++) {
+    memcpy(out.data() + entries[i].offset, images[i].data(), images[i].size());
+  }
+
+  FILE *file = fopen(argv[optind], "wb");
+  if (file == NULL || fwrite(out.data(), 1, out.size(), file) != out.size()) {
+    perror(argv[optind]);
+    if (file) fclose(file);
+    return 1;
+  }
+  fclose(file);
+  printf("%d drive cycles, %d of %lu bytes\n", count, offset, maxBytes);
+  return 0;
+}
@@ -0,0 +1,150 @@
+/*
+ * main.cpp
+ *
+ * Compresses a drive cycle with DriveCycleEncoder, checks that
+ * DriveCycleImage reads back the same samples and reports the compression
+ * ratio and the decode time per sample, reading in prefetcher sized blocks.
+ *
+ *   DriveCycleCodecBench                 synthetic 3 h cycle at 10 Hz
+ *   DriveCycleCodecBench image           samples of an existing image
+ */
+
+#include "DriveCycleCatalog.hpp"
+#include "DriveCycleEncoder.hpp"
+#include "DriveCyclePrefetcher.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+
+#define RAW_PATH                    "/tmp/DriveCycleCodecBench.raw.bin"
+#define RICE_PATH                   "/tmp/DriveCycleCodecBench.rice.bin"
+#define SYNTHETIC_HOURS             3
+#define SYNTHETIC_PERIOD_MS         100
+#define SCALE_W                     10
+#define PARTITION_BYTES             0x100000
+#define DECODE_PASSES               20
+
+/* Random driving: segments of constant acceleration with stops, power of a 2 t vehicle */
+static void synthetic(std::vector<int16_t> &samples) {
+  const double mass = 2000, cdA = 0.7, crr = 0.01, rho = 1.2, g = 9.81;
+  double dt = SYNTHETIC_PERIOD_MS / 1000.0;
+  double speed = 0, accel = 0, segment = 0;
+  srand(1);
+  for (uint32_t i = 0; i < SYNTHETIC_HOURS * 3600000 / SYNTHETIC_PERIOD_MS; i++) {
+    if (segment <= 0) {
+      segment = 2 + rand() % 20;
+      accel = (rand() % 2) ? (rand() % 2000) / 1000.0 : -(rand() % 3000) / 1000.0;
+      if (rand() % 10 == 0) accel = 0;
+    }
+    segment -= dt;
+    speed += accel * dt;
+    if (speed < 0) speed = 0;
+    if (speed > 36) speed = 36;
+    double force = mass * accel + 0.5 * rho * cdA * speed * speed + ((speed > 0) ? crr * mass * g : 0);
+    double powerW = force * speed;
+    samples.push_back((int16_t)round(fmax(fmin(powerW / SCALE_W, INT16_MAX), INT16_MIN)));
+  }
+}
+
+static bool fromImage(const char *path, std::vector<int16_t> &samples) {
+  DriveCycleCatalog catalog;
+  DriveCycleImage image;
+  if (!catalog.map(path) || !catalog.open(0, image)) {
+    return false;
+  }
+  for (uint32_t i = 0; i < image.getSampleCount(); i++) {
+    samples.push_back((int16_t)round(image.getPowerKW(i) * 1000 / SCALE_W));
+  }
+  return true;
+}
+
+static size_t writeImage(const char *path, uint16_t encoding, const std::vector<int16_t> &samples) {
+  DriveCycleImage::Header header = {};
+  header.magic = DRIVECYCLE_MAGIC;
+  header.version = DRIVECYCLE_VERSION;
+  header.periodMs = SYNTHETIC_PERIOD_MS;
+  header.sampleCount = samples.size();
+  header.powerScaleW = SCALE_W;
+  header.encoding = encoding;
+  std::vector<uint8_t> payload;
+  if (encoding == DRIVECYCLE_ENCODING_RICE) {
+    DriveCycleEncoder encoder(payload);
+    for (size_t i = 0; i < samples.size(); i++) {
+      encoder.encode(samples[i]);
+    }
+    encoder.finish();
+  } else {
+    payload.resize(samples.size() * sizeof(int16_t));
+    memcpy(payload.data(), samples.data(), payload.size());
+  }
+  FILE *file = fopen(path, "wb");
+  if (file == NULL) {
+    perror(path);
+    return 0;
+  }
+  fwrite(&header, sizeof(header), 1, file);
+  fwrite(payload.data(), 1, payload.size(), file);
+  fclose(file);
+  return sizeof(header) + payload.size();
+}
+
+/* Reads the whole image in prefetcher half buffers, returns ns per sample */
+static double readTime(const char *path, const std::vector<int16_t> &samples) {
+  DriveCycleCatalog catalog;
+  DriveCycleImage image;
+  if (!catalog.map(path) || !catalog.open(0, image)) {
+    exit(1);
+  }
+  float block[PREFETCH_HALF_SAMPLES];
+  uint32_t count = image.getSampleCount();
+  auto start = std::chrono::steady_clock::now();
+  for (int pass = 0; pass < DECODE_PASSES; pass++) {
+    for (uint32_t index = 0; index < count; index += PREFETCH_HALF_SAMPLES) {
+      uint32_t n = (count - index < PREFETCH_HALF_SAMPLES) ? count - index : PREFETCH_HALF_SAMPLES;
+      if (!image.read(index, block, n)) {
+        fprintf(stderr, "%s: read failed at %d\n", path, index);
+        exit(1);
+      }
+      if (pass == 0) {
+        for (uint32_t i = 0; i < n; i++) {
+          if (fabsf(block[i] - samples[index + i] * SCALE_W / 1000.0f) > 1e-3f) {
+            fprintf(stderr, "%s: sample %d differs\n", path, index + i);
+            exit(1);
+          }
+        }
+      }
+    }
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return seconds * 1e9 / ((double)count * DECODE_PASSES);
+}
+
+int main(int argc, char **argv) {
+  std::vector<int16_t> samples;
+  if (argc > 1) {
+    if (!fromImage(argv[1], samples)) {
+      return 1;
+    }
+  } else {
+    synthetic(samples);
+  }
+  size_t rawBytes = writeImage(RAW_PATH, DRIVECYCLE_ENCODING_RAW, samples);
+  size_t riceBytes = writeImage(RICE_PATH, DRIVECYCLE_ENCODING_RICE, samples);
+  if (rawBytes == 0 || riceBytes == 0) {
+    return 1;
+  }
+  double rawNs = readTime(RAW_PATH, samples);
+  double riceNs = readTime(RICE_PATH, samples);
+  double hours = samples.size() * SYNTHETIC_PERIOD_MS / 3600000.0;
+
+  printf("%zu samples (%.1f h at %d ms)\n\n", samples.size(), hours, SYNTHETIC_PERIOD_MS);
+  printf("encoding  bytes      bits/sample  ratio  read ns/sample  h in 1 MB\n");
+  printf("raw       %-9zu  %11.2f  %5.2f  %14.1f  %9.1f\n", rawBytes, rawBytes * 8.0 / samples.size(), 1.0,
+         rawNs, hours * PARTITION_BYTES / rawBytes);
+  printf("rice      %-9zu  %11.2f  %5.2f  %14.1f  %9.1f\n", riceBytes, riceBytes * 8.0 / samples.size(),
+         (double)rawBytes / riceBytes, riceNs, hours * PARTITION_BYTES / riceBytes);
+  return 0;
+}
@@ -0,0 +1,149 @@
+/*
+ * DriveCycleConverter.cpp
+ *
+ * Converts a drive cycle CSV export (time [s], speed, power [kW] per line,
+ * as read by the old PlateDriveCycleTest) into a DriveCycleImage.
+ *
+ *   DriveCycleConverter [-c] [-s scaleW] [-p periodMs] input.csv output.bin
+ */
+
+#include "DriveCycleImage.hpp"
+#include "DriveCycleEncoder.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <vector>
+
+#define DEFAULT_SCALE_W             10
+/* Allowed deviation of a time step from the sample period */
+#define PERIOD_TOLERANCE_MS         1
+
+static void usage(const char *name) {
+  fprintf(stderr, "Usage: %s [-c] [-s scaleW] [-p periodMs] input.csv output.bin\n", name);
+  fprintf(stderr, "  -c  compress the samples (delta + Rice)\n");
+  fprintf(stderr, "  -s  W per sample LSB (default %d)\n", DEFAULT_SCALE_W);
+  fprintf(stderr, "  -p  sample period, default from the time column\n");
+}
+
+int main(int argc, char **argv) {
+  int scaleW = DEFAULT_SCALE_W;
+  int periodMs = 0;
+  bool compress = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "cs:p:")) != -1) {
+    switch (opt) {
+    case 'c':
+      compress = true;
+      break;
+    case 's':
+      scaleW = atoi(optarg);
+      break;
+    case 'p':
+      periodMs = atoi(optarg);
+      break;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (argc - optind != 2 || scaleW <= 0 || scaleW > UINT16_MAX || periodMs < 0 || periodMs > UINT16_MAX) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  FILE *in = fopen(argv[optind], "r");
+  if (in == NULL) {
+    perror(argv[optind]);
+    return 1;
+  }
+  std::vector<double> times;
+  std::vector<int16_t> samples;
+  char line[256];
+  int lineNumber = 0;
+  int clipped = 0;
+  while (fgets(line, sizeof(line), in) != NULL) {
+    lineNumber++;
+    double r[3];
+    if (sscanf(line, "%lf,%lf,%lf", &r[0], &r[1], &r[2]) != 3) {
+      /* Header or empty line */
+      if (strspn(line, " \t\r\n") != strlen(line)) {
+        fprintf(stderr, "Skipping line %d: %s", lineNumber, line);
+      }
+      continue;
+    }
+    double raw = round(r[2] * 1000 / scaleW);
+    if (raw > INT16_MAX || raw < INT16_MIN) {
+      raw = (raw > 0) ? INT16_MAX : INT16_MIN;
+      clipped++;
+    }
+    times.push_back(r[0]);
+    samples.push_back((int16_t)raw);
+  }
+  fclose(in);
+
+  if (samples.size() < 2) {
+    fprintf(stderr, "Need at least 2 samples\n");
+    return 1;
+  }
+  if (periodMs == 0) {
+    periodMs = (int)round((times[1] - times[0]) * 1000);
+    if (periodMs <= 0 || periodMs > UINT16_MAX) {
+      fprintf(stderr, "Invalid period %d ms from the time column, use -p\n", periodMs);
+      return 1;
+    }
+    for (size_t i = 1; i < times.size(); i++) {
+      double step = (times[i] - times[i - 1]) * 1000;
+      if (fabs(step - periodMs) > PERIOD_TOLERANCE_MS) {
+        fprintf(stderr, "Sample %zu: time step %.1f ms differs from period %d ms\n", i, step, periodMs);
+        return 1;
+      }
+    }
+  }
+  if (clipped) {
+    fprintf(stderr, "Warning: %d samples clipped to +-%.1f kW, use a larger -s\n",
+            clipped, INT16_MAX * scaleW / 1000.0);
+  }
+
+  DriveCycleImage::Header header = {};
+  header.magic = DRIVECYCLE_MAGIC;
+  header.version = DRIVECYCLE_VERSION;
+  header.periodMs = periodMs;
+  header.sampleCount = samples.size();
+  header.powerScaleW = scaleW;
+
+  std::vector<uint8_t> payload;
+  if (compress) {
+    header.encoding = DRIVECYCLE_ENCODING_RICE;
+    DriveCycleEncoder encoder(payload);
+    for (size_t i = 0; i < samples.size(); i++) {
+      encoder.encode(samples[i]);
+    }
+    encoder.finish();
+  } else {
+    header.encoding = DRIVECYCLE_ENCODING_RAW;
+    payload.resize(samples.size() * sizeof(int16_t));
+    memcpy(payload.data(), samples.data(), payload.size());
+  }
+
+  FILE *out = fopen(argv[optind + 1], "wb");
+  if (out == NULL) {
+    perror(argv[optind + 1]);
+    return 1;
+  }
+  if (fwrite(&header, sizeof(header), 1, out) != 1 ||
+      fwrite(payload.data(), 1, payload.size(), out) != payload.size()) {
+    perror(argv[optind + 1]);
+    fclose(out);
+    return 1;
+  }
+  fclose(out);
+  printf("%zu samples, %d ms period, %d W/LSB, %zu bytes", samples.size(), periodMs, scaleW,
+         sizeof(header) + payload.size());
+  if (compress) {
+    printf(" (%.2f bits/sample)", payload.size() * 8.0 / samples.size());
+  }
+  printf("\n");
+  return 0;
+}
@@ -0,0 +1,131 @@
+/*
+ * main.cpp
+ *
+ * Plays a drive cycle through DriveCyclePlayer at several control periods
+ * and interpolation modes and compares the commanded trajectory with the
+ * reference profile. The stored samples are the reference decimated to the
+ * sample period, as the converter would write them. Each setpoint is held
+ * for one control period, as the supply does.
+ *
+ *   DriveCyclePlayback                      synthetic 10 minute profile, 1 s samples
+ *   DriveCyclePlayback image [decimation]   image samples as reference, every
+ *                                           decimation-th one stored (default 10)
+ */
+
+#include "DriveCyclePlayer.hpp"
+#include "DriveCycleCatalog.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+
+#define SYNTHETIC_LENGTH_MS         600000
+#define SYNTHETIC_PERIOD_MS         1000
+/* The supply holds a setpoint until the next one, the error is evaluated on this grid */
+#define EVAL_PERIOD_MS              10
+/* Plate power slew rate limit of PlateDriveCycleTest, kW/s */
+#define SLEW_RATE_KW_PER_S          20
+
+/* Reference power in kW at a time, linear between reference points */
+struct Reference {
+  std::vector<float> values;
+  uint32_t periodMs;
+
+  float at(uint32_t timeMs) const {
+    uint32_t i = timeMs / periodMs;
+    if (i + 1 >= values.size()) return values.back();
+    float u = (float)(timeMs % periodMs) / periodMs;
+    return values[i] + u * (values[i + 1] - values[i]);
+  }
+  uint32_t lengthMs() const {
+    return (values.size() - 1) * periodMs;
+  }
+};
+
+static void synthetic(Reference &reference) {
+  reference.periodMs = 10;
+  for (uint32_t t = 0; t <= SYNTHETIC_LENGTH_MS; t += reference.periodMs) {
+    double s = t / 1000.0;
+    reference.values.push_back(30 * sin(2 * M_PI * s / 60) + 15 * sin(2 * M_PI * s / 13) +
+                               5 * sin(2 * M_PI * s / 4.1));
+  }
+}
+
+static bool fromImage(const char *path, Reference &reference) {
+  DriveCycleCatalog catalog;
+  DriveCycleImage image;
+  if (!catalog.map(path) || !catalog.open(0, image)) {
+    return false;
+  }
+  reference.periodMs = image.getPeriodMs();
+  for (uint32_t i = 0; i < image.getSampleCount(); i++) {
+    /* Plate power, as PlateDriveCycleTest commands it */
+    reference.values.push_back(image.getPowerKW(i) / 16);
+  }
+  return reference.values.size() >= 2;
+}
+
+static void play(const Reference &reference, uint32_t samplePeriodMs, DriveCyclePlayer::Interpolation interpolation,
+                 uint32_t controlPeriodMs, float slewRate) {
+  static const char *names[] = {"hold", "linear", "cubic"};
+  DriveCyclePlayer player(interpolation, slewRate);
+  player.reset(controlPeriodMs, reference.at(0));
+  uint32_t next = 0;
+  uint32_t steps = 0;
+  uint32_t points = 0;
+  double squares = 0;
+  float maxError = 0;
+  while (1) {
+    while (player.needsSample()) {
+      if (next <= reference.lengthMs()) {
+        player.pushSample(next, reference.at(next));
+        next += samplePeriodMs;
+      } else {
+        player.endOfSamples();
+      }
+    }
+    if (player.isFinished()) break;
+    uint32_t time = player.getTimeMs();
+    float command = player.step();
+    for (uint32_t t = time; t < time + controlPeriodMs && t <= reference.lengthMs(); t += EVAL_PERIOD_MS) {
+      float error = command - reference.at(t);
+      squares += error * error;
+      if (fabsf(error) > maxError) maxError = fabsf(error);
+      points++;
+    }
+    steps++;
+  }
+  printf("%-7s %6d ms %8.0f  %7.3f kW  %7.3f kW  %5.1f %%\n", names[interpolation], controlPeriodMs, slewRate,
+         sqrt(squares / points), maxError, 100.0 * player.getSlewLimited() / steps);
+}
+
+int main(int argc, char **argv) {
+  Reference reference;
+  uint32_t samplePeriodMs;
+  if (argc > 1) {
+    if (!fromImage(argv[1], reference)) {
+      return 1;
+    }
+    samplePeriodMs = reference.periodMs * ((argc > 2) ? atoi(argv[2]) : 10);
+  } else {
+    synthetic(reference);
+    samplePeriodMs = SYNTHETIC_PERIOD_MS;
+  }
+  printf("Reference %.1f s, stored samples every %d ms\n\n", reference.lengthMs() / 1000.0, samplePeriodMs);
+  printf("mode     control   slew kW/s  RMS error   max error  slew limited\n");
+
+  static const DriveCyclePlayer::Interpolation modes[] = {DriveCyclePlayer::Hold, DriveCyclePlayer::Linear,
+                                                          DriveCyclePlayer::Cubic};
+  static const uint32_t controlPeriods[] = {1000, 100, 20};
+  for (float slewRate : {0.0f, (float)SLEW_RATE_KW_PER_S}) {
+    for (DriveCyclePlayer::Interpolation mode : modes) {
+      for (uint32_t controlPeriodMs : controlPeriods) {
+        if (controlPeriodMs <= samplePeriodMs) {
+          play(reference, samplePeriodMs, mode, controlPeriodMs, slewRate);
+        }
+      }
+    }
+    printf("\n");
+  }
+  return 0;
+}
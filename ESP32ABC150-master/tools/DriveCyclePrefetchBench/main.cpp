@@ -0,0 +1,159 @@
+/*
+ * main.cpp
+ *
+ * Replays a synthetic drive cycle through the plate loop timing of
+ * PlateDriveCycleTest with injected storage latency, once reading each
+ * sample inside the loop and once through DriveCyclePrefetcher, and reports
+ * schedule slips, underruns and wake-up jitter. Runs in virtual time.
+ *
+ *   DriveCyclePrefetchBench [samples] [periodMs]
+ */
+
+#include "DriveCycleCatalog.hpp"
+#include "DriveCyclePrefetcher.hpp"
+#include "JitterHistogram.hpp"
+#include "OSPort.hpp"
+#include "OSPortHost.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define IMAGE_PATH                  "/tmp/DriveCyclePrefetchBench.bin"
+#define PLATE_TASK_PRIORITY         (OSPORT_MAX_PRIORITIES - 4)
+
+/* Storage latency per access: usually a few ms, sometimes a long stall */
+#define LATENCY_MS                  2
+#define STALL_MS                    250
+#define STALL_ONE_IN                40
+
+static uint32_t seed;
+
+static uint32_t accessLatencyMs() {
+  seed = seed * 1103515245 + 12345;
+  uint32_t r = (seed >> 16) & 0x7FFF;
+  return (r % STALL_ONE_IN == 0) ? STALL_MS : (r % (LATENCY_MS + 1));
+}
+
+/* Prefetcher whose reads see the same storage latency, once per half */
+class SlowPrefetcher : public DriveCyclePrefetcher {
+public:
+  SlowPrefetcher(DriveCycleImage &_image) : DriveCyclePrefetcher(_image) {}
+protected:
+  void fetch(uint32_t index, float *out, uint32_t count) {
+    OSPort::delay(accessLatencyMs());
+    DriveCyclePrefetcher::fetch(index, out, count);
+  }
+};
+
+struct Run {
+  const char *name;
+  DriveCycleImage *image;
+  DriveCyclePrefetcher *prefetcher;
+  uint32_t period;
+  uint32_t played;
+  uint32_t slips;
+  uint32_t maxLateMs;
+  JitterHistogram jitter;
+  float checksum;
+  volatile bool done;
+  OSPort::TaskHandle task;
+
+  Run(const char *_name, DriveCycleImage *_image, DriveCyclePrefetcher *_prefetcher, uint32_t _period) :
+      name(_name), image(_image), prefetcher(_prefetcher), period(_period), played(0), slips(0), maxLateMs(0),
+      checksum(0), done(false), task(NULL) {}
+};
+
+static void plateLoop(void *arg) {
+  Run *run = (Run *)arg;
+  uint32_t count = run->image->getSampleCount();
+  if (run->prefetcher) run->prefetcher->start();
+  uint32_t lastWake = OSPort::getTickMs();
+  uint32_t scheduled = lastWake;
+  int64_t lastWakeUs = 0;
+  while (1) {
+    OSPort::delayUntil(&lastWake, run->period);
+    scheduled += run->period;
+    uint32_t now = OSPort::getTickMs();
+    if (now > scheduled) {
+      run->slips++;
+      if (now - scheduled > run->maxLateMs) run->maxLateMs = now - scheduled;
+    }
+    int64_t nowUs = OSPort::getTimeUs();
+    if (lastWakeUs != 0) run->jitter.record(nowUs - lastWakeUs, run->period * 1000);
+    lastWakeUs = nowUs;
+
+    float powerKW;
+    if (run->prefetcher) {
+      if (!run->prefetcher->next(&powerKW)) {
+        if (run->prefetcher->isFinished()) break;
+        continue;
+      }
+    } else {
+      if (run->played >= count) break;
+      OSPort::delay(accessLatencyMs());
+      powerKW = run->image->getPowerKW(run->played);
+    }
+    run->checksum += powerKW;
+    run->played++;
+  }
+  run->done = true;
+  OSPort::suspendTask(NULL);
+}
+
+static void runBench(Run &run) {
+  seed = 1;
+  int64_t start = OSPort::getTimeMs();
+  OSPort::createTask(plateLoop, run.name, 4096, &run, PLATE_TASK_PRIORITY, &run.task);
+  while (!run.done) {
+    OSPort::delay(1000);
+  }
+  printf("%s: %d samples in %.1f s, checksum %.1f\n", run.name, run.played,
+         (OSPort::getTimeMs() - start) / 1000.0, run.checksum);
+  printf("  %d schedule slips (max %d ms late), %d underruns\n", run.slips, run.maxLateMs,
+         run.prefetcher ? run.prefetcher->getUnderruns() : 0);
+  run.jitter.print();
+}
+
+static bool writeImage(uint32_t samples, uint32_t periodMs) {
+  DriveCycleImage::Header header = {};
+  header.magic = DRIVECYCLE_MAGIC;
+  header.version = DRIVECYCLE_VERSION;
+  header.periodMs = periodMs;
+  header.sampleCount = samples;
+  header.powerScaleW = 10;
+  FILE *file = fopen(IMAGE_PATH, "wb");
+  if (file == NULL) return false;
+  fwrite(&header, sizeof(header), 1, file);
+  for (uint32_t i = 0; i < samples; i++) {
+    int16_t sample = (int16_t)(6000 * sin(i / 30.0));
+    fwrite(&sample, sizeof(sample), 1, file);
+  }
+  fclose(file);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  uint32_t samples = (argc > 1) ? atoi(argv[1]) : 3000;
+  uint32_t periodMs = (argc > 2) ? atoi(argv[2]) : 100;
+  if (!writeImage(samples, periodMs)) {
+    perror(IMAGE_PATH);
+    return 1;
+  }
+  OSPortHost::enableVirtualTime();
+  DriveCycleCatalog catalog;
+  DriveCycleImage image;
+  if (!catalog.map(IMAGE_PATH) || !catalog.open(0, image)) {
+    return 1;
+  }
+  printf("%d samples every %d ms, storage latency 0-%d ms, 1 in %d accesses %d ms\n\n",
+         samples, periodMs, LATENCY_MS, STALL_ONE_IN, STALL_MS);
+
+  Run direct = {"Read in loop", &image, NULL, periodMs};
+  runBench(direct);
+  printf("\n");
+  SlowPrefetcher prefetcher(image);
+  Run prefetched = {"Prefetched", &image, &prefetcher, periodMs};
+  runBench(prefetched);
+  printf("\n");
+  return 0;
+}
@@ -0,0 +1,262 @@
+/*
+ * main.cpp
+ *
+ * Replays BMS telemetry recorded every control period of PlateDriveCycleTest
+ * and counts how often the plate command runs over the battery's power limits,
+ * once clamped to the reported availablePower and chargingPower as before and
+ * once to the limits of LimitPredictor. The reported limits are LIMIT_LAG_MS
+ * old, so a command violates the limit when it is above what the BMS reports
+ * LIMIT_LAG_MS later. Also reported is the energy the clamping takes from
+ * the demand. Exits with 1 if the predicted limits are violated.
+ *
+ * Without a recording a 20 minute run of a pack model (SOC and temperature
+ * derating, voltage sag under sustained load, limits reported every 500 ms)
+ * with the unpredicted clamp is recorded first; -w saves it.
+ *
+ *   LimitPredictorBench [-w recording.csv] [recording.csv]
+ *
+ * Recording: one line per control period,
+ *   time_ms,demand_kw,available_kw,charging_kw,max_temp,power_kw
+ * demand_kw is the DriveCyclePlayer output and power_kw the measured power,
+ * both positive for discharge.
+ */
+
+#include "DriveCyclePlayer.hpp"
+#include "LimitPredictor.hpp"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+
+/* As in PlateDriveCycleTest.cpp */
+#define CONTROL_PERIOD_MS           100
+#define SLEW_RATE_KW_PER_S          20
+#define LIMIT_LAG_S                 1.0
+#define LIMIT_LOOKAHEAD_SAMPLES     32
+/* Drive cycle sample period of the lookahead */
+#define SAMPLE_PERIOD_MS            1000
+
+/* Pack model */
+#define LIMIT_LAG_MS                1000
+#define REPORT_PERIOD_MS            500
+#define PACK_CAPACITY_KWH           4.0
+#define PACK_INITIAL_SOC            0.6
+#define MAX_DISCHARGE_KW            20.0
+#define MAX_CHARGE_KW               12.0
+#define SAG_TIME_CONSTANT_S         30.0
+#define SAG_KW_PER_KW               0.4
+#define AMBIENT_TEMP                25.0
+#define HEATING_PER_KW2             0.003
+#define COOLING_TIME_CONSTANT_S     300.0
+#define DERATE_START_TEMP           45.0
+#define DERATE_END_TEMP             60.0
+#define SYNTHETIC_LENGTH_S          1200
+
+struct Row {
+  uint32_t timeMs;
+  float demand;
+  float available;
+  float charging;
+  float maxTemp;
+  float power;
+};
+
+static float clampUnit(float value) {
+  return (value < 0) ? 0 : ((value > 1) ? 1 : value);
+}
+
+/* Pack state and the limits it allows */
+class Pack {
+public:
+  Pack() : soc(PACK_INITIAL_SOC), sag(0), temp(AMBIENT_TEMP) {}
+
+  void step(float powerKW, float dtSeconds) {
+    soc -= powerKW * dtSeconds / 3600 / PACK_CAPACITY_KWH;
+    sag += (powerKW - sag) * dtSeconds / SAG_TIME_CONSTANT_S;
+    temp += (HEATING_PER_KW2 * powerKW * powerKW - (temp - AMBIENT_TEMP) / COOLING_TIME_CONSTANT_S) * dtSeconds;
+  }
+
+  float available() {
+    float limit = MAX_DISCHARGE_KW * clampUnit((soc - 0.05) / 0.3) * derate() - SAG_KW_PER_KW * fmaxf(sag, 0);
+    return fmaxf(limit, 0);
+  }
+
+  float charging() {
+    float limit = MAX_CHARGE_KW * clampUnit((0.97 - soc) / 0.2) * derate() - SAG_KW_PER_KW * fmaxf(-sag, 0);
+    return fmaxf(limit, 0);
+  }
+
+  float getTemp() {
+    return temp;
+  }
+
+private:
+  float soc;
+  float sag;
+  float temp;
+
+  float derate() {
+    return clampUnit((DERATE_END_TEMP - temp) / (DERATE_END_TEMP - DERATE_START_TEMP));
+  }
+};
+
+/* Clamping of PlateDriveCycleTest::loopPlate, positive discharges the battery */
+static float clampDemand(float demand, float maxDischarge, float maxCharge) {
+  if (demand >= 70) {
+    demand = 70;
+  }
+  return (demand >= 0) ? fminf(demand, maxDischarge) : -fminf(-demand, maxCharge);
+}
+
+static void record(std::vector<Row> &rows) {
+  std::vector<float> profile;
+  for (uint32_t s = 0; s <= SYNTHETIC_LENGTH_S; s++) {
+    profile.push_back(6 + 7 * sin(2 * M_PI * s / 90) + 5 * sin(2 * M_PI * s / 17) + 3 * sin(2 * M_PI * s / 7));
+  }
+  Pack pack;
+  DriveCyclePlayer player(DriveCyclePlayer::Cubic, SLEW_RATE_KW_PER_S);
+  player.reset(CONTROL_PERIOD_MS);
+  /* State of the pack LIMIT_LAG_MS ago, a report every REPORT_PERIOD_MS */
+  std::vector<Row> history;
+  Row reported = {0, 0, pack.available(), pack.charging(), pack.getTemp(), 0};
+  float power = 0;
+  uint32_t next = 0;
+  uint32_t ms = 0;
+  while (1) {
+    while (player.needsSample()) {
+      if (next < profile.size()) {
+        player.pushSample(next * SAMPLE_PERIOD_MS, profile[next]);
+        next++;
+      } else {
+        player.endOfSamples();
+      }
+    }
+    if (player.isFinished()) break;
+    Row actual = {ms, 0, pack.available(), pack.charging(), pack.getTemp(), 0};
+    history.push_back(actual);
+    if (ms % REPORT_PERIOD_MS == 0 && ms >= LIMIT_LAG_MS) {
+      reported = history[(ms - LIMIT_LAG_MS) / CONTROL_PERIOD_MS];
+    }
+    Row row = {ms, player.step(), reported.available, reported.charging, reported.maxTemp, power};
+    rows.push_back(row);
+    power = clampDemand(row.demand, row.available, row.charging);
+    pack.step(power, CONTROL_PERIOD_MS / 1000.0f);
+    ms += CONTROL_PERIOD_MS;
+  }
+}
+
+static bool load(const char *path, std::vector<Row> &rows) {
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    perror(path);
+    return false;
+  }
+  char line[256];
+  while (fgets(line, sizeof(line), file)) {
+    Row row;
+    if (sscanf(line, "%u,%f,%f,%f,%f,%f", &row.timeMs, &row.demand, &row.available, &row.charging,
+               &row.maxTemp, &row.power) == 6) {
+      rows.push_back(row);
+    }
+  }
+  fclose(file);
+  if (rows.empty()) {
+    fprintf(stderr, "%s: no telemetry\n", path);
+    return false;
+  }
+  return true;
+}
+
+static bool save(const char *path, const std::vector<Row> &rows) {
+  FILE *file = fopen(path, "w");
+  if (file == NULL) {
+    perror(path);
+    return false;
+  }
+  fprintf(file, "time_ms,demand_kw,available_kw,charging_kw,max_temp,power_kw\n");
+  for (size_t i = 0; i < rows.size(); i++) {
+    fprintf(file, "%u,%.3f,%.3f,%.3f,%.2f,%.3f\n", rows[i].timeMs, rows[i].demand, rows[i].available,
+            rows[i].charging, rows[i].maxTemp, rows[i].power);
+  }
+  fclose(file);
+  return true;
+}
+
+/* Returns the violations */
+static uint32_t replay(const std::vector<Row> &rows, bool predict) {
+  const size_t lagRows = LIMIT_LAG_MS / CONTROL_PERIOD_MS;
+  const size_t stride = SAMPLE_PERIOD_MS / CONTROL_PERIOD_MS;
+  LimitPredictor predictor(LIMIT_LAG_S, SLEW_RATE_KW_PER_S);
+  uint32_t violations = 0;
+  uint32_t steps = 0;
+  float maxOvershoot = 0;
+  /* Wh */
+  double overEnergy = 0;
+  double demandEnergy = 0;
+  double commandEnergy = 0;
+  for (size_t i = 0; i + lagRows < rows.size(); i++) {
+    const Row &row = rows[i];
+    float maxDischarge = row.available;
+    float maxCharge = row.charging;
+    if (predict) {
+      /* Drive cycle samples ahead, from the demand the player produced */
+      float upcoming[LIMIT_LOOKAHEAD_SAMPLES];
+      uint32_t count = 0;
+      for (size_t j = i + stride; j < rows.size() && count < LIMIT_LOOKAHEAD_SAMPLES; j += stride) {
+        upcoming[count++] = rows[j].demand;
+      }
+      predictor.update(row.available, row.charging, row.power, CONTROL_PERIOD_MS / 1000.0f);
+      predictor.shape(upcoming, count, SAMPLE_PERIOD_MS / 1000.0f, SAMPLE_PERIOD_MS / 1000.0f,
+                      &maxDischarge, &maxCharge);
+    }
+    float command = clampDemand(row.demand, maxDischarge, maxCharge);
+    /* What the BMS reports a lag later is the limit this command met */
+    const Row &truth = rows[i + lagRows];
+    float overshoot = (command >= 0) ? command - truth.available : -command - truth.charging;
+    if (overshoot > 0.01f) {
+      violations++;
+      overEnergy += overshoot * CONTROL_PERIOD_MS / 3600.0;
+      maxOvershoot = fmaxf(maxOvershoot, overshoot);
+    }
+    demandEnergy += fabsf(row.demand) * CONTROL_PERIOD_MS / 3600.0;
+    commandEnergy += fabsf(command) * CONTROL_PERIOD_MS / 3600.0;
+    steps++;
+  }
+  printf("%-12s  %5u / %5u  %7.3f kW  %8.2f Wh  %8.1f / %8.1f Wh\n", predict ? "predicted" : "reported",
+         violations, steps, maxOvershoot, overEnergy, commandEnergy, demandEnergy);
+  if (predict) {
+    printf("\nfitted: discharge %.1f kW/kWh %.2f kW/(10 kW)^2 s, charge %.1f kW/kWh %.2f kW/(10 kW)^2 s\n",
+           predictor.getEnergySensitivity(false), predictor.getHeatSensitivity(false),
+           predictor.getEnergySensitivity(true), predictor.getHeatSensitivity(true));
+  }
+  return violations;
+}
+
+int main(int argc, char **argv) {
+  const char *output = NULL;
+  const char *input = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+      output = argv[++i];
+    } else {
+      input = argv[i];
+    }
+  }
+  std::vector<Row> rows;
+  if (input) {
+    if (!load(input, rows)) {
+      return 1;
+    }
+  } else {
+    record(rows);
+  }
+  if (output && !save(output, rows)) {
+    return 1;
+  }
+  printf("%.1f s of telemetry, limits %d ms old\n\n", rows.back().timeMs / 1000.0, LIMIT_LAG_MS);
+  printf("limits        violations   max over   over energy   delivered / demand\n");
+  replay(rows, false);
+  uint32_t violations = replay(rows, true);
+  printf("\n%s\n", (violations == 0) ? "The predicted limits hold" : "LimitPredictorBench FAILED");
+  return (violations == 0) ? 0 : 1;
+}
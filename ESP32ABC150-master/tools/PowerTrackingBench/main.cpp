@@ -0,0 +1,218 @@
+/*
+ * main.cpp
+ *
+ * Plays a drive cycle on channel A of the simulator the way PlateDriveCycleTest
+ * does (DriveCyclePlayer every 100 ms, setpoint clamped to the battery's
+ * available and charging power), once open loop and once with PowerTracker
+ * on the DATA_A feedback, against a supply that delivers 95 % of the
+ * commanded power with a 150 ms time constant. Reports the tracking error of
+ * the delivered power and the energy error over the cycle.
+ *
+ *   PowerTrackingBench [image]     default: synthetic 20 minute profile
+ */
+
+#include "ABC150Simulator.hpp"
+#include "DriveCycleCatalog.hpp"
+#include "DriveCyclePlayer.hpp"
+#include "PowerTracker.hpp"
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+
+/* As in PlateDriveCycleTest.cpp */
+#define CONTROL_PERIOD_MS           100
+#define SLEW_RATE_KW_PER_S          20
+#define TRACKING_KP                 0.2
+#define TRACKING_KI                 1.0
+#define TRACKING_INTEGRAL_LIMIT_W   5000
+
+#define SUPPLY_POWER_GAIN           0.95
+#define SUPPLY_RESPONSE_MS          150
+/* Battery limits reported by the BMS */
+#define AVAILABLE_POWER_KW          6
+#define CHARGING_POWER_KW           4
+#define SYNTHETIC_LENGTH_S          1200
+#define HANDSHAKE_PERIOD_MS         500
+
+struct Profile {
+  std::vector<float> powerKW;   // plate power, positive is discharge
+  uint32_t periodMs;
+};
+
+static void synthetic(Profile &profile) {
+  profile.periodMs = 1000;
+  for (uint32_t s = 0; s <= SYNTHETIC_LENGTH_S; s++) {
+    profile.powerKW.push_back(4 * sin(2 * M_PI * s / 90) + 2.5 * sin(2 * M_PI * s / 17) + 1.5 * sin(2 * M_PI * s / 7));
+  }
+}
+
+static bool fromImage(const char *path, Profile &profile) {
+  DriveCycleCatalog catalog;
+  DriveCycleImage image;
+  if (!catalog.map(path) || !catalog.open(0, image)) {
+    return false;
+  }
+  profile.periodMs = image.getPeriodMs();
+  for (uint32_t i = 0; i < image.getSampleCount(); i++) {
+    profile.powerKW.push_back(image.getPowerKW(i) / 16);
+  }
+  return true;
+}
+
+/* PC side: remote control handshake, then power commands and DATA_A feedback */
+class PlateClient {
+public:
+  PlateClient(ABC150Simulator &_sim) : sim(_sim), stationID(0), remote(false), voltage(0), current(0), counter(0) {}
+
+  void receive(const SimFrame &frame) {
+    if (frame.id == STATION_ID_A) {
+      double values[ABC150Codec::STATION_ID_FIELDS];
+      ABC150Codec::decode(ABC150Codec::STATION_ID_LAYOUT, frame.data, values);
+      stationID = values[ABC150Codec::STATION_ID];
+    } else if (frame.id == STATUS_A) {
+      double values[ABC150Codec::STATUS_FIELDS];
+      ABC150Codec::decode(ABC150Codec::STATUS_LAYOUT, frame.data, values);
+      remote = values[ABC150Codec::STATUS_CONVERTER] == ABC150Simulator::Remote;
+    } else if (frame.id == DATA_A) {
+      double values[ABC150Codec::DATA_FIELDS];
+      ABC150Codec::decode(ABC150Codec::DATA_LAYOUT, frame.data, values);
+      voltage = values[ABC150Codec::DATA_VOLTAGE];
+      current = values[ABC150Codec::DATA_CURRENT];
+    }
+  }
+
+  bool takeControl() {
+    while (!remote) {
+      sim.step(HANDSHAKE_PERIOD_MS);
+      if (stationID) {
+        SimFrame frame = {CHANGE_CONTROL, ABC150Codec::CHANGE_CONTROL_LAYOUT.dlc, {}};
+        double values[ABC150Codec::CHANGE_CONTROL_FIELDS];
+        values[ABC150Codec::CHANGE_CONTROL_CHANNEL] = 0;
+        values[ABC150Codec::CHANGE_CONTROL_FROM] = ABC150Simulator::Local;
+        values[ABC150Codec::CHANGE_CONTROL_TO] = ABC150Simulator::Remote;
+        values[ABC150Codec::CHANGE_CONTROL_HW_ID] = 0x0D;
+        values[ABC150Codec::CHANGE_CONTROL_STATION_ID] = stationID;
+        ABC150Codec::encode(ABC150Codec::CHANGE_CONTROL_LAYOUT, frame.data, values);
+        sim.receive(frame);
+      }
+      if (sim.getTimeMs() > 10000) return false;
+    }
+    return true;
+  }
+
+  void setPower(float powerW) {
+    sendLimits(LOWER_LIMITS_A_OUT, 200, -200, -50000);
+    sendLimits(UPPER_LIMITS_A_OUT, 420, 200, 50000);
+    SimFrame frame = {COMMAND_A, ABC150Codec::COMMAND_LAYOUT.dlc, {}};
+    double values[ABC150Codec::COMMAND_FIELDS];
+    values[ABC150Codec::COMMAND_COUNTER] = counter++;
+    values[ABC150Codec::COMMAND_VALUE] = (int16_t)lround(powerW / POWER_SCALE);
+    values[ABC150Codec::COMMAND_CONTROL_MODE] = ABC150Simulator::Power;
+    values[ABC150Codec::COMMAND_LOAD_MODE] = ABC150Simulator::Independent;
+    ABC150Codec::encode(ABC150Codec::COMMAND_LAYOUT, frame.data, values);
+    sim.receive(frame);
+  }
+
+  float getMeasuredPower() {
+    return voltage * current;
+  }
+
+private:
+  ABC150Simulator &sim;
+  uint64_t stationID;
+  bool remote;
+  float voltage;
+  float current;
+  uint8_t counter;
+
+  void sendLimits(uint32_t id, float voltageLimit, float currentLimit, float powerLimit) {
+    SimFrame frame = {id, ABC150Codec::LIMITS_OUT_LAYOUT.dlc, {}};
+    double values[ABC150Codec::LIMITS_OUT_FIELDS];
+    values[ABC150Codec::LIMITS_OUT_COUNTER] = counter;
+    values[ABC150Codec::LIMITS_OUT_VOLTAGE] = voltageLimit;
+    values[ABC150Codec::LIMITS_OUT_CURRENT] = currentLimit;
+    values[ABC150Codec::LIMITS_OUT_POWER] = powerLimit;
+    ABC150Codec::encode(ABC150Codec::LIMITS_OUT_LAYOUT, frame.data, values);
+    sim.receive(frame);
+  }
+};
+
+static void run(const Profile &profile, bool tracking) {
+  PlateClient *client = NULL;
+  ABC150Simulator sim([&client](const SimFrame &frame) {
+    if (client) client->receive(frame);
+  });
+  PlateClient plate(sim);
+  client = &plate;
+  sim.powerGain = SUPPLY_POWER_GAIN;
+  sim.responseTimeMs = SUPPLY_RESPONSE_MS;
+  if (!plate.takeControl()) {
+    printf("No remote control\n");
+    return;
+  }
+
+  DriveCyclePlayer player(DriveCyclePlayer::Cubic, SLEW_RATE_KW_PER_S);
+  PowerTracker tracker(TRACKING_KP, TRACKING_KI, TRACKING_INTEGRAL_LIMIT_W);
+  player.reset(CONTROL_PERIOD_MS);
+  uint32_t next = 0;
+  double squares = 0;
+  /* Wh, discharge and charge separately so they do not cancel */
+  double targetEnergy[2] = {0, 0};
+  double deliveredEnergy[2] = {0, 0};
+  float maxError = 0;
+  uint32_t ms = 0;
+  while (1) {
+    while (player.needsSample()) {
+      if (next < profile.powerKW.size()) {
+        player.pushSample(next * profile.periodMs, profile.powerKW[next]);
+        next++;
+      } else {
+        player.endOfSamples();
+      }
+    }
+    if (player.isFinished()) break;
+    /* Clamping of PlateDriveCycleTest::loopPlate, ABC150 sign: negative discharges the battery */
+    float testPower = player.step();
+    float power = (testPower >= 0) ? -fminf(testPower, AVAILABLE_POWER_KW) : fminf(-testPower, CHARGING_POWER_KW);
+    float command = power * 1000;
+    if (tracking) {
+      command = tracker.update(power * 1000, plate.getMeasuredPower(), -AVAILABLE_POWER_KW * 1000,
+                               CHARGING_POWER_KW * 1000, CONTROL_PERIOD_MS / 1000.0f);
+    }
+    plate.setPower(command);
+    for (int i = 0; i < CONTROL_PERIOD_MS; i++) {
+      sim.step(1);
+      float delivered = sim.getVoltage(0) * sim.getCurrent(0);
+      float error = delivered - power * 1000;
+      squares += error * error;
+      if (fabsf(error) > maxError) maxError = fabsf(error);
+      targetEnergy[power > 0] += fabsf(power * 1000) / 3600000.0;
+      deliveredEnergy[delivered > 0] += fabsf(delivered) / 3600000.0;
+      ms++;
+    }
+  }
+  printf("%-12s  %8.3f kW  %8.3f kW  %7.1f / %5.1f Wh  %7.1f / %5.1f Wh  %6.2f / %6.2f %%\n",
+         tracking ? "PI tracking" : "open loop", sqrt(squares / ms) / 1000, maxError / 1000,
+         targetEnergy[0], targetEnergy[1], deliveredEnergy[0], deliveredEnergy[1],
+         100 * (deliveredEnergy[0] - targetEnergy[0]) / targetEnergy[0],
+         100 * (deliveredEnergy[1] - targetEnergy[1]) / targetEnergy[1]);
+}
+
+int main(int argc, char **argv) {
+  Profile profile;
+  if (argc > 1) {
+    if (!fromImage(argv[1], profile)) {
+      return 1;
+    }
+  } else {
+    synthetic(profile);
+  }
+  printf("%.1f s cycle, supply gain %.2f, time constant %d ms, battery limits -%d/+%d kW\n\n",
+         (profile.powerKW.size() - 1) * profile.periodMs / 1000.0, SUPPLY_POWER_GAIN, SUPPLY_RESPONSE_MS,
+         AVAILABLE_POWER_KW, CHARGING_POWER_KW);
+  printf("                                     discharge / charge\n");
+  printf("controller    RMS error   max error     target energy    delivered energy     energy error\n");
+  run(profile, false);
+  run(profile, true);
+  return 0;
+}
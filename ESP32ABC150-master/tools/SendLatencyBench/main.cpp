@@ -0,0 +1,215 @@
+/*
+ * main.cpp
+ *
+ * Time from a setpoint change to its COMMAND frame on the wire, through the
+ * real ABC150CANHandler of the host build: setPower() wakes the send task
+ * with notifySend(), sendTask() rate limits and sends the package. The CAN
+ * driver below timestamps every frame written to it, in real time.
+ *
+ * Channel A is put in remote control with a STATUS frame and takeControl().
+ * Step i sets -5 * (i + 1) W, one COMMAND wire LSB more than the step before,
+ * so a COMMAND frame carries step i or a newer one once its command is at or
+ * below step i's. The latency of a step is the time from the setter call to
+ * the first such frame. Steps come
+ *
+ *  - isolated: 20 to 40 ms apart, each should go out at once
+ *  - in bursts: 0 to 4 ms apart, they are coalesced into one package per
+ *    SEND_MIN_INTERVAL_MS
+ *
+ * Then nothing changes for KEEP_ALIVE_MS, which must give the keep-alive
+ * packages every 500 ms. Prints the latency distribution per schedule.
+ * Exits with 1 if a step is not sent within SEND_MIN_INTERVAL_MS plus
+ * LATENCY_SLACK_MS, two packages are closer than SEND_MIN_INTERVAL_MS, or
+ * the keep-alive packages are missing.
+ *
+ *   SendLatencyBench [steps]     default 200, per schedule
+ */
+
+#include "ABC150CANHandler.hpp"
+#include "ABC150Codec.hpp"
+#include "AmpleCAN.hpp"
+#include "OSPort.hpp"
+#include <algorithm>
+#include <mutex>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* As in ABC150CANHandler.cpp */
+#define SEND_MIN_INTERVAL_MS        10
+#define KEEP_ALIVE_PERIOD_MS        500
+/* Scheduler wake-up and tick rounding on a loaded host */
+#define LATENCY_SLACK_MS            5
+#define TICK_MS                     1
+#define KEEP_ALIVE_MS               1100
+#define POWER_STEP_W                -5.0f
+
+static bool passed = true;
+
+/* Timestamps the frames written to it */
+
+class StampingDriver : public CANDriver {
+public:
+  struct Write {
+    int64_t timeUs;
+    CAN_frame_t frame;
+  };
+
+  int CAN_write_frame(const CAN_frame_t *p_frame) {
+    Write write = {OSPort::getTimeUs(), *p_frame};
+    std::lock_guard<std::mutex> lock(writesMutex);
+    writes.push_back(write);
+    return 0;
+  }
+
+  std::vector<Write> takeWrites() {
+    std::lock_guard<std::mutex> lock(writesMutex);
+    std::vector<Write> taken;
+    taken.swap(writes);
+    return taken;
+  }
+
+private:
+  std::mutex writesMutex;
+  std::vector<Write> writes;
+};
+
+/* Steps */
+
+struct Schedule {
+  const char *name;
+  uint32_t minGapMs;
+  uint32_t maxGapMs;
+};
+
+static void putInRemoteControl(ABC150CANHandler &handler) {
+  CAN_frame_t msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.MsgID = STATUS_A;
+  msg.FIR.B.FF = CAN_frame_std;
+  msg.FIR.B.DLC = ABC150Codec::STATUS_LAYOUT.dlc;
+  int64_t raws[ABC150Codec::STATUS_FIELDS] = {0};
+  raws[ABC150Codec::STATUS_CONVERTER] = ABC150CANHandler::Remote;
+  ABC150Codec::encodeRaw(ABC150Codec::STATUS_LAYOUT, msg.data.u8, raws);
+  handler.msgReceived(msg);
+  handler.takeControl(ABC150CANHandler::A);
+}
+
+/* Calls setPower() for steps first .. first + count - 1, returns the setter times */
+static std::vector<int64_t> runSteps(ABC150CANHandler &handler, const Schedule &schedule, int first, int count) {
+  std::vector<int64_t> setUs;
+  for (int i = first; i < first + count; i++) {
+    OSPort::delay(schedule.minGapMs + rand() % (schedule.maxGapMs - schedule.minGapMs + 1));
+    setUs.push_back(OSPort::getTimeUs());
+    handler.setPower(ABC150CANHandler::A, POWER_STEP_W * (i + 1));
+  }
+  /* The last step goes out within the rate limit */
+  OSPort::delay(SEND_MIN_INTERVAL_MS + LATENCY_SLACK_MS);
+  return setUs;
+}
+
+/* Newest step a COMMAND frame carries */
+static int commandStep(const CAN_frame_t &frame) {
+  int64_t raws[ABC150Codec::COMMAND_FIELDS];
+  ABC150Codec::decodeRaw(ABC150Codec::COMMAND_LAYOUT, frame.data.u8, raws);
+  return -raws[ABC150Codec::COMMAND_VALUE] - 1;
+}
+
+static std::vector<StampingDriver::Write> commands(const std::vector<StampingDriver::Write> &writes) {
+  std::vector<StampingDriver::Write> found;
+  for (size_t i = 0; i < writes.size(); i++) {
+    if (writes[i].frame.MsgID == COMMAND_A) {
+      found.push_back(writes[i]);
+    }
+  }
+  return found;
+}
+
+/* Shortest time between two packages, ms */
+static double minSpacingMs(const std::vector<StampingDriver::Write> &packages) {
+  double spacing = 1e9;
+  for (size_t i = 1; i < packages.size(); i++) {
+    spacing = std::min(spacing, (packages[i].timeUs - packages[i - 1].timeUs) / 1000.0);
+  }
+  return spacing;
+}
+
+static double percentileMs(std::vector<int64_t> &sortedUs, double fraction) {
+  return sortedUs[(size_t)((sortedUs.size() - 1) * fraction)] / 1000.0;
+}
+
+static void check(const char *name, bool ok) {
+  printf("  %-52s %s\n", name, ok ? "ok" : "WRONG");
+  passed = passed && ok;
+}
+
+/* Latency of every step from the COMMAND frames sent while it ran */
+static void report(const Schedule &schedule, int first, const std::vector<int64_t> &setUs,
+                   const std::vector<StampingDriver::Write> &writes) {
+  std::vector<StampingDriver::Write> packages = commands(writes);
+  std::vector<int64_t> latencies;
+  int carried = 0;
+  int unsent = 0;
+  size_t package = 0;
+  for (size_t i = 0; i < setUs.size(); i++) {
+    int step = first + i;
+    while (package < packages.size() && commandStep(packages[package].frame) < step) {
+      package++;
+    }
+    if (package == packages.size()) {
+      unsent++;
+      continue;
+    }
+    carried += (commandStep(packages[package].frame) == step);
+    latencies.push_back(packages[package].timeUs - setUs[i]);
+  }
+  std::sort(latencies.begin(), latencies.end());
+  bool ok = unsent == 0 && !latencies.empty() &&
+            latencies.back() <= (SEND_MIN_INTERVAL_MS + LATENCY_SLACK_MS) * 1000 &&
+            minSpacingMs(packages) >= SEND_MIN_INTERVAL_MS - TICK_MS;
+  if (latencies.empty()) {
+    latencies.push_back(0);
+  }
+  printf("%-10s %5u %7d %8d %8.2f %8.2f %8.2f %8.2f %8.2f %9.1f  %s\n", schedule.name, (unsigned)setUs.size(),
+         (int)packages.size(), (int)setUs.size() - carried - unsent, percentileMs(latencies, 0),
+         percentileMs(latencies, 0.5), percentileMs(latencies, 0.9), percentileMs(latencies, 0.99),
+         percentileMs(latencies, 1), minSpacingMs(packages), ok ? "ok" : "WRONG");
+  passed = passed && ok;
+}
+
+int main(int argc, char **argv) {
+  int steps = (argc > 1) ? atoi(argv[1]) : 200;
+  if (steps <= 0) {
+    return 1;
+  }
+  srand(1);
+  StampingDriver driver;
+  AmpleCAN can(driver);
+  ABC150CANHandler handler(can);
+  putInRemoteControl(handler);
+  OSPort::delay(SEND_MIN_INTERVAL_MS + LATENCY_SLACK_MS);
+  driver.takeWrites();
+
+  Schedule schedules[] = {{"isolated", 20, 40}, {"bursts", 0, 4}};
+  printf("%d steps per schedule, setPower() to COMMAND frame written, ms\n", steps);
+  printf("%-10s %5s %7s %8s %8s %8s %8s %8s %8s %9s\n", "", "steps", "frames", "merged", "min", "p50", "p90",
+         "p99", "max", "spacing");
+  int first = 0;
+  for (size_t s = 0; s < sizeof(schedules) / sizeof(schedules[0]); s++) {
+    std::vector<int64_t> setUs = runSteps(handler, schedules[s], first, steps);
+    report(schedules[s], first, setUs, driver.takeWrites());
+    first += steps;
+  }
+
+  printf("\n");
+  OSPort::delay(KEEP_ALIVE_MS);
+  std::vector<StampingDriver::Write> keepAlive = commands(driver.takeWrites());
+  int expected = (KEEP_ALIVE_MS - SEND_MIN_INTERVAL_MS - LATENCY_SLACK_MS) / KEEP_ALIVE_PERIOD_MS;
+  printf("  %d keep-alive packages in %d ms without a change\n", (int)keepAlive.size(), KEEP_ALIVE_MS);
+  check("keep-alive every 500 ms", (int)keepAlive.size() == expected &&
+                                   minSpacingMs(keepAlive) >= KEEP_ALIVE_PERIOD_MS - TICK_MS);
+
+  printf("\n%s\n", passed ? "Every step sent within the rate limit" : "SendLatencyBench FAILED");
+  return passed ? 0 : 1;
+}
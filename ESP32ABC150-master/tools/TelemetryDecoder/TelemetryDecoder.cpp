@@ -0,0 +1,181 @@
+/*
+ * TelemetryDecoder.cpp
+ *
+ * Turns the binary telemetry stream of TelemetryStream (a capture of the
+ * telemetry UART or the WebSocket messages one after the other, or the serial
+ * port read live) into CSV: one file with a line per sample, one with a line
+ * per status frame. Bytes between frames, e.g. a frame cut off when the port
+ * was opened, are skipped. Prints the frames decoded, the corrupt ones and
+ * the frames lost according to the sequence numbers.
+ *
+ *   TelemetryDecoder stream|- samples.csv [status.csv]
+ */
+
+#include "TelemetryFrame.hpp"
+#include "ABC150Units.hpp"
+#include <stdio.h>
+#include <string.h>
+
+/* ABC150CANHandler::ControlMode */
+enum {Voltage, Current, Power};
+
+static const char *testStateNames[] = {"Idle", "Running", "Success", "Failed", "Restart"};
+
+static float voltage(int16_t raw) {
+  return ABC150Units::toVolts(ABC150Units::voltageFromWire(raw));
+}
+
+static float current(int16_t raw) {
+  return ABC150Units::toAmps(ABC150Units::currentFromWire(raw));
+}
+
+static float power(int16_t raw) {
+  return ABC150Units::toWatts(ABC150Units::powerFromWire(raw));
+}
+
+static float command(uint8_t controlMode, int16_t raw) {
+  switch (controlMode) {
+  case Voltage:
+    return voltage(raw);
+  case Current:
+    return current(raw);
+  case Power:
+    return power(raw);
+  default:
+    return 0;
+  }
+}
+
+static void writeSamplesHeader(FILE *out) {
+  fprintf(out, "time_ms");
+  for (int ch = 0; ch < TELEMETRY_CHANNELS; ch++) {
+    char c = 'a' + ch;
+    fprintf(out, ",%c_voltage_v,%c_current_a,%c_timestamp", c, c, c);
+  }
+  fprintf(out, "\n");
+}
+
+static void writeSamples(FILE *out, const TelemetryFrame::Decoded &decoded) {
+  for (int i = 0; i < decoded.count; i++) {
+    const TelemetrySample &sample = decoded.samples[i];
+    fprintf(out, "%u", sample.timeMs);
+    for (int ch = 0; ch < TELEMETRY_CHANNELS; ch++) {
+      fprintf(out, ",%.2f,%.2f,%u", voltage(sample.channels[ch].voltage), current(sample.channels[ch].current),
+              sample.channels[ch].timestamp);
+    }
+    fprintf(out, "\n");
+  }
+}
+
+static void writeStatusHeader(FILE *out) {
+  fprintf(out, "time_ms");
+  for (int ch = 0; ch < TELEMETRY_CHANNELS; ch++) {
+    char c = 'a' + ch;
+    fprintf(out, ",%c_converter_status,%c_control_mode,%c_enable,%c_command,%c_lower_voltage_v,%c_lower_current_a,"
+            "%c_lower_power_w,%c_upper_voltage_v,%c_upper_current_a,%c_upper_power_w", c, c, c, c, c, c, c, c, c, c);
+  }
+  fprintf(out, ",tests,battery_voltage_v,battery_current_a,soc_pct,online,hv_on,max_temp_c,avg_temp_c,"
+          "min_cell_v,max_cell_v,available_power_kw,available_energy_kwh,charging_power_kw\n");
+}
+
+static void writeStatus(FILE *out, const TelemetryStatus &status) {
+  fprintf(out, "%u", status.timeMs);
+  for (int ch = 0; ch < TELEMETRY_CHANNELS; ch++) {
+    const TelemetryChannelStatus &channel = status.channels[ch];
+    fprintf(out, ",%u,%u,%u,%.2f,%.2f,%.2f,%.0f,%.2f,%.2f,%.0f", channel.converterStatus, channel.controlMode,
+            channel.enable, command(channel.controlMode, channel.command), voltage(channel.lowerVoltageLimit),
+            current(channel.lowerCurrentLimit), power(channel.lowerPowerLimit), voltage(channel.upperVoltageLimit),
+            current(channel.upperCurrentLimit), power(channel.upperPowerLimit));
+  }
+  fprintf(out, ",");
+  for (int i = 0; i < status.testCount; i++) {
+    uint8_t state = status.testStates[i];
+    fprintf(out, "%s%s", (i > 0) ? " " : "", (state < sizeof(testStateNames) / sizeof(testStateNames[0])) ?
+            testStateNames[state] : "Unknown");
+  }
+  const TelemetryBattery &battery = status.battery;
+  fprintf(out, ",%.2f,%.2f,%.2f,%u,%u,%.1f,%.1f,%.3f,%.3f,%.2f,%.2f,%.2f\n", voltage(battery.voltage),
+          current(battery.current), battery.soc / 100.0, battery.onlineCount, battery.hvOnCount,
+          battery.maxTemp / 10.0, battery.avgTemp / 10.0, battery.minCellVoltage / 1000.0,
+          battery.maxCellVoltage / 1000.0, battery.availablePower / 100.0, battery.availableEnergy / 100.0,
+          battery.chargingPower / 100.0);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3 || argc > 4) {
+    fprintf(stderr, "Usage: %s stream|- samples.csv [status.csv]\n", argv[0]);
+    return 1;
+  }
+  FILE *in = (strcmp(argv[1], "-") == 0) ? stdin : fopen(argv[1], "rb");
+  if (in == NULL) {
+    perror(argv[1]);
+    return 1;
+  }
+  FILE *samplesOut = fopen(argv[2], "w");
+  if (samplesOut == NULL) {
+    perror(argv[2]);
+    return 1;
+  }
+  FILE *statusOut = NULL;
+  if (argc == 4) {
+    statusOut = fopen(argv[3], "w");
+    if (statusOut == NULL) {
+      perror(argv[3]);
+      return 1;
+    }
+    writeStatusHeader(statusOut);
+  }
+  writeSamplesHeader(samplesOut);
+
+  uint8_t chunk[TELEMETRY_MAX_FRAME];
+  size_t length = 0;
+  bool overflow = false;
+  unsigned long frames = 0, samples = 0, statuses = 0, corrupt = 0, lost = 0, skipped = 0;
+  int lastSequence = -1;
+  TelemetryFrame::Decoded decoded;
+  int c;
+  while ((c = fgetc(in)) != EOF) {
+    if (c != 0) {
+      if (length < sizeof(chunk)) {
+        chunk[length++] = c;
+      } else {
+        overflow = true;
+        skipped++;
+      }
+      continue;
+    }
+    if (length == 0) {
+      continue;
+    }
+    if (overflow || !TelemetryFrame::decode(chunk, length, &decoded)) {
+      /* A cut off or damaged frame */
+      corrupt++;
+      skipped += length;
+    } else {
+      frames++;
+      if (lastSequence >= 0) {
+        lost += (uint8_t)(decoded.sequence - lastSequence - 1);
+      }
+      lastSequence = decoded.sequence;
+      if (decoded.type == TelemetryFrame::Samples) {
+        writeSamples(samplesOut, decoded);
+        samples += decoded.count;
+      } else {
+        statuses++;
+        if (statusOut != NULL) {
+          writeStatus(statusOut, decoded.status);
+        }
+      }
+    }
+    length = 0;
+    overflow = false;
+  }
+
+  fprintf(stderr, "%lu frames, %lu samples, %lu status, %lu corrupt, %lu lost, %lu bytes skipped\n", frames,
+          samples, statuses, corrupt, lost, skipped);
+  fclose(samplesOut);
+  if (statusOut != NULL) {
+    fclose(statusOut);
+  }
+  return 0;
+}
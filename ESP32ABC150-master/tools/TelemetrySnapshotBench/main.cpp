@@ -0,0 +1,303 @@
+/*
+ * main.cpp
+ *
+ * Stress test of the Telemetry snapshot ABC150CANHandler publishes through
+ * SeqLock.hpp. One writer, the CAN receive path, publishes as fast as it can
+ * while three readers, like ABC150TestManager::loopTask,
+ * PlateDriveCycleTest::loopPlateTask and sendTask, read in a loop:
+ *
+ *  - SeqLock<Telemetry>: every field of Telemetry is derived from one
+ *    counter, so a read mixing two writes shows up in any field
+ *  - field by field: the same writes stored and loaded one field at a time,
+ *    as channelInfo was before the SeqLock, to show the check catches what
+ *    the SeqLock prevents. Reported only, how often it tears depends on the
+ *    host.
+ *  - ABC150CANHandler::getTelemetry(): DATA frames through the real
+ *    msgReceived(), whose voltage and current are derived from the frame's
+ *    timestamp
+ *
+ * A read is torn if its fields do not belong to the same write, and goes
+ * backwards if it is older than the previous read of the same reader. Every
+ * read is timed. Exits with 1 if a SeqLock or handler read is torn or goes
+ * backwards, or a reader or the writer made no progress.
+ *
+ *   TelemetrySnapshotBench [ms]     default 2000, per test
+ */
+
+#include "ABC150CANHandler.hpp"
+#include "ABC150Codec.hpp"
+#include "ABC150Units.hpp"
+#include "AmpleCAN.hpp"
+#include "SeqLock.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define READERS                     3
+/* Latencies kept per reader, the most recent ones */
+#define LATENCY_SAMPLES             (1 << 20)
+/* Counter values kept exact in a float */
+#define COUNTER_WRAP                (1 << 20)
+/* Voltage and current wire values of the DATA frames */
+#define WIRE_WRAP                   16384
+
+typedef ABC150CANHandler::Telemetry Telemetry;
+
+static bool passed = true;
+
+/* Telemetry of write n */
+
+static Telemetry telemetryFor(uint32_t n) {
+  Telemetry telemetry;
+  memset(&telemetry, 0, sizeof(telemetry));
+  uint32_t wrapped = n % COUNTER_WRAP;
+  telemetry.voltage = (float)wrapped;
+  telemetry.current = -(float)wrapped;
+  telemetry.timestamp = n;
+  telemetry.command = wrapped * 0.5f;
+  telemetry.converterStatus = (ABC150CANHandler::ConverterStatus)(n % 3);
+  telemetry.controlMode = (ABC150CANHandler::ControlMode)(n % 4);
+  telemetry.normalMode = (ABC150CANHandler::NormalMode)(n % 2);
+  telemetry.enableMode = (ABC150CANHandler::EnableMode)((n / 2) % 2);
+  telemetry.loadMode = (ABC150CANHandler::LoadMode)((n / 4) % 4);
+  telemetry.rvsMode = (ABC150CANHandler::RVSMode)((n / 16) % 2);
+  telemetry.connectorStatusNegative = n & 1;
+  telemetry.connectorStatusPositive = n & 2;
+  telemetry.connectorStatusInterlock = n & 4;
+  return telemetry;
+}
+
+static bool sameWrite(const Telemetry &a, const Telemetry &b) {
+  return a.voltage == b.voltage && a.current == b.current && a.timestamp == b.timestamp &&
+         a.command == b.command && a.converterStatus == b.converterStatus && a.controlMode == b.controlMode &&
+         a.normalMode == b.normalMode && a.enableMode == b.enableMode && a.loadMode == b.loadMode &&
+         a.rvsMode == b.rvsMode && a.connectorStatusNegative == b.connectorStatusNegative &&
+         a.connectorStatusPositive == b.connectorStatusPositive &&
+         a.connectorStatusInterlock == b.connectorStatusInterlock;
+}
+
+/* Before: one field at a time */
+
+#define FIELDS                      13
+
+class FieldByField {
+public:
+  FieldByField() {
+    for (int i = 0; i < FIELDS; i++) {
+      fields[i].store(0, std::memory_order_relaxed);
+    }
+  }
+
+  void write(const Telemetry &telemetry) {
+    uint32_t values[FIELDS];
+    pack(telemetry, values);
+    for (int i = 0; i < FIELDS; i++) {
+      fields[i].store(values[i], std::memory_order_relaxed);
+    }
+  }
+
+  Telemetry read() const {
+    uint32_t values[FIELDS];
+    for (int i = 0; i < FIELDS; i++) {
+      values[i] = fields[i].load(std::memory_order_relaxed);
+    }
+    return unpack(values);
+  }
+
+private:
+  std::atomic<uint32_t> fields[FIELDS];
+
+  static uint32_t floatBits(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+  }
+
+  static float bitsFloat(uint32_t bits) {
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+  static void pack(const Telemetry &t, uint32_t (&values)[FIELDS]) {
+    uint32_t packed[FIELDS] = {floatBits(t.voltage), floatBits(t.current), t.timestamp, floatBits(t.command),
+                               (uint32_t)t.converterStatus, (uint32_t)t.controlMode, (uint32_t)t.normalMode,
+                               (uint32_t)t.enableMode, (uint32_t)t.loadMode, (uint32_t)t.rvsMode,
+                               t.connectorStatusNegative, t.connectorStatusPositive, t.connectorStatusInterlock};
+    memcpy(values, packed, sizeof(values));
+  }
+
+  static Telemetry unpack(const uint32_t (&values)[FIELDS]) {
+    Telemetry t;
+    memset(&t, 0, sizeof(t));
+    t.voltage = bitsFloat(values[0]);
+    t.current = bitsFloat(values[1]);
+    t.timestamp = values[2];
+    t.command = bitsFloat(values[3]);
+    t.converterStatus = (ABC150CANHandler::ConverterStatus)values[4];
+    t.controlMode = (ABC150CANHandler::ControlMode)values[5];
+    t.normalMode = (ABC150CANHandler::NormalMode)values[6];
+    t.enableMode = (ABC150CANHandler::EnableMode)values[7];
+    t.loadMode = (ABC150CANHandler::LoadMode)values[8];
+    t.rvsMode = (ABC150CANHandler::RVSMode)values[9];
+    t.connectorStatusNegative = values[10];
+    t.connectorStatusPositive = values[11];
+    t.connectorStatusInterlock = values[12];
+    return t;
+  }
+};
+
+/* DATA frames through the handler */
+
+static CAN_frame_t dataFrame(uint32_t timestamp) {
+  CAN_frame_t msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.MsgID = DATA_A;
+  msg.FIR.B.FF = CAN_frame_std;
+  msg.FIR.B.DLC = ABC150Codec::DATA_LAYOUT.dlc;
+  int16_t wire = timestamp % WIRE_WRAP;
+  int64_t raws[ABC150Codec::DATA_FIELDS];
+  raws[ABC150Codec::DATA_VOLTAGE] = wire;
+  raws[ABC150Codec::DATA_CURRENT] = -wire;
+  raws[ABC150Codec::DATA_TIMESTAMP] = timestamp;
+  ABC150Codec::encodeRaw(ABC150Codec::DATA_LAYOUT, msg.data.u8, raws);
+  return msg;
+}
+
+/* What msgReceived() must have decoded from dataFrame(timestamp) */
+static bool decodedFromOneFrame(const Telemetry &telemetry) {
+  int16_t wire = telemetry.timestamp % WIRE_WRAP;
+  return telemetry.voltage == ABC150Units::toVolts(ABC150Units::voltageFromWire(wire)) &&
+         telemetry.current == ABC150Units::toAmps(ABC150Units::currentFromWire(-wire));
+}
+
+/* Stress */
+
+struct Reader {
+  uint64_t reads;
+  uint64_t torn;
+  uint64_t backwards;
+  std::vector<uint32_t> latencies;
+};
+
+struct Result {
+  const char *name;
+  uint32_t writes;
+  Reader readers[READERS];
+
+  Result(const char *_name) : name(_name), writes(0) {}
+};
+
+/* Runs write(n) for n = 1, 2, ... and READERS loops of read() for ms, check(telemetry) tells a torn read */
+template <typename Write, typename Read, typename Check>
+static void stress(Result &result, uint32_t ms, Write write, Read read, Check check) {
+  std::atomic<bool> running(true);
+  std::thread readers[READERS];
+  for (int r = 0; r < READERS; r++) {
+    Reader &reader = result.readers[r];
+    reader.reads = 0;
+    reader.torn = 0;
+    reader.backwards = 0;
+    reader.latencies.assign(LATENCY_SAMPLES, 0);
+    readers[r] = std::thread([&running, &reader, read, check]() {
+      uint32_t last = 0;
+      while (running.load(std::memory_order_relaxed)) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        Telemetry telemetry = read();
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        reader.latencies[reader.reads % LATENCY_SAMPLES] =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        reader.reads++;
+        if (!check(telemetry)) {
+          reader.torn++;
+        } else if (telemetry.timestamp < last) {
+          reader.backwards++;
+        } else {
+          last = telemetry.timestamp;
+        }
+      }
+    });
+  }
+  std::thread writer([&running, &result, write]() {
+    uint32_t n = 0;
+    while (running.load(std::memory_order_relaxed)) {
+      write(++n);
+    }
+    result.writes = n;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+  running.store(false);
+  writer.join();
+  for (int r = 0; r < READERS; r++) {
+    readers[r].join();
+  }
+}
+
+static uint32_t percentile(std::vector<uint32_t> &sorted, double fraction) {
+  return sorted[(size_t)((sorted.size() - 1) * fraction)];
+}
+
+/* Returns false if a read was torn or went backwards, or nothing was read or written */
+static bool report(Result &result) {
+  uint64_t reads = 0;
+  uint64_t torn = 0;
+  uint64_t backwards = 0;
+  std::vector<uint32_t> latencies;
+  for (int r = 0; r < READERS; r++) {
+    Reader &reader = result.readers[r];
+    reads += reader.reads;
+    torn += reader.torn;
+    backwards += reader.backwards;
+    latencies.insert(latencies.end(), reader.latencies.begin(),
+                     reader.latencies.begin() + std::min<uint64_t>(reader.reads, LATENCY_SAMPLES));
+    passed = passed && reader.reads > 0;
+  }
+  std::sort(latencies.begin(), latencies.end());
+  printf("  %-34s %10u %11llu %8llu %9llu %7u %7u %8u %9u\n", result.name, result.writes,
+         (unsigned long long)reads, (unsigned long long)torn, (unsigned long long)backwards,
+         percentile(latencies, 0.5), percentile(latencies, 0.99), percentile(latencies, 0.999), latencies.back());
+  return result.writes > 0 && torn == 0 && backwards == 0;
+}
+
+int main(int argc, char **argv) {
+  long ms = (argc > 1) ? atol(argv[1]) : 2000;
+  if (ms <= 0) {
+    return 1;
+  }
+  printf("%d readers, one writer, %ld ms per test, read latency in ns\n", READERS, ms);
+  printf("  %-34s %10s %11s %8s %9s %7s %7s %8s %9s\n", "", "writes", "reads", "torn", "backwards", "p50",
+         "p99", "p99.9", "max");
+
+  Result seqLock = {"SeqLock<Telemetry>"};
+  SeqLock<Telemetry> snapshot;
+  stress(seqLock, ms, [&snapshot](uint32_t n) { snapshot.write(telemetryFor(n)); },
+         [&snapshot]() { return snapshot.read(); },
+         [](const Telemetry &t) { return sameWrite(t, telemetryFor(t.timestamp)); });
+  passed = report(seqLock) && passed;
+
+  Result fieldByField = {"field by field (before)"};
+  FieldByField fields;
+  stress(fieldByField, ms, [&fields](uint32_t n) { fields.write(telemetryFor(n)); },
+         [&fields]() { return fields.read(); },
+         [](const Telemetry &t) { return sameWrite(t, telemetryFor(t.timestamp)); });
+  report(fieldByField);
+
+  Result handlerRead = {"ABC150CANHandler::getTelemetry()"};
+  CANDriver driver;
+  AmpleCAN can(driver);
+  ABC150CANHandler handler(can);
+  stress(handlerRead, ms, [&handler](uint32_t n) {
+           CAN_frame_t msg = dataFrame(n);
+           handler.msgReceived(msg);
+         },
+         [&handler]() { return handler.getTelemetry(ABC150CANHandler::A); }, decodedFromOneFrame);
+  passed = report(handlerRead) && passed;
+
+  printf("\n%s\n", passed ? "No torn reads" : "TelemetrySnapshotBench FAILED");
+  return passed ? 0 : 1;
+}
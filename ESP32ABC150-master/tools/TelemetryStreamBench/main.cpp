@@ -0,0 +1,265 @@
+/*
+ * main.cpp
+ *
+ * Runs TelemetryStream on TestScheduler in virtual time at 10, 50 and 100 Hz
+ * with synthetic channels, setpoints, test states and battery aggregates.
+ * The sink captures the stream like the telemetry UART would. The capture is
+ * then decoded: every sample and status must come back exactly as taken, in
+ * order, with no frame lost. Every 7.05 s channel B's timestamp jumps by more
+ * than a frame can code as a delta, which must start a new frame.
+ *
+ * The stream's bytes per second are compared with the text it replaces, the
+ * 1 Hz debug log line. The status frame carries the same aggregates and must
+ * take fewer bytes than the line; the samples cannot: the voltage and current
+ * of two channels at 100 Hz are 800 bytes/s before any framing, so the
+ * 100 Hz stream is printed as a multiple of the line and is only checked to
+ * leave half of the 115200 baud telemetry UART free. Exits with 1 if a check
+ * fails.
+ *
+ *   TelemetryStreamBench [seconds [capture.bin]]     default 60, the 100 Hz capture is written for TelemetryDecoder
+ */
+
+#include "TelemetryStream.hpp"
+#include "TelemetryFrame.hpp"
+#include "TestScheduler.hpp"
+#include "OSPort.hpp"
+#include "OSPortHost.hpp"
+#include <math.h>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TIMESTAMP_JUMP_EVERY_MS     7050
+#define TIMESTAMP_JUMP_MS           1000
+#define TESTS                       8
+#define UART_BAUD                   115200
+#define UART_BITS_PER_BYTE          10
+/* Share of the telemetry UART the 100 Hz stream may take */
+#define MAX_UART_SHARE              50
+
+#define DEBUG_LOG_FORMAT            "%.02fV | %.02fA | %.02f%% | %d online | %d HV_ON | %.02fC_Max | %.02fC_Avg | " \
+                                    "%.02fkw_AP | %.02fkw_AE | %.02fkw_CP\r\n"
+
+static std::vector<uint8_t> capture;
+static std::vector<TelemetrySample> taken;
+static std::vector<TelemetryStatus> statuses;
+static uint32_t jumps;
+static bool passed = true;
+
+/* Sources */
+
+static void sampleSource(void *, TelemetrySample &sample) {
+  uint32_t now = OSPort::getTickMs();
+  double t = now / 1000.0;
+  for (int ch = 0; ch < TELEMETRY_CHANNELS; ch++) {
+    sample.channels[ch].voltage = (int16_t)(19000 + 400 * sin(t / 30 + ch));
+    sample.channels[ch].current = (int16_t)(5000 * sin(t * 2 + ch));
+    /* The ABC150 time, off by a few ms from ours */
+    sample.channels[ch].timestamp = now + 37 * ch + (now % 3);
+  }
+  sample.channels[1].timestamp += (now / TIMESTAMP_JUMP_EVERY_MS) * TIMESTAMP_JUMP_MS;
+  if (!taken.empty() && now / TIMESTAMP_JUMP_EVERY_MS != taken.back().timeMs / TIMESTAMP_JUMP_EVERY_MS) {
+    jumps++;
+  }
+  sample.timeMs = now;
+  taken.push_back(sample);
+}
+
+static void statusSource(void *, TelemetryStatus &status) {
+  uint32_t now = OSPort::getTickMs();
+  uint32_t seconds = now / 1000;
+  for (int ch = 0; ch < TELEMETRY_CHANNELS; ch++) {
+    TelemetryChannelStatus &channel = status.channels[ch];
+    channel.converterStatus = 1;
+    channel.controlMode = (seconds + ch) % 4;
+    channel.enable = seconds % 2;
+    channel.command = -(int16_t)(seconds * 7 + ch);
+    channel.lowerVoltageLimit = 14000;
+    channel.lowerCurrentLimit = -15000;
+    channel.lowerPowerLimit = -30000;
+    channel.upperVoltageLimit = 20100;
+    channel.upperCurrentLimit = 15000;
+    channel.upperPowerLimit = 30000;
+  }
+  status.testCount = TESTS;
+  for (int i = 0; i < TESTS; i++) {
+    status.testStates[i] = (seconds + i) % 5;
+  }
+  TelemetryBattery &battery = status.battery;
+  battery.voltage = 19000 + seconds;
+  battery.current = -2500;
+  battery.soc = 8725 - seconds;
+  battery.onlineCount = 16;
+  battery.hvOnCount = 16;
+  battery.maxTemp = 315;
+  battery.avgTemp = 282;
+  battery.minCellVoltage = 3712;
+  battery.maxCellVoltage = 3741;
+  battery.availablePower = 7000;
+  battery.availableEnergy = 5120;
+  battery.chargingPower = 4550;
+  status.timeMs = now;
+  statuses.push_back(status);
+}
+
+/* Telemetry UART */
+
+static void captureSink(const uint8_t *data, size_t length, void *) {
+  capture.insert(capture.end(), data, data + length);
+}
+
+/* Decoding */
+
+static bool sameSample(const TelemetrySample &a, const TelemetrySample &b) {
+  if (a.timeMs != b.timeMs) {
+    return false;
+  }
+  for (int ch = 0; ch < TELEMETRY_CHANNELS; ch++) {
+    if (a.channels[ch].voltage != b.channels[ch].voltage || a.channels[ch].current != b.channels[ch].current ||
+        a.channels[ch].timestamp != b.channels[ch].timestamp) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Compared as encoded, the structs have padding */
+static bool sameStatus(const TelemetryStatus &a, const TelemetryStatus &b) {
+  uint8_t payloadA[TELEMETRY_STATUS_SIZE];
+  uint8_t payloadB[TELEMETRY_STATUS_SIZE];
+  size_t length = TelemetryFrame::putStatus(a, payloadA);
+  return a.timeMs == b.timeMs && length == TelemetryFrame::putStatus(b, payloadB) &&
+         memcmp(payloadA, payloadB, length) == 0;
+}
+
+struct Decoding {
+  uint32_t frames;
+  uint32_t samples;
+  uint32_t statuses;
+  uint32_t corrupt;
+  uint32_t lost;
+  bool exact;
+};
+
+static Decoding decodeCapture() {
+  Decoding result = {0, 0, 0, 0, 0, true};
+  TelemetryFrame::Decoded decoded;
+  int lastSequence = -1;
+  size_t start = 0;
+  for (size_t i = 0; i <= capture.size(); i++) {
+    if (i < capture.size() && capture[i] != 0) {
+      continue;
+    }
+    size_t length = i - start;
+    const uint8_t *chunk = capture.data() + start;
+    start = i + 1;
+    if (length == 0) {
+      continue;
+    }
+    if (!TelemetryFrame::decode(chunk, length, &decoded)) {
+      result.corrupt++;
+      continue;
+    }
+    result.frames++;
+    if (lastSequence >= 0) {
+      result.lost += (uint8_t)(decoded.sequence - lastSequence - 1);
+    }
+    lastSequence = decoded.sequence;
+    if (decoded.type == TelemetryFrame::Samples) {
+      for (int s = 0; s < decoded.count; s++) {
+        if (result.samples >= taken.size() || !sameSample(decoded.samples[s], taken[result.samples])) {
+          result.exact = false;
+        }
+        result.samples++;
+      }
+    } else {
+      if (result.statuses >= statuses.size() || !sameStatus(decoded.status, statuses[result.statuses])) {
+        result.exact = false;
+      }
+      result.statuses++;
+    }
+  }
+  return result;
+}
+
+static void check(const char *name, bool ok) {
+  printf("  %-56s %s\n", name, ok ? "ok" : "WRONG");
+  passed = passed && ok;
+}
+
+int main(int argc, char **argv) {
+  int seconds = (argc > 1) ? atoi(argv[1]) : 60;
+  if (seconds <= 0) {
+    return 1;
+  }
+  OSPortHost::enableVirtualTime();
+  TestScheduler scheduler;
+  scheduler.start();
+  TelemetryStream stream(&sampleSource, &statusSource, NULL);
+  stream.schedule(scheduler);
+  stream.addSink(&captureSink, NULL);
+  stream.start();
+
+  char line[256];
+  double debugLogBytesPerSecond = snprintf(line, sizeof(line), DEBUG_LOG_FORMAT, 403.2f, -12.5f, 87.25f, 16, 16,
+                                           31.5f, 28.25f, 70.0f, 51.2f, 45.5f);
+
+  const uint32_t rates[] = {10, 50, 100};
+  bool exactAll = true;
+  double fullRateBytesPerSecond = 0;
+  double statusBytesPerSecond = 0;
+  printf("%d s per rate, 1 Hz debug log line: %.0f bytes/s\n\n", seconds, debugLogBytesPerSecond);
+  printf("  %-8s %-8s %-8s %-8s %-7s %-6s %-8s %-12s %-9s %s\n", "Rate Hz", "Samples", "Status", "Frames", "Jumps",
+         "Lost", "Corrupt", "Bytes/s", "UART %", "Decoded");
+  for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+    capture.clear();
+    taken.clear();
+    statuses.clear();
+    jumps = 0;
+    uint32_t bytesBefore = stream.getBytes();
+    uint32_t droppedBefore = stream.getDropped();
+    stream.setRate(rates[r]);
+    OSPort::delay(seconds * 1000);
+    stream.setRate(0);
+    /* Let the writer task catch up, a batch cut short by setRate(0) is never sent */
+    OSPort::delay(1000);
+    uint32_t samplesPerFrame = rates[r] * TELEMETRY_FRAME_PERIOD_MS / 1000;
+
+    Decoding decoding = decodeCapture();
+    double bytesPerSecond = (double)(stream.getBytes() - bytesBefore) / seconds;
+    bool exact = decoding.exact && decoding.samples <= taken.size() &&
+                 taken.size() - decoding.samples < samplesPerFrame && decoding.statuses == statuses.size() &&
+                 decoding.lost == 0 && decoding.corrupt == 0 && stream.getDropped() == droppedBefore;
+    printf("  %-8u %-8u %-8u %-8u %-7u %-6u %-8u %-12.0f %-9.1f %s\n", rates[r], decoding.samples,
+           decoding.statuses, decoding.frames, jumps, decoding.lost, decoding.corrupt, bytesPerSecond,
+           bytesPerSecond * UART_BITS_PER_BYTE * 100 / UART_BAUD, exact ? "exact" : "WRONG");
+    exactAll = exact && exactAll;
+    fullRateBytesPerSecond = bytesPerSecond;
+    if (!statuses.empty()) {
+      uint8_t frame[TELEMETRY_MAX_FRAME];
+      statusBytesPerSecond = TelemetryFrame::encodeStatus(statuses.back(), 0, frame, sizeof(frame)) * 1000.0 /
+                             TELEMETRY_STATUS_PERIOD_MS;
+    }
+
+    if (rates[r] == TELEMETRY_MAX_RATE_HZ && argc > 2) {
+      FILE *out = fopen(argv[2], "wb");
+      if (out == NULL) {
+        perror(argv[2]);
+        return 1;
+      }
+      fwrite(capture.data(), 1, capture.size(), out);
+      fclose(out);
+    }
+  }
+
+  printf("\nStatus frames %.0f bytes/s, %d Hz stream %.1f times the 1 Hz debug log line\n\n", statusBytesPerSecond,
+         TELEMETRY_MAX_RATE_HZ, fullRateBytesPerSecond / debugLogBytesPerSecond);
+  check("every sample and status decoded exactly, none lost", exactAll);
+  check("status frames take fewer bytes than the debug log line",
+        statusBytesPerSecond < debugLogBytesPerSecond);
+  check("100 Hz stream leaves half of the telemetry UART free",
+        fullRateBytesPerSecond * UART_BITS_PER_BYTE * 100 / UART_BAUD < MAX_UART_SHARE);
+  printf("\n%s\n", passed ? "Telemetry decodes exactly and fits its UART" : "TelemetryStreamBench FAILED");
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,314 @@
+/*
+ * main.cpp
+ *
+ * Runs the simulator frames of both channels through TelemetryWatchdog the
+ * way ABC150CANHandler feeds it (DATA with its timestamp, STATUS) and checks
+ * the watchdog every test loop period like the tests' loopCheck(), one single
+ * channel test per channel. After a few seconds frames are dropped or the
+ * DATA timestamp of a channel freezes. A channel goes stale when one of its
+ * sources is older than the limit; when it is still stale at a check, that
+ * check must fail the test, at most one loop period after it went stale. A
+ * fresh channel must never fail.
+ *
+ * Then runs a PulseTest on channel A (SingleChannelTest::loopCheck()) and a
+ * PowerHoldTest (DualChannelTest::loopCheck()) against the simulator through
+ * the real ABC150CANHandler, loop() every loop period, and drops frames on
+ * the bus 3 s into the run. The loop() that fails the test must start at
+ * most one loop period after channel A went stale, and leave the test
+ * Failed; frames of channel B alone must not fail it. Exits with 1 otherwise.
+ *
+ *   TelemetryWatchdogBench [stale limit ms]     default 500
+ */
+
+#include "ABC150CANHandler.hpp"
+#include "ABC150SimBus.hpp"
+#include "ABC150Simulator.hpp"
+#include "PowerHoldTest.hpp"
+#include "PulseTest.hpp"
+#include "TelemetryWatchdog.hpp"
+#include "OSPort.hpp"
+#include "OSPortHost.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RUN_MS                      10000
+#define FAULT_MS                    5000
+/* ABC150TestManager loop period */
+#define LOOP_PERIOD_MS              100
+#define CHANNELS                    2
+/* Tests through the handler */
+#define AMPLE_ID                    1
+#define STARTUP_MS                  1500
+#define TEST_FAULT_MS               3000
+#define TEST_TIMEOUT_MS             20000
+#define HOLD_POWER                  -2000.0f
+#define HOLD_MS                     10000
+
+struct Scenario {
+  const char *name;
+  /* Frame IDs dropped after FAULT_MS, 0 ends the list */
+  uint32_t dropped[4];
+  /* Channel whose DATA timestamp stops after FAULT_MS, -1 for none */
+  int frozenChannel;
+  /* Share of all frames lost at random from the start */
+  double loss;
+};
+
+static const Scenario scenarios[] = {
+    {"no loss",                {0},                                    -1, 0},
+    {"20 % random loss",       {0},                                    -1, 0.2},
+    {"bus silent",             {DATA_A, DATA_B, STATUS_A, STATUS_B},   -1, 0},
+    {"DATA_A dropped",         {DATA_A},                               -1, 0},
+    {"STATUS_B dropped",       {STATUS_B},                             -1, 0},
+    {"timestamp A frozen",     {0},                                     0, 0},
+};
+
+struct TestScenario {
+  const char *name;
+  /* Frame IDs dropped TEST_FAULT_MS into the run, 0 ends the list */
+  uint32_t dropped[4];
+  /* The test on channel A must fail */
+  bool fails;
+};
+
+static const TestScenario testScenarios[] = {
+    {"no loss",                {0},                                    false},
+    {"DATA_B dropped",         {DATA_B},                               false},
+    {"DATA_A dropped",         {DATA_A},                               true},
+    {"STATUS_A dropped",       {STATUS_A},                             true},
+    {"bus silent",             {DATA_A, DATA_B, STATUS_A, STATUS_B},   true},
+};
+
+static uint32_t get32(const uint8_t *in) {
+  return in[0] | (in[1] << 8) | (in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+static bool isDropped(const Scenario &scenario, uint32_t id) {
+  for (int i = 0; i < 4 && scenario.dropped[i] != 0; i++) {
+    if (scenario.dropped[i] == id) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Returns false if a check failed */
+static bool run(const Scenario &scenario, TelemetryWatchdog &watchdog) {
+  uint32_t limit = watchdog.getStaleLimit();
+  /* Reference times of the frames the receive path got, in bench ms */
+  int64_t lastSeen[CHANNELS][TelemetryWatchdog::Sources] = {};
+  uint32_t lastStamp[CHANNELS] = {};
+  uint32_t frozenStamp = 0;
+  int64_t now = 0;
+  watchdog.reset();
+
+  ABC150Simulator sim([&](const SimFrame &frame) {
+    int channel = (frame.id == DATA_B || frame.id == STATUS_B) ? 1 : 0;
+    bool data = frame.id == DATA_A || frame.id == DATA_B;
+    if (!data && frame.id != STATUS_A && frame.id != STATUS_B) {
+      return;
+    }
+    if ((now >= FAULT_MS && isDropped(scenario, frame.id)) || rand() < scenario.loss * RAND_MAX) {
+      return;
+    }
+    if (data) {
+      uint32_t timestamp = get32(frame.data + 4);
+      if (channel == scenario.frozenChannel) {
+        if (now < FAULT_MS) {
+          frozenStamp = timestamp;
+        } else {
+          timestamp = frozenStamp;
+        }
+      }
+      if (timestamp != lastStamp[channel] || lastSeen[channel][TelemetryWatchdog::Timestamp] == 0) {
+        lastSeen[channel][TelemetryWatchdog::Timestamp] = now;
+        lastStamp[channel] = timestamp;
+      }
+      lastSeen[channel][TelemetryWatchdog::Data] = now;
+      watchdog.data(channel, timestamp);
+    } else {
+      lastSeen[channel][TelemetryWatchdog::Status] = now;
+      watchdog.status(channel);
+    }
+  });
+
+  /* Start of the current stale interval, -1 while fresh */
+  int64_t staleSince[CHANNELS] = {-1, -1};
+  int64_t staleAt[CHANNELS] = {-1, -1};
+  int64_t failedAt[CHANNELS] = {-1, -1};
+  bool wrongFailure[CHANNELS] = {};
+  TelemetryWatchdog::Source failedSource[CHANNELS] = {};
+  /* The first STATUS comes after 100 ms, tests start once the channel is fresh */
+  bool running[CHANNELS] = {};
+  for (now = 1; now <= RUN_MS; now++) {
+    /* The watchdog's clock reads now while the frames of this ms arrive */
+    OSPort::delay(1);
+    sim.step(1);
+    for (int channel = 0; channel < CHANNELS; channel++) {
+      bool stale = false;
+      for (int source = 0; source < TelemetryWatchdog::Sources; source++) {
+        stale = stale || lastSeen[channel][source] == 0 || now - lastSeen[channel][source] > limit;
+      }
+      if (!stale) {
+        staleSince[channel] = -1;
+      } else if (staleSince[channel] < 0) {
+        staleSince[channel] = now;
+      }
+    }
+    if (now % LOOP_PERIOD_MS != 0) {
+      continue;
+    }
+    /* Gaps that end before a check leave the test running */
+    for (int channel = 0; channel < CHANNELS; channel++) {
+      if (!running[channel]) {
+        running[channel] = watchdog.isFresh(channel);
+        continue;
+      }
+      if (failedAt[channel] >= 0) {
+        continue;
+      }
+      if (!watchdog.isFresh(channel)) {
+        failedAt[channel] = now;
+        failedSource[channel] = watchdog.getOldest(channel);
+        wrongFailure[channel] = staleSince[channel] < 0;
+      }
+      if (staleSince[channel] >= 0) {
+        staleAt[channel] = staleSince[channel];
+      }
+    }
+  }
+
+  bool passed = true;
+  printf("%-22s", scenario.name);
+  for (int channel = 0; channel < CHANNELS; channel++) {
+    bool ok;
+    if (staleAt[channel] < 0 || wrongFailure[channel]) {
+      ok = running[channel] && failedAt[channel] < 0;
+      printf("  %c %-30s", 'A' + channel, ok ? "fresh, running" : "failed without stale telemetry");
+    } else {
+      int64_t latency = failedAt[channel] - staleAt[channel];
+      ok = failedAt[channel] >= 0 && latency >= 0 && latency <= LOOP_PERIOD_MS;
+      char result[64];
+      if (failedAt[channel] < 0) {
+        snprintf(result, sizeof(result), "stale, never failed");
+      } else {
+        snprintf(result, sizeof(result), "%s, failed after %d ms", TelemetryWatchdog::getSourceName(failedSource[channel]),
+                 (int)latency);
+      }
+      printf("  %c %-30s", 'A' + channel, result);
+    }
+    passed = passed && ok;
+  }
+  printf("  %s\n", passed ? "ok" : "WRONG");
+  return passed;
+}
+
+/* Returns false if a check failed */
+template <typename Start>
+static bool runTest(const char *testName, ABC150Test &test, Start start, const TestScenario &scenario,
+                    ABC150SimBus &bus, ABC150CANHandler &handler) {
+  /* Last delivery of each dropped ID, tick ms */
+  int64_t lastDelivered[4] = {};
+  int64_t faultAt = -1;
+  bus.setFilter([&](const SimFrame &frame) {
+    int64_t now = OSPort::getTickMs();
+    for (int i = 0; i < 4 && scenario.dropped[i] != 0; i++) {
+      if (scenario.dropped[i] == frame.id) {
+        if (faultAt >= 0 && now >= faultAt) {
+          return false;
+        }
+        lastDelivered[i] = now;
+      }
+    }
+    return true;
+  });
+
+  bool started = start();
+  int64_t startMs = OSPort::getTickMs();
+  faultAt = startMs + TEST_FAULT_MS;
+  /* Start of the loop() that failed the test and the time it returned */
+  int64_t failCallAt = -1;
+  int64_t failedAt = -1;
+  bool active = started;
+  while (active && OSPort::getTickMs() - startMs < TEST_TIMEOUT_MS) {
+    OSPort::delay(LOOP_PERIOD_MS);
+    int64_t callAt = OSPort::getTickMs();
+    test.loop();
+    ABC150Test::TestState state = test.getTestState();
+    if (state == ABC150Test::TestState::Failed && failCallAt < 0) {
+      failCallAt = callAt;
+      failedAt = OSPort::getTickMs();
+    }
+    active = state == ABC150Test::TestState::Running || state == ABC150Test::TestState::Restart;
+  }
+  bus.setFilter(ABC150SimBus::Filter());
+  /* Back to local control and fresh for the next run */
+  OSPort::delay(bus.getSimulator().commandTimeoutMs + STARTUP_MS);
+
+  /* A channel goes stale one ms after its oldest source passed the limit */
+  int64_t staleAt = -1;
+  for (int i = 0; i < 4 && scenario.dropped[i] != 0; i++) {
+    int64_t sourceStale = lastDelivered[i] + handler.getWatchdog().getStaleLimit() + 1;
+    staleAt = (staleAt < 0 || sourceStale < staleAt) ? sourceStale : staleAt;
+  }
+  ABC150Test::TestState state = test.getTestState();
+  bool passed;
+  char result[64];
+  if (!scenario.fails) {
+    passed = started && state == ABC150Test::TestState::Success;
+    snprintf(result, sizeof(result), "%s", (state == ABC150Test::TestState::Success) ? "success" : "did not succeed");
+  } else if (failCallAt < 0) {
+    passed = false;
+    snprintf(result, sizeof(result), "never failed");
+  } else {
+    int64_t latency = failCallAt - staleAt;
+    passed = started && latency >= 0 && latency <= LOOP_PERIOD_MS;
+    snprintf(result, sizeof(result), "failed after %d ms, stopped in %d ms", (int)latency,
+             (int)(failedAt - failCallAt));
+  }
+  printf("%-16s %-18s  %-38s  %s\n", testName, scenario.name, started ? result : "refused", passed ? "ok" : "WRONG");
+  return passed;
+}
+
+/* PulseTest and PowerHoldTest through the real handler, limit as in the watchdog runs */
+static bool runTests(uint32_t limit) {
+  ABC150SimBus bus;
+  ABC150CANHandler handler(bus.getCAN());
+  PlateCANHandler plate(bus.getCAN(), AMPLE_ID, 240, 406, NULL, true);
+  BatteryModuleInfo *bmInfo = BatteryModuleCollection::collection().addBatteryModule(1, 1);
+  handler.getWatchdog().setStaleLimit(limit);
+  bus.start();
+  OSPort::delay(STARTUP_MS);
+
+  bool passed = true;
+  for (unsigned i = 0; i < sizeof(testScenarios) / sizeof(testScenarios[0]); i++) {
+    PulseTest pulse(0, ABC150CANHandler::A, &handler, &plate);
+    passed = runTest("PulseTest A", pulse, [&]() { return pulse.startTest(bmInfo); }, testScenarios[i], bus,
+                     handler) && passed;
+  }
+  for (unsigned i = 0; i < sizeof(testScenarios) / sizeof(testScenarios[0]); i++) {
+    PowerHoldTest hold(&handler, &plate, HOLD_POWER, HOLD_MS);
+    passed = runTest("PowerHoldTest", hold, [&]() { return hold.startTest(); }, testScenarios[i], bus,
+                     handler) && passed;
+  }
+  return passed;
+}
+
+int main(int argc, char **argv) {
+  int limit = (argc > 1) ? atoi(argv[1]) : 500;
+  if (limit <= 0) {
+    return 1;
+  }
+  OSPortHost::enableVirtualTime();
+  srand(1);
+  TelemetryWatchdog watchdog(limit);
+  printf("Stale limit %d ms, test loop %d ms, fault after %d ms\n\n", limit, LOOP_PERIOD_MS, FAULT_MS);
+  bool passed = true;
+  for (unsigned i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+    passed = run(scenarios[i], watchdog) && passed;
+  }
+  printf("\nTests through ABC150CANHandler, frames dropped %d ms into the run\n\n", TEST_FAULT_MS);
+  passed = runTests(limit) && passed;
+  return passed ? 0 : 1;
+}
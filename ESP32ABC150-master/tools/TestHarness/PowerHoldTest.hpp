@@ -0,0 +1,95 @@
+/*
+ * PowerHoldTest.hpp
+ *
+ * Dual channel test for the host tools that run tests on ABC150SimBus.
+ */
+
+#ifndef _POWERHOLDTEST_HPP_
+#define _POWERHOLDTEST_HPP_
+
+#include "DualChannelTest.hpp"
+#include "OSPort.hpp"
+#include "esp_log.h"
+
+/* Holds a plate power on channel A in parallel load mode, the command sequence of PlateDriveCycleTest
+ * without the drive cycle */
+class PowerHoldTest : public DualChannelTest {
+public:
+  PowerHoldTest(ABC150CANHandler *_abc150Handler, PlateCANHandler *_plateHandler, float _power, uint32_t _holdMs) :
+                DualChannelTest(_abc150Handler, _plateHandler),
+                abc150Handler(_abc150Handler),
+                plateHandler(_plateHandler),
+                power(_power),
+                holdMs(_holdMs){
+    TAG = "PowerHoldTest";
+  }
+
+  bool startTest() {
+    OSPort::lock(startMutex);
+    if (!preTestChecks() || state == TestState::Running) {
+      OSPort::unlock(startMutex);
+      return false;
+    }
+    plateHandler->HVOn();
+    for (int channel = ABC150CANHandler::A; channel <= ABC150CANHandler::B; channel++) {
+      ABC150CANHandler::Channel ch = (ABC150CANHandler::Channel)channel;
+      abc150Handler->setLowerVoltageLimit(ch, 240);
+      abc150Handler->setLowerCurrentLimit(ch, -15 * onlineCount);
+      abc150Handler->setLowerPowerLimit(ch, -3600 * onlineCount);
+      abc150Handler->setUpperVoltageLimit(ch, 406);
+      abc150Handler->setUpperCurrentLimit(ch, 6 * onlineCount);
+      abc150Handler->setUpperPowerLimit(ch, 2436 * onlineCount);
+    }
+    abc150Handler->takeControl(ABC150CANHandler::A);
+    OSPort::delay(500);
+    abc150Handler->takeControl(ABC150CANHandler::B);
+    abc150Handler->setLoadMode(ABC150CANHandler::A, ABC150CANHandler::Parallel);
+    OSPort::delay(500);
+    abc150Handler->releaseControl(ABC150CANHandler::B);
+    startTime = OSPort::getTimeMs();
+    abc150Handler->setPower(ABC150CANHandler::A, power);
+    abc150Handler->enable(ABC150CANHandler::A);
+    state = TestState::Running;
+    OSPort::unlock(startMutex);
+    return true;
+  }
+
+  bool stopTest(TestState testState) {
+    OSPort::lock(stopMutex);
+    abc150Handler->disable(ABC150CANHandler::A);
+    OSPort::delay(500);
+    plateHandler->HVOff();
+    abc150Handler->setLoadMode(ABC150CANHandler::A, ABC150CANHandler::Independent);
+    OSPort::delay(1000);
+    abc150Handler->releaseControl(ABC150CANHandler::A);
+    abc150Handler->releaseControl(ABC150CANHandler::B);
+    stopTime = OSPort::getTimeMs();
+    state = testState;
+    if (testState == TestState::Success) {
+      ESP_LOGI(TAG, "Success");
+    } else if (testState == TestState::Failed) {
+      ESP_LOGI(TAG, "Failed");
+    } else {
+      ESP_LOGI(TAG, "Idle");
+    }
+    OSPort::unlock(stopMutex);
+    return true;
+  }
+
+  void loop() {
+    if (state == TestState::Running && loopCheck() && OSPort::getTimeMs() - startTime >= holdMs) {
+      stopTest(TestState::Success);
+    }
+  }
+
+  void printResult() {
+  }
+
+private:
+  ABC150CANHandler *abc150Handler;
+  PlateCANHandler *plateHandler;
+  float power;
+  uint32_t holdMs;
+};
+
+#endif /* _POWERHOLDTEST_HPP_ */
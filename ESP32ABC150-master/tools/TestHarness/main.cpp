@@ -0,0 +1,160 @@
+/*
+ * main.cpp
+ *
+ * Runs the tests against the simulator through the real ABC150CANHandler of
+ * the host build: the simulator's frames go through msgReceived(), the
+ * packages of the handler's send task are what the simulator regulates on
+ * (ABC150SimBus). A PulseTest per channel checks SingleChannelTest::loopCheck(),
+ * a power test on channel A in parallel load mode DualChannelTest::loopCheck().
+ * loop() is called every test period like ABC150TestManager's test job, in
+ * virtual time. Each test must reach Running, hold its setpoint on the
+ * simulator and end in Success. Exits with 1 otherwise.
+ */
+
+#include "ABC150CANHandler.hpp"
+#include "ABC150SimBus.hpp"
+#include "PowerHoldTest.hpp"
+#include "PulseTest.hpp"
+#include "OSPort.hpp"
+#include "OSPortHost.hpp"
+#include "esp_log.h"
+#include <stdio.h>
+#include <math.h>
+
+#define CHANNELS                    2
+#define AMPLE_ID                    1
+/* GREETING answer and the first STATION_ID of both channels */
+#define STARTUP_MS                  1500
+/* PulseTest runs 10 s after its 2 s take-control settle */
+#define TEST_TIMEOUT_MS             30000
+/* Setpoints are compared in the middle of the run */
+#define SAMPLE_MS                   5000
+#define PULSE_CURRENT               -10.0f
+#define CURRENT_TOLERANCE           0.1f
+#define HOLD_POWER                  -2000.0f
+#define HOLD_MS                     10000
+#define POWER_TOLERANCE             0.02f
+
+static const char *TAG = "TestHarness";
+static const char *stateNames[] = {"Idle", "Running", "Success", "Failed", "Restart"};
+
+struct Run {
+  const char *name;
+  ABC150Test *test;
+  bool started;
+  int64_t startMs;
+  int64_t endMs;
+  /* Simulator and handler values at SAMPLE_MS */
+  float simValue;
+  float handlerValue;
+  bool remote;
+
+  Run(const char *_name, ABC150Test *_test) :
+      name(_name), test(_test), started(false), startMs(0), endMs(0), simValue(0), handlerValue(0), remote(false) {}
+};
+
+static bool isActive(ABC150Test *test) {
+  ABC150Test::TestState state = test->getTestState();
+  return state == ABC150Test::TestState::Running || state == ABC150Test::TestState::Restart;
+}
+
+static void start(Run &run, bool started) {
+  run.started = started;
+  run.startMs = OSPort::getTimeMs();
+  run.endMs = run.startMs;
+}
+
+/* loop() of each running test every period until none runs, sample() once SAMPLE_MS into the last start */
+template <typename Sample>
+static void runLoops(Run *runs, int count, Sample sample) {
+  int64_t lastStart = 0;
+  for (int i = 0; i < count; i++) {
+    lastStart = (runs[i].startMs > lastStart) ? runs[i].startMs : lastStart;
+  }
+  bool sampled = false;
+  bool active = true;
+  while (active && OSPort::getTimeMs() - lastStart < TEST_TIMEOUT_MS) {
+    OSPort::delay(runs[0].test->getPeriodMs());
+    active = false;
+    for (int i = 0; i < count; i++) {
+      if (isActive(runs[i].test)) {
+        runs[i].test->loop();
+        if (!isActive(runs[i].test)) {
+          runs[i].endMs = OSPort::getTimeMs();
+        }
+      }
+      active = active || isActive(runs[i].test);
+    }
+    if (!sampled && OSPort::getTimeMs() - lastStart >= SAMPLE_MS) {
+      sample();
+      sampled = true;
+    }
+  }
+}
+
+static bool report(const Run &run, const char *unit, float target, float tolerance) {
+  ABC150Test::TestState state = run.test->getTestState();
+  bool passed = run.started && state == ABC150Test::TestState::Success && run.remote &&
+                fabsf(run.simValue - target) <= tolerance && fabsf(run.handlerValue - run.simValue) <= tolerance;
+  printf("%-16s %-8s %6.1f s  %9.2f %s  %9.2f %s  %-7s  %s\n", run.name, run.started ? "started" : "refused",
+         (run.endMs - run.startMs) / 1000.0, run.simValue, unit, run.handlerValue, unit, stateNames[(int)state],
+         passed ? "ok" : "WRONG");
+  return passed;
+}
+
+static bool runPulseTests(ABC150SimBus &bus, ABC150CANHandler &handler, PlateCANHandler &plate,
+                          BatteryModuleInfo **bms) {
+  PulseTest pulseA(0, ABC150CANHandler::A, &handler, &plate);
+  PulseTest pulseB(0, ABC150CANHandler::B, &handler, &plate);
+  Run runs[CHANNELS] = {{"PulseTest A", &pulseA}, {"PulseTest B", &pulseB}};
+  for (int channel = 0; channel < CHANNELS; channel++) {
+    start(runs[channel], ((PulseTest *)runs[channel].test)->startTest(bms[channel]));
+  }
+  ABC150Simulator &sim = bus.getSimulator();
+  runLoops(runs, CHANNELS, [&]() {
+    for (int channel = 0; channel < CHANNELS; channel++) {
+      runs[channel].simValue = sim.getCurrent(channel);
+      runs[channel].handlerValue = handler.getCurrent((ABC150CANHandler::Channel)channel);
+      runs[channel].remote = sim.getConverterStatus(channel) == ABC150Simulator::Remote;
+    }
+  });
+  bool passed = true;
+  for (int channel = 0; channel < CHANNELS; channel++) {
+    passed = report(runs[channel], "A", PULSE_CURRENT, CURRENT_TOLERANCE) && passed;
+  }
+  return passed;
+}
+
+static bool runPowerHoldTest(ABC150SimBus &bus, ABC150CANHandler &handler, PlateCANHandler &plate) {
+  PowerHoldTest hold(&handler, &plate, HOLD_POWER, HOLD_MS);
+  Run run = {"PowerHoldTest", &hold};
+  start(run, hold.startTest());
+  ABC150Simulator &sim = bus.getSimulator();
+  runLoops(&run, 1, [&]() {
+    run.simValue = sim.getVoltage(0) * sim.getCurrent(0);
+    run.handlerValue = handler.getVoltage(ABC150CANHandler::A) * handler.getCurrent(ABC150CANHandler::A);
+    run.remote = sim.getConverterStatus(0) == ABC150Simulator::Remote;
+  });
+  return report(run, "W", HOLD_POWER, fabsf(HOLD_POWER) * POWER_TOLERANCE);
+}
+
+int main() {
+  OSPortHost::enableVirtualTime();
+  ABC150SimBus bus;
+  ABC150CANHandler handler(bus.getCAN());
+  PlateCANHandler plate(bus.getCAN(), AMPLE_ID, 240, 406, NULL, true);
+  BatteryModuleCollection &collection = BatteryModuleCollection::collection();
+  BatteryModuleInfo *bms[CHANNELS] = {collection.addBatteryModule(1, 1), collection.addBatteryModule(2, 2)};
+  bus.start();
+  OSPort::delay(STARTUP_MS);
+  bool passed = handler.isDetected();
+  ESP_LOGI(TAG, "ABC150 %s", passed ? "detected" : "not detected");
+
+  passed = runPulseTests(bus, handler, plate, bms) && passed;
+  /* Both channels back in local control */
+  OSPort::delay(bus.getSimulator().commandTimeoutMs + STARTUP_MS);
+  passed = runPowerHoldTest(bus, handler, plate) && passed;
+
+  printf("%u frames through msgReceived()\n", bus.getDelivered());
+  return passed ? 0 : 1;
+}
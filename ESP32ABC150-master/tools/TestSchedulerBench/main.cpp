@@ -0,0 +1,139 @@
+/*
+ * main.cpp
+ *
+ * Runs a fast control job next to slow monitoring jobs on TestScheduler in
+ * virtual time, once with the control job in its own lane and once with
+ * everything in one lane like the old test manager loop. Jobs take their
+ * execution time in OSPort::delay(), so a job in the other lane runs in the
+ * meantime as if it had preempted it. Every 100th control run and every 50th
+ * run of one monitoring job overrun on purpose. A job that stops itself and one
+ * that is never activated check that only active jobs run.
+ *
+ * Exits with 1 if, in its own lane, the control job misses any deadline
+ * besides the injected ones or skips other releases, or the inactive and
+ * stopped jobs run when they should not.
+ *
+ *   TestSchedulerBench [seconds]     default 60
+ */
+
+#include "TestScheduler.hpp"
+#include "OSPort.hpp"
+#include "OSPortHost.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Plate loop like PlateDriveCycleTest with a 20 ms drive cycle */
+#define CONTROL_PERIOD_MS           20
+#define CONTROL_DEADLINE_MS         10
+#define CONTROL_EXEC_MS             2
+#define CONTROL_OVERRUN_MS          25
+#define CONTROL_OVERRUN_EVERY       100
+/* Test loop() like the monitoring tests */
+#define MONITOR_PERIOD_MS           100
+#define MONITOR_EXEC_MS             5
+#define MONITOR_OVERRUN_MS          250
+#define MONITOR_OVERRUN_EVERY       50
+/* Runs after which the stopping job returns false */
+#define STOP_AFTER_RUNS             20
+
+struct BenchJob {
+  const char *name;
+  TestScheduler::Lane lane;
+  uint32_t periodMs;
+  uint32_t deadlineMs;
+  uint32_t execMs;
+  /* Every overrunEvery-th run takes overrunMs instead, 0 never */
+  uint32_t overrunEvery;
+  uint32_t overrunMs;
+  /* Returns false after this many runs, 0 never */
+  uint32_t stopAfter;
+  bool activate;
+  int job;
+  uint32_t runs;
+  uint32_t injected;
+};
+
+static bool runJob(void *arg) {
+  BenchJob *job = (BenchJob *)arg;
+  job->runs++;
+  if (job->overrunEvery != 0 && job->runs % job->overrunEvery == 0) {
+    job->injected++;
+    OSPort::delay(job->overrunMs);
+  } else {
+    OSPort::delay(job->execMs);
+  }
+  return job->stopAfter == 0 || job->runs < job->stopAfter;
+}
+
+/* Returns false if a check failed */
+static bool run(const char *title, bool controlLane, uint32_t seconds) {
+  BenchJob jobs[] = {
+      {"control", TestScheduler::Control, CONTROL_PERIOD_MS, CONTROL_DEADLINE_MS, CONTROL_EXEC_MS,
+       CONTROL_OVERRUN_EVERY, CONTROL_OVERRUN_MS, 0, true, 0, 0, 0},
+      {"monitor, overruns", TestScheduler::Monitor, MONITOR_PERIOD_MS, MONITOR_PERIOD_MS, MONITOR_EXEC_MS,
+       MONITOR_OVERRUN_EVERY, MONITOR_OVERRUN_MS, 0, true, 0, 0, 0},
+      {"monitor", TestScheduler::Monitor, MONITOR_PERIOD_MS, MONITOR_PERIOD_MS, MONITOR_EXEC_MS, 0, 0, 0, true,
+       0, 0, 0},
+      {"monitor, stops itself", TestScheduler::Monitor, MONITOR_PERIOD_MS, MONITOR_PERIOD_MS, MONITOR_EXEC_MS, 0, 0,
+       STOP_AFTER_RUNS, true, 0, 0, 0},
+      {"monitor, idle", TestScheduler::Monitor, MONITOR_PERIOD_MS, MONITOR_PERIOD_MS, MONITOR_EXEC_MS, 0, 0, 0, false,
+       0, 0, 0},
+  };
+  const int count = sizeof(jobs) / sizeof(jobs[0]);
+  if (!controlLane) {
+    jobs[0].lane = TestScheduler::Monitor;
+  }
+
+  TestScheduler scheduler;
+  if (!scheduler.start()) {
+    return false;
+  }
+  for (int i = 0; i < count; i++) {
+    jobs[i].runs = 0;
+    jobs[i].injected = 0;
+    jobs[i].job = scheduler.addJob(jobs[i].name, &runJob, &jobs[i], jobs[i].lane, jobs[i].periodMs,
+                                   jobs[i].deadlineMs);
+  }
+  for (int i = 0; i < count; i++) {
+    if (jobs[i].activate) {
+      scheduler.activate(jobs[i].job);
+    }
+  }
+  OSPort::delay(seconds * 1000);
+  for (int i = 0; i < count; i++) {
+    scheduler.deactivate(jobs[i].job);
+  }
+  /* Let running releases complete */
+  OSPort::delay(MONITOR_OVERRUN_MS);
+
+  printf("%s\n", title);
+  scheduler.print();
+  BenchJob &control = jobs[0];
+  uint32_t overruns = scheduler.getOverruns(control.job);
+  uint32_t skipped = scheduler.getSkipped(control.job);
+  printf("  control: %u runs, %u injected overruns, %u overruns, %u skipped, max response %u us\n\n",
+         control.runs, control.injected, overruns, skipped, scheduler.getMaxResponseUs(control.job));
+
+  bool passed = jobs[3].runs == STOP_AFTER_RUNS && scheduler.getRuns(jobs[3].job) == STOP_AFTER_RUNS &&
+                !scheduler.isActive(jobs[3].job) && jobs[4].runs == 0;
+  if (controlLane) {
+    /* A CONTROL_OVERRUN_MS run skips the releases it covers */
+    uint32_t skippedPerOverrun = (CONTROL_OVERRUN_MS - 1) / CONTROL_PERIOD_MS;
+    passed = passed && control.injected > 0 && overruns == control.injected &&
+             skipped == control.injected * skippedPerOverrun;
+  }
+  return passed;
+}
+
+int main(int argc, char **argv) {
+  int seconds = (argc > 1) ? atoi(argv[1]) : 60;
+  if (seconds <= 0) {
+    return 1;
+  }
+  OSPortHost::enableVirtualTime();
+  bool passed = run("Control job in its own lane", true, seconds);
+  run("Everything in one lane", false, seconds);
+  printf("%s\n", passed ? "Control lane meets its deadlines apart from the injected overruns" :
+                          "Control lane missed deadlines it should have met");
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,320 @@
+/*
+ * main.cpp
+ *
+ * Checks how the real ABC150CANHandler of the host build writes its command
+ * packages (sendPackage() and writeFrames()) against a CAN driver that
+ * models the three MCP2515 transmit buffers draining onto a 250 kbps bus,
+ * in virtual time.
+ *
+ * Both channels are put in remote control with STATUS frames and
+ * takeControl(), back to back, and get a new setpoint every
+ * SETPOINT_PERIOD_MS, so the send task sends both packages every
+ * SEND_MIN_INTERVAL_MS. The driver records every write and whether all
+ * transmit buffers were still full, in which case the MCP2515 would lose a
+ * frame. Virtual time only says in which ms tick a write happened, so the
+ * driver assumes the worst case: a frame starts draining at the end of its
+ * tick and the next write comes at the start of its own.
+ *
+ *  - no write finds the transmit buffers full
+ *  - every package is COMMAND, LOWER_LIMITS_OUT, UPPER_LIMITS_OUT of one
+ *    channel, channel A before B, all three with the same counter stamp,
+ *    which advances by one per package and channel
+ *  - every PC greeting the ABC150 asks for with REQUEST_PC, in between,
+ *    goes out through the same pacing, none written from the receive path
+ *  - the frames of one cycle written back to back without pacing, and with
+ *    the 1 ms delay after each frame sendPackage() had before, go through the
+ *    same driver: the first must overflow it, which shows the check works,
+ *    the second gives the cycle time before
+ *
+ * Prints the send task's time per cycle and the time until the last frame
+ * left the bus. Exits with 1 if a check fails.
+ *
+ *   TxPacingBench [cycles]     default 500
+ */
+
+#include "ABC150CANHandler.hpp"
+#include "ABC150Codec.hpp"
+#include "AmpleCAN.hpp"
+#include "OSPort.hpp"
+#include "OSPortHost.hpp"
+#include <algorithm>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* As in ABC150CANHandler.cpp */
+#define TX_MAILBOXES                3
+#define SEND_MIN_INTERVAL_MS        10
+#define PACKAGE_FRAMES              3
+#define ABC150_BIT_RATE             250000
+#define SETPOINT_PERIOD_MS          5
+#define TICK_US                     1000
+/* The package of a cycle before, one ms after each frame */
+#define OLD_FRAME_DELAY_MS          1
+#define CHANNELS                    2
+#define POWER_W                     -1000.0f
+/* The ABC150 asks for the PC greeting every this many setpoints */
+#define GREETING_REQUEST_EVERY      7
+
+static bool passed = true;
+
+/* Three transmit buffers draining in write order */
+
+class MailboxDriver : public CANDriver {
+public:
+  struct Write {
+    CAN_frame_t frame;
+    int64_t tickUs;
+    /* When the frame has left the bus, worst case */
+    int64_t doneUs;
+    bool overflow;
+  };
+
+  MailboxDriver() : overflows(0) {}
+
+  int CAN_write_frame(const CAN_frame_t *p_frame) {
+    int64_t tickUs = OSPort::getTimeUs();
+    int busy = 0;
+    for (size_t i = writes.size(); i > 0 && writes[i - 1].doneUs > tickUs; i--) {
+      busy++;
+    }
+    Write write;
+    write.frame = *p_frame;
+    write.tickUs = tickUs;
+    write.overflow = busy >= TX_MAILBOXES;
+    int64_t startUs = tickUs + TICK_US;
+    if (!writes.empty()) {
+      startUs = std::max(startUs, writes.back().doneUs);
+    }
+    write.doneUs = startUs + wireUs(p_frame->FIR.B.DLC);
+    overflows += write.overflow;
+    writes.push_back(write);
+    return 0;
+  }
+
+  const std::vector<Write> &getWrites() {
+    return writes;
+  }
+
+  uint32_t getOverflows() {
+    return overflows;
+  }
+
+  /* Standard frame with the most stuff bits and the interframe space */
+  static int64_t wireUs(uint8_t dlc) {
+    uint32_t bits = 47 + 8 * dlc + (34 + 8 * dlc - 1) / 4;
+    return bits * 1000000LL / ABC150_BIT_RATE;
+  }
+
+private:
+  std::vector<Write> writes;
+  uint32_t overflows;
+};
+
+/* Handler */
+
+static void putInRemoteControl(ABC150CANHandler &handler) {
+  for (int channel = 0; channel < CHANNELS; channel++) {
+    CAN_frame_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.MsgID = STATUS_A + channel * CHANNEL_ID_STRIDE;
+    msg.FIR.B.FF = CAN_frame_std;
+    msg.FIR.B.DLC = ABC150Codec::STATUS_LAYOUT.dlc;
+    int64_t raws[ABC150Codec::STATUS_FIELDS] = {0};
+    raws[ABC150Codec::STATUS_CONVERTER] = ABC150CANHandler::Remote;
+    ABC150Codec::encodeRaw(ABC150Codec::STATUS_LAYOUT, msg.data.u8, raws);
+    handler.msgReceived(msg);
+  }
+  handler.takeControl(ABC150CANHandler::A);
+  handler.takeControl(ABC150CANHandler::B);
+}
+
+static void requestGreeting(ABC150CANHandler &handler) {
+  CAN_frame_t msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.MsgID = REQUEST_PC;
+  msg.FIR.B.FF = CAN_frame_std;
+  msg.FIR.B.DLC = ABC150Codec::REQUEST_LAYOUT.dlc;
+  int64_t raws[ABC150Codec::REQUEST_FIELDS] = {PC_GREETING};
+  ABC150Codec::encodeRaw(ABC150Codec::REQUEST_LAYOUT, msg.data.u8, raws);
+  handler.msgReceived(msg);
+}
+
+/* Checks */
+
+static void check(const char *name, bool ok) {
+  printf("  %-58s %s\n", name, ok ? "ok" : "WRONG");
+  passed = passed && ok;
+}
+
+static int countWrites(const std::vector<MailboxDriver::Write> &writes, uint32_t id) {
+  int count = 0;
+  for (size_t i = 0; i < writes.size(); i++) {
+    count += (writes[i].frame.MsgID == id);
+  }
+  return count;
+}
+
+static uint8_t counterStamp(const CAN_frame_t &frame) {
+  return frame.data.u8[0];
+}
+
+/* Index of the first write of each package */
+static std::vector<size_t> findPackages(const std::vector<MailboxDriver::Write> &writes) {
+  std::vector<size_t> packages;
+  for (size_t i = 0; i < writes.size(); i++) {
+    uint32_t id = writes[i].frame.MsgID;
+    if (id == COMMAND_A || id == COMMAND_B) {
+      packages.push_back(i);
+    }
+  }
+  return packages;
+}
+
+static bool packagesInOrder(const std::vector<MailboxDriver::Write> &writes, const std::vector<size_t> &packages) {
+  for (size_t p = 0; p < packages.size(); p++) {
+    size_t first = packages[p];
+    int channel = (writes[first].frame.MsgID == COMMAND_B);
+    uint32_t base = COMMAND_A + channel * CHANNEL_ID_STRIDE;
+    if (first + PACKAGE_FRAMES > writes.size()) {
+      return false;
+    }
+    for (int i = 0; i < PACKAGE_FRAMES; i++) {
+      if (writes[first + i].frame.MsgID != base + i) {
+        printf("  package %u: frame %d is 0x%03x\n", (unsigned)p, i, writes[first + i].frame.MsgID);
+        return false;
+      }
+    }
+    /* Channel A, then B in every cycle */
+    if (p > 0 && channel == (writes[packages[p - 1]].frame.MsgID == COMMAND_B)) {
+      printf("  package %u: channel %c twice\n", (unsigned)p, 'A' + channel);
+      return false;
+    }
+  }
+  return !packages.empty() && writes[packages[0]].frame.MsgID == COMMAND_A;
+}
+
+static bool counterStampsPaired(const std::vector<MailboxDriver::Write> &writes, const std::vector<size_t> &packages) {
+  int last[CHANNELS] = {-1, -1};
+  for (size_t p = 0; p < packages.size(); p++) {
+    size_t first = packages[p];
+    int channel = (writes[first].frame.MsgID == COMMAND_B);
+    uint8_t stamp = counterStamp(writes[first].frame);
+    for (int i = 1; i < PACKAGE_FRAMES; i++) {
+      if (counterStamp(writes[first + i].frame) != stamp) {
+        printf("  package %u: counter stamps %u and %u\n", (unsigned)p, stamp, counterStamp(writes[first + i].frame));
+        return false;
+      }
+    }
+    if (last[channel] >= 0 && stamp != (uint8_t)(last[channel] + 1)) {
+      printf("  package %u: counter stamp %u after %d\n", (unsigned)p, stamp, last[channel]);
+      return false;
+    }
+    last[channel] = stamp;
+  }
+  return true;
+}
+
+/* Timing */
+
+struct CycleTime {
+  /* First to last write, the send task is busy in between */
+  double taskMs;
+  /* First write until the last frame left the bus */
+  double busMs;
+};
+
+/* Cycles of the writes from first on, a cycle starts with a channel A package */
+static std::vector<CycleTime> cycleTimes(const std::vector<MailboxDriver::Write> &writes,
+                                         const std::vector<size_t> &packages) {
+  std::vector<CycleTime> cycles;
+  for (size_t p = 0; p + 1 < packages.size(); p += CHANNELS) {
+    const MailboxDriver::Write &first = writes[packages[p]];
+    const MailboxDriver::Write &last = writes[packages[p + 1] + PACKAGE_FRAMES - 1];
+    CycleTime cycle = {(last.tickUs - first.tickUs) / 1000.0, (last.doneUs - first.tickUs) / 1000.0};
+    cycles.push_back(cycle);
+  }
+  return cycles;
+}
+
+static void printCycles(const char *name, const std::vector<CycleTime> &cycles) {
+  double taskMax = 0;
+  double busMax = 0;
+  double taskSum = 0;
+  double busSum = 0;
+  for (size_t i = 0; i < cycles.size(); i++) {
+    taskMax = std::max(taskMax, cycles[i].taskMs);
+    busMax = std::max(busMax, cycles[i].busMs);
+    taskSum += cycles[i].taskMs;
+    busSum += cycles[i].busMs;
+  }
+  printf("  %-30s %6u %10.2f %10.2f %10.2f %10.2f\n", name, (unsigned)cycles.size(), taskSum / cycles.size(),
+         taskMax, busSum / cycles.size(), busMax);
+}
+
+/* Writes the frames of the first cycle again through another driver, delayMs after each frame */
+static CycleTime replayCycle(MailboxDriver &driver, const std::vector<MailboxDriver::Write> &writes,
+                             const std::vector<size_t> &packages, uint32_t delayMs) {
+  int64_t startUs = OSPort::getTimeUs();
+  for (int p = 0; p < CHANNELS; p++) {
+    for (int i = 0; i < PACKAGE_FRAMES; i++) {
+      driver.CAN_write_frame(&writes[packages[p] + i].frame);
+      if (delayMs > 0) {
+        OSPort::delay(delayMs);
+      }
+    }
+  }
+  CycleTime cycle = {(OSPort::getTimeUs() - startUs) / 1000.0, (driver.getWrites().back().doneUs - startUs) / 1000.0};
+  return cycle;
+}
+
+int main(int argc, char **argv) {
+  int cycles = (argc > 1) ? atoi(argv[1]) : 500;
+  if (cycles <= 0) {
+    return 1;
+  }
+  OSPortHost::enableVirtualTime();
+  MailboxDriver driver;
+  AmpleCAN can(driver);
+  ABC150CANHandler handler(can);
+  putInRemoteControl(handler);
+  /* takeControl() greets once per channel */
+  int greetings = CHANNELS;
+  for (int i = 0; i < cycles * SEND_MIN_INTERVAL_MS / SETPOINT_PERIOD_MS; i++) {
+    OSPort::delay(SETPOINT_PERIOD_MS);
+    handler.setPower(ABC150CANHandler::A, POWER_W - i % 100);
+    handler.setPower(ABC150CANHandler::B, POWER_W + i % 100);
+    if (i % GREETING_REQUEST_EVERY == 0) {
+      requestGreeting(handler);
+      greetings++;
+    }
+  }
+  OSPort::delay(SEND_MIN_INTERVAL_MS);
+
+  const std::vector<MailboxDriver::Write> &writes = driver.getWrites();
+  std::vector<size_t> packages = findPackages(writes);
+  printf("%u frames, %u packages, %.0f us on the bus per LIMITS_OUT frame\n\n", (unsigned)writes.size(),
+         (unsigned)packages.size(), (double)MailboxDriver::wireUs(ABC150Codec::LIMITS_OUT_LAYOUT.dlc));
+
+  check("no write finds the transmit buffers full", driver.getOverflows() == 0);
+  check("packages are COMMAND, LOWER, UPPER, channel A then B", packagesInOrder(writes, packages));
+  check("counter stamps paired within and advancing across packages", counterStampsPaired(writes, packages));
+  check("a package every cycle", (int)packages.size() >= CHANNELS * (cycles - 1));
+  check("every requested PC greeting sent", countWrites(writes, PC_GREETING) == greetings);
+
+  MailboxDriver unpaced;
+  replayCycle(unpaced, writes, packages, 0);
+  check("the same cycle written unpaced overflows the buffers", unpaced.getOverflows() > 0);
+  MailboxDriver old;
+  std::vector<CycleTime> oldCycle(1, replayCycle(old, writes, packages, OLD_FRAME_DELAY_MS));
+  check("the same cycle with the 1 ms delays of before fits", old.getOverflows() == 0);
+
+  printf("\nPer cycle of both packages, ms\n");
+  printf("  %-30s %6s %10s %10s %10s %10s\n", "", "cycles", "task mean", "task max", "bus mean", "bus max");
+  printCycles("writeFrames()", cycleTimes(writes, packages));
+  printCycles("1 ms after each frame (before)", oldCycle);
+
+  printf("\n%s\n", passed ? "Packages paced without losing a frame" : "TxPacingBench FAILED");
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,303 @@
+/*
+ * AmpleNetworkHost.cpp
+ *
+ * Host definitions of the AmpleNetwork and ESP-IDF driver interfaces the
+ * ABC150 component uses, see the headers in include/.
+ */
+
+#include "AmpleCAN.hpp"
+#include "AmpleLogger.hpp"
+#include "AmpleSerial.hpp"
+#include "BatteryModuleCollection.hpp"
+#include "NVSConfig.hpp"
+#include "PCAL6416a.hpp"
+#include "PlateCANHandler.hpp"
+#include "driver/gpio.h"
+#include "esp_log.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Modules HV on and off switch at once */
+#define MAX_BATTERY_MODULES         64
+
+static const char *TAG = "AmpleNetworkHost";
+
+
+int CANDriver::CAN_write_frame(const CAN_frame_t *p_frame) {
+  std::lock_guard<std::mutex> lock(framesMutex);
+  frames.push_back(*p_frame);
+  return 0;
+}
+
+int CANDriver::writeFrames(const CAN_frame_t *frames, int count) {
+  int written = 0;
+  while (written < count && CAN_write_frame(&frames[written]) == 0) {
+    written++;
+  }
+  return written;
+}
+
+std::vector<CAN_frame_t> CANDriver::takeFrames() {
+  std::lock_guard<std::mutex> lock(framesMutex);
+  std::vector<CAN_frame_t> taken;
+  taken.swap(frames);
+  return taken;
+}
+
+AmpleCAN::AmpleCAN(CANDriver &_can) :
+                   can(_can){
+}
+
+void AmpleCAN::registerListener(uint32_t id, AmpleCANListener *listener) {
+  listeners[id] = listener;
+}
+
+bool AmpleCAN::receive(CAN_frame_t &msg) {
+  std::map<uint32_t, AmpleCANListener*>::iterator it = listeners.find(msg.MsgID);
+  if (it == listeners.end()) {
+    return false;
+  }
+  it->second->msgReceived(msg);
+  return true;
+}
+
+
+void TestLogger::logStartTime(const char *testName) {
+  ESP_LOGI(TAG, "%s started", testName);
+}
+
+void TestLogger::logEndTime(const char *testName) {
+  ESP_LOGI(TAG, "%s ended", testName);
+}
+
+void TestLogger::logDriveCyclePower(float, float) {
+}
+
+void BatteryModuleLogger::log12v(bool enabled) {
+  ESP_LOGI(TAG, "12 V %s", enabled ? "on" : "off");
+}
+
+TestLogger *AmpleLogger::getTestLogger() {
+  static TestLogger testLogger;
+  return &testLogger;
+}
+
+BatteryModuleLogger *AmpleLogger::getBatteryModuleLogger() {
+  static BatteryModuleLogger batteryModuleLogger;
+  return &batteryModuleLogger;
+}
+
+
+AmpleSerial::AmpleSerial(uart_port_t _port) :
+                         port(_port){
+}
+
+char AmpleSerial::rx_char() {
+  int c = getchar();
+  return (c == EOF) ? 0 : (char)c;
+}
+
+bool AmpleSerial::readLine(std::string &line, const char *prompt) {
+  printf("%s", prompt);
+  fflush(stdout);
+  return (bool)std::getline(std::cin, line);
+}
+
+bool AmpleSerial::readNumber(int &number, const char *prompt) {
+  std::string line;
+  if (!readLine(line, prompt)) return false;
+  char *end;
+  long value = strtol(line.c_str(), &end, 10);
+  if (end == line.c_str()) return false;
+  number = value;
+  return true;
+}
+
+bool AmpleSerial::readNumber(unsigned int &number, const char *prompt) {
+  int value;
+  if (!readNumber(value, prompt) || value < 0) return false;
+  number = value;
+  return true;
+}
+
+bool AmpleSerial::readFloatNumber(float &number, const char *prompt) {
+  std::string line;
+  if (!readLine(line, prompt)) return false;
+  char *end;
+  float value = strtof(line.c_str(), &end);
+  if (end == line.c_str()) return false;
+  number = value;
+  return true;
+}
+
+bool AmpleSerial::readString(char *buffer, int size, const char *prompt) {
+  std::string line;
+  if (size <= 0 || !readLine(line, prompt)) return false;
+  snprintf(buffer, size, "%s", line.c_str());
+  return true;
+}
+
+void AmpleSerial::clear() {
+}
+
+
+BatteryModuleCollection &BatteryModuleCollection::collection() {
+  static BatteryModuleCollection collection;
+  return collection;
+}
+
+BatteryModuleInfo *BatteryModuleCollection::addBatteryModule(unsigned int id, int batteryID, float cellVoltage) {
+  BatteryModuleInfo *bmInfo = new BatteryModuleInfo();
+  bmInfo->id = id;
+  bmInfo->batteryID = batteryID;
+  bmInfo->online = true;
+  bmInfo->onlineStatus = true;
+  bmInfo->used = true;
+  for (int i = 0; i < NUM_CELLS; i++) {
+    bmInfo->cellVoltages[i] = cellVoltage;
+  }
+  bmInfo->minCellVoltage = cellVoltage;
+  bmInfo->maxCellVoltage = cellVoltage;
+  bmInfo->voltage = cellVoltage * NUM_CELLS;
+  bmInfo->busVoltage = bmInfo->voltage;
+  bmInfo->bmVoltage = bmInfo->voltage;
+  bmInfo->avgTemp = 25;
+  bmInfo->maxTemp = 25;
+  modules.push_back(bmInfo);
+  batteryInfo.onlineCount++;
+  return bmInfo;
+}
+
+BatteryInfo *BatteryModuleCollection::getBatteryInfo() {
+  batteryInfo.HVOnCount = getHVCount();
+  return &batteryInfo;
+}
+
+BatteryModuleInfo *BatteryModuleCollection::getBatteryModuleByID(unsigned int id) {
+  for (size_t i = 0; i < modules.size(); i++) {
+    if ((unsigned int)modules[i]->id == id) return modules[i];
+  }
+  return NULL;
+}
+
+BatteryModuleInfo *BatteryModuleCollection::getBatteryModuleByBatteryID(int batteryID) {
+  for (size_t i = 0; i < modules.size(); i++) {
+    if (modules[i]->batteryID == batteryID) return modules[i];
+  }
+  return NULL;
+}
+
+int BatteryModuleCollection::count() {
+  return modules.size();
+}
+
+int BatteryModuleCollection::getAllBatteryModules(BatteryModuleInfo **bms, int size) {
+  int n = 0;
+  for (size_t i = 0; i < modules.size() && n < size; i++) {
+    bms[n++] = modules[i];
+  }
+  return n;
+}
+
+bool BatteryModuleCollection::isBMErrors(BatteryModuleInfo *bmInfo) {
+  return isBMCriticalErrors(bmInfo) || isBMPlateErrors(bmInfo) || bmInfo->cellVoltageError ||
+         bmInfo->voltageDiffError || bmInfo->tempError || bmInfo->currentError;
+}
+
+bool BatteryModuleCollection::isBMCriticalErrors(BatteryModuleInfo *bmInfo) {
+  return bmInfo->shortCircuitError || bmInfo->FETFailure || bmInfo->otherHardwareFailure;
+}
+
+bool BatteryModuleCollection::isBMPlateErrors(BatteryModuleInfo *bmInfo) {
+  return bmInfo->busVoltageDiffError || bmInfo->tempSensingFailure || bmInfo->voltageSensingFailure;
+}
+
+int BatteryModuleCollection::getHVCount() {
+  int hvCount = 0;
+  for (size_t i = 0; i < modules.size(); i++) {
+    if (modules[i]->HVOn) hvCount++;
+  }
+  return hvCount;
+}
+
+
+PlateCANHandler::PlateCANHandler(AmpleCAN &_can, unsigned int _ampleID, int, int, void *,
+                                 bool) :
+                                 can(_can),
+                                 ampleID(_ampleID){
+}
+
+void PlateCANHandler::HVOn() {
+  BatteryModuleInfo *bms[MAX_BATTERY_MODULES];
+  int bmCount = BatteryModuleCollection::collection().getAllBatteryModules(bms, MAX_BATTERY_MODULES);
+  for (int i = 0; i < bmCount; i++) {
+    if (bms[i]->online && bms[i]->used) bms[i]->HVOn = true;
+  }
+}
+
+void PlateCANHandler::HVOff() {
+  BatteryModuleInfo *bms[MAX_BATTERY_MODULES];
+  int bmCount = BatteryModuleCollection::collection().getAllBatteryModules(bms, MAX_BATTERY_MODULES);
+  for (int i = 0; i < bmCount; i++) {
+    bms[i]->HVOn = false;
+  }
+}
+
+void PlateCANHandler::HVOn(int batteryID) {
+  BatteryModuleInfo *bmInfo = BatteryModuleCollection::collection().getBatteryModuleByBatteryID(batteryID);
+  if (bmInfo != NULL && bmInfo->online) bmInfo->HVOn = true;
+}
+
+void PlateCANHandler::HVOff(int batteryID) {
+  BatteryModuleInfo *bmInfo = BatteryModuleCollection::collection().getBatteryModuleByBatteryID(batteryID);
+  if (bmInfo != NULL) bmInfo->HVOn = false;
+}
+
+void PlateCANHandler::setBMState(int batteryID, bool used) {
+  BatteryModuleInfo *bmInfo = BatteryModuleCollection::collection().getBatteryModuleByBatteryID(batteryID);
+  if (bmInfo != NULL) bmInfo->used = used;
+}
+
+
+static int nvsValues[NVS_KEYS];
+
+int NVSConfig::getInt(int key) {
+  return (key >= 0 && key < NVS_KEYS) ? nvsValues[key] : 0;
+}
+
+void NVSConfig::setInt(int key, int value) {
+  if (key >= 0 && key < NVS_KEYS) nvsValues[key] = value;
+}
+
+
+PCAL6416a *PCAL6416a::getInstance() {
+  static PCAL6416a instance;
+  return &instance;
+}
+
+void PCAL6416a::gpioSetValue(gpio pin, int value) {
+  levels[pin] = value;
+}
+
+int PCAL6416a::gpioGetValue(gpio pin) {
+  return levels[pin];
+}
+
+
+static int gpioLevels[GPIO_NUM_MAX];
+
+void gpio_pad_select_gpio(int) {
+}
+
+int gpio_set_direction(gpio_num_t, gpio_mode_t) {
+  return 0;
+}
+
+int gpio_set_level(gpio_num_t gpio_num, unsigned int level) {
+  gpioLevels[gpio_num] = level;
+  return 0;
+}
+
+int gpio_get_level(gpio_num_t gpio_num) {
+  return gpioLevels[gpio_num];
+}
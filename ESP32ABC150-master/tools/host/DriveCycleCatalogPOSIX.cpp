@@ -0,0 +1,50 @@
+/*
+ * DriveCycleCatalogPOSIX.cpp
+ *
+ * DriveCycleCatalog backend mapping a catalog or image file, name is the file path.
+ */
+
+#include "DriveCycleCatalog.hpp"
+#include "esp_log.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool DriveCycleCatalog::map(const char *name) {
+  unmap();
+  int fd = ::open(name, O_RDONLY);
+  if (fd < 0) {
+    ESP_LOGE(TAG, "Cannot open %s", name);
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    ESP_LOGE(TAG, "Cannot read %s", name);
+    ::close(fd);
+    return false;
+  }
+  void *mapped = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (mapped == MAP_FAILED) {
+    ESP_LOGE(TAG, "Failed to map %s", name);
+    return false;
+  }
+  data = (const uint8_t *)mapped;
+  mapSize = st.st_size;
+  if (!checkIndex()) {
+    unmap();
+    return false;
+  }
+  return true;
+}
+
+void DriveCycleCatalog::unmap() {
+  if (data != NULL) {
+    munmap((void *)data, mapSize);
+  }
+  data = NULL;
+  mapSize = 0;
+  entries = NULL;
+  count = 0;
+}
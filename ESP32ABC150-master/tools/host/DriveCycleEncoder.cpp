@@ -0,0 +1,45 @@
+/*
+ * DriveCycleEncoder.cpp
+ */
+
+#include "DriveCycleEncoder.hpp"
+
+DriveCycleEncoder::DriveCycleEncoder(std::vector<uint8_t> &_out) :
+                                     out(_out),
+                                     previous(0),
+                                     bits(0),
+                                     bitCount(0){
+}
+
+void DriveCycleEncoder::writeBits(uint32_t value, int count) {
+  bits = (bits << count) | value;
+  bitCount += count;
+  while (bitCount >= 8) {
+    bitCount -= 8;
+    out.push_back((uint8_t)(bits >> bitCount));
+  }
+}
+
+void DriveCycleEncoder::encode(int16_t sample) {
+  uint32_t value = RiceState::zigzag(sample - previous);
+  previous = sample;
+  int k = rice.parameter();
+  rice.update(value);
+  uint32_t quotient = value >> k;
+  if (quotient >= RICE_ESCAPE_QUOTIENT) {
+    writeBits((1 << RICE_ESCAPE_QUOTIENT) - 1, RICE_ESCAPE_QUOTIENT);
+    writeBits(value, RICE_RAW_BITS);
+    return;
+  }
+  /* quotient ones and the terminating zero */
+  writeBits(((1 << quotient) - 1) << 1, quotient + 1);
+  if (k > 0) {
+    writeBits(value & ((1 << k) - 1), k);
+  }
+}
+
+void DriveCycleEncoder::finish() {
+  if (bitCount > 0) {
+    writeBits(0, 8 - bitCount);
+  }
+}
@@ -0,0 +1,354 @@
+/*
+ * MCP2515_CAN.cpp
+ *
+ * Register model of the host MCP2515 driver, see include/MCP2515_CAN.hpp.
+ */
+
+#include "MCP2515_CAN.hpp"
+#include "OSPort.hpp"
+#include "esp_log.h"
+#include <string.h>
+
+/* Bytes per mask or filter: SIDH, SIDL, EID8, EID0 */
+#define MCP2515_ID_BYTES            4
+#define MCP2515_RXB0_FILTERS        2
+#define MCP2515_RXB1_FILTERS        4
+/* TXBnSIDH to TXBnD7 */
+#define MCP2515_TX_FRAME_BYTES      13
+/* SPI bytes: instruction and address, READ STATUS and its answer, LOAD TX BUFFER with a frame, RTS */
+#define MCP2515_SPI_HEADER          2
+#define MCP2515_READ_STATUS_BYTES   2
+#define MCP2515_LOAD_TX_BYTES       (1 + MCP2515_TX_FRAME_BYTES)
+#define MCP2515_RTS_BYTES           1
+/* SIDL.EXIDE and TXBnDLC.RTR */
+#define MCP2515_EXIDE               0x08
+#define MCP2515_RTR                 0x40
+
+static const char *TAG = "MCP2515_CAN";
+
+MCP2515_CAN::MCP2515_CAN(int speedKbps, int) :
+                         spiTransactions(0),
+                         spiBytes(0),
+                         rejectedFrames(0),
+                         bitRate(speedKbps * 1000),
+                         busFreeUs(0) {
+  memset(registers, 0, sizeof(registers));
+  memset(requestUs, 0, sizeof(requestUs));
+  /* After reset the chip is in configuration mode, the driver starts it receiving every frame */
+  registers[MCP2515_CANSTAT] = MCP2515_MODE_CONFIG;
+  registers[MCP2515_CANCTRL] = MCP2515_MODE_CONFIG;
+  uint8_t any = MCP2515_RXM_ANY;
+  write(MCP2515_RXB0CTRL, &any, 1);
+  write(MCP2515_RXB1CTRL, &any, 1);
+  setMode(MCP2515_MODE_NORMAL);
+}
+
+uint8_t MCP2515_CAN::filterAddress(int filter) {
+  return (filter < 3) ? MCP2515_RXF0SIDH + filter * MCP2515_ID_BYTES
+                      : MCP2515_RXF3SIDH + (filter - 3) * MCP2515_ID_BYTES;
+}
+
+void MCP2515_CAN::store(uint8_t address, const uint8_t *data, int count) {
+  bool config = (registers[MCP2515_CANSTAT] & MCP2515_MODE_MASK) == MCP2515_MODE_CONFIG;
+  for (int i = 0; i < count; i++) {
+    uint8_t a = (address + i) % MCP2515_REGISTERS;
+    uint8_t low = a & 0x0F;
+    /* CANSTAT and CANCTRL are mapped into every row, CANSTAT is read only */
+    if (low == MCP2515_CANSTAT) {
+      continue;
+    }
+    if (low == MCP2515_CANCTRL) {
+      registers[MCP2515_CANCTRL] = data[i];
+      registers[MCP2515_CANSTAT] = (registers[MCP2515_CANSTAT] & ~MCP2515_MODE_MASK) | (data[i] & MCP2515_MODE_MASK);
+      continue;
+    }
+    /* TXREQ is only set by RTS and cleared when the frame has left the bus */
+    if (a >= MCP2515_TXB0CTRL && (a - MCP2515_TXB0CTRL) % MCP2515_TXB_STRIDE == 0 &&
+        (a - MCP2515_TXB0CTRL) / MCP2515_TXB_STRIDE < MCP2515_TX_BUFFERS) {
+      registers[a] = (data[i] & ~MCP2515_TXREQ) | (registers[a] & MCP2515_TXREQ);
+      continue;
+    }
+    /* Masks and filters only in configuration mode */
+    bool filterRegister = (a < 0x0C) || (a >= 0x10 && a < 0x1C) || (a >= 0x20 && a < 0x28);
+    if (filterRegister && !config) {
+      continue;
+    }
+    registers[a] = data[i];
+  }
+}
+
+uint8_t MCP2515_CAN::load(uint8_t address) {
+  uint8_t low = address & 0x0F;
+  if (low == MCP2515_CANSTAT || low == MCP2515_CANCTRL) {
+    return registers[low];
+  }
+  return registers[address % MCP2515_REGISTERS];
+}
+
+void MCP2515_CAN::instruction(uint32_t bytes) {
+  transmit();
+  spiTransactions++;
+  spiBytes += bytes;
+}
+
+void MCP2515_CAN::write(uint8_t address, const uint8_t *data, int count) {
+  instruction(MCP2515_SPI_HEADER + count);
+  store(address, data, count);
+}
+
+void MCP2515_CAN::bitModify(uint8_t address, uint8_t mask, uint8_t data) {
+  instruction(MCP2515_SPI_HEADER + 2);
+  uint8_t value = (load(address) & ~mask) | (data & mask);
+  store(address, &value, 1);
+}
+
+uint8_t MCP2515_CAN::read(uint8_t address) {
+  instruction(MCP2515_SPI_HEADER + 1);
+  return load(address);
+}
+
+uint8_t MCP2515_CAN::readStatus() {
+  instruction(MCP2515_READ_STATUS_BYTES);
+  uint8_t status = 0;
+  for (int i = 0; i < MCP2515_TX_BUFFERS; i++) {
+    if (registers[MCP2515_TXB0CTRL + i * MCP2515_TXB_STRIDE] & MCP2515_TXREQ) {
+      status |= MCP2515_STATUS_TXREQ(i);
+    }
+  }
+  return status;
+}
+
+void MCP2515_CAN::loadTxBuffer(int buffer, const CAN_frame_t &frame) {
+  instruction(MCP2515_LOAD_TX_BYTES);
+  uint8_t bytes[MCP2515_TX_FRAME_BYTES];
+  encodeFrame(frame, bytes);
+  store(MCP2515_TXB0CTRL + buffer * MCP2515_TXB_STRIDE + 1, bytes, MCP2515_TX_FRAME_BYTES);
+}
+
+void MCP2515_CAN::requestToSend(uint8_t buffers) {
+  instruction(MCP2515_RTS_BYTES);
+  for (int i = 0; i < MCP2515_TX_BUFFERS; i++) {
+    if (buffers & (1 << i)) {
+      registers[MCP2515_TXB0CTRL + i * MCP2515_TXB_STRIDE] |= MCP2515_TXREQ;
+      requestUs[i] = OSPort::getTimeUs();
+    }
+  }
+}
+
+void MCP2515_CAN::encodeFrame(const CAN_frame_t &frame, uint8_t *bytes) {
+  memset(bytes, 0, MCP2515_TX_FRAME_BYTES);
+  if (frame.FIR.B.FF == CAN_frame_ext) {
+    bytes[0] = frame.MsgID >> 21;
+    bytes[1] = ((frame.MsgID >> 13) & 0xE0) | MCP2515_EXIDE | ((frame.MsgID >> 16) & 0x03);
+    bytes[2] = frame.MsgID >> 8;
+    bytes[3] = frame.MsgID;
+  } else {
+    bytes[0] = frame.MsgID >> 3;
+    bytes[1] = (frame.MsgID & 0x07) << 5;
+  }
+  bytes[4] = frame.FIR.B.DLC | (frame.FIR.B.RTR ? MCP2515_RTR : 0);
+  memcpy(&bytes[5], frame.data.u8, sizeof(frame.data.u8));
+}
+
+CAN_frame_t MCP2515_CAN::decodeFrame(int buffer) {
+  const uint8_t *bytes = &registers[MCP2515_TXB0CTRL + buffer * MCP2515_TXB_STRIDE + 1];
+  CAN_frame_t frame;
+  memset(&frame, 0, sizeof(frame));
+  if (bytes[1] & MCP2515_EXIDE) {
+    frame.FIR.B.FF = CAN_frame_ext;
+    frame.MsgID = (bytes[0] << 21) | ((bytes[1] & 0xE0) << 13) | ((bytes[1] & 0x03) << 16) | (bytes[2] << 8) |
+                  bytes[3];
+  } else {
+    frame.FIR.B.FF = CAN_frame_std;
+    frame.MsgID = (bytes[0] << 3) | (bytes[1] >> 5);
+  }
+  frame.FIR.B.DLC = bytes[4] & 0x0F;
+  frame.FIR.B.RTR = (bytes[4] & MCP2515_RTR) != 0;
+  memcpy(frame.data.u8, &bytes[5], sizeof(frame.data.u8));
+  return frame;
+}
+
+void MCP2515_CAN::transmit() {
+  int64_t nowUs = OSPort::getTimeUs();
+  while (true) {
+    /* The bus starts the next frame when it is free and something is requested */
+    int64_t startUs = INT64_MAX;
+    for (int i = 0; i < MCP2515_TX_BUFFERS; i++) {
+      if ((registers[MCP2515_TXB0CTRL + i * MCP2515_TXB_STRIDE] & MCP2515_TXREQ) && requestUs[i] < startUs) {
+        startUs = requestUs[i];
+      }
+    }
+    if (startUs == INT64_MAX) {
+      return;
+    }
+    if (startUs < busFreeUs) {
+      startUs = busFreeUs;
+    }
+    int winner = -1;
+    int priority = -1;
+    for (int i = MCP2515_TX_BUFFERS - 1; i >= 0; i--) {
+      uint8_t control = registers[MCP2515_TXB0CTRL + i * MCP2515_TXB_STRIDE];
+      if ((control & MCP2515_TXREQ) && requestUs[i] <= startUs && (control & MCP2515_TXP_MASK) > priority) {
+        winner = i;
+        priority = control & MCP2515_TXP_MASK;
+      }
+    }
+    CAN_frame_t frame = decodeFrame(winner);
+    int64_t doneUs = startUs + wireUs(frame);
+    if (doneUs > nowUs) {
+      return;
+    }
+    transmitted.push_back(frame);
+    registers[MCP2515_TXB0CTRL + winner * MCP2515_TXB_STRIDE] &= ~MCP2515_TXREQ;
+    busFreeUs = doneUs;
+  }
+}
+
+int64_t MCP2515_CAN::wireUs(const CAN_frame_t &frame) {
+  uint32_t header = (frame.FIR.B.FF == CAN_frame_ext) ? 67 : 47;
+  uint32_t stuffed = header - 13 + 8 * frame.FIR.B.DLC;
+  uint32_t bits = header + 8 * frame.FIR.B.DLC + (stuffed - 1) / 4;
+  return bits * 1000000LL / bitRate;
+}
+
+int MCP2515_CAN::CAN_write_frame(const CAN_frame_t *p_frame) {
+  std::lock_guard<std::mutex> lock(spiMutex);
+  uint8_t status = readStatus();
+  for (int i = 0; i < MCP2515_TX_BUFFERS; i++) {
+    if (!(status & MCP2515_STATUS_TXREQ(i))) {
+      loadTxBuffer(i, *p_frame);
+      requestToSend(1 << i);
+      CANDriver::CAN_write_frame(p_frame);
+      return 0;
+    }
+  }
+  rejectedFrames++;
+  return -1;
+}
+
+int MCP2515_CAN::writeFrames(const CAN_frame_t *frames, int count) {
+  std::lock_guard<std::mutex> lock(spiMutex);
+  uint8_t status = readStatus();
+  int written = 0;
+  uint8_t buffers = 0;
+  if (status == 0) {
+    /* All free: TXB0CTRL to the last data byte in one WRITE, CANSTAT and CANCTRL in between rewritten unchanged */
+    written = (count < MCP2515_TX_BUFFERS) ? count : MCP2515_TX_BUFFERS;
+    uint8_t bytes[MCP2515_TX_BUFFERS * MCP2515_TXB_STRIDE];
+    for (int i = 0; i < written; i++) {
+      uint8_t *buffer = &bytes[i * MCP2515_TXB_STRIDE];
+      /* Descending priority keeps the write order on the bus */
+      buffer[0] = MCP2515_TXP_MASK - i;
+      encodeFrame(frames[i], &buffer[1]);
+      buffer[1 + MCP2515_TX_FRAME_BYTES] = registers[MCP2515_CANSTAT];
+      buffer[2 + MCP2515_TX_FRAME_BYTES] = registers[MCP2515_CANCTRL];
+      buffers |= 1 << i;
+    }
+    write(MCP2515_TXB0CTRL, bytes, (written - 1) * MCP2515_TXB_STRIDE + 1 + MCP2515_TX_FRAME_BYTES);
+  } else {
+    for (int i = 0; i < MCP2515_TX_BUFFERS && written < count; i++) {
+      if (!(status & MCP2515_STATUS_TXREQ(i))) {
+        loadTxBuffer(i, frames[written++]);
+        buffers |= 1 << i;
+      }
+    }
+  }
+  if (buffers != 0) {
+    requestToSend(buffers);
+  }
+  for (int i = 0; i < written; i++) {
+    CANDriver::CAN_write_frame(&frames[i]);
+  }
+  rejectedFrames += count - written;
+  return written;
+}
+
+bool MCP2515_CAN::setMode(uint8_t mode) {
+  bitModify(MCP2515_CANCTRL, MCP2515_MODE_MASK, mode);
+  return (read(MCP2515_CANSTAT) & MCP2515_MODE_MASK) == mode;
+}
+
+bool MCP2515_CAN::setAcceptanceFilter(const uint16_t *masks, const uint16_t *filters) {
+  std::lock_guard<std::mutex> lock(spiMutex);
+  if (!setMode(MCP2515_MODE_CONFIG)) {
+    ESP_LOGE(TAG, "No configuration mode");
+    return false;
+  }
+  /* SIDH and SIDL with EXIDE clear, the extended ID bytes are not compared for standard frames */
+  uint8_t id[MCP2515_ID_BYTES] = {0};
+  for (int i = 0; i < MCP2515_MASKS; i++) {
+    id[0] = masks[i] >> 3;
+    id[1] = (masks[i] & 0x07) << 5;
+    write(MCP2515_RXM0SIDH + i * MCP2515_ID_BYTES, id, MCP2515_ID_BYTES);
+  }
+  for (int i = 0; i < MCP2515_FILTERS; i++) {
+    id[0] = filters[i] >> 3;
+    id[1] = (filters[i] & 0x07) << 5;
+    write(filterAddress(i), id, MCP2515_ID_BYTES);
+  }
+  /* Filters on, RXB0 rolls over into RXB1 when full */
+  uint8_t rxb0 = MCP2515_BUKT;
+  uint8_t rxb1 = 0;
+  write(MCP2515_RXB0CTRL, &rxb0, 1);
+  write(MCP2515_RXB1CTRL, &rxb1, 1);
+  if (!setMode(MCP2515_MODE_NORMAL)) {
+    ESP_LOGE(TAG, "No normal mode");
+    return false;
+  }
+  return true;
+}
+
+uint16_t MCP2515_CAN::readID(uint8_t address) {
+  return (registers[address] << 3) | (registers[address + 1] >> 5);
+}
+
+bool MCP2515_CAN::accepts(uint32_t id) {
+  std::lock_guard<std::mutex> lock(spiMutex);
+  if ((registers[MCP2515_RXB0CTRL] & MCP2515_RXM_ANY) == MCP2515_RXM_ANY) {
+    return true;
+  }
+  uint16_t mask = readID(MCP2515_RXM0SIDH);
+  for (int i = 0; i < MCP2515_RXB0_FILTERS; i++) {
+    if (((id ^ readID(filterAddress(i))) & mask) == 0) {
+      return true;
+    }
+  }
+  if ((registers[MCP2515_RXB1CTRL] & MCP2515_RXM_ANY) == MCP2515_RXM_ANY) {
+    return true;
+  }
+  mask = readID(MCP2515_RXM0SIDH + MCP2515_ID_BYTES);
+  for (int i = MCP2515_RXB0_FILTERS; i < MCP2515_RXB0_FILTERS + MCP2515_RXB1_FILTERS; i++) {
+    if (((id ^ readID(filterAddress(i))) & mask) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+uint8_t MCP2515_CAN::readRegister(uint8_t address) {
+  std::lock_guard<std::mutex> lock(spiMutex);
+  return read(address);
+}
+
+uint32_t MCP2515_CAN::getSPITransactions() {
+  std::lock_guard<std::mutex> lock(spiMutex);
+  return spiTransactions;
+}
+
+uint32_t MCP2515_CAN::getSPIBytes() {
+  std::lock_guard<std::mutex> lock(spiMutex);
+  return spiBytes;
+}
+
+uint32_t MCP2515_CAN::getRejectedFrames() {
+  std::lock_guard<std::mutex> lock(spiMutex);
+  return rejectedFrames;
+}
+
+std::vector<CAN_frame_t> MCP2515_CAN::takeTransmitted() {
+  std::lock_guard<std::mutex> lock(spiMutex);
+  transmit();
+  std::vector<CAN_frame_t> taken;
+  taken.swap(transmitted);
+  return taken;
+}
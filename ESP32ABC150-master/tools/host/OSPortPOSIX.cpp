@@ -0,0 +1,431 @@
+/*
+ * OSPortPOSIX.cpp
+ *
+ * OSPort on Linux. Tasks are threads, all blocking calls wait on a per task
+ * condition variable under one scheduler lock. Stack sizes are ignored.
+ * Suspending or deleting another task takes effect at that task's next
+ * OSPort call, which is where all ABC150 tasks block anyway.
+ *
+ * In real time mode the threads run in parallel and priorities are ignored.
+ * In virtual time mode (OSPortHost::enableVirtualTime) only one task runs at
+ * a time, like on a single core without preemption: the running task keeps
+ * the CPU until it blocks, then the highest priority ready task runs. When
+ * no task is ready the clock jumps to the earliest timeout. A run therefore
+ * takes as long as the computation and is deterministic.
+ */
+
+#include "OSPort.hpp"
+#include "OSPortHost.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define WAIT_FOREVER_MS             INT64_MAX
+/* Priority of threads that call OSPort without being created as a task, like the ESP-IDF main task */
+#define FOREIGN_TASK_PRIORITY       1
+#define TIMER_TASK_PRIORITY         (OSPORT_MAX_PRIORITIES - 1)
+
+typedef std::chrono::steady_clock Clock;
+
+struct Task {
+  std::string name;
+  OSPort::TaskFunction function;
+  void *arg;
+  int priority;
+  std::condition_variable wake;
+  uint32_t notifyCount;
+  bool suspended;
+  bool deleted;
+  /* Waiting in blockOn() for waitObject or until deadline */
+  bool blocked;
+  void *waitObject;
+  int64_t deadline;
+  /* Virtual time: waiting for the CPU, readyOrder keeps equal priorities FIFO */
+  bool ready;
+  uint64_t readyOrder;
+};
+
+struct PortMutex {
+  Task *owner;
+};
+
+/* Thrown into a deleted task to unwind it at its next OSPort call */
+struct TaskDeleted {};
+
+/* Never destroyed, detached threads may still wait on them at exit */
+static std::mutex &schedMutex = *new std::mutex();
+static std::vector<Task *> &tasks = *new std::vector<Task *>();
+static thread_local Task *currentTask = NULL;
+static const Clock::time_point bootTime = Clock::now();
+
+static bool virtualTime = false;
+static std::atomic<int64_t> virtualNow(0);
+static Task *runningTask = NULL;
+static uint64_t readyCounter = 0;
+static Clock::time_point virtualStartReal;
+
+static int64_t nowMs() {
+  if (virtualTime) return virtualNow.load();
+  return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - bootTime).count();
+}
+
+static Task *newTask(const char *name, OSPort::TaskFunction function, void *arg, int priority) {
+  Task *task = new Task();
+  task->name = name;
+  task->function = function;
+  task->arg = arg;
+  task->priority = priority;
+  task->notifyCount = 0;
+  task->suspended = false;
+  task->deleted = false;
+  task->blocked = false;
+  task->waitObject = NULL;
+  task->deadline = WAIT_FOREVER_MS;
+  task->ready = false;
+  task->readyOrder = 0;
+  tasks.push_back(task);
+  return task;
+}
+
+/* Virtual time: hands the CPU to the next ready task, advancing the clock if none is ready */
+static void dispatch() {
+  while (1) {
+    Task *next = NULL;
+    for (Task *task : tasks) {
+      if (task->ready && (next == NULL || task->priority > next->priority ||
+          (task->priority == next->priority && task->readyOrder < next->readyOrder))) {
+        next = task;
+      }
+    }
+    if (next != NULL) {
+      next->ready = false;
+      runningTask = next;
+      next->wake.notify_all();
+      return;
+    }
+
+    int64_t earliest = WAIT_FOREVER_MS;
+    for (Task *task : tasks) {
+      if (task->blocked && task->deadline < earliest) earliest = task->deadline;
+    }
+    if (earliest == WAIT_FOREVER_MS) {
+      /* Idle until a thread outside the scheduler wakes a task */
+      return;
+    }
+    if (earliest > virtualNow.load()) virtualNow.store(earliest);
+    for (Task *task : tasks) {
+      if (task->blocked && task->deadline <= earliest) {
+        task->blocked = false;
+        task->ready = true;
+        task->readyOrder = readyCounter++;
+      }
+    }
+  }
+}
+
+static void makeReady(Task *task) {
+  if (!task->blocked) return;
+  task->blocked = false;
+  if (virtualTime) {
+    task->ready = true;
+    task->readyOrder = readyCounter++;
+    if (runningTask == NULL) dispatch();
+  } else {
+    task->wake.notify_all();
+  }
+}
+
+/* Wakes all tasks blocked on object */
+static void wakeObject(void *object) {
+  for (Task *task : tasks) {
+    if (task->blocked && task->waitObject == object) makeReady(task);
+  }
+}
+
+static void waitForCPU(std::unique_lock<std::mutex> &lock, Task *task) {
+  task->wake.wait(lock, [task] { return runningTask == task; });
+}
+
+/* Task of the calling thread, threads not created by OSPort are adopted on first use */
+static Task *self(std::unique_lock<std::mutex> &lock) {
+  if (currentTask == NULL) {
+    currentTask = newTask("foreign", NULL, NULL, FOREIGN_TASK_PRIORITY);
+    if (virtualTime) {
+      currentTask->ready = true;
+      currentTask->readyOrder = readyCounter++;
+      if (runningTask == NULL) dispatch();
+      waitForCPU(lock, currentTask);
+    }
+  }
+  return currentTask;
+}
+
+/* Blocks the calling task until condition holds or deadline passes. Returns false on timeout. */
+template <typename Condition>
+static bool blockOn(std::unique_lock<std::mutex> &lock, Task *task, void *object, int64_t deadline,
+                    Condition condition) {
+  while (!condition()) {
+    if (task->deleted) throw TaskDeleted();
+    if (nowMs() >= deadline) return false;
+    task->blocked = true;
+    task->waitObject = object;
+    task->deadline = deadline;
+    if (virtualTime) {
+      runningTask = NULL;
+      dispatch();
+      waitForCPU(lock, task);
+    } else if (deadline == WAIT_FOREVER_MS) {
+      task->wake.wait(lock);
+    } else {
+      task->wake.wait_until(lock, bootTime + std::chrono::milliseconds(deadline));
+    }
+    task->blocked = false;
+    task->waitObject = NULL;
+  }
+  if (task->deleted) throw TaskDeleted();
+  return true;
+}
+
+/* Honours a pending suspend or delete of the calling task */
+static void checkpoint(std::unique_lock<std::mutex> &lock, Task *task) {
+  blockOn(lock, task, task, WAIT_FOREVER_MS, [task] { return !task->suspended; });
+}
+
+static int64_t toDeadline(uint32_t timeout) {
+  return (timeout == OSPORT_WAIT_FOREVER) ? WAIT_FOREVER_MS : nowMs() + timeout;
+}
+
+static void taskEntry(Task *task) {
+  currentTask = task;
+  {
+    std::unique_lock<std::mutex> lock(schedMutex);
+    if (virtualTime) waitForCPU(lock, task);
+  }
+  try {
+    task->function(task->arg);
+  } catch (TaskDeleted &) {
+  }
+  std::unique_lock<std::mutex> lock(schedMutex);
+  task->deleted = true;
+  if (runningTask == task) {
+    runningTask = NULL;
+    dispatch();
+  }
+  /* The handle may still be referenced, tasks are not freed */
+}
+
+static void startTask(Task *task) {
+  if (virtualTime) {
+    task->ready = true;
+    task->readyOrder = readyCounter++;
+    if (runningTask == NULL) dispatch();
+  }
+  std::thread(taskEntry, task).detach();
+}
+
+namespace OSPort {
+
+bool createTask(TaskFunction function, const char *name, uint32_t, void *arg,
+                int priority, TaskHandle *handle) {
+  std::unique_lock<std::mutex> lock(schedMutex);
+  Task *task = newTask(name, function, arg, priority);
+  if (handle != NULL) *handle = task;
+  startTask(task);
+  return true;
+}
+
+void deleteTask(TaskHandle handle) {
+  std::unique_lock<std::mutex> lock(schedMutex);
+  Task *task = (handle == NULL) ? self(lock) : (Task *)handle;
+  task->deleted = true;
+  if (task == currentTask) throw TaskDeleted();
+  makeReady(task);
+}
+
+void suspendTask(TaskHandle handle) {
+  std::unique_lock<std::mutex> lock(schedMutex);
+  Task *task = (handle == NULL) ? self(lock) : (Task *)handle;
+  task->suspended = true;
+  if (task == currentTask) checkpoint(lock, task);
+}
+
+void resumeTask(TaskHandle handle) {
+  std::unique_lock<std::mutex> lock(schedMutex);
+  Task *task = (Task *)handle;
+  task->suspended = false;
+  if (task->waitObject == task) makeReady(task);
+}
+
+void delay(uint32_t ms) {
+  std::unique_lock<std::mutex> lock(schedMutex);
+  Task *task = self(lock);
+  /* Notifications do not end a delay */
+  blockOn(lock, task, NULL, nowMs() + ms, [] { return false; });
+  checkpoint(lock, task);
+}
+
+void delayUntil(uint32_t *lastWakeTime, uint32_t period) {
+  uint32_t elapsed = getTickMs() - *lastWakeTime;
+  *lastWakeTime += period;
+  delay((elapsed < period) ? (period - elapsed) : 0);
+}
+
+uint32_t getTickMs() {
+  return (uint32_t)nowMs();
+}
+
+int64_t getTimeMs() {
+  return nowMs();
+}
+
+int64_t getTimeUs() {
+  if (virtualTime) return virtualNow.load() * 1000;
+  return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - bootTime).count();
+}
+
+void notifyGive(TaskHandle handle) {
+  std::unique_lock<std::mutex> lock(schedMutex);
+  Task *task = (Task *)handle;
+  task->notifyCount++;
+  if (task->waitObject == task) makeReady(task);
+}
+
+uint32_t notifyTake(uint32_t timeout) {
+  std::unique_lock<std::mutex> lock(schedMutex);
+  Task *task = self(lock);
+  uint32_t count = 0;
+  if (blockOn(lock, task, task, toDeadline(timeout), [task] { return task->notifyCount > 0; })) {
+    count = task->notifyCount;
+    task->notifyCount = 0;
+  }
+  checkpoint(lock, task);
+  return count;
+}
+
+Mutex createMutex() {
+  PortMutex *mutex = new PortMutex();
+  mutex->owner = NULL;
+  return mutex;
+}
+
+bool lock(Mutex handle, uint32_t timeout) {
+  std::unique_lock<std::mutex> lock(schedMutex);
+  PortMutex *mutex = (PortMutex *)handle;
+  Task *task = self(lock);
+  if (!blockOn(lock, task, mutex, toDeadline(timeout), [mutex] { return mutex->owner == NULL; })) {
+    return false;
+  }
+  mutex->owner = task;
+  return true;
+}
+
+void unlock(Mutex handle) {
+  std::unique_lock<std::mutex> lock(schedMutex);
+  PortMutex *mutex = (PortMutex *)handle;
+  mutex->owner = NULL;
+  wakeObject(mutex);
+}
+
+/* Each timer has its own task, like the FreeRTOS timer task the function must not block long */
+struct SoftTimer {
+  std::string name;
+  uint32_t period;
+  bool autoReload;
+  TimerFunction function;
+  void *arg;
+  bool active;
+  /* Incremented on every start/stop so a pending expiry is discarded */
+  uint32_t generation;
+};
+
+static void timerTask(void *arg) {
+  SoftTimer *timer = (SoftTimer *)arg;
+  Task *task = currentTask;
+  std::unique_lock<std::mutex> lock(schedMutex);
+  while (1) {
+    blockOn(lock, task, timer, WAIT_FOREVER_MS, [timer] { return timer->active; });
+    uint32_t generation = timer->generation;
+    if (blockOn(lock, task, timer, nowMs() + timer->period,
+                [timer, generation] { return !timer->active || timer->generation != generation; })) {
+      /* Stopped or restarted */
+      continue;
+    }
+    if (!timer->autoReload) timer->active = false;
+    lock.unlock();
+    timer->function(timer->arg);
+    lock.lock();
+  }
+}
+
+Timer createTimer(const char *name, uint32_t period, bool autoReload, TimerFunction function, void *arg) {
+  SoftTimer *timer = new SoftTimer();
+  timer->name = name;
+  timer->period = period;
+  timer->autoReload = autoReload;
+  timer->function = function;
+  timer->arg = arg;
+  timer->active = false;
+  timer->generation = 0;
+  std::unique_lock<std::mutex> lock(schedMutex);
+  startTask(newTask(name, timerTask, timer, TIMER_TASK_PRIORITY));
+  return timer;
+}
+
+bool startTimer(Timer handle) {
+  std::unique_lock<std::mutex> lock(schedMutex);
+  SoftTimer *timer = (SoftTimer *)handle;
+  timer->active = true;
+  timer->generation++;
+  wakeObject(timer);
+  return true;
+}
+
+bool stopTimer(Timer handle) {
+  std::unique_lock<std::mutex> lock(schedMutex);
+  SoftTimer *timer = (SoftTimer *)handle;
+  timer->active = false;
+  timer->generation++;
+  wakeObject(timer);
+  return true;
+}
+
+}
+
+namespace OSPortHost {
+
+void enableVirtualTime() {
+  std::unique_lock<std::mutex> lock(schedMutex);
+  if (virtualTime) return;
+  virtualTime = true;
+  virtualNow.store(0);
+  virtualStartReal = Clock::now();
+  /* The calling thread owns the CPU until it blocks */
+  if (currentTask == NULL) currentTask = newTask("main", NULL, NULL, FOREIGN_TASK_PRIORITY);
+  runningTask = currentTask;
+  atexit(printSpeedup);
+}
+
+bool isVirtualTime() {
+  return virtualTime;
+}
+
+double getSpeedup() {
+  if (!virtualTime) return 1;
+  double real = std::chrono::duration<double, std::milli>(Clock::now() - virtualStartReal).count();
+  return (real > 0) ? virtualNow.load() / real : 0;
+}
+
+void printSpeedup() {
+  if (!virtualTime) return;
+  double real = std::chrono::duration<double>(Clock::now() - virtualStartReal).count();
+  printf("Virtual time %.1f s in %.2f s wall clock, speedup %.0fx\n",
+         virtualNow.load() / 1000.0, real, getSpeedup());
+}
+
+}
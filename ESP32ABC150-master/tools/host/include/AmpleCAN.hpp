@@ -0,0 +1,80 @@
+/*
+ * AmpleCAN.hpp
+ *
+ * Host replacement for the AmpleNetwork CAN layer. CANDriver keeps the frames
+ * written to it instead of sending them, derive from it to put something else
+ * on the other end of the bus. writeFrames() is the batch write of the
+ * AmpleNetwork drivers. AmpleCAN::receive() hands a frame to the
+ * listener registered for its ID like the receive task does on the ESP32.
+ */
+
+#ifndef _HOST_AMPLECAN_HPP_
+#define _HOST_AMPLECAN_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <map>
+#include <mutex>
+#include <vector>
+
+typedef enum {
+  CAN_frame_std = 0,
+  CAN_frame_ext = 1
+} CAN_frame_format_t;
+
+typedef union {
+  uint32_t U;
+  struct {
+    uint8_t DLC:4;
+    unsigned int unknown_2:2;
+    unsigned int RTR:1;
+    CAN_frame_format_t FF:1;
+    unsigned int reserved_24:24;
+  } B;
+} CAN_FIR_t;
+
+typedef struct {
+  CAN_FIR_t FIR;
+  uint32_t MsgID;
+  union {
+    uint8_t u8[8];
+    uint32_t u32[2];
+  } data;
+} CAN_frame_t;
+
+class CANDriver {
+public:
+  virtual ~CANDriver() {}
+  /* Keeps the frame, returns 0 like a successful write */
+  virtual int CAN_write_frame(const CAN_frame_t *p_frame);
+  /* Writes frames to the transmit buffers in order, at most as many as are free, returns the number written.
+   * One CAN_write_frame() per frame unless the driver can do better. */
+  virtual int writeFrames(const CAN_frame_t *frames, int count);
+  /* Frames written since the last call, oldest first */
+  std::vector<CAN_frame_t> takeFrames();
+
+private:
+  std::mutex framesMutex;
+  std::vector<CAN_frame_t> frames;
+};
+
+class AmpleCANListener {
+public:
+  virtual ~AmpleCANListener() {}
+  virtual void msgReceived(CAN_frame_t &msg) = 0;
+};
+
+class AmpleCAN {
+public:
+  CANDriver &can;
+
+  AmpleCAN(CANDriver &_can);
+  void registerListener(uint32_t id, AmpleCANListener *listener);
+  /* Passes a received frame to its listener, false if none is registered */
+  bool receive(CAN_frame_t &msg);
+
+private:
+  std::map<uint32_t, AmpleCANListener*> listeners;
+};
+
+#endif /* _HOST_AMPLECAN_HPP_ */
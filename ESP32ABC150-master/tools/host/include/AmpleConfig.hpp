@@ -0,0 +1,21 @@
+/*
+ * AmpleConfig.hpp
+ *
+ * Host replacement for main/include/AmpleConfig.hpp, only the contactor pins
+ * the plate tests switch.
+ */
+
+#ifndef _HOST_AMPLECONFIG_HPP_
+#define _HOST_AMPLECONFIG_HPP_
+
+#include "PCAL6416a.hpp"
+
+namespace CONFIG {
+namespace CONTACTORS {
+  const PCAL6416a::gpio preChargeCtrlPin = PCAL6416a::P0_5;
+  const PCAL6416a::gpio relayNCtrlPin = PCAL6416a::P0_6;
+  const PCAL6416a::gpio relayPCtrlPin = PCAL6416a::P0_7;
+}
+}
+
+#endif /* _HOST_AMPLECONFIG_HPP_ */
@@ -0,0 +1,30 @@
+/*
+ * AmpleLogger.hpp
+ *
+ * Host replacement for the AmpleNetwork loggers. Start and end of a test are
+ * logged through ESP_LOGI, the drive cycle power of every control period is
+ * dropped.
+ */
+
+#ifndef _HOST_AMPLELOGGER_HPP_
+#define _HOST_AMPLELOGGER_HPP_
+
+class TestLogger {
+public:
+  void logStartTime(const char *testName);
+  void logEndTime(const char *testName);
+  void logDriveCyclePower(float setpoint, float measured);
+};
+
+class BatteryModuleLogger {
+public:
+  void log12v(bool enabled);
+};
+
+class AmpleLogger {
+public:
+  static TestLogger *getTestLogger();
+  static BatteryModuleLogger *getBatteryModuleLogger();
+};
+
+#endif /* _HOST_AMPLELOGGER_HPP_ */
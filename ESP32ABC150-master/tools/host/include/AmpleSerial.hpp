@@ -0,0 +1,37 @@
+/*
+ * AmpleSerial.hpp
+ *
+ * Host replacement for the console UART, reads stdin and writes stdout.
+ */
+
+#ifndef _HOST_AMPLESERIAL_HPP_
+#define _HOST_AMPLESERIAL_HPP_
+
+#include <string>
+#include <iostream>
+
+#define GREEN                       "\033[32m"
+#define RED                         "\033[31m"
+#define RESET                       "\033[0m"
+
+typedef int uart_port_t;
+#define UART_NUM_0                  0
+
+class AmpleSerial {
+public:
+  AmpleSerial(uart_port_t _port = UART_NUM_0);
+  /* Next character, 0 at the end of the input */
+  char rx_char();
+  bool readNumber(int &number, const char *prompt);
+  bool readNumber(unsigned int &number, const char *prompt);
+  bool readFloatNumber(float &number, const char *prompt);
+  bool readString(char *buffer, int size, const char *prompt);
+  void clear();
+
+private:
+  uart_port_t port;
+
+  bool readLine(std::string &line, const char *prompt);
+};
+
+#endif /* _HOST_AMPLESERIAL_HPP_ */
@@ -0,0 +1,101 @@
+/*
+ * BatteryModuleCollection.hpp
+ *
+ * Host replacement for the battery module collection the plate CAN handler
+ * fills on the ESP32. Here the harness adds the modules and sets their state
+ * directly.
+ */
+
+#ifndef _HOST_BATTERYMODULECOLLECTION_HPP_
+#define _HOST_BATTERYMODULECOLLECTION_HPP_
+
+#include <vector>
+#include <iostream>
+#include <string>
+#include <string.h>
+#include <assert.h>
+#include <sstream>
+
+using namespace std;
+
+#define NUM_CELLS                   96
+#define NUM_THERMISTORS             32
+
+struct BatteryInfo {
+  float voltage;
+  float current;
+  float soc;
+  int onlineCount;
+  int HVOnCount;
+  float maxTemp;
+  float avgTemp;
+  float availablePower;
+  float availableEnergy;
+  float chargingPower;
+  float chargingCurrent;
+  float minCellVoltage;
+  float maxCellVoltage;
+};
+
+struct BatteryModuleInfo {
+  int id;
+  int batteryID;
+  bool online;
+  bool onlineStatus;
+  bool manualForceOffline;
+  bool charging;
+  bool HVOn;
+  bool used;
+  bool shortCircuitError;
+  bool cellVoltageError;
+  bool voltageDiffError;
+  bool busVoltageDiffError;
+  bool tempError;
+  bool currentError;
+  bool tempSensingFailure;
+  bool voltageSensingFailure;
+  bool FETFailure;
+  bool otherHardwareFailure;
+  float voltage;
+  float busVoltage;
+  float bmVoltage;
+  float current;
+  float maxCellVoltage;
+  float minCellVoltage;
+  float avgTemp;
+  float maxTemp;
+  float soc;
+  float availablePower;
+  float availableEnergy;
+  float chargingPower;
+  float chargingCurrent;
+  float cellVoltages[NUM_CELLS];
+  float sensorTemperatures[NUM_THERMISTORS];
+  int softwareVersion;
+  int maxTempID;
+  int minCellVoltageID;
+  int maxCellVoltageID;
+};
+
+class BatteryModuleCollection {
+public:
+  static BatteryModuleCollection &collection();
+  /* Online module with all cells at cellVoltage, returns it for further setup */
+  BatteryModuleInfo *addBatteryModule(unsigned int id, int batteryID, float cellVoltage = 3.7f);
+  BatteryInfo *getBatteryInfo();
+  BatteryModuleInfo *getBatteryModuleByID(unsigned int id);
+  BatteryModuleInfo *getBatteryModuleByBatteryID(int batteryID);
+  int count();
+  int getAllBatteryModules(BatteryModuleInfo **bms, int size);
+  bool isBMErrors(BatteryModuleInfo *bmInfo);
+  bool isBMCriticalErrors(BatteryModuleInfo *bmInfo);
+  bool isBMPlateErrors(BatteryModuleInfo *bmInfo);
+  int getHVCount();
+
+private:
+  /* Modules are never removed, pointers to them stay valid */
+  vector<BatteryModuleInfo*> modules;
+  BatteryInfo batteryInfo = {};
+};
+
+#endif /* _HOST_BATTERYMODULECOLLECTION_HPP_ */
@@ -0,0 +1,33 @@
+/*
+ * DriveCycleEncoder.hpp
+ *
+ * Host side of DriveCycleCodec.hpp: compresses drive cycle samples for
+ * DRIVECYCLE_ENCODING_RICE images. Not part of the firmware, which only
+ * decodes.
+ */
+
+#ifndef _DRIVECYCLEENCODER_HPP_
+#define _DRIVECYCLEENCODER_HPP_
+
+#include "DriveCycleCodec.hpp"
+#include <stdint.h>
+#include <vector>
+
+class DriveCycleEncoder {
+public:
+  DriveCycleEncoder(std::vector<uint8_t> &_out);
+  void encode(int16_t sample);
+  /* Pads the last byte */
+  void finish();
+
+private:
+  std::vector<uint8_t> &out;
+  RiceState rice;
+  int32_t previous;
+  uint32_t bits;
+  int bitCount;
+
+  void writeBits(uint32_t value, int count);
+};
+
+#endif /* _DRIVECYCLEENCODER_HPP_ */
@@ -0,0 +1,21 @@
+/*
+ * ESP32_CAN.hpp
+ *
+ * Host replacement for the ESP32 TWAI driver, keeps the frames written.
+ */
+
+#ifndef _HOST_ESP32_CAN_HPP_
+#define _HOST_ESP32_CAN_HPP_
+
+#include "AmpleCAN.hpp"
+#include "driver/gpio.h"
+
+#define CAN_SPEED_250KBPS           250
+#define CAN_SPEED_500KBPS           500
+
+class ESP32_CAN: public CANDriver {
+public:
+  ESP32_CAN(int, gpio_num_t, gpio_num_t, int) {}
+};
+
+#endif /* _HOST_ESP32_CAN_HPP_ */
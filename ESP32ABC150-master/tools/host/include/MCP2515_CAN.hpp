@@ -0,0 +1,115 @@
+/*
+ * MCP2515_CAN.hpp
+ *
+ * Host replacement for the MCP2515 driver. Keeps the frames written like
+ * CANDriver and models the register file behind the SPI instructions the
+ * driver uses: masks and filters only take writes in configuration mode, and
+ * every instruction counts as one SPI transaction. The driver starts in
+ * normal mode with the filters off, receiving every frame.
+ *
+ * A frame requested with RTS leaves the bus after its bit time at the given
+ * rate, in OSPort time, one at a time: the pending buffer with the highest
+ * TXP first, of equal ones the highest numbered. CAN_write_frame() sends a
+ * frame through one free buffer (READ STATUS, LOAD TX BUFFER, RTS).
+ * writeFrames() loads up to all three in one WRITE when they are free,
+ * control registers with descending TXP included, and requests them with a
+ * single RTS.
+ */
+
+#ifndef _HOST_MCP2515_CAN_HPP_
+#define _HOST_MCP2515_CAN_HPP_
+
+#include "AmpleCAN.hpp"
+#include <mutex>
+#include <vector>
+
+#define MCP2515_MASKS               2
+#define MCP2515_FILTERS             6
+#define MCP2515_REGISTERS           0x80
+
+/* Registers, datasheet table 11-1 */
+#define MCP2515_RXF0SIDH            0x00
+#define MCP2515_RXF3SIDH            0x10
+#define MCP2515_RXM0SIDH            0x20
+#define MCP2515_CANSTAT             0x0E
+#define MCP2515_CANCTRL             0x0F
+#define MCP2515_RXB0CTRL            0x60
+#define MCP2515_RXB1CTRL            0x70
+#define MCP2515_TXB0CTRL            0x30
+/* TXBnCTRL of buffer n at MCP2515_TXB0CTRL + n * MCP2515_TXB_STRIDE */
+#define MCP2515_TXB_STRIDE          0x10
+#define MCP2515_TX_BUFFERS          3
+
+/* CANCTRL.REQOP and CANSTAT.OPMOD */
+#define MCP2515_MODE_MASK           0xE0
+#define MCP2515_MODE_NORMAL         0x00
+#define MCP2515_MODE_CONFIG         0x80
+/* RXBnCTRL.RXM, filters off; RXB0CTRL.BUKT, roll over into RXB1 */
+#define MCP2515_RXM_ANY             0x60
+#define MCP2515_BUKT                0x04
+/* TXBnCTRL.TXREQ and TXP */
+#define MCP2515_TXREQ               0x08
+#define MCP2515_TXP_MASK            0x03
+/* READ STATUS: TXREQ of buffer n */
+#define MCP2515_STATUS_TXREQ(n)     (0x04 << (2 * (n)))
+
+class MCP2515_CAN: public CANDriver {
+public:
+  MCP2515_CAN(int speedKbps, int);
+
+  int CAN_write_frame(const CAN_frame_t *p_frame);
+  int writeFrames(const CAN_frame_t *frames, int count);
+
+  /* Writes RXM0-1 and RXF0-5 (standard IDs) in configuration mode, switches the filters on and returns to
+   * normal mode. False if the chip does not confirm a mode. */
+  bool setAcceptanceFilter(const uint16_t *masks, const uint16_t *filters);
+  /* A received standard frame would be loaded into RXB0 or RXB1 and interrupt */
+  bool accepts(uint32_t id);
+
+  uint8_t readRegister(uint8_t address);
+  uint32_t getSPITransactions();
+  uint32_t getSPIBytes();
+  /* Frames that found no free transmit buffer */
+  uint32_t getRejectedFrames();
+  /* Frames that left the bus since the last call, in bus order */
+  std::vector<CAN_frame_t> takeTransmitted();
+
+private:
+  uint8_t registers[MCP2515_REGISTERS];
+  uint32_t spiTransactions;
+  uint32_t spiBytes;
+  uint32_t rejectedFrames;
+  uint32_t bitRate;
+  /* Time of the RTS per transmit buffer, and when the bus is free again */
+  int64_t requestUs[MCP2515_TX_BUFFERS];
+  int64_t busFreeUs;
+  std::vector<CAN_frame_t> transmitted;
+  std::mutex spiMutex;
+
+  /* SPI instructions, each sends what the bus had time for first */
+  void instruction(uint32_t bytes);
+  void write(uint8_t address, const uint8_t *data, int count);
+  void bitModify(uint8_t address, uint8_t mask, uint8_t data);
+  uint8_t read(uint8_t address);
+  uint8_t readStatus();
+  void loadTxBuffer(int buffer, const CAN_frame_t &frame);
+  void requestToSend(uint8_t buffers);
+
+  /* The register file behind them */
+  void store(uint8_t address, const uint8_t *data, int count);
+  uint8_t load(uint8_t address);
+
+  bool setMode(uint8_t mode);
+  /* Standard ID of a mask or filter from its SIDH address */
+  uint16_t readID(uint8_t address);
+  static uint8_t filterAddress(int filter);
+  /* TXBnSIDH to TXBnD7 of a frame */
+  static void encodeFrame(const CAN_frame_t &frame, uint8_t *bytes);
+  CAN_frame_t decodeFrame(int buffer);
+  /* Sends the requested frames the bus had time for until now */
+  void transmit();
+  /* Bit time of a frame with the most stuff bits and the interframe space */
+  int64_t wireUs(const CAN_frame_t &frame);
+};
+
+#endif /* _HOST_MCP2515_CAN_HPP_ */
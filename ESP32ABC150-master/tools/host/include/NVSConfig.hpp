@@ -0,0 +1,24 @@
+/*
+ * NVSConfig.hpp
+ *
+ * Host replacement for the NVS configuration, every key reads as 0 until set.
+ */
+
+#ifndef _HOST_NVSCONFIG_HPP_
+#define _HOST_NVSCONFIG_HPP_
+
+enum NVSKey {
+  MCP2515_CAN_ENABLE,
+  ESP32_CAN_ENABLE,
+  MIN_CAR_OPERATING_VOLTAGE,
+  MAX_CAR_OPERATING_VOLTAGE,
+  NVS_KEYS
+};
+
+class NVSConfig {
+public:
+  static int getInt(int key);
+  static void setInt(int key, int value);
+};
+
+#endif /* _HOST_NVSCONFIG_HPP_ */
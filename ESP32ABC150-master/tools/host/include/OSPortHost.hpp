@@ -0,0 +1,22 @@
+/*
+ * OSPortHost.hpp
+ *
+ * Host only extensions of OSPort.
+ */
+
+#ifndef _OSPORTHOST_HPP_
+#define _OSPORTHOST_HPP_
+
+namespace OSPortHost {
+
+/* Switches to virtual time, call before creating any task. The calling thread becomes a task. */
+void enableVirtualTime();
+bool isVirtualTime();
+/* Virtual time elapsed per wall clock time since enableVirtualTime() */
+double getSpeedup();
+/* Also called at exit when virtual time is enabled */
+void printSpeedup();
+
+}
+
+#endif /* _OSPORTHOST_HPP_ */
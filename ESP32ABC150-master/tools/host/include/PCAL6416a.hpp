@@ -0,0 +1,22 @@
+/*
+ * PCAL6416a.hpp
+ *
+ * Host replacement for the PCAL6416A I/O expander, keeps the output levels.
+ */
+
+#ifndef _HOST_PCAL6416A_HPP_
+#define _HOST_PCAL6416A_HPP_
+
+class PCAL6416a {
+public:
+  enum gpio {P0_0, P0_1, P0_2, P0_3, P0_4, P0_5, P0_6, P0_7, GPIOS};
+
+  static PCAL6416a *getInstance();
+  void gpioSetValue(gpio pin, int value);
+  int gpioGetValue(gpio pin);
+
+private:
+  int levels[GPIOS] = {};
+};
+
+#endif /* _HOST_PCAL6416A_HPP_ */
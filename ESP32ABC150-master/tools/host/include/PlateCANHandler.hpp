@@ -0,0 +1,29 @@
+/*
+ * PlateCANHandler.hpp
+ *
+ * Host replacement for the plate CAN handler. HV on and off switch the
+ * modules of BatteryModuleCollection directly instead of commanding them.
+ */
+
+#ifndef _HOST_PLATECANHANDLER_HPP_
+#define _HOST_PLATECANHANDLER_HPP_
+
+#include "AmpleCAN.hpp"
+
+class PlateCANHandler {
+public:
+  PlateCANHandler(AmpleCAN &_can, unsigned int _ampleID, int minVoltage, int maxVoltage, void *arg,
+                  bool enable);
+  /* All online modules in use */
+  void HVOn();
+  void HVOff();
+  void HVOn(int batteryID);
+  void HVOff(int batteryID);
+  void setBMState(int batteryID, bool used);
+
+private:
+  AmpleCAN &can;
+  unsigned int ampleID;
+};
+
+#endif /* _HOST_PLATECANHANDLER_HPP_ */
@@ -0,0 +1,30 @@
+/*
+ * gpio.h
+ *
+ * Host replacement for the ESP-IDF GPIO driver, levels are kept per pin.
+ */
+
+#ifndef _HOST_DRIVER_GPIO_H_
+#define _HOST_DRIVER_GPIO_H_
+
+typedef enum {
+  GPIO_NUM_0 = 0,
+  GPIO_NUM_21 = 21,
+  GPIO_NUM_22 = 22,
+  GPIO_NUM_25 = 25,
+  GPIO_NUM_26 = 26,
+  GPIO_NUM_35 = 35,
+  GPIO_NUM_MAX = 40
+} gpio_num_t;
+
+typedef enum {
+  GPIO_MODE_INPUT = 1,
+  GPIO_MODE_OUTPUT = 2
+} gpio_mode_t;
+
+void gpio_pad_select_gpio(int gpio_num);
+int gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode);
+int gpio_set_level(gpio_num_t gpio_num, unsigned int level);
+int gpio_get_level(gpio_num_t gpio_num);
+
+#endif /* _HOST_DRIVER_GPIO_H_ */
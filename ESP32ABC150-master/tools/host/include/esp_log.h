@@ -0,0 +1,22 @@
+/*
+ * esp_log.h
+ *
+ * Host replacement for the ESP-IDF log macros, prints to stdout.
+ */
+
+#ifndef _HOST_ESP_LOG_H_
+#define _HOST_ESP_LOG_H_
+
+#include <stdio.h>
+#include "OSPort.hpp"
+
+#define HOST_LOG(letter, tag, format, ...) \
+  printf(letter " (%lld) %s: " format "\n", (long long)OSPort::getTimeMs(), tag, ##__VA_ARGS__)
+
+#define ESP_LOGE(tag, format, ...)  HOST_LOG("E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...)  HOST_LOG("W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...)  HOST_LOG("I", tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...)  do {} while (0)
+#define ESP_LOGV(tag, format, ...)  do {} while (0)
+
+#endif /* _HOST_ESP_LOG_H_ */
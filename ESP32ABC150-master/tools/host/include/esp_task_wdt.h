@@ -0,0 +1,10 @@
+/*
+ * esp_task_wdt.h
+ *
+ * The task watchdog does not exist on the host.
+ */
+
+#ifndef _HOST_ESP_TASK_WDT_H_
+#define _HOST_ESP_TASK_WDT_H_
+
+#endif /* _HOST_ESP_TASK_WDT_H_ */